@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2013 Colin Walters <walters@verbum.org>
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ostree-bootconfig-parser.h"
+
+G_BEGIN_DECLS
+
+/* Serialized form of a bootconfig: (options, overlay initrds) */
+#define _OSTREE_BOOTCONFIG_PARSER_GVARIANT_FORMAT "(a{ss}as)"
+
+GVariant *_ostree_bootconfig_parser_to_variant (OstreeBootconfigParser *self);
+
+OstreeBootconfigParser *_ostree_bootconfig_parser_new_from_variant (GVariant *v);
+
+G_END_DECLS
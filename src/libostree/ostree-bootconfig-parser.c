@@ -17,7 +17,7 @@
 
 #include "config.h"
 
-#include "ostree-bootconfig-parser.h"
+#include "ostree-bootconfig-parser-private.h"
 #include "otutil.h"
 
 struct _OstreeBootconfigParser
@@ -56,6 +56,46 @@ ostree_bootconfig_parser_clone (OstreeBootconfigParser *self)
   return parser;
 }
 
+/* Serialize the parsed state; used by the sysroot deployment cache so that
+ * a warm load doesn't need to re-read the BLS entries.
+ */
+GVariant *
+_ostree_bootconfig_parser_to_variant (OstreeBootconfigParser *self)
+{
+  g_auto (GVariantBuilder) builder = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&builder, (GVariantType *)"a{ss}");
+  GLNX_HASH_TABLE_FOREACH_KV (self->options, const char *, k, const char *, v)
+    g_variant_builder_add (&builder, "{ss}", k, v);
+
+  const char *const empty[] = { NULL };
+  const char *const *initrds = self->overlay_initrds ? (const char *const *)self->overlay_initrds
+                                                     : empty;
+  return g_variant_new ("(@a{ss}^as)", g_variant_builder_end (&builder), initrds);
+}
+
+/* Reverse of the above. */
+OstreeBootconfigParser *
+_ostree_bootconfig_parser_new_from_variant (GVariant *v)
+{
+  g_autoptr (OstreeBootconfigParser) parser = ostree_bootconfig_parser_new ();
+  g_autoptr (GVariant) options = NULL;
+  g_autofree char **initrds = NULL;
+  g_variant_get (v, "(@a{ss}^a&s)", &options, &initrds);
+
+  GVariantIter viter;
+  const char *k;
+  const char *val;
+  g_variant_iter_init (&viter, options);
+  while (g_variant_iter_next (&viter, "{&s&s}", &k, &val))
+    g_hash_table_replace (parser->options, g_strdup (k), g_strdup (val));
+
+  if (initrds && *initrds)
+    parser->overlay_initrds = g_strdupv (initrds);
+  parser->parsed = TRUE;
+
+  return g_steal_pointer (&parser);
+}
+
 /**
  * ostree_bootconfig_parser_parse_at:
  * @self: Parser
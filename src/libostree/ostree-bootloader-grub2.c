@@ -285,6 +285,85 @@ _ostree_bootloader_grub2_generate_config (OstreeSysroot *sysroot, int bootversio
   return TRUE;
 }
 
+/* In-process equivalent of the ostree-grub-generator script; this avoids
+ * forking a shell (and a number of processes for each entry) on every
+ * deployment change for systems which don't use the system grub2-mkconfig.
+ */
+static gboolean
+grub2_write_builtin_config (OstreeBootloaderGrub2 *self, int bootversion, GFile *target,
+                            GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GPtrArray) loader_configs = NULL;
+  if (!_ostree_sysroot_read_boot_loader_configs (self->sysroot, bootversion, &loader_configs,
+                                                 cancellable, error))
+    return FALSE;
+
+  /* Default to /boot if OSTREE_BOOT_PARTITION is not set and /boot is on the
+   * same device as /ostree/repo */
+  const char *boot_prefix = g_getenv ("OSTREE_BOOT_PARTITION");
+  if (boot_prefix == NULL)
+    {
+      struct stat boot_stbuf;
+      struct stat repo_stbuf;
+      if (!glnx_fstatat_allow_noent (self->sysroot->sysroot_fd, "boot/ostree", &boot_stbuf, 0,
+                                     error))
+        return FALSE;
+      const gboolean have_boot_ostree = (errno == 0);
+      if (!glnx_fstatat_allow_noent (self->sysroot->sysroot_fd, "ostree/repo", &repo_stbuf, 0,
+                                     error))
+        return FALSE;
+      const gboolean have_repo = (errno == 0);
+      if (have_boot_ostree && have_repo && boot_stbuf.st_dev == repo_stbuf.st_dev)
+        boot_prefix = "/boot";
+      else
+        boot_prefix = "";
+    }
+
+  g_autoptr (GString) output = g_string_new (
+      "# This file was generated by ostree-grub-generator. Do not modify the generated file - all "
+      "changes will\n"
+      "# be lost the next time file is regenerated. For more details refer to the "
+      "ostree-grub-generator script.\n"
+      "serial --unit=0 --speed=115200 --word=8 --parity=no --stop=1\n"
+      "default=boot\n"
+      "timeout=10\n"
+      "\n");
+
+  for (guint i = 0; i < loader_configs->len; i++)
+    {
+      OstreeBootconfigParser *config = loader_configs->pdata[i];
+
+      const char *title = ostree_bootconfig_parser_get (config, "title");
+      if (!title)
+        title = "(Untitled)";
+      const char *kernel = ostree_bootconfig_parser_get (config, "linux");
+      if (!kernel)
+        return glnx_throw (error, "No \"linux\" key in bootloader config");
+      const char *options = ostree_bootconfig_parser_get (config, "options");
+      const char *initrd = ostree_bootconfig_parser_get (config, "initrd");
+      const char *devicetree = ostree_bootconfig_parser_get (config, "devicetree");
+
+      g_autofree char *quoted_title = g_shell_quote (title);
+      g_string_append_printf (output, "menuentry %s {\n", quoted_title);
+      g_string_append_printf (output, "\t linux %s%s", boot_prefix, kernel);
+      if (options)
+        g_string_append_printf (output, " %s", options);
+      g_string_append_c (output, '\n');
+      if (initrd)
+        g_string_append_printf (output, "\t initrd %s%s\n", boot_prefix, initrd);
+      if (devicetree)
+        g_string_append_printf (output, "\t devicetree %s%s\n", boot_prefix, devicetree);
+      g_string_append (output, "}\n\n");
+    }
+
+  if (!glnx_file_replace_contents_at (AT_FDCWD, gs_file_get_path_cached (target),
+                                      (guint8 *)output->str, output->len,
+                                      GLNX_FILE_REPLACE_DATASYNC_NEW, cancellable, error))
+    return FALSE;
+
+  return TRUE;
+}
+
 typedef struct
 {
   const char *root;
@@ -347,6 +426,85 @@ grub2_child_setup (gpointer user_data)
     }
 }
 
+#define GRUB2_GENERATOR_PATH TARGET_PREFIX "/lib/ostree/ostree-grub-generator"
+
+/* The in-process generator is only used by default if the installed
+ * ostree-grub-generator is the one we were built with (or is missing), so
+ * that downstream customizations of the script keep being honored.
+ */
+static gboolean
+grub2_generator_is_unmodified (gboolean *out_unmodified, GCancellable *cancellable, GError **error)
+{
+  *out_unmodified = FALSE;
+#ifdef GRUB2_GENERATOR_SHA256
+  if (!glnx_fstatat_allow_noent (AT_FDCWD, GRUB2_GENERATOR_PATH, NULL, 0, error))
+    return FALSE;
+  if (errno == ENOENT)
+    {
+      *out_unmodified = TRUE;
+      return TRUE;
+    }
+
+  g_autofree char *checksum = ot_checksum_file_at (AT_FDCWD, GRUB2_GENERATOR_PATH,
+                                                   G_CHECKSUM_SHA256, cancellable, error);
+  if (!checksum)
+    return FALSE;
+  *out_unmodified = g_str_equal (checksum, GRUB2_GENERATOR_SHA256);
+  if (!*out_unmodified)
+    g_debug ("%s has been modified, executing it", GRUB2_GENERATOR_PATH);
+#endif
+  return TRUE;
+}
+
+/* Execute grub2-mkconfig (or a replacement generator) to write @target */
+static gboolean
+grub2_spawn_mkconfig (OstreeBootloaderGrub2 *self, const char *grub_exec,
+                      const char *grub2_mkconfig_chroot, int bootversion, GFile *target,
+                      GError **error)
+{
+  const char *grub_argv[4] = { NULL, "-o", NULL, NULL };
+  Grub2ChildSetupData cdata = {
+    NULL,
+  };
+  grub_argv[0] = grub_exec;
+  grub_argv[2] = gs_file_get_path_cached (target);
+
+  GSpawnFlags grub_spawnflags = G_SPAWN_SEARCH_PATH;
+  const bool running_in_systemd = getenv ("INVOCATION_ID") != NULL;
+  const bool debug_grub2 = g_getenv ("OSTREE_DEBUG_GRUB2");
+  /* If we're running in systemd (as part of `ostree-finalize-staged.service`)
+   * then we do want to gather output from the binary so that if something fails
+   * we can debug it.
+   *
+   * We also have an opt-in variable to display errors.
+   */
+  if (!(running_in_systemd || debug_grub2))
+    grub_spawnflags |= G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
+  cdata.root = grub2_mkconfig_chroot;
+  g_autofree char *bootversion_str = g_strdup_printf ("%u", (guint)bootversion);
+  cdata.bootversion_str = bootversion_str;
+  cdata.is_efi = self->is_efi;
+  /* Note in older versions of the grub2 package, this script doesn't even try
+     to be atomic; it just does:
+
+     cat ${grub_cfg}.new > ${grub_cfg}
+     rm -f ${grub_cfg}.new
+
+     Upstream is fixed though.
+  */
+  int grub2_estatus;
+  if (!g_spawn_sync (NULL, (char **)grub_argv, NULL, grub_spawnflags, grub2_child_setup, &cdata,
+                     NULL, NULL, &grub2_estatus, error))
+    return FALSE;
+  if (!g_spawn_check_exit_status (grub2_estatus, error))
+    {
+      g_prefix_error (error, "%s: ", grub_argv[0]);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 /* Main entrypoint for writing GRUB configuration. */
 static gboolean
 _ostree_bootloader_grub2_write_config (OstreeBootloader *bootloader, int bootversion,
@@ -356,22 +514,36 @@ _ostree_bootloader_grub2_write_config (OstreeBootloader *bootloader, int bootver
   OstreeBootloaderGrub2 *self = OSTREE_BOOTLOADER_GRUB2 (bootloader);
 
   /* Autotests can set this envvar to select which code path to test, useful for OS installers as
-   * well */
+   * well.  The special value "builtin" selects the in-process generator.  Any other value is a
+   * program to execute, such as a (possibly customized) copy of the ostree-grub-generator script.
+   */
   gboolean use_system_grub2_mkconfig = TRUE;
+  gboolean use_builtin_generator = FALSE;
 #ifdef USE_BUILTIN_GRUB2_MKCONFIG
   use_system_grub2_mkconfig = FALSE;
 #endif
   const gchar *grub_exec = g_getenv ("OSTREE_GRUB2_EXEC");
-  if (grub_exec)
+  if (g_strcmp0 (grub_exec, "builtin") == 0)
+    {
+      use_system_grub2_mkconfig = FALSE;
+      use_builtin_generator = TRUE;
+    }
+  else if (grub_exec)
     {
+      use_builtin_generator = FALSE;
       if (g_str_has_suffix (grub_exec, GRUB2_MKCONFIG_PATH))
         use_system_grub2_mkconfig = TRUE;
       else
         use_system_grub2_mkconfig = FALSE;
     }
+  else if (use_system_grub2_mkconfig)
+    grub_exec = GRUB2_MKCONFIG_PATH;
   else
-    grub_exec = use_system_grub2_mkconfig ? GRUB2_MKCONFIG_PATH
-                                          : TARGET_PREFIX "/lib/ostree/ostree-grub-generator";
+    {
+      grub_exec = GRUB2_GENERATOR_PATH;
+      if (!grub2_generator_is_unmodified (&use_builtin_generator, cancellable, error))
+        return FALSE;
+    }
 
   g_autofree char *grub2_mkconfig_chroot = NULL;
   if (use_system_grub2_mkconfig && ostree_sysroot_get_booted_deployment (self->sysroot) == NULL
@@ -415,45 +587,14 @@ _ostree_bootloader_grub2_write_config (OstreeBootloader *bootloader, int bootver
                                                       "boot/loader.%d/grub.cfg", bootversion);
     }
 
-  const char *grub_argv[4] = { NULL, "-o", NULL, NULL };
-  Grub2ChildSetupData cdata = {
-    NULL,
-  };
-  grub_argv[0] = grub_exec;
-  grub_argv[2] = gs_file_get_path_cached (new_config_path);
-
-  GSpawnFlags grub_spawnflags = G_SPAWN_SEARCH_PATH;
-  const bool running_in_systemd = getenv ("INVOCATION_ID") != NULL;
-  const bool debug_grub2 = g_getenv ("OSTREE_DEBUG_GRUB2");
-  /* If we're running in systemd (as part of `ostree-finalize-staged.service`)
-   * then we do want to gather output from the binary so that if something fails
-   * we can debug it.
-   *
-   * We also have an opt-in variable to display errors.
-   */
-  if (!(running_in_systemd || debug_grub2))
-    grub_spawnflags |= G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
-  cdata.root = grub2_mkconfig_chroot;
-  g_autofree char *bootversion_str = g_strdup_printf ("%u", (guint)bootversion);
-  cdata.bootversion_str = bootversion_str;
-  cdata.is_efi = self->is_efi;
-  /* Note in older versions of the grub2 package, this script doesn't even try
-     to be atomic; it just does:
-
-     cat ${grub_cfg}.new > ${grub_cfg}
-     rm -f ${grub_cfg}.new
-
-     Upstream is fixed though.
-  */
-  int grub2_estatus;
-  if (!g_spawn_sync (NULL, (char **)grub_argv, NULL, grub_spawnflags, grub2_child_setup, &cdata,
-                     NULL, NULL, &grub2_estatus, error))
-    return FALSE;
-  if (!g_spawn_check_exit_status (grub2_estatus, error))
+  if (use_builtin_generator)
     {
-      g_prefix_error (error, "%s: ", grub_argv[0]);
-      return FALSE;
+      if (!grub2_write_builtin_config (self, bootversion, new_config_path, cancellable, error))
+        return FALSE;
     }
+  else if (!grub2_spawn_mkconfig (self, grub_exec, grub2_mkconfig_chroot, bootversion,
+                                  new_config_path, error))
+    return FALSE;
 
   /* Now let's fdatasync() for the new file */
   {
@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ostree-bsdiff.h"
+
+/* A bsdiff generator producing patches for the vendored bspatch.  It
+ * follows the reference bsdiff algorithm, but indexes the old file with
+ * a 32 bit suffix array built in linear time by SA-IS (Nong, Zhang and
+ * Chan, "Two Efficient Algorithms for Linear Time Suffix Array
+ * Construction") rather than qsufsort's O(n log n) time and 16 bytes of
+ * memory per input byte.  The index is kept separate from the diff so
+ * that one old file can be compared against several new ones.
+ */
+
+struct _OstreeBsdiffIndex
+{
+  GBytes *old_content;
+  const guint8 *old;
+  gint64 old_size;
+  /* Suffix array of the old content including the empty suffix, which
+   * sorts first; old_size + 1 entries.
+   */
+  gint32 *sa;
+};
+
+/* At the top level the input is the old content with every byte shifted
+ * up by one and a virtual 0 sentinel appended; the reduced problems are
+ * arrays of names which already end with a unique 0.
+ */
+typedef struct
+{
+  const guint8 *bytes;
+  const gint32 *names;
+  gint32 n;
+} SaisString;
+
+static inline gint32
+sais_chr (const SaisString *s, gint32 i)
+{
+  if (s->bytes)
+    return i == s->n - 1 ? 0 : s->bytes[i] + 1;
+  return s->names[i];
+}
+
+/* Bit set for S-type suffixes, clear for L-type */
+static inline gboolean
+sais_is_s (const guint8 *types, gint32 i)
+{
+  return (types[i >> 3] >> (i & 7)) & 1;
+}
+
+static inline void
+sais_set_s (guint8 *types, gint32 i)
+{
+  types[i >> 3] |= 1 << (i & 7);
+}
+
+static inline gboolean
+sais_is_lms (const guint8 *types, gint32 i)
+{
+  return i > 0 && sais_is_s (types, i) && !sais_is_s (types, i - 1);
+}
+
+static void
+sais_get_buckets (const SaisString *s, gint32 *buckets, gint32 alphabet_size, gboolean end)
+{
+  gint32 sum = 0;
+
+  memset (buckets, 0, sizeof (gint32) * alphabet_size);
+  for (gint32 i = 0; i < s->n; i++)
+    buckets[sais_chr (s, i)]++;
+  for (gint32 i = 0; i < alphabet_size; i++)
+    {
+      sum += buckets[i];
+      buckets[i] = end ? sum : sum - buckets[i];
+    }
+}
+
+static void
+sais_induce (const SaisString *s, const guint8 *types, gint32 *sa, gint32 *buckets,
+             gint32 alphabet_size)
+{
+  /* L-type suffixes from the start of their buckets, left to right */
+  sais_get_buckets (s, buckets, alphabet_size, FALSE);
+  for (gint32 i = 0; i < s->n; i++)
+    {
+      gint32 j = sa[i] - 1;
+      if (j >= 0 && !sais_is_s (types, j))
+        sa[buckets[sais_chr (s, j)]++] = j;
+    }
+
+  /* Then S-type suffixes from the end of their buckets, right to left */
+  sais_get_buckets (s, buckets, alphabet_size, TRUE);
+  for (gint32 i = s->n - 1; i >= 0; i--)
+    {
+      gint32 j = sa[i] - 1;
+      if (j >= 0 && sais_is_s (types, j))
+        sa[--buckets[sais_chr (s, j)]] = j;
+    }
+}
+
+static void
+sais (const SaisString *s, gint32 *sa, gint32 alphabet_size)
+{
+  const gint32 n = s->n;
+
+  if (n == 1)
+    {
+      sa[0] = 0;
+      return;
+    }
+
+  /* The sentinel is S-type, and so the suffix before it is L-type */
+  g_autofree guint8 *types = g_malloc0 (n / 8 + 1);
+  sais_set_s (types, n - 1);
+  for (gint32 i = n - 3; i >= 0; i--)
+    {
+      gint32 c = sais_chr (s, i);
+      gint32 next = sais_chr (s, i + 1);
+      if (c < next || (c == next && sais_is_s (types, i + 1)))
+        sais_set_s (types, i);
+    }
+
+  /* Sort the LMS substrings by inducing from their unsorted positions */
+  g_autofree gint32 *buckets = g_new (gint32, alphabet_size);
+  sais_get_buckets (s, buckets, alphabet_size, TRUE);
+  for (gint32 i = 0; i < n; i++)
+    sa[i] = -1;
+  for (gint32 i = 1; i < n; i++)
+    {
+      if (sais_is_lms (types, i))
+        sa[--buckets[sais_chr (s, i)]] = i;
+    }
+  sais_induce (s, types, sa, buckets, alphabet_size);
+  g_clear_pointer (&buckets, g_free);
+
+  /* Gather the sorted LMS substrings; there are at most n/2 of them */
+  gint32 n1 = 0;
+  for (gint32 i = 0; i < n; i++)
+    {
+      if (sais_is_lms (types, sa[i]))
+        sa[n1++] = sa[i];
+    }
+
+  /* Name them, with equal substrings getting equal names, storing the
+   * name of the substring at position p at n1 + p / 2.
+   */
+  for (gint32 i = n1; i < n; i++)
+    sa[i] = -1;
+  gint32 n_names = 0;
+  gint32 prev = -1;
+  for (gint32 i = 0; i < n1; i++)
+    {
+      const gint32 pos = sa[i];
+      gboolean differs = FALSE;
+      for (gint32 d = 0; d < n; d++)
+        {
+          if (prev == -1 || sais_chr (s, pos + d) != sais_chr (s, prev + d)
+              || sais_is_s (types, pos + d) != sais_is_s (types, prev + d))
+            {
+              differs = TRUE;
+              break;
+            }
+          else if (d > 0 && (sais_is_lms (types, pos + d) || sais_is_lms (types, prev + d)))
+            break;
+        }
+      if (differs)
+        {
+          n_names++;
+          prev = pos;
+        }
+      sa[n1 + pos / 2] = n_names - 1;
+    }
+  for (gint32 i = n - 1, j = n - 1; i >= n1; i--)
+    {
+      if (sa[i] >= 0)
+        sa[j--] = sa[i];
+    }
+
+  /* Sort the reduced string, recursing unless all the names are unique */
+  gint32 *sa1 = sa;
+  gint32 *s1 = sa + n - n1;
+  if (n_names < n1)
+    {
+      SaisString reduced = { NULL, s1, n1 };
+      sais (&reduced, sa1, n_names);
+    }
+  else
+    {
+      for (gint32 i = 0; i < n1; i++)
+        sa1[s1[i]] = i;
+    }
+
+  /* And induce the full suffix array from the sorted LMS suffixes */
+  buckets = g_new (gint32, alphabet_size);
+  sais_get_buckets (s, buckets, alphabet_size, TRUE);
+  for (gint32 i = 1, j = 0; i < n; i++)
+    {
+      if (sais_is_lms (types, i))
+        s1[j++] = i;
+    }
+  for (gint32 i = 0; i < n1; i++)
+    sa1[i] = s1[sa1[i]];
+  for (gint32 i = n1; i < n; i++)
+    sa[i] = -1;
+  for (gint32 i = n1 - 1; i >= 0; i--)
+    {
+      gint32 j = sa[i];
+      sa[i] = -1;
+      sa[--buckets[sais_chr (s, j)]] = j;
+    }
+  sais_induce (s, types, sa, buckets, alphabet_size);
+}
+
+/* Building the suffix array peaks at about 6.25 bytes per old byte: the
+ * array itself, the buckets of the first reduced problem and the type
+ * bits.  Add the old and new content, and the patch which is normally
+ * smaller than the new content.
+ */
+guint64
+_ostree_bsdiff_memory_estimate (guint64 old_size, guint64 new_size)
+{
+  return (old_size + 1) * 7 + old_size + 2 * new_size;
+}
+
+/* bspatch reads lengths into an int */
+static gboolean
+check_size (gsize size, GError **error)
+{
+  if (size >= G_MAXINT32)
+    return glnx_throw (error, "File too large for bsdiff: %" G_GSIZE_FORMAT " bytes", size);
+  return TRUE;
+}
+
+OstreeBsdiffIndex *
+_ostree_bsdiff_index_new (GBytes *old_content, GError **error)
+{
+  gsize old_size;
+  const guint8 *old = g_bytes_get_data (old_content, &old_size);
+
+  if (!check_size (old_size, error))
+    return NULL;
+
+  OstreeBsdiffIndex *index = g_new0 (OstreeBsdiffIndex, 1);
+  index->old_content = g_bytes_ref (old_content);
+  index->old = old;
+  index->old_size = old_size;
+  index->sa = g_new (gint32, old_size + 1);
+
+  SaisString s = { old, NULL, old_size + 1 };
+  sais (&s, index->sa, G_MAXUINT8 + 2);
+  /* The sentinel suffix is the empty one */
+  g_assert_cmpint (index->sa[0], ==, old_size);
+
+  return index;
+}
+
+void
+_ostree_bsdiff_index_free (OstreeBsdiffIndex *index)
+{
+  g_bytes_unref (index->old_content);
+  g_free (index->sa);
+  g_free (index);
+}
+
+const gint32 *
+_ostree_bsdiff_index_peek_suffix_array (OstreeBsdiffIndex *index, gsize *out_len)
+{
+  *out_len = index->old_size + 1;
+  return index->sa;
+}
+
+static gint64
+match_len (const guint8 *a, gint64 a_len, const guint8 *b, gint64 b_len)
+{
+  const gint64 len = MIN (a_len, b_len);
+  gint64 i;
+
+  for (i = 0; i < len && a[i] == b[i]; i++)
+    ;
+  return i;
+}
+
+/* Find the longest match of @buf in the old content */
+static gint64
+index_search (OstreeBsdiffIndex *index, const guint8 *buf, gint64 len, gint64 *out_pos)
+{
+  const guint8 *old = index->old;
+  const gint64 old_size = index->old_size;
+  const gint32 *sa = index->sa;
+  gint64 st = 0;
+  gint64 en = old_size;
+
+  while (en - st >= 2)
+    {
+      const gint64 x = st + (en - st) / 2;
+      if (memcmp (old + sa[x], buf, MIN (old_size - sa[x], len)) < 0)
+        st = x;
+      else
+        en = x;
+    }
+
+  const gint64 st_len = match_len (old + sa[st], old_size - sa[st], buf, len);
+  const gint64 en_len = match_len (old + sa[en], old_size - sa[en], buf, len);
+  if (st_len > en_len)
+    {
+      *out_pos = sa[st];
+      return st_len;
+    }
+  *out_pos = sa[en];
+  return en_len;
+}
+
+/* Sign and magnitude, little endian */
+static void
+append_offset (GByteArray *out, gint64 x)
+{
+  guint8 buf[8];
+  guint64 y = x < 0 ? -x : x;
+
+  for (guint i = 0; i < sizeof (buf); i++)
+    {
+      buf[i] = y & 0xff;
+      y >>= 8;
+    }
+  if (x < 0)
+    buf[7] |= 0x80;
+  g_byte_array_append (out, buf, sizeof (buf));
+}
+
+/* Generate a patch that turns the indexed old content into @new_content,
+ * in the format read by bspatch().
+ */
+GBytes *
+_ostree_bsdiff_index_diff (OstreeBsdiffIndex *index, GBytes *new_content, GError **error)
+{
+  gsize new_size_u;
+  const guint8 *new = g_bytes_get_data (new_content, &new_size_u);
+  const gint64 new_size = new_size_u;
+  const guint8 *old = index->old;
+  const gint64 old_size = index->old_size;
+
+  if (!check_size (new_size_u, error))
+    return NULL;
+
+  g_autoptr (GByteArray) out = g_byte_array_new ();
+  gint64 scan = 0, len = 0, pos = 0;
+  gint64 last_scan = 0, last_pos = 0, last_offset = 0;
+
+  while (scan < new_size)
+    {
+      gint64 old_score = 0;
+      gint64 scsc;
+
+      /* Look for the next match which is better than continuing the
+       * previous one with an offset
+       */
+      for (scsc = scan += len; scan < new_size; scan++)
+        {
+          len = index_search (index, new + scan, new_size - scan, &pos);
+
+          for (; scsc < scan + len; scsc++)
+            {
+              if (scsc + last_offset < old_size && old[scsc + last_offset] == new[scsc])
+                old_score++;
+            }
+
+          if ((len == old_score && len != 0) || len > old_score + 8)
+            break;
+
+          if (scan + last_offset < old_size && old[scan + last_offset] == new[scan])
+            old_score--;
+        }
+
+      if (len == old_score && scan != new_size)
+        continue;
+
+      /* Extend the previous match forwards and this one backwards */
+      gint64 s = 0, sf = 0, lenf = 0;
+      for (gint64 i = 0; last_scan + i < scan && last_pos + i < old_size;)
+        {
+          if (old[last_pos + i] == new[last_scan + i])
+            s++;
+          i++;
+          if (s * 2 - i > sf * 2 - lenf)
+            {
+              sf = s;
+              lenf = i;
+            }
+        }
+
+      gint64 lenb = 0;
+      if (scan < new_size)
+        {
+          gint64 sb = 0;
+          s = 0;
+          for (gint64 i = 1; scan >= last_scan + i && pos >= i; i++)
+            {
+              if (old[pos - i] == new[scan - i])
+                s++;
+              if (s * 2 - i > sb * 2 - lenb)
+                {
+                  sb = s;
+                  lenb = i;
+                }
+            }
+        }
+
+      /* If they overlap, find the best place to split */
+      if (last_scan + lenf > scan - lenb)
+        {
+          const gint64 overlap = (last_scan + lenf) - (scan - lenb);
+          gint64 ss = 0, lens = 0;
+          s = 0;
+          for (gint64 i = 0; i < overlap; i++)
+            {
+              if (new[last_scan + lenf - overlap + i] == old[last_pos + lenf - overlap + i])
+                s++;
+              if (new[scan - lenb + i] == old[pos - lenb + i])
+                s--;
+              if (s > ss)
+                {
+                  ss = s;
+                  lens = i + 1;
+                }
+            }
+          lenf += lens - overlap;
+          lenb -= lens;
+        }
+
+      const gint64 extra_len = (scan - lenb) - (last_scan + lenf);
+      append_offset (out, lenf);
+      append_offset (out, extra_len);
+      append_offset (out, (pos - lenb) - (last_pos + lenf));
+
+      const guint diff_start = out->len;
+      g_byte_array_set_size (out, diff_start + lenf);
+      for (gint64 i = 0; i < lenf; i++)
+        out->data[diff_start + i] = new[last_scan + i] - old[last_pos + i];
+      g_byte_array_append (out, new + last_scan + lenf, extra_len);
+
+      last_scan = scan - lenb;
+      last_pos = pos - lenb;
+      last_offset = pos - scan;
+    }
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&out));
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "libglnx.h"
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _OstreeBsdiffIndex OstreeBsdiffIndex;
+
+guint64 _ostree_bsdiff_memory_estimate (guint64 old_size, guint64 new_size);
+
+OstreeBsdiffIndex *_ostree_bsdiff_index_new (GBytes *old_content, GError **error);
+
+void _ostree_bsdiff_index_free (OstreeBsdiffIndex *index);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeBsdiffIndex, _ostree_bsdiff_index_free)
+
+GBytes *_ostree_bsdiff_index_diff (OstreeBsdiffIndex *index, GBytes *new_content,
+                                   GError **error);
+
+/* For tests */
+const gint32 *_ostree_bsdiff_index_peek_suffix_array (OstreeBsdiffIndex *index, gsize *out_len);
+
+G_END_DECLS
@@ -26,6 +26,9 @@
 #include "ostree-chain-input-stream.h"
 #include "ostree-core-private.h"
 #include "ostree-varint.h"
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-decompressor.h"
+#endif
 #include "ostree.h"
 #include "otutil.h"
 #include <gio/gfiledescriptorbased.h>
@@ -568,6 +571,47 @@ ostree_raw_file_to_content_stream (GInputStream *input, GFileInfo *file_info, GV
   return TRUE;
 }
 
+/* Archive objects written with "[archive] compression=zstd" hold a zstd
+ * frame rather than raw deflate data.  zlib never starts a raw deflate
+ * stream with the zstd frame magic, so sniff it rather than requiring
+ * callers to know how the object was written.
+ */
+static GInputStream *
+archive_content_decompress (GInputStream *input, GCancellable *cancellable, GError **error)
+{
+  static const guint8 zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+  g_autoptr (GBufferedInputStream) buffered
+      = (GBufferedInputStream *)g_buffered_input_stream_new (input);
+
+  gsize available;
+  while ((available = g_buffered_input_stream_get_available (buffered)) < sizeof (zstd_magic))
+    {
+      gssize n_read = g_buffered_input_stream_fill (buffered, sizeof (zstd_magic) - available,
+                                                    cancellable, error);
+      if (n_read < 0)
+        return NULL;
+      else if (n_read == 0)
+        break;
+    }
+
+  guint8 magic[sizeof (zstd_magic)];
+  g_autoptr (GConverter) decomp = NULL;
+  if (g_buffered_input_stream_peek (buffered, magic, 0, sizeof (magic)) == sizeof (magic)
+      && memcmp (magic, zstd_magic, sizeof (magic)) == 0)
+    {
+#ifdef HAVE_ZSTD
+      decomp = (GConverter *)_ostree_zstd_decompressor_new ();
+#else
+      return glnx_null_throw (error, "Object is zstd compressed, which is not supported in this "
+                                     "build");
+#endif
+    }
+  else
+    decomp = (GConverter *)g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
+
+  return g_converter_input_stream_new ((GInputStream *)buffered, decomp);
+}
+
 /**
  * ostree_content_stream_parse:
  * @compressed: Whether or not the stream is zlib-compressed
@@ -636,9 +680,9 @@ ostree_content_stream_parse (gboolean compressed, GInputStream *input, guint64 i
        **/
       if (compressed)
         {
-          g_autoptr (GConverter) zlib_decomp
-              = (GConverter *)g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
-          ret_input = g_converter_input_stream_new (input, zlib_decomp);
+          ret_input = archive_content_decompress (input, cancellable, error);
+          if (!ret_input)
+            return FALSE;
         }
       else
         ret_input = g_object_ref (input);
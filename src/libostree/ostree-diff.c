@@ -413,6 +413,357 @@ out:
   return ret;
 }
 
+typedef struct
+{
+  const char *name;
+  gboolean is_dir;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+  char meta_checksum[OSTREE_SHA256_STRING_LEN + 1];
+} DiffTreeEntry;
+
+typedef struct
+{
+  OstreeRepo *repo;
+  OstreeDiffFlags flags;
+  OstreeDiffChangeFunc func;
+  gpointer user_data;
+  GString *path;
+} DiffCommitsData;
+
+/* Load the dirtree @contents_checksum and return its files and
+ * subdirectories as a single array sorted by name.  The names point into
+ * the returned @out_dirtree, which must outlive the array.
+ */
+static gboolean
+load_tree_entries (OstreeRepo *repo, const char *contents_checksum, GVariant **out_dirtree,
+                   GArray **out_entries, GError **error)
+{
+  g_autoptr (GVariant) dirtree = NULL;
+  if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_TREE, contents_checksum, &dirtree,
+                                 error))
+    return FALSE;
+
+  g_autoptr (GVariant) files_variant = g_variant_get_child_value (dirtree, 0);
+  g_autoptr (GVariant) dirs_variant = g_variant_get_child_value (dirtree, 1);
+  const guint nfiles = g_variant_n_children (files_variant);
+  const guint ndirs = g_variant_n_children (dirs_variant);
+
+  g_autoptr (GArray) entries
+      = g_array_sized_new (FALSE, FALSE, sizeof (DiffTreeEntry), nfiles + ndirs);
+  guint i = 0;
+  guint j = 0;
+  /* Both arrays are sorted by name, and a name is never in both */
+  while (i < nfiles || j < ndirs)
+    {
+      DiffTreeEntry entry = {
+        NULL,
+      };
+      g_autoptr (GVariant) csum_v = NULL;
+      g_autoptr (GVariant) meta_csum_v = NULL;
+      const char *file_name = NULL;
+      const char *dir_name = NULL;
+
+      if (i < nfiles)
+        g_variant_get_child (files_variant, i, "(&s@ay)", &file_name, NULL);
+      if (j < ndirs)
+        g_variant_get_child (dirs_variant, j, "(&s@ay@ay)", &dir_name, NULL, NULL);
+
+      if (dir_name == NULL || (file_name != NULL && strcmp (file_name, dir_name) < 0))
+        {
+          g_variant_get_child (files_variant, i, "(&s@ay)", &entry.name, &csum_v);
+          i++;
+        }
+      else
+        {
+          g_variant_get_child (dirs_variant, j, "(&s@ay@ay)", &entry.name, &csum_v,
+                               &meta_csum_v);
+          entry.is_dir = TRUE;
+          j++;
+        }
+
+      const guchar *csum = ostree_checksum_bytes_peek_validate (csum_v, error);
+      if (!csum)
+        return FALSE;
+      ostree_checksum_inplace_from_bytes (csum, entry.checksum);
+      if (meta_csum_v)
+        {
+          csum = ostree_checksum_bytes_peek_validate (meta_csum_v, error);
+          if (!csum)
+            return FALSE;
+          ostree_checksum_inplace_from_bytes (csum, entry.meta_checksum);
+        }
+
+      g_array_append_val (entries, entry);
+    }
+
+  *out_dirtree = g_steal_pointer (&dirtree);
+  *out_entries = g_steal_pointer (&entries);
+  return TRUE;
+}
+
+static gboolean
+diff_entry_query (DiffCommitsData *data, const DiffTreeEntry *entry, GFileType *out_type,
+                  guint64 *out_size, GCancellable *cancellable, GError **error)
+{
+  *out_type = G_FILE_TYPE_UNKNOWN;
+  *out_size = 0;
+  if (entry == NULL)
+    return TRUE;
+  if (entry->is_dir)
+    {
+      *out_type = G_FILE_TYPE_DIRECTORY;
+      return TRUE;
+    }
+  /* Anything else needs the file object header */
+  if ((data->flags & OSTREE_DIFF_FLAGS_QUERY_FILE_INFO) == 0)
+    return TRUE;
+
+  g_autoptr (GFileInfo) finfo = NULL;
+  if (!ostree_repo_load_file (data->repo, entry->checksum, NULL, &finfo, NULL, cancellable, error))
+    return FALSE;
+  *out_type = g_file_info_get_file_type (finfo);
+  *out_size = g_file_info_get_size (finfo);
+  return TRUE;
+}
+
+static gboolean
+diff_emit_change (DiffCommitsData *data, OstreeDiffChangeType change_type,
+                  const DiffTreeEntry *src, const DiffTreeEntry *target,
+                  GCancellable *cancellable, GError **error)
+{
+  OstreeDiffChange change = {
+    .change_type = change_type,
+    .path = data->path->str,
+  };
+
+  if (src)
+    change.src_checksum = src->is_dir ? src->meta_checksum : src->checksum;
+  if (target)
+    change.target_checksum = target->is_dir ? target->meta_checksum : target->checksum;
+  if (!diff_entry_query (data, src, &change.src_type, &change.src_size, cancellable, error))
+    return FALSE;
+  if (!diff_entry_query (data, target, &change.target_type, &change.target_size, cancellable,
+                         error))
+    return FALSE;
+
+  return data->func (&change, data->user_data, error);
+}
+
+/* Merge-join the two dirtrees by name; either side may be %NULL, in which
+ * case everything in the other side is reported as added or removed.  A
+ * subdirectory whose dirtree and dirmeta checksums are the same on both
+ * sides is skipped without being loaded.
+ */
+static gboolean
+diff_trees (DiffCommitsData *data, const char *src_contents, const char *target_contents,
+            GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GVariant) src_dirtree = NULL;
+  g_autoptr (GVariant) target_dirtree = NULL;
+  g_autoptr (GArray) src_entries = NULL;
+  g_autoptr (GArray) target_entries = NULL;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  if (src_contents
+      && !load_tree_entries (data->repo, src_contents, &src_dirtree, &src_entries, error))
+    return FALSE;
+  if (target_contents
+      && !load_tree_entries (data->repo, target_contents, &target_dirtree, &target_entries, error))
+    return FALSE;
+
+  const guint n_src = src_entries ? src_entries->len : 0;
+  const guint n_target = target_entries ? target_entries->len : 0;
+  const gsize path_len = data->path->len;
+  guint i = 0;
+  guint j = 0;
+  while (i < n_src || j < n_target)
+    {
+      const DiffTreeEntry *src = i < n_src ? &g_array_index (src_entries, DiffTreeEntry, i) : NULL;
+      const DiffTreeEntry *target
+          = j < n_target ? &g_array_index (target_entries, DiffTreeEntry, j) : NULL;
+      int cmp;
+
+      if (src == NULL)
+        cmp = 1;
+      else if (target == NULL)
+        cmp = -1;
+      else
+        cmp = strcmp (src->name, target->name);
+
+      if (cmp < 0)
+        {
+          target = NULL;
+          i++;
+        }
+      else if (cmp > 0)
+        {
+          src = NULL;
+          j++;
+        }
+      else
+        {
+          i++;
+          j++;
+        }
+
+      g_string_append_c (data->path, '/');
+      g_string_append (data->path, src ? src->name : target->name);
+
+      if (src && target && src->is_dir && target->is_dir)
+        {
+          if (strcmp (src->meta_checksum, target->meta_checksum) != 0)
+            {
+              if (!diff_emit_change (data, OSTREE_DIFF_CHANGE_MODIFIED, src, target, cancellable,
+                                     error))
+                return FALSE;
+            }
+          if (strcmp (src->checksum, target->checksum) != 0)
+            {
+              if (!diff_trees (data, src->checksum, target->checksum, cancellable, error))
+                return FALSE;
+            }
+        }
+      else if (src && target)
+        {
+          /* Both files, or a change of type */
+          if (src->is_dir != target->is_dir || strcmp (src->checksum, target->checksum) != 0)
+            {
+              if (!diff_emit_change (data, OSTREE_DIFF_CHANGE_MODIFIED, src, target, cancellable,
+                                     error))
+                return FALSE;
+            }
+          if (src->is_dir && !diff_trees (data, src->checksum, NULL, cancellable, error))
+            return FALSE;
+          if (target->is_dir && !diff_trees (data, NULL, target->checksum, cancellable, error))
+            return FALSE;
+        }
+      else if (src)
+        {
+          if (!diff_emit_change (data, OSTREE_DIFF_CHANGE_REMOVED, src, NULL, cancellable, error))
+            return FALSE;
+          if (src->is_dir && !diff_trees (data, src->checksum, NULL, cancellable, error))
+            return FALSE;
+        }
+      else
+        {
+          if (!diff_emit_change (data, OSTREE_DIFF_CHANGE_ADDED, NULL, target, cancellable, error))
+            return FALSE;
+          if (target->is_dir && !diff_trees (data, NULL, target->checksum, cancellable, error))
+            return FALSE;
+        }
+
+      g_string_truncate (data->path, path_len);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+load_commit_root (OstreeRepo *repo, const char *rev, DiffTreeEntry *out_root, GError **error)
+{
+  g_autofree char *commit_checksum = NULL;
+  if (!ostree_repo_resolve_rev (repo, rev, FALSE, &commit_checksum, error))
+    return FALSE;
+
+  g_autoptr (GVariant) commit = NULL;
+  if (!ostree_repo_load_commit (repo, commit_checksum, &commit, NULL, error))
+    return FALSE;
+
+  g_autoptr (GVariant) contents_csum_v = NULL;
+  g_autoptr (GVariant) meta_csum_v = NULL;
+  g_variant_get_child (commit, 6, "@ay", &contents_csum_v);
+  g_variant_get_child (commit, 7, "@ay", &meta_csum_v);
+
+  const guchar *csum = ostree_checksum_bytes_peek_validate (contents_csum_v, error);
+  if (!csum)
+    return FALSE;
+  ostree_checksum_inplace_from_bytes (csum, out_root->checksum);
+  csum = ostree_checksum_bytes_peek_validate (meta_csum_v, error);
+  if (!csum)
+    return FALSE;
+  ostree_checksum_inplace_from_bytes (csum, out_root->meta_checksum);
+  out_root->name = "";
+  out_root->is_dir = TRUE;
+
+  return TRUE;
+}
+
+/**
+ * ostree_diff_commits:
+ * @repo: Repo
+ * @flags: Flags; only %OSTREE_DIFF_FLAGS_QUERY_FILE_INFO is supported
+ * @src: Source revision (ref or checksum)
+ * @target: Target revision (ref or checksum)
+ * @func: (scope call): Called once for each change
+ * @user_data: Data for @func
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Compute the difference between the trees of two commits in @repo,
+ * calling @func for each added, removed and modified path.  Unlike
+ * ostree_diff_dirs(), this compares the stored dirtree checksums
+ * directly, so subdirectories that are identical in both commits are
+ * skipped without being loaded, and no #GFile is created for anything.
+ *
+ * The contents of directories that are added or removed are reported
+ * as well.  A path that changed between a regular file or symlink and a
+ * directory is reported as modified, followed by the contents of the
+ * directory side.  Changes are reported in name order, depth first.
+ *
+ * The type and size of files are only filled in when
+ * %OSTREE_DIFF_FLAGS_QUERY_FILE_INFO is set in @flags, as that needs the
+ * file object to be read; see #OstreeDiffChange.  Extended attributes
+ * are part of the stored checksums, so %OSTREE_DIFF_FLAGS_IGNORE_XATTRS
+ * cannot be honored and is an error.
+ *
+ * If @func returns %FALSE, the diff stops and its error is propagated.
+ *
+ * Since: 2025.2
+ */
+gboolean
+ostree_diff_commits (OstreeRepo *repo, OstreeDiffFlags flags, const char *src, const char *target,
+                     OstreeDiffChangeFunc func, gpointer user_data, GCancellable *cancellable,
+                     GError **error)
+{
+  g_return_val_if_fail (OSTREE_IS_REPO (repo), FALSE);
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (target != NULL, FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  if ((flags & ~OSTREE_DIFF_FLAGS_QUERY_FILE_INFO) != 0)
+    return glnx_throw (error, "Unsupported diff flags 0x%x", (guint)flags);
+
+  DiffTreeEntry src_root = {
+    NULL,
+  };
+  DiffTreeEntry target_root = {
+    NULL,
+  };
+  if (!load_commit_root (repo, src, &src_root, error))
+    return FALSE;
+  if (!load_commit_root (repo, target, &target_root, error))
+    return FALSE;
+
+  g_autoptr (GString) path = g_string_new ("/");
+  DiffCommitsData data = { repo, flags, func, user_data, path };
+
+  if (strcmp (src_root.meta_checksum, target_root.meta_checksum) != 0)
+    {
+      if (!diff_emit_change (&data, OSTREE_DIFF_CHANGE_MODIFIED, &src_root, &target_root,
+                             cancellable, error))
+        return FALSE;
+    }
+
+  if (strcmp (src_root.checksum, target_root.checksum) == 0)
+    return TRUE;
+
+  /* Children are built as "/name" onto the path */
+  g_string_truncate (path, 0);
+  return diff_trees (&data, src_root.checksum, target_root.checksum, cancellable, error);
+}
+
 static void
 print_diff_item (char prefix, GFile *base, GFile *file)
 {
@@ -28,11 +28,17 @@ G_BEGIN_DECLS
 
 /**
  * OstreeDiffFlags:
+ * @OSTREE_DIFF_FLAGS_NONE: No flags
+ * @OSTREE_DIFF_FLAGS_IGNORE_XATTRS: Don't compare extended attributes; not supported by
+ *   ostree_diff_commits()
+ * @OSTREE_DIFF_FLAGS_QUERY_FILE_INFO: For ostree_diff_commits(), load each changed file to
+ *   report its type and size (Since: 2025.2)
  */
 typedef enum
 {
   OSTREE_DIFF_FLAGS_NONE = 0,
-  OSTREE_DIFF_FLAGS_IGNORE_XATTRS = (1 << 0)
+  OSTREE_DIFF_FLAGS_IGNORE_XATTRS = (1 << 0),
+  OSTREE_DIFF_FLAGS_QUERY_FILE_INFO = (1 << 1),
 } OstreeDiffFlags;
 
 /**
@@ -103,6 +109,75 @@ gboolean ostree_diff_dirs_with_options (OstreeDiffFlags flags, GFile *a, GFile *
                                         OstreeDiffDirsOptions *options, GCancellable *cancellable,
                                         GError **error);
 
+/**
+ * OstreeDiffChangeType:
+ * @OSTREE_DIFF_CHANGE_ADDED: Path only exists in the target
+ * @OSTREE_DIFF_CHANGE_REMOVED: Path only exists in the source
+ * @OSTREE_DIFF_CHANGE_MODIFIED: Path exists in both, with different content or metadata
+ *
+ * Since: 2025.2
+ */
+typedef enum
+{
+  OSTREE_DIFF_CHANGE_ADDED,
+  OSTREE_DIFF_CHANGE_REMOVED,
+  OSTREE_DIFF_CHANGE_MODIFIED,
+} OstreeDiffChangeType;
+
+/**
+ * OstreeDiffChange:
+ * @change_type: Kind of change
+ * @path: Absolute path in the commit tree
+ * @src_type: Type in the source, or %G_FILE_TYPE_UNKNOWN if added
+ * @target_type: Type in the target, or %G_FILE_TYPE_UNKNOWN if removed
+ * @src_checksum: Content checksum in the source (dirmeta checksum for directories),
+ *   or %NULL if added
+ * @target_checksum: Content checksum in the target (dirmeta checksum for directories),
+ *   or %NULL if removed
+ * @src_size: Size in the source; 0 for directories
+ * @target_size: Size in the target; 0 for directories
+ *
+ * A single change reported by ostree_diff_commits().  It is only valid
+ * for the duration of the callback.
+ *
+ * Finding the type and size of anything other than a directory requires
+ * reading the file object, so this is only done when
+ * %OSTREE_DIFF_FLAGS_QUERY_FILE_INFO is passed.  Otherwise, the type is
+ * %G_FILE_TYPE_UNKNOWN and the size 0 for files and symbolic links; use
+ * the checksums to tell whether a side is present.
+ *
+ * Since: 2025.2
+ */
+typedef struct
+{
+  OstreeDiffChangeType change_type;
+  const char *path;
+  GFileType src_type;
+  GFileType target_type;
+  const char *src_checksum;
+  const char *target_checksum;
+  guint64 src_size;
+  guint64 target_size;
+} OstreeDiffChange;
+
+/**
+ * OstreeDiffChangeFunc:
+ * @change: The change
+ * @user_data: User data
+ * @error: Error
+ *
+ * Returns: %TRUE to continue the diff, %FALSE (with @error set) to stop it
+ *
+ * Since: 2025.2
+ */
+typedef gboolean (*OstreeDiffChangeFunc) (const OstreeDiffChange *change, gpointer user_data,
+                                          GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_diff_commits (OstreeRepo *repo, OstreeDiffFlags flags, const char *src,
+                              const char *target, OstreeDiffChangeFunc func, gpointer user_data,
+                              GCancellable *cancellable, GError **error);
+
 _OSTREE_PUBLIC
 void ostree_diff_print (GFile *a, GFile *b, GPtrArray *modified, GPtrArray *removed,
                         GPtrArray *added);
@@ -101,6 +101,7 @@ struct FetcherRequest
   guint refcount;
   GPtrArray *mirrorlist;
   guint idx;
+  GArray *failed_mirrors; /* (element-type guint) */
 
   char *filename;
   guint64 current_size;
@@ -398,6 +399,12 @@ check_multi_info (OstreeFetcher *fetcher)
                 }
               else
                 {
+                  if (giocode != G_IO_ERROR_NOT_FOUND)
+                    {
+                      if (req->failed_mirrors == NULL)
+                        req->failed_mirrors = g_array_new (FALSE, FALSE, sizeof (guint));
+                      g_array_append_val (req->failed_mirrors, req->idx);
+                    }
                   continued_request = TRUE;
                 }
             }
@@ -683,6 +690,7 @@ request_unref (FetcherRequest *req)
     return;
 
   g_ptr_array_unref (req->mirrorlist);
+  g_clear_pointer (&req->failed_mirrors, g_array_unref);
   g_free (req->filename);
   g_clear_error (&req->caught_write_error);
   glnx_tmpfile_clear (&req->tmpf);
@@ -986,6 +994,14 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
   g_assert_cmpint (rc, ==, CURLM_OK);
   rc = curl_easy_setopt (req->easy, CURLOPT_LOW_SPEED_TIME, req->fetcher->opt_low_speed_time);
   g_assert_cmpint (rc, ==, CURLM_OK);
+  /* Requests aren't cancellable with curl, so this is the only way to
+   * bound how long a caller waits for them */
+  if (req->flags & OSTREE_FETCHER_REQUEST_SHORT_TIMEOUT)
+    {
+      rc = curl_easy_setopt (req->easy, CURLOPT_TIMEOUT,
+                             (long)OSTREE_FETCHER_SHORT_REQUEST_TIMEOUT);
+      g_assert_cmpint (rc, ==, CURLM_OK);
+    }
   /* closure bindings -> task */
   rc = curl_easy_setopt (req->easy, CURLOPT_PRIVATE, task);
   g_assert_cmpint (rc, ==, CURLM_OK);
@@ -1093,6 +1109,33 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
   return TRUE;
 }
 
+/* Returns the index in the mirrorlist passed to the request of the mirror
+ * which served it, or which was tried last if it failed.
+ */
+guint
+_ostree_fetcher_request_get_mirror_index (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), 0);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), 0);
+
+  FetcherRequest *req = g_task_get_task_data ((GTask *)result);
+  return req->idx;
+}
+
+/* Returns the indexes in the mirrorlist passed to the request of the
+ * mirrors which were skipped because of a server or transport error, rather
+ * than because they didn't have the file; %NULL if there were none.
+ */
+const GArray *
+_ostree_fetcher_request_get_failed_mirrors (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), NULL);
+
+  FetcherRequest *req = g_task_get_task_data ((GTask *)result);
+  return req->failed_mirrors;
+}
+
 void
 _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                    OstreeFetcherRequestFlags flags, const char *if_none_match,
@@ -89,6 +89,7 @@ typedef struct
   GPtrArray *mirrorlist; /* list of base URIs */
   char *filename;        /* relative name to fetch or NULL */
   guint mirrorlist_idx;
+  GArray *failed_mirrors; /* (element-type guint) */
 
   OstreeFetcherState state;
 
@@ -206,6 +207,7 @@ pending_uri_unref (OstreeFetcherPendingURI *pending)
   g_clear_pointer (&pending->thread_closure, thread_closure_unref);
 
   g_clear_pointer (&pending->mirrorlist, g_ptr_array_unref);
+  g_clear_pointer (&pending->failed_mirrors, g_array_unref);
   g_free (pending->filename);
   g_clear_object (&pending->request);
   g_clear_object (&pending->request_body);
@@ -1060,6 +1062,14 @@ on_request_sent (GObject *object, GAsyncResult *result, gpointer user_data)
           /* is there another mirror we can try? */
           if (pending->mirrorlist_idx + 1 < pending->mirrorlist->len)
             {
+              if (msg->status_code != SOUP_STATUS_CANCELLED
+                  && _ostree_fetcher_http_status_code_to_io_error (msg->status_code, FALSE)
+                         != G_IO_ERROR_NOT_FOUND)
+                {
+                  if (pending->failed_mirrors == NULL)
+                    pending->failed_mirrors = g_array_new (FALSE, FALSE, sizeof (guint));
+                  g_array_append_val (pending->failed_mirrors, pending->mirrorlist_idx);
+                }
               pending->mirrorlist_idx++;
               create_pending_soup_request (pending, &local_error);
               if (local_error != NULL)
@@ -1246,6 +1256,33 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
   return TRUE;
 }
 
+/* Returns the index in the mirrorlist passed to the request of the mirror
+ * which served it, or which was tried last if it failed.
+ */
+guint
+_ostree_fetcher_request_get_mirror_index (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), 0);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), 0);
+
+  OstreeFetcherPendingURI *pending = g_task_get_task_data ((GTask *)result);
+  return pending->mirrorlist_idx;
+}
+
+/* Returns the indexes in the mirrorlist passed to the request of the
+ * mirrors which were skipped because of a server or transport error, rather
+ * than because they didn't have the file; %NULL if there were none.
+ */
+const GArray *
+_ostree_fetcher_request_get_failed_mirrors (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), NULL);
+
+  OstreeFetcherPendingURI *pending = g_task_get_task_data ((GTask *)result);
+  return pending->failed_mirrors;
+}
+
 void
 _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                    OstreeFetcherRequestFlags flags, const char *if_none_match,
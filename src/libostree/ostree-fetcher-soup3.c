@@ -42,6 +42,7 @@ typedef struct
   GPtrArray *mirrorlist; /* list of base URIs */
   char *filename;        /* relative name to fetch or NULL */
   guint mirrorlist_idx;
+  GArray *failed_mirrors; /* (element-type guint) */
 
   SoupMessage *message;
   struct OstreeFetcher *fetcher;
@@ -100,6 +101,7 @@ fetcher_request_free (FetcherRequest *request)
 {
   g_debug ("Freeing request for %s", request->filename);
   g_clear_pointer (&request->mirrorlist, g_ptr_array_unref);
+  g_clear_pointer (&request->failed_mirrors, g_array_unref);
   g_clear_pointer (&request->filename, g_free);
   g_clear_object (&request->message);
   g_clear_pointer (&request->mainctx, g_main_context_unref);
@@ -613,6 +615,13 @@ on_request_sent (GObject *object, GAsyncResult *result, gpointer user_data)
           /* is there another mirror we can try? */
           if (request->mirrorlist_idx + 1 < request->mirrorlist->len)
             {
+              if (_ostree_fetcher_http_status_code_to_io_error (status, FALSE)
+                  != G_IO_ERROR_NOT_FOUND)
+                {
+                  if (request->failed_mirrors == NULL)
+                    request->failed_mirrors = g_array_new (FALSE, FALSE, sizeof (guint));
+                  g_array_append_val (request->failed_mirrors, request->mirrorlist_idx);
+                }
               request->mirrorlist_idx++;
               initiate_task_request (g_object_ref (task));
               return;
@@ -830,6 +839,33 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
   return TRUE;
 }
 
+/* Returns the index in the mirrorlist passed to the request of the mirror
+ * which served it, or which was tried last if it failed.
+ */
+guint
+_ostree_fetcher_request_get_mirror_index (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), 0);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), 0);
+
+  FetcherRequest *request = g_task_get_task_data ((GTask *)result);
+  return request->mirrorlist_idx;
+}
+
+/* Returns the indexes in the mirrorlist passed to the request of the
+ * mirrors which were skipped because of a server or transport error, rather
+ * than because they didn't have the file; %NULL if there were none.
+ */
+const GArray *
+_ostree_fetcher_request_get_failed_mirrors (OstreeFetcher *self, GAsyncResult *result)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), NULL);
+
+  FetcherRequest *request = g_task_get_task_data ((GTask *)result);
+  return request->failed_mirrors;
+}
+
 void
 _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                    OstreeFetcherRequestFlags flags, const char *if_none_match,
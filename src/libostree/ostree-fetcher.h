@@ -62,8 +62,12 @@ typedef enum
   OSTREE_FETCHER_REQUEST_NUL_TERMINATION = (1 << 0),
   OSTREE_FETCHER_REQUEST_OPTIONAL_CONTENT = (1 << 1),
   OSTREE_FETCHER_REQUEST_LINKABLE = (1 << 2),
+  /* Fail after OSTREE_FETCHER_SHORT_REQUEST_TIMEOUT seconds */
+  OSTREE_FETCHER_REQUEST_SHORT_TIMEOUT = (1 << 3),
 } OstreeFetcherRequestFlags;
 
+#define OSTREE_FETCHER_SHORT_REQUEST_TIMEOUT 5
+
 void _ostree_fetcher_uri_free (OstreeFetcherURI *uri);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeFetcherURI, _ostree_fetcher_uri_free)
 
@@ -128,6 +132,11 @@ gboolean _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncR
                                                     gboolean *out_not_modified, char **out_etag,
                                                     guint64 *out_last_modified, GError **error);
 
+guint _ostree_fetcher_request_get_mirror_index (OstreeFetcher *self, GAsyncResult *result);
+
+const GArray *_ostree_fetcher_request_get_failed_mirrors (OstreeFetcher *self,
+                                                          GAsyncResult *result);
+
 void _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
                                         const char *filename, OstreeFetcherRequestFlags flags,
                                         const char *if_none_match, guint64 if_modified_since,
@@ -348,6 +348,61 @@ out:
   return result;
 }
 
+/* Compute a checksum over the contents of all the keyrings and keys
+ * added to @self, so that a verification result can be reused for as
+ * long as they don't change.  Like _ostree_gpg_verifier_import_keys(),
+ * keyring files which don't exist are skipped.
+ */
+gboolean
+_ostree_gpg_verifier_checksum_keyrings (OstreeGpgVerifier *self, char **out_checksum,
+                                        GCancellable *cancellable, GError **error)
+{
+  g_auto (OtChecksum) checksum = {
+    0,
+  };
+  ot_checksum_init (&checksum);
+
+  for (GList *link = self->keyrings; link != NULL; link = link->next)
+    {
+      GFile *keyring_file = link->data;
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (AT_FDCWD, gs_file_get_path_cached (keyring_file), &fd, error))
+        return FALSE;
+      if (fd == -1)
+        continue;
+      g_autoptr (GBytes) bytes = glnx_fd_readall_bytes (fd, cancellable, error);
+      if (!bytes)
+        return FALSE;
+      ot_checksum_update_bytes (&checksum, bytes);
+    }
+
+  for (guint i = 0; i < self->keyring_data->len; i++)
+    ot_checksum_update_bytes (&checksum, self->keyring_data->pdata[i]);
+
+  /* Mark the switch to ASCII-armored keys */
+  ot_checksum_update (&checksum, (const guint8 *)"", 1);
+
+  if (self->key_ascii_files)
+    {
+      for (guint i = 0; i < self->key_ascii_files->len; i++)
+        {
+          const char *path = self->key_ascii_files->pdata[i];
+          glnx_autofd int fd = -1;
+          if (!glnx_openat_rdonly (AT_FDCWD, path, TRUE, &fd, error))
+            return FALSE;
+          g_autoptr (GBytes) bytes = glnx_fd_readall_bytes (fd, cancellable, error);
+          if (!bytes)
+            return FALSE;
+          ot_checksum_update_bytes (&checksum, bytes);
+        }
+    }
+
+  char hexdigest[_OSTREE_SHA256_STRING_LEN + 1];
+  ot_checksum_get_hexdigest (&checksum, hexdigest, sizeof (hexdigest));
+  *out_checksum = g_strdup (hexdigest);
+  return TRUE;
+}
+
 /* Given @path which should contain a GPG keyring file, add it
  * to the list of trusted keys.
  */
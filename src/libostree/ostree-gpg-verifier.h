@@ -48,6 +48,9 @@ OstreeGpgVerifyResult *_ostree_gpg_verifier_check_signature (OstreeGpgVerifier *
                                                              GCancellable *cancellable,
                                                              GError **error);
 
+gboolean _ostree_gpg_verifier_checksum_keyrings (OstreeGpgVerifier *self, char **out_checksum,
+                                                 GCancellable *cancellable, GError **error);
+
 gboolean _ostree_gpg_verifier_list_keys (OstreeGpgVerifier *self, const char *const *key_ids,
                                          GPtrArray **out_keys, GCancellable *cancellable,
                                          GError **error);
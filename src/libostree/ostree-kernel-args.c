@@ -104,13 +104,6 @@ kernel_args_entry_value_equal (gconstpointer data, gconstpointer value)
   return g_strcmp0 (_ostree_kernel_args_entry_get_value (e), value) == 0;
 }
 
-static gboolean
-kernel_args_entry_key_equal (gconstpointer data, gconstpointer key)
-{
-  const OstreeKernelArgsEntry *e = data;
-  return g_strcmp0 (_ostree_kernel_args_entry_get_key (e), key) == 0;
-}
-
 static void
 kernel_args_entry_replace_value (OstreeKernelArgsEntry *e, const char *value)
 {
@@ -119,12 +112,39 @@ kernel_args_entry_replace_value (OstreeKernelArgsEntry *e, const char *value)
   _ostree_kernel_args_entry_set_value (e, g_strdup (value));
 }
 
+/* Remove all of @entries from @order in a single pass, rather than shifting
+ * the array once per entry.
+ */
 static void
 kernel_args_remove_entries_from_order (GPtrArray *order, GPtrArray *entries)
 {
   g_assert (entries);
-  for (int i = 0; i < entries->len; i++)
-    g_assert (g_ptr_array_remove (order, entries->pdata[i]));
+  guint n_kept = 0;
+  for (guint i = 0; i < order->len; i++)
+    {
+      gpointer e = order->pdata[i];
+      if (!ot_ptr_array_find_with_equal_func (entries, e, NULL, NULL))
+        order->pdata[n_kept++] = e;
+    }
+  g_assert_cmpuint (order->len - n_kept, ==, entries->len);
+  g_ptr_array_set_size (order, n_kept);
+}
+
+/* Like kernel_args_remove_entries_from_order(), for a set of entries to
+ * remove which may span several keys.
+ */
+static void
+kernel_args_remove_entry_set_from_order (GPtrArray *order, GHashTable *entries)
+{
+  guint n_kept = 0;
+  for (guint i = 0; i < order->len; i++)
+    {
+      gpointer e = order->pdata[i];
+      if (!g_hash_table_contains (entries, e))
+        order->pdata[n_kept++] = e;
+    }
+  g_assert_cmpuint (order->len - n_kept, ==, g_hash_table_size (entries));
+  g_ptr_array_set_size (order, n_kept);
 }
 
 static char *
@@ -201,6 +221,38 @@ split_kernel_args (const char *str)
   return (char **)g_ptr_array_free (strv, FALSE);
 }
 
+/* Append a single argument, as returned by split_kernel_args(); takes
+ * ownership of @arg.  Entries for a key which is already present share
+ * the key owned by the hash table.
+ */
+static void
+kernel_args_append_take (OstreeKernelArgs *kargs, char *arg)
+{
+  const char *val = split_keyeq (arg);
+
+  OstreeKernelArgsEntry *entry = _ostree_kernel_args_entry_new ();
+  _ostree_kernel_args_entry_set_value (entry, g_strdup (val));
+
+  gpointer old_key;
+  gpointer old_entries_ptr;
+  GPtrArray *entries;
+  if (g_hash_table_lookup_extended (kargs->table, arg, &old_key, &old_entries_ptr))
+    {
+      entries = old_entries_ptr;
+      _ostree_kernel_args_entry_set_key (entry, old_key);
+      g_free (arg);
+    }
+  else
+    {
+      entries = g_ptr_array_new_with_free_func (kernel_args_entry_free_from_table);
+      _ostree_kernel_args_entry_set_key (entry, arg);
+      g_hash_table_replace (kargs->table, arg, entries);
+    }
+
+  g_ptr_array_add (entries, entry);
+  g_ptr_array_add (kargs->order, entry);
+}
+
 /**
  * ostree_kernel_args_new: (skip)
  *
@@ -426,51 +478,99 @@ ostree_kernel_args_delete_key_entry (OstreeKernelArgs *kargs, const char *key, G
 gboolean
 ostree_kernel_args_delete (OstreeKernelArgs *kargs, const char *arg, GError **error)
 {
-  // Split the arg
-  g_auto (GStrv) argv = split_kernel_args (arg);
-
-  for (char **iter = argv; iter && *iter; iter++)
-    {
-      g_autofree char *arg_owned = g_strdup (*iter);
+  const char *argv[] = { arg, NULL };
+  return ostree_kernel_args_delete_argv (kargs, (char **)argv, error);
+}
 
-      const char *key = arg_owned;
-      const char *val = split_keyeq (arg_owned);
+/* Delete a single argument as described for ostree_kernel_args_delete().  The
+ * entry is removed from the table, but left in the order array; it's added to
+ * @removed, which takes ownership of it.
+ */
+static gboolean
+kernel_args_delete_one (OstreeKernelArgs *kargs, const char *arg, GHashTable *removed,
+                        GError **error)
+{
+  g_autofree char *arg_owned = g_strdup (arg);
 
-      GPtrArray *entries = g_hash_table_lookup (kargs->table, key);
-      if (!entries)
-        return glnx_throw (error, "No key '%s' found", key);
-      g_assert_cmpuint (entries->len, >, 0);
+  const char *key = arg_owned;
+  const char *val = split_keyeq (arg_owned);
 
-      /* special-case: we allow deleting by key only if there's only one val */
-      if (entries->len == 1)
-        {
-          /* but if a specific val was passed, check that it's the same */
-          OstreeKernelArgsEntry *e = entries->pdata[0];
-          if (val && !strcmp0_equal (val, _ostree_kernel_args_entry_get_value (e)))
-            return glnx_throw (error, "No karg '%s=%s' found", key, val);
-          if (!ostree_kernel_args_delete_key_entry (kargs, key, error))
-            return glnx_throw (error, "Remove key entry '%s=%s' failed.", key, val);
-          continue;
-        }
+  GPtrArray *entries = g_hash_table_lookup (kargs->table, key);
+  if (!entries)
+    return glnx_throw (error, "No key '%s' found", key);
+  g_assert_cmpuint (entries->len, >, 0);
 
-      /* note val might be NULL here, in which case we're looking for `key`, not `key=` or
-       * `key=val` */
-      guint i = 0;
-      if (!ot_ptr_array_find_with_equal_func (entries, val, kernel_args_entry_value_equal, &i))
-        {
-          if (!val)
-            /* didn't find NULL -> only key= key=val1 key=val2 style things left, so the user
-             * needs to be more specific */
-            return glnx_throw (error, "Multiple values for key '%s' found", arg);
-          return glnx_throw (error, "No karg '%s' found", arg);
-        }
+  /* special-case: we allow deleting by key only if there's only one val */
+  if (entries->len == 1)
+    {
+      /* but if a specific val was passed, check that it's the same */
+      OstreeKernelArgsEntry *e = entries->pdata[0];
+      if (val && !strcmp0_equal (val, _ostree_kernel_args_entry_get_value (e)))
+        return glnx_throw (error, "No karg '%s=%s' found", key, val);
+
+      gpointer old_key;
+      gpointer old_entries;
+      g_assert (g_hash_table_steal_extended (kargs->table, key, &old_key, &old_entries));
+      g_hash_table_add (removed, g_ptr_array_steal_index (old_entries, 0));
+      g_ptr_array_unref (old_entries);
+      /* Nothing dereferences the key of a removed entry */
+      g_free (old_key);
+      return TRUE;
+    }
 
-      g_assert (g_ptr_array_remove (kargs->order, entries->pdata[i]));
-      g_assert (g_ptr_array_remove_index (entries, i));
+  /* note val might be NULL here, in which case we're looking for `key`, not `key=` or
+   * `key=val` */
+  guint i = 0;
+  if (!ot_ptr_array_find_with_equal_func (entries, val, kernel_args_entry_value_equal, &i))
+    {
+      if (!val)
+        /* didn't find NULL -> only key= key=val1 key=val2 style things left, so the user
+         * needs to be more specific */
+        return glnx_throw (error, "Multiple values for key '%s' found", arg);
+      return glnx_throw (error, "No karg '%s' found", arg);
     }
+
+  g_hash_table_add (removed, g_ptr_array_steal_index (entries, i));
   return TRUE;
 }
 
+/**
+ * ostree_kernel_args_delete_argv:
+ * @kargs: a OstreeKernelArgs instance
+ * @argv: an array of keys or key/value pairs for deletion
+ * @error: an GError instance
+ *
+ * Deletes each of @argv as described for ostree_kernel_args_delete(), in
+ * order.  This is more efficient than calling ostree_kernel_args_delete()
+ * for each argument, as the remaining arguments are only compacted once.
+ *
+ * On failure, the arguments preceding the one which failed have been
+ * deleted.
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ *
+ * Since: 2025.2
+ **/
+gboolean
+ostree_kernel_args_delete_argv (OstreeKernelArgs *kargs, char **argv, GError **error)
+{
+  g_autoptr (GHashTable) removed
+      = g_hash_table_new_full (NULL, NULL, kernel_args_entry_free_from_table, NULL);
+  gboolean ret = TRUE;
+  for (char **strviter = argv; ret && strviter && *strviter; strviter++)
+    {
+      // Split the arg
+      g_auto (GStrv) split = split_kernel_args (*strviter);
+      for (char **iter = split; ret && iter && *iter; iter++)
+        ret = kernel_args_delete_one (kargs, *iter, removed, error);
+    }
+
+  /* Also on failure, so that the order array matches the table */
+  if (g_hash_table_size (removed) > 0)
+    kernel_args_remove_entry_set_from_order (kargs->order, removed);
+  return ret;
+}
+
 /**
  * ostree_kernel_args_replace_take:
  * @kargs: a OstreeKernelArgs instance
@@ -503,9 +603,10 @@ ostree_kernel_args_replace_take (OstreeKernelArgs *kargs, char *arg)
       g_assert (old_entries);
       g_assert_cmpuint (old_entries->len, >, 0);
 
+      /* The first entry for a key is also its first occurrence in the order */
       guint old_order_index = 0;
-      g_assert (ot_ptr_array_find_with_equal_func (kargs->order, old_key,
-                                                   kernel_args_entry_key_equal, &old_order_index));
+      g_assert (ot_ptr_array_find_with_equal_func (kargs->order, old_entries->pdata[0], NULL,
+                                                   &old_order_index));
       kernel_args_remove_entries_from_order (kargs->order, old_entries);
 
       g_assert_cmpstr (old_key, ==, arg);
@@ -557,30 +658,7 @@ ostree_kernel_args_append (OstreeKernelArgs *kargs, const char *arg)
   g_auto (GStrv) argv = split_kernel_args (arg);
 
   for (char **iter = argv; iter && *iter; iter++)
-    {
-      gboolean existed = TRUE;
-      GPtrArray *entries = NULL;
-
-      char *duped = g_strdup (*iter);
-      const char *val = split_keyeq (duped);
-
-      entries = g_hash_table_lookup (kargs->table, duped);
-      if (!entries)
-        {
-          entries = g_ptr_array_new_with_free_func (kernel_args_entry_free_from_table);
-          existed = FALSE;
-        }
-
-      OstreeKernelArgsEntry *entry = _ostree_kernel_args_entry_new ();
-      _ostree_kernel_args_entry_set_key (entry, duped);
-      _ostree_kernel_args_entry_set_value (entry, g_strdup (val));
-
-      g_ptr_array_add (entries, entry);
-      g_ptr_array_add (kargs->order, entry);
-
-      if (!existed)
-        g_hash_table_replace (kargs->table, duped, entries);
-    }
+    kernel_args_append_take (kargs, g_steal_pointer (iter));
 }
 
 /**
@@ -699,19 +777,13 @@ ostree_kernel_args_append_proc_cmdline (OstreeKernelArgs *kargs, GCancellable *c
 void
 ostree_kernel_args_parse_append (OstreeKernelArgs *kargs, const char *options)
 {
-  char **args = NULL;
-  char **iter;
-
   if (!options)
     return;
 
-  args = split_kernel_args (options);
-  for (iter = args; *iter; iter++)
-    {
-      char *arg = *iter;
-      ostree_kernel_args_append (kargs, arg);
-    }
-  g_strfreev (args);
+  /* Split once; each argument is then owned by @kargs directly */
+  g_auto (GStrv) args = split_kernel_args (options);
+  for (char **iter = args; *iter; iter++)
+    kernel_args_append_take (kargs, g_steal_pointer (iter));
 }
 
 /**
@@ -60,6 +60,9 @@ gboolean ostree_kernel_args_new_replace (OstreeKernelArgs *kargs, const char *ar
 _OSTREE_PUBLIC
 gboolean ostree_kernel_args_delete (OstreeKernelArgs *kargs, const char *arg, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_kernel_args_delete_argv (OstreeKernelArgs *kargs, char **argv, GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_kernel_args_delete_key_entry (OstreeKernelArgs *kargs, const char *key,
                                               GError **error);
@@ -39,6 +39,18 @@ enum
  *
  * An implementation of #GConverter that compresses data using
  * LZMA.
+ *
+ * The optional params are an a{sv} with:
+ *   - threads: u: Number of encoder threads, 0 for one per CPU.  Default 1.
+ *   - block-size: t: Uncompressed size of each block when using more than
+ *     one thread.  Default 0, which lets liblzma pick.
+ *   - memlimit: t: Upper bound in bytes on the memory used by the encoder
+ *     with more than one thread; fewer threads are used to stay below it.
+ *     Default a quarter of the physical memory, 0 for no limit.
+ *
+ * With more than one thread the input is split into independently
+ * compressed blocks of an ordinary xz stream, so any LZMA decompressor
+ * can still read the output.
  */
 
 static void _ostree_lzma_compressor_iface_init (GConverterIface *iface);
@@ -55,6 +67,7 @@ struct _OstreeLzmaCompressor
   GVariant *params;
   lzma_stream lstream;
   gboolean initialized;
+  gboolean multithreaded;
 };
 
 G_DEFINE_TYPE_WITH_CODE (OstreeLzmaCompressor, _ostree_lzma_compressor, G_TYPE_OBJECT,
@@ -81,7 +94,7 @@ _ostree_lzma_compressor_set_property (GObject *object, guint prop_id, const GVal
   switch (prop_id)
     {
     case PROP_PARAMS:
-      self->params = g_value_get_variant (value);
+      self->params = g_value_dup_variant (value);
       break;
 
     default:
@@ -147,6 +160,7 @@ _ostree_lzma_compressor_reset (GConverter *converter)
       lzma_end (&self->lstream);
       self->lstream = tmp;
       self->initialized = FALSE;
+      self->multithreaded = FALSE;
     }
 }
 
@@ -167,7 +181,39 @@ _ostree_lzma_compressor_convert (GConverter *converter, const void *inbuf, gsize
 
   if (!self->initialized)
     {
-      res = lzma_easy_encoder (&self->lstream, 8, LZMA_CHECK_CRC64);
+      guint32 threads = 1;
+      guint64 block_size = 0;
+      guint64 memlimit = lzma_physmem () / 4;
+      if (self->params)
+        {
+          (void)g_variant_lookup (self->params, "threads", "u", &threads);
+          (void)g_variant_lookup (self->params, "block-size", "t", &block_size);
+          (void)g_variant_lookup (self->params, "memlimit", "t", &memlimit);
+        }
+
+#if LZMA_VERSION >= 50020002
+      lzma_mt mt = {
+        0,
+      };
+      if (threads == 0)
+        threads = MAX (lzma_cputhreads (), 1);
+      mt.threads = threads;
+      mt.block_size = block_size;
+      mt.preset = 8;
+      mt.check = LZMA_CHECK_CRC64;
+      /* Each thread needs its own match finder and input and output
+       * buffers of a block each, so drop threads rather than run out of
+       * memory; this returns UINT64_MAX if the options are invalid. */
+      while (memlimit > 0 && mt.threads > 1 && lzma_stream_encoder_mt_memusage (&mt) > memlimit)
+        mt.threads--;
+      if (mt.threads > 1)
+        {
+          res = lzma_stream_encoder_mt (&self->lstream, &mt);
+          self->multithreaded = TRUE;
+        }
+      else
+#endif
+        res = lzma_easy_encoder (&self->lstream, 8, LZMA_CHECK_CRC64);
       if (res != LZMA_OK)
         return _ostree_lzma_return (res, error);
       self->initialized = TRUE;
@@ -183,7 +229,8 @@ _ostree_lzma_compressor_convert (GConverter *converter, const void *inbuf, gsize
   if (flags & G_CONVERTER_INPUT_AT_END)
     action = LZMA_FINISH;
   else if (flags & G_CONVERTER_FLUSH)
-    action = LZMA_SYNC_FLUSH;
+    /* The multithreaded encoder can only flush by ending the block */
+    action = self->multithreaded ? LZMA_FULL_FLUSH : LZMA_SYNC_FLUSH;
 
   res = lzma_code (&self->lstream, action);
   if (res != LZMA_OK && res != LZMA_STREAM_END)
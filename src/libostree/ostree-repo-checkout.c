@@ -814,6 +814,9 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
                                            cancellable, error))
                 return FALSE;
 
+              if (is_archive_z2_with_cache && hardlink_res == HARDLINK_RESULT_LINKED)
+                g_atomic_int_inc (&current_repo->uncompressed_cache_hits);
+
               if (hardlink_res == HARDLINK_RESULT_LINKED && options->devino_to_csum_cache)
                 {
                   struct stat stbuf;
@@ -858,6 +861,7 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
     {
       HardlinkResult hardlink_res = HARDLINK_RESULT_NOT_SUPPORTED;
 
+      g_atomic_int_inc (&repo->uncompressed_cache_misses);
       if (!ostree_repo_load_file (repo, checksum, &input, NULL, NULL, cancellable, error))
         return FALSE;
 
@@ -892,6 +896,7 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
         if (repo->updated_uncompressed_dirs == NULL)
           repo->updated_uncompressed_dirs = g_hash_table_new (NULL, NULL);
         g_hash_table_add (repo->updated_uncompressed_dirs, key);
+        repo->uncompressed_cache_grew = TRUE;
       }
       g_mutex_unlock (&repo->cache_lock);
 
@@ -1340,8 +1345,9 @@ ostree_repo_checkout_composefs (OstreeRepo *self, GVariant *options, int destina
 
   g_autoptr (OstreeComposefsTarget) target = ostree_composefs_target_new ();
 
-  if (!_ostree_repo_checkout_composefs (self, verity, target, (OstreeRepoFile *)commit_root,
-                                        cancellable, error))
+  gboolean used_digest_index = FALSE;
+  if (!_ostree_repo_checkout_composefs (self, verity, TRUE, &used_digest_index, target,
+                                        (OstreeRepoFile *)commit_root, cancellable, error))
     return FALSE;
 
   g_autofree guchar *fsverity_digest = NULL;
@@ -1353,8 +1359,35 @@ ostree_repo_checkout_composefs (OstreeRepo *self, GVariant *options, int destina
    */
   if (verity == OT_TRISTATE_YES)
     {
-      if (!compare_verity_digests (metadata_composefs, fsverity_digest, error))
-        return FALSE;
+      g_autoptr (GError) local_error = NULL;
+      if (!compare_verity_digests (metadata_composefs, fsverity_digest, &local_error))
+        {
+          if (!used_digest_index)
+            {
+              g_propagate_error (error, g_steal_pointer (&local_error));
+              return FALSE;
+            }
+
+          /* The digest index is only a cache; before failing, generate the
+           * image again with every digest computed, and drop the index if
+           * that helped. */
+          g_debug ("%s; retrying without the fs-verity digest index", local_error->message);
+          g_clear_pointer (&target, ostree_composefs_target_unref);
+          target = ostree_composefs_target_new ();
+          if (!_ostree_repo_checkout_composefs (self, verity, FALSE, NULL, target,
+                                                (OstreeRepoFile *)commit_root, cancellable, error))
+            return FALSE;
+          if (ftruncate (tmpf.fd, 0) < 0 || lseek (tmpf.fd, 0, SEEK_SET) < 0)
+            return glnx_throw_errno_prefix (error, "Truncating composefs image");
+          g_clear_pointer (&fsverity_digest, g_free);
+          if (!ostree_composefs_target_write (target, tmpf.fd, &fsverity_digest, cancellable,
+                                              error))
+            return FALSE;
+          if (!compare_verity_digests (metadata_composefs, fsverity_digest, error))
+            return FALSE;
+          if (!_ostree_repo_drop_fsverity_index (self, error))
+            return FALSE;
+        }
     }
 
   if (!glnx_fchmod (tmpf.fd, 0644, error))
@@ -1374,6 +1407,126 @@ ostree_repo_checkout_composefs (OstreeRepo *self, GVariant *options, int destina
 }
 
 /* Begin a checkout process */
+typedef struct
+{
+  char *path;
+  guint64 size;
+  struct timespec ctime;
+} UncompressedCacheEntry;
+
+static void
+uncompressed_cache_entry_clear (gpointer data)
+{
+  UncompressedCacheEntry *entry = data;
+  g_free (entry->path);
+}
+
+static gint
+uncompressed_cache_entry_compare (gconstpointer a, gconstpointer b)
+{
+  const UncompressedCacheEntry *entry_a = a;
+  const UncompressedCacheEntry *entry_b = b;
+
+  if (entry_a->ctime.tv_sec != entry_b->ctime.tv_sec)
+    return entry_a->ctime.tv_sec < entry_b->ctime.tv_sec ? -1 : 1;
+  if (entry_a->ctime.tv_nsec != entry_b->ctime.tv_nsec)
+    return entry_a->ctime.tv_nsec < entry_b->ctime.tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/* Evict objects that no checkout is using (i.e. with a link count of 1)
+ * from the uncompressed object cache, least recently used first, until
+ * they take up no more than uncompressed-cache-max-size.  Hardlinking an
+ * object into a checkout or removing it changes its ctime, so that serves
+ * as the time of last use without touching the mtime it shares with
+ * checkouts, and it works across processes.
+ */
+static gboolean
+prune_uncompressed_cache (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  if (self->uncompressed_objects_dir_fd < 0)
+    return TRUE;
+
+  const guint64 max_size = self->uncompressed_cache_max_mb << 20;
+  g_autoptr (GArray) unused = g_array_new (FALSE, FALSE, sizeof (UncompressedCacheEntry));
+  g_array_set_clear_func (unused, uncompressed_cache_entry_clear);
+  guint64 unused_size = 0;
+
+  for (guint prefix = 0; prefix < 256; prefix++)
+    {
+      char objdir_name[3];
+      g_auto (GLnxDirFdIterator) dfd_iter = {
+        0,
+      };
+      gboolean exists;
+
+      snprintf (objdir_name, sizeof (objdir_name), "%02x", prefix);
+      if (!ot_dfd_iter_init_allow_noent (self->uncompressed_objects_dir_fd, objdir_name, &dfd_iter,
+                                         &exists, error))
+        return FALSE;
+      if (!exists)
+        continue;
+
+      while (TRUE)
+        {
+          struct dirent *dent;
+          struct stat stbuf;
+
+          if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+            return FALSE;
+          if (dent == NULL)
+            break;
+
+          if (!glnx_fstatat_allow_noent (dfd_iter.fd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW,
+                                         error))
+            return FALSE;
+          if (errno == ENOENT || !S_ISREG (stbuf.st_mode) || stbuf.st_nlink != 1)
+            continue;
+
+          UncompressedCacheEntry entry = {
+            g_strconcat (objdir_name, "/", dent->d_name, NULL),
+            stbuf.st_size,
+            stbuf.st_ctim,
+          };
+          g_array_append_val (unused, entry);
+          unused_size += stbuf.st_size;
+        }
+    }
+
+  if (unused_size <= max_size)
+    return TRUE;
+
+  g_array_sort (unused, uncompressed_cache_entry_compare);
+  for (guint i = 0; i < unused->len && unused_size > max_size; i++)
+    {
+      UncompressedCacheEntry *entry = &g_array_index (unused, UncompressedCacheEntry, i);
+      if (!glnx_unlinkat (self->uncompressed_objects_dir_fd, entry->path, 0, error))
+        return FALSE;
+      unused_size -= entry->size;
+    }
+
+  return TRUE;
+}
+
+/* Called at the end of a checkout; if it added objects to a size-limited
+ * uncompressed object cache, bring the cache back under its limit.
+ */
+static gboolean
+maybe_prune_uncompressed_cache (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  if (self->uncompressed_cache_max_mb == 0)
+    return TRUE;
+
+  g_mutex_lock (&self->cache_lock);
+  gboolean grew = self->uncompressed_cache_grew;
+  self->uncompressed_cache_grew = FALSE;
+  g_mutex_unlock (&self->cache_lock);
+
+  if (!grew)
+    return TRUE;
+  return prune_uncompressed_cache (self, cancellable, error);
+}
+
 static gboolean
 checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int destination_parent_fd,
                   const char *destination_name, OstreeRepoFile *source, GFileInfo *source_info,
@@ -1443,9 +1596,11 @@ checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int de
       /* let's just ignore filter here; I can't think of a useful case for filtering when
        * only checking out one path */
       options->filter = NULL;
-      return checkout_one_file_at (self, options, &state, ostree_repo_file_get_checksum (source),
-                                   destination_dfd, g_file_info_get_name (source_info), cancellable,
-                                   error);
+      if (!checkout_one_file_at (self, options, &state, ostree_repo_file_get_checksum (source),
+                                 destination_dfd, g_file_info_get_name (source_info), cancellable,
+                                 error))
+        return FALSE;
+      return maybe_prune_uncompressed_cache (self, cancellable, error);
     }
 
   /* Cache any directory metadata we read during this operation;
@@ -1457,8 +1612,10 @@ checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int de
   g_assert_cmpint (g_file_info_get_file_type (source_info), ==, G_FILE_TYPE_DIRECTORY);
   const char *dirtree_checksum = ostree_repo_file_tree_get_contents_checksum (source);
   const char *dirmeta_checksum = ostree_repo_file_tree_get_metadata_checksum (source);
-  return checkout_tree_at_recurse (self, options, &state, destination_parent_fd, destination_name,
-                                   dirtree_checksum, dirmeta_checksum, cancellable, error);
+  if (!checkout_tree_at_recurse (self, options, &state, destination_parent_fd, destination_name,
+                                 dirtree_checksum, dirmeta_checksum, cancellable, error))
+    return FALSE;
+  return maybe_prune_uncompressed_cache (self, cancellable, error);
 }
 
 static void
@@ -1689,7 +1846,9 @@ ostree_repo_devino_cache_new (void)
  *
  * Call this after finishing a succession of checkout operations; it
  * will delete any currently-unused uncompressed objects from the
- * cache.
+ * cache.  If the `core.uncompressed-cache-max-size` option is set,
+ * unused objects are instead kept up to that size, evicting the least
+ * recently used ones first.
  */
 gboolean
 ostree_repo_checkout_gc (OstreeRepo *self, GCancellable *cancellable, GError **error)
@@ -1699,8 +1858,12 @@ ostree_repo_checkout_gc (OstreeRepo *self, GCancellable *cancellable, GError **e
   g_mutex_lock (&self->cache_lock);
   to_clean_dirs = self->updated_uncompressed_dirs;
   self->updated_uncompressed_dirs = g_hash_table_new (NULL, NULL);
+  self->uncompressed_cache_grew = FALSE;
   g_mutex_unlock (&self->cache_lock);
 
+  if (self->uncompressed_cache_max_mb > 0)
+    return prune_uncompressed_cache (self, cancellable, error);
+
   if (!to_clean_dirs)
     return TRUE; /* Note early return */
 
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ostree-core-private.h"
+#include "ostree-repo-private.h"
+#include "ot-fs-utils.h"
+#include "otutil.h"
+
+/* The commit graph in `state/commit-graph` holds the parent, timestamp and
+ * root tree of commit objects, so that walking history doesn't need to
+ * load and parse each commit.  It is a magic, followed by fixed size
+ * records sorted by the binary commit checksum.
+ *
+ * The generation number of a commit is one more than that of its parent,
+ * or 1 for a commit without a parent; it is 0 if the parent isn't in the
+ * graph (yet).  An ancestor always has a lower generation number than its
+ * descendants.
+ *
+ * Commit objects are immutable, so an entry never becomes wrong; it only
+ * outlives its commit if that is deleted, which is why lookups still check
+ * that the object exists.  Entries are added as commits are written, and
+ * whenever a lookup has to fall back to loading a commit; they are written
+ * out when a transaction is committed, and when pruning.
+ */
+#define COMMIT_GRAPH_PATH "state/commit-graph"
+#define COMMIT_GRAPH_MAGIC "OSTCGR01"
+#define COMMIT_GRAPH_MAGIC_LEN 8
+
+#define COMMIT_GRAPH_FLAG_HAS_PARENT (1 << 0)
+
+typedef struct
+{
+  guint8 checksum[OSTREE_SHA256_DIGEST_LEN];
+  guint8 parent[OSTREE_SHA256_DIGEST_LEN];
+  guint8 root_contents[OSTREE_SHA256_DIGEST_LEN];
+  guint8 root_metadata[OSTREE_SHA256_DIGEST_LEN];
+  guint64 timestamp;  /* Big endian, as in the commit */
+  guint32 generation; /* Big endian */
+  guint32 flags;      /* Big endian */
+} CommitGraphRecord;
+
+G_STATIC_ASSERT (sizeof (CommitGraphRecord) == 4 * OSTREE_SHA256_DIGEST_LEN + 16);
+
+static int
+compare_commit_graph_record (const void *a, const void *b)
+{
+  return memcmp (a, b, OSTREE_SHA256_DIGEST_LEN);
+}
+
+static void
+commit_graph_record_init (CommitGraphRecord *record, const char *checksum, GVariant *commit)
+{
+  g_autoptr (GVariant) parent = NULL;
+  g_autoptr (GVariant) root_contents = NULL;
+  g_autoptr (GVariant) root_metadata = NULL;
+  guint64 timestamp;
+
+  memset (record, 0, sizeof (*record));
+  ostree_checksum_inplace_to_bytes (checksum, record->checksum);
+
+  g_variant_get_child (commit, 1, "@ay", &parent);
+  if (g_variant_n_children (parent) == OSTREE_SHA256_DIGEST_LEN)
+    {
+      memcpy (record->parent, g_variant_get_data (parent), OSTREE_SHA256_DIGEST_LEN);
+      record->flags = GUINT32_TO_BE (COMMIT_GRAPH_FLAG_HAS_PARENT);
+    }
+
+  g_variant_get_child (commit, 5, "t", &timestamp);
+  record->timestamp = timestamp;
+
+  g_variant_get_child (commit, 6, "@ay", &root_contents);
+  if (g_variant_n_children (root_contents) == OSTREE_SHA256_DIGEST_LEN)
+    memcpy (record->root_contents, g_variant_get_data (root_contents), OSTREE_SHA256_DIGEST_LEN);
+  g_variant_get_child (commit, 7, "@ay", &root_metadata);
+  if (g_variant_n_children (root_metadata) == OSTREE_SHA256_DIGEST_LEN)
+    memcpy (record->root_metadata, g_variant_get_data (root_metadata), OSTREE_SHA256_DIGEST_LEN);
+}
+
+/* Record @commit, to be written to the graph by
+ * _ostree_repo_flush_commit_graph().
+ */
+void
+_ostree_repo_note_commit (OstreeRepo *self, const char *checksum, GVariant *commit)
+{
+  if (!self->writable)
+    return;
+
+  CommitGraphRecord *record = g_new (CommitGraphRecord, 1);
+  commit_graph_record_init (record, checksum, commit);
+
+  g_mutex_lock (&self->txn_lock);
+  if (self->pending_commit_graph == NULL)
+    self->pending_commit_graph = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_replace (self->pending_commit_graph, g_strdup (checksum), record);
+  g_mutex_unlock (&self->txn_lock);
+}
+
+/* Load the sorted records of the graph, which are cached until the file
+ * changes; sets @out_records to %NULL if there is no (valid) graph.
+ */
+static gboolean
+load_commit_graph (OstreeRepo *self, GBytes **out_records, GError **error)
+{
+  *out_records = NULL;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->repo_dir_fd, COMMIT_GRAPH_PATH, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  struct stat stbuf;
+  if (!glnx_fstat (fd, &stbuf, error))
+    return FALSE;
+
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->cache_lock);
+
+  if (self->commit_graph != NULL && self->commit_graph_stbuf.st_ino == stbuf.st_ino
+      && self->commit_graph_stbuf.st_dev == stbuf.st_dev
+      && self->commit_graph_stbuf.st_size == stbuf.st_size
+      && self->commit_graph_stbuf.st_mtim.tv_sec == stbuf.st_mtim.tv_sec
+      && self->commit_graph_stbuf.st_mtim.tv_nsec == stbuf.st_mtim.tv_nsec)
+    {
+      *out_records = g_bytes_ref (self->commit_graph);
+      return TRUE;
+    }
+
+  g_autoptr (GBytes) bytes = ot_fd_readall_or_mmap (fd, 0, error);
+  if (!bytes)
+    return FALSE;
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (bytes, &len);
+  if (len < COMMIT_GRAPH_MAGIC_LEN
+      || memcmp (buf, COMMIT_GRAPH_MAGIC, COMMIT_GRAPH_MAGIC_LEN) != 0
+      || (len - COMMIT_GRAPH_MAGIC_LEN) % sizeof (CommitGraphRecord) != 0)
+    {
+      g_debug ("Ignoring invalid commit graph");
+      return TRUE;
+    }
+
+  g_clear_pointer (&self->commit_graph, g_bytes_unref);
+  self->commit_graph
+      = g_bytes_new_from_bytes (bytes, COMMIT_GRAPH_MAGIC_LEN, len - COMMIT_GRAPH_MAGIC_LEN);
+  self->commit_graph_stbuf = stbuf;
+
+  *out_records = g_bytes_ref (self->commit_graph);
+  return TRUE;
+}
+
+static const CommitGraphRecord *
+commit_graph_bsearch (const CommitGraphRecord *records, gsize n_records, const guint8 *checksum)
+{
+  return bsearch (checksum, records, n_records, sizeof (CommitGraphRecord),
+                  compare_commit_graph_record);
+}
+
+/* Fill in the generation numbers which are still unknown, now that more of
+ * the parents may be in the graph.
+ */
+static void
+compute_generations (CommitGraphRecord *records, gsize n_records)
+{
+  g_autoptr (GPtrArray) chain = g_ptr_array_new ();
+  g_autofree guint8 *visited = g_new0 (guint8, n_records);
+
+  for (gsize i = 0; i < n_records; i++)
+    {
+      CommitGraphRecord *record = &records[i];
+
+      /* Walk back until we find a commit with a known generation, or the
+       * root, or the end of the history we have. */
+      g_ptr_array_set_size (chain, 0);
+      while (record != NULL && record->generation == 0 && !visited[record - records])
+        {
+          visited[record - records] = TRUE;
+          g_ptr_array_add (chain, record);
+
+          if (GUINT32_FROM_BE (record->flags) & COMMIT_GRAPH_FLAG_HAS_PARENT)
+            record = (CommitGraphRecord *)commit_graph_bsearch (records, n_records,
+                                                                record->parent);
+          else
+            record = NULL;
+        }
+      if (chain->len == 0)
+        continue;
+
+      const CommitGraphRecord *last = chain->pdata[chain->len - 1];
+      guint32 generation;
+      if ((GUINT32_FROM_BE (last->flags) & COMMIT_GRAPH_FLAG_HAS_PARENT) == 0)
+        generation = 0;
+      else if (record != NULL && record->generation != 0)
+        generation = GUINT32_FROM_BE (record->generation);
+      else
+        continue; /* Missing history, so these stay unknown */
+
+      for (guint j = chain->len; j > 0; j--)
+        {
+          CommitGraphRecord *r = chain->pdata[j - 1];
+          r->generation = GUINT32_TO_BE (++generation);
+        }
+    }
+}
+
+static gboolean
+flush_commit_graph (OstreeRepo *self, GHashTable *pending, gboolean drop_missing,
+                    GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GBytes) old_records_bytes = NULL;
+  if (!load_commit_graph (self, &old_records_bytes, error))
+    return FALSE;
+  gsize old_len = 0;
+  const CommitGraphRecord *old_records
+      = old_records_bytes ? g_bytes_get_data (old_records_bytes, &old_len) : NULL;
+  const gsize n_old = old_len / sizeof (CommitGraphRecord);
+
+  const guint n_new = pending ? g_hash_table_size (pending) : 0;
+  g_autofree CommitGraphRecord *new_records = g_new (CommitGraphRecord, n_new);
+  if (pending != NULL)
+    {
+      CommitGraphRecord *p = new_records;
+      GLNX_HASH_TABLE_FOREACH_V (pending, const CommitGraphRecord *, record)
+        *p++ = *record;
+    }
+  qsort (new_records, n_new, sizeof (CommitGraphRecord), compare_commit_graph_record);
+
+  /* Merge the two sorted lists, keeping the generation number we already
+   * know for existing entries. */
+  g_autoptr (GArray) records
+      = g_array_sized_new (FALSE, FALSE, sizeof (CommitGraphRecord), n_old + n_new);
+  gsize i = 0, j = 0;
+  while (i < n_old || j < n_new)
+    {
+      int c;
+      if (i == n_old)
+        c = 1;
+      else if (j == n_new)
+        c = -1;
+      else
+        c = compare_commit_graph_record (&old_records[i], &new_records[j]);
+      if (c < 0)
+        g_array_append_val (records, old_records[i++]);
+      else if (c > 0)
+        g_array_append_val (records, new_records[j++]);
+      else
+        {
+          g_array_append_val (records, old_records[i]);
+          i++;
+          j++;
+        }
+    }
+
+  if (drop_missing)
+    {
+      guint kept = 0;
+      for (guint k = 0; k < records->len; k++)
+        {
+          CommitGraphRecord *record = &g_array_index (records, CommitGraphRecord, k);
+          char checksum[OSTREE_SHA256_STRING_LEN + 1];
+          gboolean exists;
+
+          ostree_checksum_inplace_from_bytes (record->checksum, checksum);
+          if (!ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &exists,
+                                       cancellable, error))
+            return FALSE;
+          if (exists)
+            g_array_index (records, CommitGraphRecord, kept++) = *record;
+        }
+      g_array_set_size (records, kept);
+    }
+
+  compute_generations ((CommitGraphRecord *)records->data, records->len);
+
+  g_autoptr (GByteArray) buf = g_byte_array_sized_new (
+      COMMIT_GRAPH_MAGIC_LEN + records->len * sizeof (CommitGraphRecord));
+  g_byte_array_append (buf, (const guint8 *)COMMIT_GRAPH_MAGIC, COMMIT_GRAPH_MAGIC_LEN);
+  g_byte_array_append (buf, (const guint8 *)records->data,
+                       records->len * sizeof (CommitGraphRecord));
+
+  /* The state/ directory may not exist in older repositories */
+  if (mkdirat (self->repo_dir_fd, "state", DEFAULT_DIRECTORY_MODE) != 0 && errno != EEXIST)
+    return glnx_throw_errno_prefix (error, "mkdir(state)");
+
+  return _ostree_repo_file_replace_contents (self, self->repo_dir_fd, COMMIT_GRAPH_PATH, buf->data,
+                                             buf->len, cancellable, error);
+}
+
+/* Merge any commits noted since the last flush into the graph; if
+ * @drop_missing is set, also drop the entries for commits which have been
+ * deleted.  Like the fs-verity digest index, the graph is only an
+ * optimization and concurrent writers may drop each other's entries, so
+ * errors are logged and otherwise ignored.
+ */
+void
+_ostree_repo_flush_commit_graph (OstreeRepo *self, gboolean drop_missing,
+                                 GCancellable *cancellable)
+{
+  g_mutex_lock (&self->txn_lock);
+  g_autoptr (GHashTable) pending = g_steal_pointer (&self->pending_commit_graph);
+  g_mutex_unlock (&self->txn_lock);
+
+  if (!self->writable || (pending == NULL && !drop_missing))
+    return;
+
+  g_autoptr (GError) local_error = NULL;
+  if (!flush_commit_graph (self, pending, drop_missing, cancellable, &local_error))
+    g_debug ("Failed to update commit graph: %s", local_error->message);
+}
+
+/**
+ * ostree_repo_lookup_commit_graph:
+ * @self: Repo
+ * @checksum: ASCII SHA256 checksum of a commit
+ * @out_exists: (out): Whether the commit exists in the repository
+ * @out_parent: (out) (optional) (nullable) (transfer full): Checksum of the parent commit, or
+ *   %NULL if it has none
+ * @out_timestamp: (out) (optional): Timestamp of the commit
+ * @out_generation: (out) (optional): Generation number of the commit, or 0 if not known
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Look up the parent and timestamp of commit @checksum, using the
+ * repository's commit graph so that walking history doesn't require
+ * loading and parsing each commit object.  Commits which aren't in the
+ * graph are loaded as usual.
+ *
+ * The generation number is 1 for a commit without a parent, and otherwise
+ * one more than that of its parent.  A commit can therefore only be an
+ * ancestor of another if its generation number is lower.  It is 0 if the
+ * commit graph doesn't have the commit or the complete history before it.
+ *
+ * If the commit doesn't exist, @out_exists is set to %FALSE and the other
+ * outputs are not set.
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ * Since: 2025.2
+ */
+gboolean
+ostree_repo_lookup_commit_graph (OstreeRepo *self, const char *checksum, gboolean *out_exists,
+                                 char **out_parent, guint64 *out_timestamp,
+                                 guint *out_generation, GCancellable *cancellable,
+                                 GError **error)
+{
+  g_return_val_if_fail (OSTREE_IS_REPO (self), FALSE);
+  g_return_val_if_fail (out_exists != NULL, FALSE);
+
+  if (!ostree_validate_checksum_string (checksum, error))
+    return FALSE;
+
+  CommitGraphRecord record;
+  gboolean found = FALSE;
+
+  g_mutex_lock (&self->txn_lock);
+  const CommitGraphRecord *pending
+      = self->pending_commit_graph ? g_hash_table_lookup (self->pending_commit_graph, checksum)
+                                   : NULL;
+  if (pending != NULL)
+    {
+      record = *pending;
+      found = TRUE;
+    }
+  g_mutex_unlock (&self->txn_lock);
+
+  if (!found)
+    {
+      g_autoptr (GBytes) records = NULL;
+      if (!load_commit_graph (self, &records, error))
+        return FALSE;
+
+      if (records != NULL)
+        {
+          guint8 key[OSTREE_SHA256_DIGEST_LEN];
+          gsize len;
+          const CommitGraphRecord *buf = g_bytes_get_data (records, &len);
+
+          ostree_checksum_inplace_to_bytes (checksum, key);
+          const CommitGraphRecord *r
+              = commit_graph_bsearch (buf, len / sizeof (CommitGraphRecord), key);
+          if (r != NULL)
+            {
+              record = *r;
+              found = TRUE;
+            }
+        }
+    }
+
+  if (found)
+    {
+      gboolean exists;
+      if (!ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &exists,
+                                   cancellable, error))
+        return FALSE;
+      if (!exists)
+        {
+          *out_exists = FALSE;
+          return TRUE;
+        }
+    }
+  else
+    {
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &commit,
+                                               error))
+        return FALSE;
+      if (commit == NULL)
+        {
+          *out_exists = FALSE;
+          return TRUE;
+        }
+
+      commit_graph_record_init (&record, checksum, commit);
+      _ostree_repo_note_commit (self, checksum, commit);
+    }
+
+  *out_exists = TRUE;
+  if (out_parent != NULL)
+    {
+      if (GUINT32_FROM_BE (record.flags) & COMMIT_GRAPH_FLAG_HAS_PARENT)
+        *out_parent = ostree_checksum_from_bytes (record.parent);
+      else
+        *out_parent = NULL;
+    }
+  if (out_timestamp != NULL)
+    *out_timestamp = GUINT64_FROM_BE (record.timestamp);
+  if (out_generation != NULL)
+    *out_generation = GUINT32_FROM_BE (record.generation);
+  return TRUE;
+}
@@ -39,6 +39,9 @@
 #include "ostree-repo-private.h"
 #include "ostree-sepolicy-private.h"
 #include "ostree-varint.h"
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-compressor.h"
+#endif
 #include "ostree.h"
 #include "otutil.h"
 
@@ -190,6 +193,10 @@ _ostree_repo_commit_tmpf_final (OstreeRepo *self, const char *checksum, OstreeOb
   if (!_ostree_tmpf_fsverity (self, tmpf, NULL, error))
     return FALSE;
 
+  /* In archive mode the object is compressed, so its digest isn't useful */
+  if (objtype == OSTREE_OBJECT_TYPE_FILE && self->mode != OSTREE_REPO_MODE_ARCHIVE)
+    _ostree_repo_note_fsverity_digest_from_fd (self, checksum, tmpf->fd);
+
   if (!glnx_link_tmpfile_at (tmpf, GLNX_LINK_TMPFILE_NOREPLACE_IGNORE_EXIST, dest_dfd, tmpbuf,
                              error))
     return FALSE;
@@ -852,6 +859,26 @@ _try_clone_from_payload_link (OstreeRepo *self, OstreeRepo *dest_repo, const cha
   return TRUE;
 }
 
+/* The compressor for the content of archive file objects; see the
+ * [archive] compression config option.
+ */
+static GConverter *
+new_archive_compressor (OstreeRepo *self)
+{
+#ifdef HAVE_ZSTD
+  if (self->archive_zstd)
+    {
+      g_auto (GVariantBuilder) params = OT_VARIANT_BUILDER_INITIALIZER;
+      g_variant_builder_init (&params, G_VARIANT_TYPE ("a{sv}"));
+      g_variant_builder_add (&params, "{sv}", "level",
+                             g_variant_new_int32 (self->zstd_compression_level));
+      return (GConverter *)_ostree_zstd_compressor_new (g_variant_builder_end (&params));
+    }
+#endif
+  return (GConverter *)g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                              self->zlib_compression_level);
+}
+
 /* The main driver for writing a content (regfile or symlink) object.
  * There are a variety of tricky cases here; for example, bare-user
  * repos store symlinks as regular files.  Computing checksums
@@ -1007,7 +1034,7 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
     }
   else
     {
-      g_autoptr (GConverter) zlib_compressor = NULL;
+      g_autoptr (GConverter) compressor = NULL;
       g_autoptr (GOutputStream) compressed_out_stream = NULL;
       g_autoptr (GOutputStream) temp_out = NULL;
 
@@ -1031,9 +1058,8 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
 
       if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR)
         {
-          zlib_compressor = (GConverter *)g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
-                                                                 self->zlib_compression_level);
-          compressed_out_stream = g_converter_output_stream_new (temp_out, zlib_compressor);
+          compressor = new_archive_compressor (self);
+          compressed_out_stream = g_converter_output_stream_new (temp_out, compressor);
           /* Don't close the base; we'll do that later */
           g_filter_output_stream_set_close_base_stream (
               (GFilterOutputStream *)compressed_out_stream, FALSE);
@@ -1405,6 +1431,10 @@ write_metadata_object (OstreeRepo *self, OstreeObjectType objtype, const char *e
               return FALSE;
             }
         }
+
+      g_autoptr (GVariant) commit = g_variant_ref_sink (
+          g_variant_new_from_bytes (OSTREE_COMMIT_GVARIANT_FORMAT, buf, TRUE));
+      _ostree_repo_note_commit (self, actual_checksum, commit);
     }
 
   /* Update the stats, note we both wrote one and add to total */
@@ -2239,6 +2269,9 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
   if (!fsync_object_dirs (self, cancellable, error))
     return FALSE;
 
+  _ostree_repo_flush_fsverity_index (self);
+  _ostree_repo_flush_commit_graph (self, FALSE, cancellable);
+
   g_debug ("txn commit %s", glnx_basename (self->commit_stagedir.path));
   if (!glnx_tmpdir_delete (&self->commit_stagedir, cancellable, error))
     return FALSE;
@@ -2251,13 +2284,25 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
   if (self->loose_object_devino_hash)
     g_hash_table_remove_all (self->loose_object_devino_hash);
 
-  if (self->txn.refs)
-    if (!_ostree_repo_update_refs (self, self->txn.refs, cancellable, error))
-      return FALSE;
+  /* With packed refs, all of the updates go into a single rewrite of
+   * refs/packed-refs rather than one file (and fsync) per ref. */
+  if (self->packed_refs && (self->txn.refs || self->txn.collection_refs))
+    {
+      if (!_ostree_repo_pack_refs (self, self->txn.refs, self->txn.collection_refs, cancellable,
+                                   error))
+        return FALSE;
+    }
+  else
+    {
+      if (self->txn.refs)
+        if (!_ostree_repo_update_refs (self, self->txn.refs, cancellable, error))
+          return FALSE;
 
-  if (self->txn.collection_refs)
-    if (!_ostree_repo_update_collection_refs (self, self->txn.collection_refs, cancellable, error))
-      return FALSE;
+      if (self->txn.collection_refs)
+        if (!_ostree_repo_update_collection_refs (self, self->txn.collection_refs, cancellable,
+                                                  error))
+          return FALSE;
+    }
 
   /* Update the summary if auto-update-summary is set, because doing so was
    * delayed for each ref change during the transaction.
@@ -2324,6 +2369,11 @@ ostree_repo_abort_transaction (OstreeRepo *self, GCancellable *cancellable, GErr
   g_clear_pointer (&self->txn.refs, g_hash_table_destroy);
   g_clear_pointer (&self->txn.collection_refs, g_hash_table_destroy);
 
+  /* The commits noted for the commit graph are being discarded */
+  g_mutex_lock (&self->txn_lock);
+  g_clear_pointer (&self->pending_commit_graph, g_hash_table_unref);
+  g_mutex_unlock (&self->txn_lock);
+
   glnx_tmpdir_unset (&self->commit_stagedir);
   glnx_release_lock_file (&self->commit_stagedir_lock);
 
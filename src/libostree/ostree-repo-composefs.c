@@ -264,11 +264,132 @@ _ostree_composefs_set_xattrs (struct lcfs_node_s *node, GVariant *xattrs, GCance
   return TRUE;
 }
 
+/* State for a single composefs checkout */
+typedef struct
+{
+  OstreeRepo *repo;
+  OtTristate verity;
+  GCancellable *cancellable;
+  /* Object checksum -> fs-verity digest; a content object is only
+   * measured once, however often it appears in the tree.
+   */
+  GHashTable *digests;
+  /* The repository's persistent digest index, used only instead of
+   * computing digests in userspace; may be %NULL */
+  OstreeFsverityIndex *index;
+  gboolean used_index;
+  /* Object checksum -> GPtrArray of nodes still needing a digest
+   * computed in userspace; see compute_pending_digests().
+   */
+  GHashTable *pending;
+  GMutex mutex;
+  GError *error;
+} ComposefsCheckout;
+
+static void
+composefs_checkout_init (ComposefsCheckout *checkout, OstreeRepo *repo, OtTristate verity,
+                         GCancellable *cancellable)
+{
+  checkout->repo = repo;
+  checkout->verity = verity;
+  checkout->cancellable = cancellable;
+  checkout->digests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  checkout->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_ptr_array_unref);
+  g_mutex_init (&checkout->mutex);
+}
+
+static void
+composefs_checkout_clear (ComposefsCheckout *checkout)
+{
+  g_clear_pointer (&checkout->digests, g_hash_table_unref);
+  g_clear_pointer (&checkout->index, _ostree_fsverity_index_free);
+  g_clear_pointer (&checkout->pending, g_hash_table_unref);
+  g_clear_error (&checkout->error);
+  g_mutex_clear (&checkout->mutex);
+}
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (ComposefsCheckout, composefs_checkout_clear)
+
 static gboolean
-checkout_one_composefs_file_at (OstreeRepo *repo, OtTristate verity, const char *checksum,
+compute_one_digest (ComposefsCheckout *checkout, const char *checksum, guint8 *out_digest,
+                    GError **error)
+{
+  if (g_cancellable_set_error_if_cancelled (checkout->cancellable, error))
+    return FALSE;
+
+  g_autoptr (GInputStream) input = NULL;
+  if (!ostree_repo_load_file (checkout->repo, checksum, &input, NULL, NULL, checkout->cancellable,
+                              error))
+    return FALSE;
+
+  if (lcfs_compute_fsverity_from_content (out_digest, input, _composefs_read_cb) != 0)
+    return glnx_throw_errno_prefix (error, "Computing fs-verity digest of %s", checksum);
+
+  return TRUE;
+}
+
+static void
+compute_digest_thread (gpointer datap, gpointer user_data)
+{
+  const char *checksum = datap;
+  ComposefsCheckout *checkout = user_data;
+  g_autofree guint8 *digest = g_malloc (OSTREE_SHA256_DIGEST_LEN);
+  g_autoptr (GError) local_error = NULL;
+
+  const gboolean ok = compute_one_digest (checkout, checksum, digest, &local_error);
+
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&checkout->mutex);
+  if (ok)
+    {
+      _ostree_repo_note_fsverity_digest (checkout->repo, checksum, digest);
+      g_hash_table_insert (checkout->digests, g_strdup (checksum), g_steal_pointer (&digest));
+    }
+  else if (checkout->error == NULL)
+    checkout->error = g_steal_pointer (&local_error);
+}
+
+/* Computing fs-verity digests in userspace means reading every byte of
+ * content, so we defer it until the whole tree has been walked and then
+ * measure each distinct object once, in parallel.  The lcfs nodes
+ * themselves are only touched from this thread.
+ */
+static gboolean
+compute_pending_digests (ComposefsCheckout *checkout, GError **error)
+{
+  if (g_hash_table_size (checkout->pending) == 0)
+    return TRUE;
+
+  GThreadPool *pool = g_thread_pool_new (compute_digest_thread, checkout,
+                                         g_get_num_processors (), FALSE, NULL);
+  GLNX_HASH_TABLE_FOREACH (checkout->pending, const char *, checksum)
+    g_thread_pool_push (pool, (gpointer)checksum, NULL);
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (checkout->error)
+    {
+      g_propagate_error (error, g_steal_pointer (&checkout->error));
+      return FALSE;
+    }
+
+  GLNX_HASH_TABLE_FOREACH_KV (checkout->pending, const char *, checksum, GPtrArray *, nodes)
+    {
+      guint8 *digest = g_hash_table_lookup (checkout->digests, checksum);
+      g_assert (digest != NULL);
+      for (guint i = 0; i < nodes->len; i++)
+        lcfs_node_set_fsverity_digest (nodes->pdata[i], digest);
+    }
+  g_hash_table_remove_all (checkout->pending);
+
+  return TRUE;
+}
+
+static gboolean
+checkout_one_composefs_file_at (ComposefsCheckout *checkout, const char *checksum,
                                 struct lcfs_node_s *parent, const char *destination_name,
                                 GCancellable *cancellable, GError **error)
 {
+  OstreeRepo *repo = checkout->repo;
+  const OtTristate verity = checkout->verity;
   g_autoptr (GInputStream) input = NULL;
   g_autoptr (GVariant) xattrs = NULL;
   struct lcfs_node_s *existing;
@@ -322,37 +443,62 @@ checkout_one_composefs_file_at (OstreeRepo *repo, OtTristate verity, const char
 
       if (verity != OT_TRISTATE_NO)
         {
-#ifdef HAVE_LINUX_FSVERITY_H
-          /* First try to get the digest directly from the bare repo file.
-           * This is the typical case when we're pulled into the target
-           * system repo with verity on and are recreating the composefs
-           * image during deploy. */
-          union
-          {
-            struct fsverity_digest d;
-            char buf[sizeof (struct fsverity_digest) + OSTREE_SHA256_DIGEST_LEN];
-          } result;
-          guchar *known_digest = NULL;
-
-          if (G_IS_UNIX_INPUT_STREAM (input))
+          guint8 *cached_digest = g_hash_table_lookup (checkout->digests, checksum);
+          GPtrArray *pending_nodes = g_hash_table_lookup (checkout->pending, checksum);
+          if (cached_digest)
+            lcfs_node_set_fsverity_digest (node, cached_digest);
+          else if (pending_nodes)
+            g_ptr_array_add (pending_nodes, lcfs_node_ref (node));
+          else
             {
-              int content_fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (input));
-              result.d.digest_size = OSTREE_SHA256_DIGEST_LEN;
+              guint8 index_digest[OSTREE_SHA256_DIGEST_LEN];
 
-              if (ioctl (content_fd, FS_IOC_MEASURE_VERITY, &result) == 0
-                  && result.d.digest_size == OSTREE_SHA256_DIGEST_LEN
-                  && result.d.digest_algorithm == FS_VERITY_HASH_ALG_SHA256)
-                known_digest = result.d.digest;
-            }
+#ifdef HAVE_LINUX_FSVERITY_H
+              /* First try to get the digest directly from the bare repo file.
+               * This is the typical case when we're pulled into the target
+               * system repo with verity on and are recreating the composefs
+               * image during deploy. */
+              union
+              {
+                struct fsverity_digest d;
+                char buf[sizeof (struct fsverity_digest) + OSTREE_SHA256_DIGEST_LEN];
+              } result;
+              guchar *known_digest = NULL;
+
+              if (G_IS_UNIX_INPUT_STREAM (input))
+                {
+                  int content_fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (input));
+                  result.d.digest_size = OSTREE_SHA256_DIGEST_LEN;
+
+                  if (ioctl (content_fd, FS_IOC_MEASURE_VERITY, &result) == 0
+                      && result.d.digest_size == OSTREE_SHA256_DIGEST_LEN
+                      && result.d.digest_algorithm == FS_VERITY_HASH_ALG_SHA256)
+                    known_digest = result.d.digest;
+                }
 #endif
 
-          if (known_digest)
-            lcfs_node_set_fsverity_digest (node, known_digest);
-          else if (verity == OT_TRISTATE_YES)
-            {
-              // Only fall back to userspace computation if explicitly requested
-              if (lcfs_node_set_fsverity_from_content (node, input, _composefs_read_cb) != 0)
-                return glnx_throw_errno (error);
+              if (known_digest)
+                {
+                  lcfs_node_set_fsverity_digest (node, known_digest);
+                  _ostree_repo_note_fsverity_digest (repo, checksum, known_digest);
+                  g_hash_table_insert (checkout->digests, g_strdup (checksum),
+                                       g_memdup2 (known_digest, OSTREE_SHA256_DIGEST_LEN));
+                }
+              else if (verity == OT_TRISTATE_YES
+                       && _ostree_fsverity_index_lookup (checkout->index, checksum, index_digest))
+                {
+                  lcfs_node_set_fsverity_digest (node, index_digest);
+                  checkout->used_index = TRUE;
+                  g_hash_table_insert (checkout->digests, g_strdup (checksum),
+                                       g_memdup2 (index_digest, OSTREE_SHA256_DIGEST_LEN));
+                }
+              else if (verity == OT_TRISTATE_YES)
+                {
+                  // Only fall back to userspace computation if explicitly requested
+                  pending_nodes = g_ptr_array_new_with_free_func ((GDestroyNotify)lcfs_node_unref);
+                  g_ptr_array_add (pending_nodes, lcfs_node_ref (node));
+                  g_hash_table_insert (checkout->pending, g_strdup (checksum), pending_nodes);
+                }
             }
         }
     }
@@ -369,10 +515,11 @@ checkout_one_composefs_file_at (OstreeRepo *repo, OtTristate verity, const char
 }
 
 static gboolean
-checkout_composefs_recurse (OstreeRepo *self, OtTristate verity, const char *dirtree_checksum,
+checkout_composefs_recurse (ComposefsCheckout *checkout, const char *dirtree_checksum,
                             const char *dirmeta_checksum, struct lcfs_node_s *parent,
                             const char *name, GCancellable *cancellable, GError **error)
 {
+  OstreeRepo *self = checkout->repo;
   g_autoptr (GVariant) dirtree = NULL;
   g_autoptr (GVariant) dirmeta = NULL;
   g_autoptr (GVariant) xattrs = NULL;
@@ -431,7 +578,7 @@ checkout_composefs_recurse (OstreeRepo *self, OtTristate verity, const char *dir
         char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
         _ostree_checksum_inplace_from_bytes_v (contents_csum_v, tmp_checksum);
 
-        if (!checkout_one_composefs_file_at (self, verity, tmp_checksum, directory, fname,
+        if (!checkout_one_composefs_file_at (checkout, tmp_checksum, directory, fname,
                                              cancellable, error))
           return glnx_prefix_error (error, "Processing %s", tmp_checksum);
       }
@@ -462,7 +609,7 @@ checkout_composefs_recurse (OstreeRepo *self, OtTristate verity, const char *dir
         _ostree_checksum_inplace_from_bytes_v (subdirtree_csum_v, subdirtree_checksum);
         char subdirmeta_checksum[OSTREE_SHA256_STRING_LEN + 1];
         _ostree_checksum_inplace_from_bytes_v (subdirmeta_csum_v, subdirmeta_checksum);
-        if (!checkout_composefs_recurse (self, verity, subdirtree_checksum, subdirmeta_checksum,
+        if (!checkout_composefs_recurse (checkout, subdirtree_checksum, subdirmeta_checksum,
                                          directory, dname, cancellable, error))
           return FALSE;
       }
@@ -476,7 +623,8 @@ checkout_composefs_recurse (OstreeRepo *self, OtTristate verity, const char *dir
 
 /* Begin a checkout process */
 static gboolean
-checkout_composefs_tree (OstreeRepo *self, OtTristate verity, OstreeComposefsTarget *target,
+checkout_composefs_tree (OstreeRepo *self, OtTristate verity, gboolean use_digest_index,
+                         gboolean *out_used_digest_index, OstreeComposefsTarget *target,
                          OstreeRepoFile *source, GFileInfo *source_info, GCancellable *cancellable,
                          GError **error)
 {
@@ -491,10 +639,27 @@ checkout_composefs_tree (OstreeRepo *self, OtTristate verity, OstreeComposefsTar
 
   g_assert_cmpint (g_file_info_get_file_type (source_info), ==, G_FILE_TYPE_DIRECTORY);
 
+  g_auto (ComposefsCheckout) checkout = {
+    NULL,
+  };
+  composefs_checkout_init (&checkout, self, verity, cancellable);
+  if (verity == OT_TRISTATE_YES && use_digest_index
+      && !_ostree_repo_load_fsverity_index (self, &checkout.index, error))
+    return FALSE;
+
   const char *dirtree_checksum = ostree_repo_file_tree_get_contents_checksum (source);
   const char *dirmeta_checksum = ostree_repo_file_tree_get_metadata_checksum (source);
-  return checkout_composefs_recurse (self, verity, dirtree_checksum, dirmeta_checksum, target->dest,
-                                     "root", cancellable, error);
+  if (!checkout_composefs_recurse (&checkout, dirtree_checksum, dirmeta_checksum, target->dest,
+                                   "root", cancellable, error))
+    return FALSE;
+
+  if (!compute_pending_digests (&checkout, error))
+    return FALSE;
+
+  _ostree_repo_flush_fsverity_index (self);
+  if (out_used_digest_index)
+    *out_used_digest_index = checkout.used_index;
+  return TRUE;
 }
 
 static struct lcfs_node_s *
@@ -526,6 +691,8 @@ ensure_lcfs_dir (struct lcfs_node_s *parent, const char *name, GError **error)
  * @self: Repo
  * @target: A target for the checkout
  * @verity: Use fsverity
+ * @use_digest_index: Look up digests which can't be measured in the fs-verity digest index
+ * @out_used_digest_index: (out) (optional): Set if any digest came from the index
  * @source: Source tree
  * @cancellable: Cancellable
  * @error: Error
@@ -541,7 +708,8 @@ ensure_lcfs_dir (struct lcfs_node_s *parent, const char *name, GError **error)
  * Returns: %TRUE on success, %FALSE on failure
  */
 gboolean
-_ostree_repo_checkout_composefs (OstreeRepo *self, OtTristate verity, OstreeComposefsTarget *target,
+_ostree_repo_checkout_composefs (OstreeRepo *self, OtTristate verity, gboolean use_digest_index,
+                                 gboolean *out_used_digest_index, OstreeComposefsTarget *target,
                                  OstreeRepoFile *source, GCancellable *cancellable, GError **error)
 {
 #ifdef HAVE_COMPOSEFS
@@ -556,7 +724,8 @@ _ostree_repo_checkout_composefs (OstreeRepo *self, OtTristate verity, OstreeComp
   if (!target_info)
     return glnx_prefix_error (error, "Failed to query");
 
-  if (!checkout_composefs_tree (self, verity, target, source, target_info, cancellable, error))
+  if (!checkout_composefs_tree (self, verity, use_digest_index, out_used_digest_index, target,
+                                source, target_info, cancellable, error))
     return FALSE;
 
   /* We need a root dir */
@@ -606,9 +775,10 @@ ostree_repo_commit_add_composefs_metadata (OstreeRepo *self, guint format_versio
 
   // We unconditionally add the expected verity digest. Note that for repositories
   // on filesystems without fsverity, this operation currently requires re-checksumming
-  // all objects.
-  if (!_ostree_repo_checkout_composefs (self, OT_TRISTATE_YES, target, repo_root, cancellable,
-                                        error))
+  // all objects; the digest index isn't authenticated, so it isn't used for metadata
+  // which may be signed.
+  if (!_ostree_repo_checkout_composefs (self, OT_TRISTATE_YES, FALSE, NULL, target, repo_root,
+                                        cancellable, error))
     return FALSE;
 
   g_autofree guchar *fsverity_digest = NULL;
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <gio/gunixinputstream.h>
+
 #include "ostree-core-private.h"
 #include "ostree-repo-private.h"
 #include "ostree.h"
@@ -38,6 +40,14 @@
 
 #define DEFAULT_DIRMODE (0755 | S_IFDIR)
 
+/* Regular files up to this size are read into memory and hashed and
+ * written by a pool of worker threads, while the main thread continues
+ * decompressing the archive; larger ones are streamed directly.
+ */
+#define AIC_MAX_BUFFERED_FILE_SIZE (8 * 1024 * 1024)
+/* Upper bound on the file data buffered for the worker threads */
+#define AIC_MAX_BYTES_IN_FLIGHT (64 * 1024 * 1024)
+
 static void
 propagate_libarchive_error (GError **error, struct archive *a)
 {
@@ -193,7 +203,8 @@ mtree_ensure_dir_with_meta (OstreeRepo *repo, OstreeMutableTree *parent, const c
 
   if (dir == NULL)
     {
-      if (!g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+      /* No error if @name exists as a file; ensure_dir() rejects that below */
+      if (*error != NULL && !g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
         return FALSE;
 
       g_clear_error (error);
@@ -224,8 +235,34 @@ typedef struct
   struct archive_entry *entry;
   GHashTable *deferred_hardlinks;
   OstreeRepoCommitModifier *modifier;
+  GCancellable *cancellable;
+
+  /* Content writes; see aic_queue_write() */
+  GThreadPool *write_pool;
+  GMutex write_lock;
+  GCond write_cond;
+  GQueue write_queue; /* (element-type AicWriteJob), in archive order */
+  gsize write_bytes_in_flight;
+  gboolean write_failed;
+  GHashTable *pending_paths; /* path -> number of queued writes for it */
 } OstreeRepoArchiveImportContext;
 
+typedef struct
+{
+  OstreeMutableTree *parent;
+  char *path;
+  char *name;
+  GFileInfo *fi;
+  GVariant *xattrs;
+  GBytes *content; /* Regular file data, if buffered */
+  gsize size;
+
+  /* Protected by write_lock */
+  gboolean done;
+  char *csum;
+  GError *error;
+} AicWriteJob;
+
 typedef struct
 {
   OstreeMutableTree *parent;
@@ -492,46 +529,250 @@ aic_handle_dir (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent,
 }
 
 static gboolean
-aic_write_file (OstreeRepoArchiveImportContext *ctx, GFileInfo *fi, GVariant *xattrs,
-                char **out_csum, GCancellable *cancellable, GError **error)
+aic_write_content (OstreeRepo *repo, GInputStream *content_input, GFileInfo *fi, GVariant *xattrs,
+                   char **out_csum, GCancellable *cancellable, GError **error)
 {
-  g_autoptr (GInputStream) archive_stream = NULL;
   g_autoptr (GInputStream) file_object_input = NULL;
   guint64 length;
 
   g_autofree guchar *csum_raw = NULL;
 
-  if (g_file_info_get_file_type (fi) == G_FILE_TYPE_REGULAR)
-    archive_stream = _ostree_libarchive_input_stream_new (ctx->archive);
-
-  if (!ostree_raw_file_to_content_stream (archive_stream, fi, xattrs, &file_object_input, &length,
+  if (!ostree_raw_file_to_content_stream (content_input, fi, xattrs, &file_object_input, &length,
                                           cancellable, error))
     return FALSE;
 
-  if (!ostree_repo_write_content (ctx->repo, NULL, file_object_input, length, &csum_raw,
-                                  cancellable, error))
+  if (!ostree_repo_write_content (repo, NULL, file_object_input, length, &csum_raw, cancellable,
+                                  error))
     return FALSE;
 
   *out_csum = ostree_checksum_from_bytes (csum_raw);
   return TRUE;
 }
 
+static void
+aic_write_job_free (AicWriteJob *job)
+{
+  g_object_unref (job->parent);
+  g_free (job->path);
+  g_free (job->name);
+  g_object_unref (job->fi);
+  g_clear_pointer (&job->xattrs, g_variant_unref);
+  g_clear_pointer (&job->content, g_bytes_unref);
+  g_free (job->csum);
+  g_clear_error (&job->error);
+  g_free (job);
+}
+
+static void
+aic_write_thread (gpointer datap, gpointer user_data)
+{
+  AicWriteJob *job = datap;
+  OstreeRepoArchiveImportContext *ctx = user_data;
+  g_autoptr (GInputStream) content_input = NULL;
+  g_autofree char *csum = NULL;
+  g_autoptr (GError) local_error = NULL;
+
+  if (job->content)
+    content_input = g_memory_input_stream_new_from_bytes (job->content);
+  (void)aic_write_content (ctx->repo, content_input, job->fi, job->xattrs, &csum,
+                           ctx->cancellable, &local_error);
+  g_clear_object (&content_input);
+
+  g_mutex_lock (&ctx->write_lock);
+  g_clear_pointer (&job->content, g_bytes_unref);
+  ctx->write_bytes_in_flight -= job->size;
+  job->csum = g_steal_pointer (&csum);
+  job->error = g_steal_pointer (&local_error);
+  job->done = TRUE;
+  g_cond_broadcast (&ctx->write_cond);
+  g_mutex_unlock (&ctx->write_lock);
+}
+
+/* Add finished writes to the mtree, strictly in archive order so that
+ * later entries replace earlier ones just as when importing serially.
+ * If @wait_all is set, wait for all queued writes; otherwise only wait
+ * while too much file data is buffered.
+ */
+static gboolean
+aic_apply_writes (OstreeRepoArchiveImportContext *ctx, gboolean wait_all, GError **error)
+{
+  g_mutex_lock (&ctx->write_lock);
+  while (TRUE)
+    {
+      AicWriteJob *job = g_queue_peek_head (&ctx->write_queue);
+      if (job != NULL && job->done)
+        {
+          g_queue_pop_head (&ctx->write_queue);
+          g_mutex_unlock (&ctx->write_lock);
+
+          guint n_pending = GPOINTER_TO_UINT (g_hash_table_lookup (ctx->pending_paths, job->path));
+          if (n_pending > 1)
+            g_hash_table_replace (ctx->pending_paths, g_strdup (job->path),
+                                  GUINT_TO_POINTER (n_pending - 1));
+          else
+            g_hash_table_remove (ctx->pending_paths, job->path);
+
+          gboolean ok;
+          if (job->error)
+            {
+              g_propagate_prefixed_error (error, g_steal_pointer (&job->error),
+                                          "ostree-tar: Failed to import file %s: ", job->path);
+              ok = FALSE;
+            }
+          else
+            ok = ostree_mutable_tree_replace_file (job->parent, job->name, job->csum, error);
+          aic_write_job_free (job);
+          if (!ok)
+            return FALSE;
+
+          g_mutex_lock (&ctx->write_lock);
+          continue;
+        }
+
+      if (job == NULL
+          || (!wait_all && !ctx->write_failed
+              && ctx->write_bytes_in_flight <= AIC_MAX_BYTES_IN_FLIGHT))
+        break;
+      g_cond_wait (&ctx->write_cond, &ctx->write_lock);
+    }
+  g_mutex_unlock (&ctx->write_lock);
+
+  return TRUE;
+}
+
+static GBytes *
+aic_read_entry_data (OstreeRepoArchiveImportContext *ctx, gsize size, GError **error)
+{
+  g_autofree guint8 *buf = g_malloc (size);
+  gsize offset = 0;
+
+  while (offset < size)
+    {
+      la_ssize_t r = archive_read_data (ctx->archive, buf + offset, size - offset);
+      if (r < 0)
+        {
+          propagate_libarchive_error (error, ctx->archive);
+          return NULL;
+        }
+      if (r == 0)
+        break;
+      offset += r;
+    }
+  if (offset != size)
+    return glnx_null_throw (error, "Short read from archive; expected %" G_GSIZE_FORMAT " bytes",
+                            size);
+
+  return g_bytes_new_take (g_steal_pointer (&buf), size);
+}
+
+/* Wait for queued writes if one of them is for a parent directory of
+ * @path, or for @path itself if it's a directory: that entry would then
+ * be added to the mtree after this one, reversing the archive order.
+ */
+static gboolean
+aic_wait_pending_parents (OstreeRepoArchiveImportContext *ctx, const char *path, gboolean is_dir,
+                          GError **error)
+{
+  if (g_hash_table_size (ctx->pending_paths) == 0)
+    return TRUE;
+
+  g_autoptr (GPtrArray) components = NULL;
+  if (!ot_util_path_split_validate (path, &components, error))
+    return FALSE;
+
+  g_autofree char *subpath = NULL;
+  const guint n = is_dir ? components->len : components->len - 1;
+  for (guint i = 0; i < n; i++)
+    {
+      append_path_component (&subpath, components->pdata[i]);
+      if (g_hash_table_contains (ctx->pending_paths, subpath))
+        return aic_apply_writes (ctx, TRUE, error);
+    }
+
+  return TRUE;
+}
+
+/* Write a file entry's content object, and add it to @parent once done.
+ * Decompressing the archive is inherently serial, but checksumming and
+ * writing objects isn't; so unless the file is large, buffer its data and
+ * hand it off to the write pool. Write errors are reported by
+ * aic_apply_writes().
+ */
+static gboolean
+aic_queue_write (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent, const char *path,
+                 GFileInfo *fi, GVariant *xattrs, GCancellable *cancellable, GError **error)
+{
+  const gboolean is_regular = g_file_info_get_file_type (fi) == G_FILE_TYPE_REGULAR;
+  const guint64 size = is_regular ? g_file_info_get_size (fi) : 0;
+
+  g_autoptr (GPtrArray) components = NULL;
+  if (!ot_util_path_split_validate (path, &components, error))
+    return FALSE;
+  g_autofree char *canonical_path = NULL;
+  for (guint i = 0; i < components->len; i++)
+    append_path_component (&canonical_path, components->pdata[i]);
+  if (canonical_path == NULL)
+    return glnx_throw (error, "Invalid file path \"%s\"", path);
+
+  AicWriteJob *job = g_new0 (AicWriteJob, 1);
+  job->parent = g_object_ref (parent);
+  job->path = g_steal_pointer (&canonical_path);
+  job->name = g_strdup (glnx_basename (path));
+  job->fi = g_object_ref (fi);
+  job->xattrs = xattrs ? g_variant_ref (xattrs) : NULL;
+
+  if (ctx->write_pool == NULL || size > AIC_MAX_BUFFERED_FILE_SIZE)
+    {
+      g_autoptr (GInputStream) archive_stream = NULL;
+      if (is_regular)
+        archive_stream = _ostree_libarchive_input_stream_new (ctx->archive);
+      if (!aic_write_content (ctx->repo, archive_stream, fi, xattrs, &job->csum, cancellable,
+                              &job->error))
+        ctx->write_failed = TRUE;
+      job->done = TRUE;
+
+      g_mutex_lock (&ctx->write_lock);
+      g_queue_push_tail (&ctx->write_queue, job);
+      g_mutex_unlock (&ctx->write_lock);
+    }
+  else
+    {
+      if (is_regular)
+        {
+          job->content = aic_read_entry_data (ctx, size, error);
+          if (job->content == NULL)
+            {
+              aic_write_job_free (job);
+              return FALSE;
+            }
+          job->size = size;
+        }
+
+      g_mutex_lock (&ctx->write_lock);
+      g_queue_push_tail (&ctx->write_queue, job);
+      ctx->write_bytes_in_flight += job->size;
+      g_mutex_unlock (&ctx->write_lock);
+      g_thread_pool_push (ctx->write_pool, job, NULL);
+    }
+
+  guint n_pending = GPOINTER_TO_UINT (g_hash_table_lookup (ctx->pending_paths, job->path));
+  g_hash_table_replace (ctx->pending_paths, g_strdup (job->path),
+                        GUINT_TO_POINTER (n_pending + 1));
+
+  return TRUE;
+}
+
 static gboolean
 aic_import_file (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent, const char *path,
                  GFileInfo *fi, GCancellable *cancellable, GError **error)
 {
   GLNX_AUTO_PREFIX_ERROR ("ostree-tar: Failed to import file", error);
-  const char *name = glnx_basename (path);
   g_autoptr (GVariant) xattrs = NULL;
-  g_autofree char *csum = NULL;
 
   if (!aic_get_xattrs (ctx, path, fi, &xattrs, cancellable, error))
     return FALSE;
 
-  if (!aic_write_file (ctx, fi, xattrs, &csum, cancellable, error))
-    return FALSE;
-
-  if (!ostree_mutable_tree_replace_file (parent, name, csum, error))
+  if (!aic_queue_write (ctx, parent, path, fi, xattrs, cancellable, error))
     return FALSE;
 
   return TRUE;
@@ -629,11 +870,20 @@ aic_import_entry (OstreeRepoArchiveImportContext *ctx, GCancellable *cancellable
   if (aic_apply_modifier_filter (ctx, path, &fi) == OSTREE_REPO_COMMIT_FILTER_SKIP)
     return TRUE;
 
+  const gboolean is_dir = g_file_info_get_file_type (fi) == G_FILE_TYPE_DIRECTORY;
+  if (!aic_wait_pending_parents (ctx, path, is_dir, error))
+    return FALSE;
+
   g_autoptr (OstreeMutableTree) parent = NULL;
   if (!aic_get_parent_dir (ctx, path, &parent, cancellable, error))
     return FALSE;
 
-  return aic_handle_entry (ctx, parent, path, fi, cancellable, error);
+  if (!aic_handle_entry (ctx, parent, path, fi, cancellable, error))
+    return FALSE;
+
+  /* Not under the per-entry error prefixes, as finished writes are
+   * generally for earlier entries */
+  return aic_apply_writes (ctx, FALSE, error);
 }
 
 static gboolean
@@ -784,16 +1034,28 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
   struct archive *a = archive;
   g_autoptr (GHashTable) deferred_hardlinks
       = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, deferred_hardlinks_list_free);
+  g_autoptr (GHashTable) pending_paths
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   OstreeRepoArchiveImportContext aictx = { .repo = self,
                                            .opts = opts,
                                            .root = mtree,
                                            .archive = archive,
                                            .deferred_hardlinks = deferred_hardlinks,
-                                           .modifier = modifier };
+                                           .pending_paths = pending_paths,
+                                           .modifier = modifier,
+                                           .cancellable = cancellable };
+  g_mutex_init (&aictx.write_lock);
+  g_cond_init (&aictx.write_cond);
+  g_queue_init (&aictx.write_queue);
 
   _ostree_repo_setup_generate_sizes (self, modifier);
 
+  /* The object size table used for generate-sizes isn't thread-safe */
+  if (!self->generate_sizes)
+    aictx.write_pool
+        = g_thread_pool_new (aic_write_thread, &aictx, g_get_num_processors (), FALSE, NULL);
+
   while (TRUE)
     {
       int r = archive_read_next_header (a, &aictx.entry);
@@ -812,6 +1074,10 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
         goto out;
     }
 
+  /* Hardlinks are resolved via the mtree, so wait for all content first */
+  if (!aic_apply_writes (&aictx, TRUE, error))
+    goto out;
+
   if (!aic_import_deferred_hardlinks (&aictx, cancellable, error))
     goto out;
 
@@ -838,6 +1104,12 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
 
   ret = TRUE;
 out:
+  /* Wait for any writes still in progress on error */
+  if (aictx.write_pool)
+    g_thread_pool_free (aictx.write_pool, FALSE, TRUE);
+  g_queue_clear_full (&aictx.write_queue, (GDestroyNotify)aic_write_job_free);
+  g_cond_clear (&aictx.write_cond);
+  g_mutex_clear (&aictx.write_lock);
   return ret;
 #else
   g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
@@ -1025,6 +1297,65 @@ out:
   return ret;
 }
 
+static gboolean
+write_data_to_libarchive (struct archive *a, const guint8 *data, gsize len, GError **error)
+{
+  while (len > 0)
+    {
+      ssize_t r = archive_write_data (a, data, len);
+      if (r <= 0)
+        {
+          propagate_libarchive_error (error, a);
+          return glnx_prefix_error (error,
+                                    "Failed to write %" G_GUINT64_FORMAT
+                                    " bytes (code %" G_GUINT64_FORMAT ")",
+                                    (guint64)len, (guint64)r);
+        }
+      data += r;
+      len -= r;
+    }
+
+  return TRUE;
+}
+
+/* For bare repositories the content stream is just the object fd; map it
+ * and hand libarchive the whole file rather than copying it through a
+ * small buffer.  Otherwise (e.g. archive mode, where we decompress) read
+ * in large chunks.
+ */
+static gboolean
+write_file_data_to_libarchive (struct archive *a, GInputStream *file_in, GCancellable *cancellable,
+                               GError **error)
+{
+  if (G_IS_UNIX_INPUT_STREAM (file_in))
+    {
+      int fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (file_in));
+      g_autoptr (GBytes) bytes = ot_fd_readall_or_mmap (fd, 0, error);
+      if (!bytes)
+        return FALSE;
+
+      gsize len;
+      const guint8 *data = g_bytes_get_data (bytes, &len);
+      return write_data_to_libarchive (a, data, len, error);
+    }
+
+  const gsize bufsize = 128 * 1024;
+  g_autofree guint8 *buf = g_malloc (bufsize);
+  while (TRUE)
+    {
+      gssize bytes_read = g_input_stream_read (file_in, buf, bufsize, cancellable, error);
+      if (bytes_read < 0)
+        return FALSE;
+      if (bytes_read == 0)
+        break;
+
+      if (!write_data_to_libarchive (a, buf, bytes_read, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 write_directory_to_libarchive_recurse (OstreeRepo *self, OstreeRepoExportArchiveOptions *opts,
                                        GFile *root, GFile *dir, struct archive *a,
@@ -1090,7 +1421,6 @@ write_directory_to_libarchive_recurse (OstreeRepo *self, OstreeRepoExportArchive
           break;
         case G_FILE_TYPE_REGULAR:
           {
-            guint8 buf[8192];
             g_autoptr (GInputStream) file_in = NULL;
             g_autoptr (GFileInfo) regular_file_info = NULL;
             const char *checksum;
@@ -1127,28 +1457,8 @@ write_directory_to_libarchive_recurse (OstreeRepo *self, OstreeRepoExportArchive
                 goto out;
               }
 
-            while (TRUE)
-              {
-                gssize bytes_read
-                    = g_input_stream_read (file_in, buf, sizeof (buf), cancellable, error);
-                if (bytes_read < 0)
-                  goto out;
-                if (bytes_read == 0)
-                  break;
-
-                {
-                  ssize_t r = archive_write_data (a, buf, bytes_read);
-                  if (r != bytes_read)
-                    {
-                      propagate_libarchive_error (error, a);
-                      g_prefix_error (error,
-                                      "Failed to write %" G_GUINT64_FORMAT
-                                      " bytes (code %" G_GUINT64_FORMAT "): ",
-                                      (guint64)bytes_read, (guint64)r);
-                      goto out;
-                    }
-                }
-              }
+            if (!write_file_data_to_libarchive (a, file_in, cancellable, error))
+              goto out;
 
             if (archive_write_finish_entry (a) != ARCHIVE_OK)
               {
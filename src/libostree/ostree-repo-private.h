@@ -31,6 +31,18 @@ G_BEGIN_DECLS
 #define OSTREE_DELTAPART_VERSION (0)
 
 #define _OSTREE_SUMMARY_CACHE_DIR "summaries"
+#define _OSTREE_REACHABLE_CACHE_DIR "reachable"
+#define _OSTREE_FSVERITY_INDEX "fsverity-index"
+#define _OSTREE_FSVERITY_INDEX_JOURNAL "fsverity-index.journal"
+
+/* Bloom filter of the content objects and static deltas in a repository,
+ * published next to the summary when `core/objects-bloom` is set.  It is a
+ * `(yyay)` GVariant of k, hash function ID and the filter bytes; the
+ * elements are content object checksums and static delta names, hashed
+ * with ostree_str_bloom_hash(). */
+#define _OSTREE_OBJECTS_BLOOM "objects.bloom"
+#define _OSTREE_OBJECTS_BLOOM_HASH_ID 1
+#define _OSTREE_OBJECTS_BLOOM_DEFAULT_FP_RATE 0.01
 #define _OSTREE_CACHE_DIR "cache"
 
 #define _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS 2
@@ -189,6 +201,10 @@ struct OstreeRepo
   gboolean txn_locked;
   _OstreeFeatureSupport fs_verity_wanted;
   _OstreeFeatureSupport fs_verity_supported;
+  /* char * checksum → fs-verity digest not yet in the on-disk index; guarded by txn_lock */
+  GHashTable *pending_fsverity_digests;
+  /* char * checksum → commit graph record not yet written out; guarded by txn_lock */
+  GHashTable *pending_commit_graph;
   OtTristate composefs_wanted;
   gboolean composefs_supported;
 
@@ -196,6 +212,18 @@ struct OstreeRepo
   guint dirmeta_cache_refcount;
   /* char * checksum → GVariant * for dirmeta objects, used in the checkout path */
   GHashTable *dirmeta_cache;
+  /* Bounded LRU cache of dirtree and dirmeta objects, shared by all readers;
+   * char * checksum → GList * link in metadata_cache_lru */
+  GHashTable *metadata_cache;
+  GQueue metadata_cache_lru;  /* OstreeRepoMetadataCacheEntry *, most recently used first */
+  gsize metadata_cache_size; /* Total size of the cached variants */
+  guint64 metadata_cache_hits;
+  guint64 metadata_cache_misses;
+  GBytes *commit_graph;           /* Records of state/commit-graph */
+  struct stat commit_graph_stbuf; /* state/commit-graph when commit_graph was loaded */
+  /* Successful signature verifications, in memory only; see
+   * ostree-repo-pull-verify.c */
+  GHashTable *verify_cache;
 
   gboolean inited;
   gboolean writable;
@@ -207,8 +235,19 @@ struct OstreeRepo
   gboolean per_object_fsync;
   gboolean disable_xattrs;
   guint zlib_compression_level;
+  gboolean archive_zstd; /* See the [archive] compression config option */
+  gint zstd_compression_level;
   GHashTable *loose_object_devino_hash;
   GHashTable *updated_uncompressed_dirs;
+  guint64 uncompressed_cache_max_mb; /* See the uncompressed-cache-max-size config option */
+  gboolean uncompressed_cache_grew;  /* Objects were added since the last prune; cache_lock */
+  guint uncompressed_cache_hits;     /* atomic */
+  guint uncompressed_cache_misses;   /* atomic */
+  gboolean packed_refs;              /* See the packed-refs config option */
+  GMutex packed_refs_lock;
+  /* char * path → char * checksum, parsed from refs/packed-refs; packed_refs_lock */
+  GHashTable *packed_refs_cache;
+  struct stat packed_refs_stbuf; /* refs/packed-refs when packed_refs_cache was loaded */
 
   /* FIXME: The object sizes hash table is really per-commit state, not repo
    * state. Using a single table for the repo means that commits cannot be
@@ -307,6 +346,13 @@ gboolean _ostree_repo_update_refs (OstreeRepo *self, GHashTable *refs, GCancella
 gboolean _ostree_repo_update_collection_refs (OstreeRepo *self, GHashTable *refs,
                                               GCancellable *cancellable, GError **error);
 
+gboolean _ostree_repo_pack_refs (OstreeRepo *self, GHashTable *refs, GHashTable *collection_refs,
+                                 GCancellable *cancellable, GError **error);
+
+#define _OSTREE_PACKED_REFS_PATH "refs/packed-refs"
+
+gboolean _ostree_parse_packed_refs (const char *contents, GHashTable **out_refs, GError **error);
+
 gboolean _ostree_repo_file_replace_contents (OstreeRepo *self, int dfd, const char *path,
                                              const guint8 *buf, gsize len,
                                              GCancellable *cancellable, GError **error);
@@ -326,6 +372,13 @@ gboolean _ostree_repo_traverse_dirtree_internal (OstreeRepo *repo, const char *d
                                                  GHashTable *inout_content_names,
                                                  GCancellable *cancellable, GError **error);
 
+gboolean _ostree_repo_traverse_commit_cached (OstreeRepo *self, const char *commit,
+                                              GHashTable *inout_reachable,
+                                              GCancellable *cancellable, GError **error);
+
+gboolean _ostree_repo_traverse_reachable_refs_cached (OstreeRepo *self, GHashTable *reachable,
+                                                      GCancellable *cancellable, GError **error);
+
 OstreeRepoCommitFilterResult _ostree_repo_commit_modifier_apply (OstreeRepo *self,
                                                                  OstreeRepoCommitModifier *modifier,
                                                                  const char *path,
@@ -344,6 +397,10 @@ OstreeGpgVerifyResult *_ostree_repo_gpg_verify_with_metadata (
 OstreeGpgVerifyResult *_ostree_repo_verify_commit_internal (
     OstreeRepo *self, const char *commit_checksum, const char *remote_name, GFile *keyringdir,
     GFile *extra_keyring, GCancellable *cancellable, GError **error);
+
+gboolean _ostree_repo_gpg_checksum_keyrings (OstreeRepo *self, const char *remote_name,
+                                             char **out_checksum, GCancellable *cancellable,
+                                             GError **error);
 #endif /* OSTREE_DISABLE_GPGME */
 
 typedef enum
@@ -415,6 +472,31 @@ gboolean _ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *sig
 gboolean _ostree_ensure_fsverity (OstreeRepo *self, gboolean allow_enoent, int dirfd,
                                   const char *path, gboolean *supported, GError **error);
 
+void _ostree_repo_note_fsverity_digest (OstreeRepo *self, const char *checksum,
+                                        const guint8 *digest);
+
+void _ostree_repo_note_fsverity_digest_from_fd (OstreeRepo *self, const char *checksum, int fd);
+
+void _ostree_repo_flush_fsverity_index (OstreeRepo *self);
+
+void _ostree_repo_note_commit (OstreeRepo *self, const char *checksum, GVariant *commit);
+
+void _ostree_repo_flush_commit_graph (OstreeRepo *self, gboolean drop_missing,
+                                      GCancellable *cancellable);
+
+typedef struct _OstreeFsverityIndex OstreeFsverityIndex;
+
+void _ostree_fsverity_index_free (OstreeFsverityIndex *index);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeFsverityIndex, _ostree_fsverity_index_free)
+
+gboolean _ostree_repo_load_fsverity_index (OstreeRepo *self, OstreeFsverityIndex **out_index,
+                                           GError **error);
+
+gboolean _ostree_fsverity_index_lookup (OstreeFsverityIndex *index, const char *checksum,
+                                        guint8 *out_digest);
+
+gboolean _ostree_repo_drop_fsverity_index (OstreeRepo *self, GError **error);
+
 gboolean _ostree_repo_verify_bindings (const char *collection_id, const char *ref_name,
                                        GVariant *commit, GError **error);
 
@@ -474,6 +556,8 @@ gboolean ostree_composefs_target_write (OstreeComposefsTarget *target, int fd,
                                         GError **error);
 
 gboolean _ostree_repo_checkout_composefs (OstreeRepo *self, OtTristate verity,
+                                          gboolean use_digest_index,
+                                          gboolean *out_used_digest_index,
                                           OstreeComposefsTarget *target, OstreeRepoFile *source,
                                           GCancellable *cancellable, GError **error);
 static inline gboolean
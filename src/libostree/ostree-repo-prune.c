@@ -136,12 +136,58 @@ exit:
   return TRUE;
 }
 
+/* Drop cached reachability data for commits which no longer exist;
+ * see _ostree_repo_traverse_commit_cached().
+ */
+static gboolean
+prune_reachable_cache (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  gboolean exists;
+  if (!ot_dfd_iter_init_allow_noent (self->cache_dir_fd, _OSTREE_REACHABLE_CACHE_DIR, &dfd_iter,
+                                     &exists, error))
+    return FALSE;
+  /* Note early return */
+  if (!exists)
+    return TRUE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      gboolean have_commit = FALSE;
+      if (ostree_validate_checksum_string (dent->d_name, NULL))
+        {
+          if (!ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_COMMIT, dent->d_name, &have_commit,
+                                       cancellable, error))
+            return FALSE;
+        }
+
+      if (!have_commit)
+        {
+          if (!glnx_unlinkat (dfd_iter.fd, dent->d_name, 0, error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 static gboolean
 _ostree_repo_prune_tmp (OstreeRepo *self, GCancellable *cancellable, GError **error)
 {
   if (self->cache_dir_fd == -1)
     return TRUE;
 
+  if (!prune_reachable_cache (self, cancellable, error))
+    return FALSE;
+
   g_auto (GLnxDirFdIterator) dfd_iter = {
     0,
   };
@@ -278,6 +324,10 @@ repo_prune_internal (OstreeRepo *self, GHashTable *objects, OstreeRepoPruneOptio
         return FALSE;
     }
 
+  /* Drop the commit graph records of any commits we just deleted */
+  if (!(options->flags & OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE) && data.n_unreachable_meta > 0)
+    _ostree_repo_flush_commit_graph (self, TRUE, cancellable);
+
   if (!ostree_repo_prune_static_deltas (self, NULL, cancellable, error))
     return FALSE;
 
@@ -291,10 +341,206 @@ repo_prune_internal (OstreeRepo *self, GHashTable *objects, OstreeRepoPruneOptio
   return TRUE;
 }
 
+/* The reachable cache stores, per commit, the set of objects found by a
+ * depth 0 traversal.  Commits are immutable, so the set never changes once
+ * the commit is complete.  The file format is a header holding a magic and
+ * the number of records, followed by one record per object: the binary
+ * checksum and one byte of object type, and finally the SHA-256 of the
+ * header and records.  Prune deletes anything missing from the set, so
+ * a corrupted file must never be used.
+ */
+#define REACHABLE_CACHE_MAGIC "OSTRCH02"
+#define REACHABLE_CACHE_HEADER_SIZE (8 + sizeof (guint64))
+#define REACHABLE_CACHE_RECORD_SIZE (OSTREE_SHA256_DIGEST_LEN + 1)
+
+static gboolean
+load_reachable_cache (OstreeRepo *self, const char *commit, GHashTable *inout_reachable,
+                      gboolean *out_loaded, GError **error)
+{
+  const char *path = glnx_strjoina (_OSTREE_REACHABLE_CACHE_DIR, "/", commit);
+
+  *out_loaded = FALSE;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, path, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  g_autoptr (GBytes) bytes = ot_fd_readall_or_mmap (fd, 0, error);
+  if (!bytes)
+    return FALSE;
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (bytes, &len);
+  guint64 n_records;
+  if (len < REACHABLE_CACHE_HEADER_SIZE + OSTREE_SHA256_DIGEST_LEN
+      || memcmp (buf, REACHABLE_CACHE_MAGIC, 8) != 0)
+    goto invalid;
+  len -= OSTREE_SHA256_DIGEST_LEN;
+  {
+    g_auto (OtChecksum) hasher = {
+      0,
+    };
+    guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+    ot_checksum_init (&hasher);
+    ot_checksum_update (&hasher, buf, len);
+    ot_checksum_get_digest (&hasher, digest, sizeof (digest));
+    if (memcmp (digest, buf + len, sizeof (digest)) != 0)
+      goto invalid;
+  }
+  memcpy (&n_records, buf + 8, sizeof (n_records));
+  n_records = GUINT64_FROM_LE (n_records);
+  if (n_records == 0
+      || (len - REACHABLE_CACHE_HEADER_SIZE) / REACHABLE_CACHE_RECORD_SIZE != n_records
+      || (len - REACHABLE_CACHE_HEADER_SIZE) % REACHABLE_CACHE_RECORD_SIZE != 0)
+    goto invalid;
+
+  /* Validate everything before touching @inout_reachable */
+  for (gsize off = REACHABLE_CACHE_HEADER_SIZE; off < len; off += REACHABLE_CACHE_RECORD_SIZE)
+    {
+      guint8 objtype = buf[off + OSTREE_SHA256_DIGEST_LEN];
+      if (objtype < OSTREE_OBJECT_TYPE_FILE || objtype > OSTREE_OBJECT_TYPE_LAST)
+        goto invalid;
+    }
+
+  for (gsize off = REACHABLE_CACHE_HEADER_SIZE; off < len; off += REACHABLE_CACHE_RECORD_SIZE)
+    {
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (buf + off, checksum);
+      OstreeObjectType objtype = buf[off + OSTREE_SHA256_DIGEST_LEN];
+      g_hash_table_add (inout_reachable,
+                        g_variant_ref_sink (ostree_object_name_serialize (checksum, objtype)));
+    }
+
+  *out_loaded = TRUE;
+  return TRUE;
+
+invalid:
+  g_debug ("Ignoring invalid reachable cache for commit %s", commit);
+  /* We'll traverse the commit and write a new one instead */
+  (void)unlinkat (self->cache_dir_fd, path, 0);
+  return TRUE;
+}
+
+/* This is an optimization only; errors are logged and otherwise ignored. */
+static void
+store_reachable_cache (OstreeRepo *self, const char *commit, GHashTable *reachable,
+                       GCancellable *cancellable)
+{
+  const char *path = glnx_strjoina (_OSTREE_REACHABLE_CACHE_DIR, "/", commit);
+  guint64 n_records = g_hash_table_size (reachable);
+  g_autoptr (GByteArray) buf = g_byte_array_sized_new (
+      REACHABLE_CACHE_HEADER_SIZE + n_records * REACHABLE_CACHE_RECORD_SIZE);
+  guint64 n_records_le = GUINT64_TO_LE (n_records);
+
+  g_byte_array_append (buf, (const guint8 *)REACHABLE_CACHE_MAGIC, 8);
+  g_byte_array_append (buf, (const guint8 *)&n_records_le, sizeof (n_records_le));
+  GLNX_HASH_TABLE_FOREACH (reachable, GVariant *, key)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      guint8 record[REACHABLE_CACHE_RECORD_SIZE];
+
+      ostree_object_name_deserialize (key, &checksum, &objtype);
+      ostree_checksum_inplace_to_bytes (checksum, record);
+      record[OSTREE_SHA256_DIGEST_LEN] = objtype;
+      g_byte_array_append (buf, record, sizeof (record));
+    }
+  g_auto (OtChecksum) hasher = {
+    0,
+  };
+  guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_init (&hasher);
+  ot_checksum_update (&hasher, buf->data, buf->len);
+  ot_checksum_get_digest (&hasher, digest, sizeof (digest));
+  g_byte_array_append (buf, digest, sizeof (digest));
+
+  g_autoptr (GError) local_error = NULL;
+  if (!glnx_shutil_mkdir_p_at (self->cache_dir_fd, _OSTREE_REACHABLE_CACHE_DIR,
+                               DEFAULT_DIRECTORY_MODE, cancellable, &local_error)
+      || !glnx_file_replace_contents_at (
+          self->cache_dir_fd, path, buf->data, buf->len,
+          self->disable_fsync ? GLNX_FILE_REPLACE_NODATASYNC : GLNX_FILE_REPLACE_DATASYNC_NEW,
+          cancellable, &local_error))
+    g_debug ("Failed to write reachable cache for commit %s: %s", commit, local_error->message);
+}
+
+/*
+ * _ostree_repo_traverse_commit_cached:
+ * @self: Repo
+ * @commit: ASCII SHA256 checksum of a commit
+ * @inout_reachable: Set of reachable objects (will be modified)
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Like ostree_repo_traverse_commit_union() with a depth of 0, but
+ * consults (and populates) a per-commit cache of the reachable set
+ * in the repository cache directory.  Since commits are immutable,
+ * repeated prunes (e.g. after every sysroot upgrade) then only pay
+ * for a full traversal of commits they haven't seen before.
+ *
+ * Partial commits are traversed but never cached.
+ */
+gboolean
+_ostree_repo_traverse_commit_cached (OstreeRepo *self, const char *commit,
+                                     GHashTable *inout_reachable, GCancellable *cancellable,
+                                     GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return ostree_repo_traverse_commit_union (self, commit, 0, inout_reachable, cancellable,
+                                              error);
+
+  g_autoptr (GVariant) commit_key
+      = g_variant_ref_sink (ostree_object_name_serialize (commit, OSTREE_OBJECT_TYPE_COMMIT));
+  if (g_hash_table_contains (inout_reachable, commit_key))
+    return TRUE;
+
+  gboolean loaded;
+  if (!load_reachable_cache (self, commit, inout_reachable, &loaded, error))
+    return FALSE;
+  if (loaded)
+    return TRUE;
+
+  g_autoptr (GHashTable) commit_reachable = ostree_repo_traverse_new_reachable ();
+  if (!ostree_repo_traverse_commit_union (self, commit, 0, commit_reachable, cancellable, error))
+    return FALSE;
+
+  if (g_hash_table_contains (commit_reachable, commit_key))
+    {
+      OstreeRepoCommitState state;
+      if (!ostree_repo_load_commit (self, commit, NULL, &state, error))
+        return FALSE;
+      if ((state & OSTREE_REPO_COMMIT_STATE_PARTIAL) == 0)
+        store_reachable_cache (self, commit, commit_reachable, cancellable);
+    }
+
+  GLNX_HASH_TABLE_FOREACH (commit_reachable, GVariant *, key)
+    g_hash_table_add (inout_reachable, g_variant_ref (key));
+
+  return TRUE;
+}
+
+static gboolean
+traverse_one_commit (OstreeRepo *self, OstreeRepoCommitTraverseFlags flags, guint depth,
+                     gboolean use_cache, const char *checksum, GHashTable *reachable,
+                     GCancellable *cancellable, GError **error)
+{
+  g_debug ("Finding objects to keep for commit %s", checksum);
+  if (use_cache)
+    return _ostree_repo_traverse_commit_cached (self, checksum, reachable, cancellable, error);
+  return ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable, NULL,
+                                                 cancellable, error);
+}
+
 static gboolean
 traverse_reachable_internal (OstreeRepo *self, OstreeRepoCommitTraverseFlags flags, guint depth,
-                             GHashTable *reachable, GCancellable *cancellable, GError **error)
+                             gboolean use_cache, GHashTable *reachable, GCancellable *cancellable,
+                             GError **error)
 {
+  /* The cache only covers full traversals at depth 0 */
+  g_assert (!use_cache || (flags == OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE && depth == 0));
+
   g_autoptr (OstreeRepoAutoLock) lock
       = ostree_repo_auto_lock_push (self, OSTREE_REPO_LOCK_SHARED, cancellable, error);
   if (!lock)
@@ -308,9 +554,8 @@ traverse_reachable_internal (OstreeRepo *self, OstreeRepoCommitTraverseFlags fla
 
   GLNX_HASH_TABLE_FOREACH_V (all_refs, const char *, checksum)
     {
-      g_debug ("Finding objects to keep for commit %s", checksum);
-      if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable, NULL,
-                                                   cancellable, error))
+      if (!traverse_one_commit (self, flags, depth, use_cache, checksum, reachable, cancellable,
+                                error))
         return FALSE;
     }
 
@@ -324,15 +569,25 @@ traverse_reachable_internal (OstreeRepo *self, OstreeRepoCommitTraverseFlags fla
 
   GLNX_HASH_TABLE_FOREACH_V (all_collection_refs, const char *, checksum)
     {
-      g_debug ("Finding objects to keep for commit %s", checksum);
-      if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable, NULL,
-                                                   cancellable, error))
+      if (!traverse_one_commit (self, flags, depth, use_cache, checksum, reachable, cancellable,
+                                error))
         return FALSE;
     }
 
   return TRUE;
 }
 
+/* Like ostree_repo_traverse_reachable_refs() with a depth of 0, but using
+ * _ostree_repo_traverse_commit_cached() for each ref.
+ */
+gboolean
+_ostree_repo_traverse_reachable_refs_cached (OstreeRepo *self, GHashTable *reachable,
+                                             GCancellable *cancellable, GError **error)
+{
+  return traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, 0, TRUE,
+                                      reachable, cancellable, error);
+}
+
 /**
  * ostree_repo_traverse_reachable_refs:
  * @self: Repo
@@ -350,8 +605,8 @@ gboolean
 ostree_repo_traverse_reachable_refs (OstreeRepo *self, guint depth, GHashTable *reachable,
                                      GCancellable *cancellable, GError **error)
 {
-  return traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, depth, reachable,
-                                      cancellable, error);
+  return traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, depth, FALSE,
+                                      reachable, cancellable, error);
 }
 
 /**
@@ -408,7 +663,8 @@ ostree_repo_prune (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
 
   if (refs_only)
     {
-      if (!traverse_reachable_internal (self, traverse_flags, depth, reachable, cancellable, error))
+      if (!traverse_reachable_internal (self, traverse_flags, depth, FALSE, reachable, cancellable,
+                                        error))
         return FALSE;
     }
 
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "ostree-bloom-private.h"
 #include "ostree-fetcher-util.h"
 #include "ostree-remote-private.h"
 #include "ostree-repo-private.h"
@@ -32,6 +33,25 @@ typedef enum
   OSTREE_FETCHER_SECURITY_STATE_INSECURE,
 } OstreeFetcherSecurityState;
 
+/* Per-mirror bookkeeping for the `stripe-mirrors` pull option */
+typedef struct
+{
+  guint n_outstanding;        /* Requests currently started on this mirror */
+  guint n_failures;           /* Requests started on this mirror which failed */
+  double bytes_per_sec;       /* Moving average of observed throughput; 0 if unknown */
+  OstreeBloom *objects_bloom; /* (nullable): Content the mirror advertises it has */
+} OtPullMirrorStats;
+
+/* A span of work recorded for the `trace-file` pull option */
+typedef struct
+{
+  const char *phase; /* e.g. "fetch", "write"; a static string */
+  char *name;        /* Object, delta part or file the span is about */
+  gint64 start;      /* Microseconds since the start of the pull */
+  gint64 duration;   /* Microseconds */
+  gint64 size;       /* Bytes transferred, or -1 */
+} OtPullTraceEvent;
+
 typedef struct
 {
   OstreeRepo *repo;
@@ -45,6 +65,9 @@ typedef struct
 
   GPtrArray *meta_mirrorlist;    /* List of base URIs for fetching metadata */
   GPtrArray *content_mirrorlist; /* List of base URIs for fetching content */
+  gboolean stripe_mirrors;
+  GPtrArray *content_mirror_rotations;     /* content_mirrorlist starting at each entry */
+  OtPullMirrorStats *content_mirror_stats; /* (array length=content_mirrorlist->len) */
   OstreeRepo *remote_repo_local;
   GPtrArray *localcache_repos; /* Array<OstreeRepo> */
 
@@ -92,6 +115,8 @@ typedef struct
   GHashTable *signapi_verified_commits; /* Map<checksum,verification> of commits that have been
                                            signapi verified */
   GHashTable *ref_keyring_map;          /* Maps OstreeCollectionRef to keyring remote name */
+  gboolean remote_packed_refs_fetched;
+  GHashTable *remote_packed_refs; /* Map<path,checksum> from refs/packed-refs, if it exists */
 
   GHashTable *static_delta_targets; /* Set<checksum> of commits fetched via static delta */
 
@@ -133,6 +158,8 @@ typedef struct
   int maxdepth;
   guint64 max_metadata_size;
   guint64 start_time;
+  GArray *trace_events; /* OtPullTraceEvent; NULL unless the trace-file option is set */
+  guint n_trace_events_dropped;
 
   gboolean is_mirror;
   gboolean trusted_http_direct;
@@ -159,8 +186,12 @@ typedef struct
 gboolean _signapi_init_for_remote (OstreeRepo *repo, const char *remote_name,
                                    GPtrArray **out_commit_verifiers,
                                    GPtrArray **out_summary_verifiers, GError **error);
-gboolean _sign_verify_for_remote (GPtrArray *signers, GBytes *signed_data, GVariant *metadata,
-                                  char **out_success_message, GError **error);
+gboolean _sign_verify_for_remote (OstreeRepo *repo, GPtrArray *signers, GBytes *signed_data,
+                                  GVariant *metadata, char **out_success_message, GError **error);
+
+gboolean _ostree_repo_gpg_verify_cached (OstreeRepo *repo, GBytes *signed_data, GVariant *metadata,
+                                         const char *remote_name, GString *out_description,
+                                         GCancellable *cancellable, GError **error);
 
 gboolean _verify_unwritten_commit (OtPullData *pull_data, const char *checksum, GVariant *commit,
                                    GVariant *detached_metadata, const OstreeCollectionRef *ref,
@@ -39,6 +39,7 @@
 #include <systemd/sd-journal.h>
 #endif
 
+#include "ostree-sign-private.h"
 #include "ostree-sign.h"
 
 static gboolean
@@ -239,12 +240,97 @@ _signapi_init_for_remote (OstreeRepo *repo, const char *remote_name,
   return TRUE;
 }
 
+/* Successful signature verifications are cached in memory for the lifetime
+ * of the OstreeRepo, since verifying with GPG in particular is expensive and
+ * the same commits and summaries can be verified several times, e.g. by a
+ * long-running daemon.  Entries are keyed by a checksum over the signature
+ * type, the keys used, the signed data and its signatures, so any change to
+ * those just misses the cache.  They are deliberately not persisted: an
+ * entry on disk is only as trustworthy as whoever can write to the cache
+ * directory, and signatures are what establishes that trust in the first
+ * place.  Failed verifications are never cached.
+ */
+#define VERIFY_CACHE_MAX_ENTRIES 1024
+
+typedef struct
+{
+  guint64 valid_until; /* Seconds since the epoch, or 0 for no limit */
+  char *description;
+} VerifyCacheEntry;
+
+static void
+verify_cache_entry_free (VerifyCacheEntry *entry)
+{
+  g_free (entry->description);
+  g_free (entry);
+}
+
+static char *
+verify_cache_key (const char *kind, const char *keys_checksum, GBytes *signed_data,
+                  GVariant *signatures)
+{
+  g_auto (OtChecksum) checksum = {
+    0,
+  };
+  ot_checksum_init (&checksum);
+  ot_checksum_update (&checksum, (const guint8 *)kind, strlen (kind) + 1);
+  ot_checksum_update (&checksum, (const guint8 *)keys_checksum, strlen (keys_checksum) + 1);
+
+  guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_bytes (signed_data, digest);
+  ot_checksum_update (&checksum, digest, sizeof (digest));
+  g_autoptr (GBytes) signatures_bytes = g_variant_get_data_as_bytes (signatures);
+  ot_checksum_update_bytes (&checksum, signatures_bytes);
+
+  char hexdigest[OSTREE_SHA256_STRING_LEN + 1];
+  ot_checksum_get_hexdigest (&checksum, hexdigest, sizeof (hexdigest));
+  return g_strdup (hexdigest);
+}
+
+static gboolean
+verify_cache_lookup (OstreeRepo *repo, const char *key, char **out_description)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&repo->cache_lock);
+  const VerifyCacheEntry *entry
+      = repo->verify_cache ? g_hash_table_lookup (repo->verify_cache, key) : NULL;
+  if (entry == NULL)
+    return FALSE;
+  if (entry->valid_until != 0
+      && (guint64)g_get_real_time () / G_USEC_PER_SEC >= entry->valid_until)
+    {
+      g_hash_table_remove (repo->verify_cache, key);
+      return FALSE;
+    }
+
+  g_debug ("Using cached signature verification %s", key);
+  *out_description = g_strdup (entry->description);
+  return TRUE;
+}
+
+static void
+verify_cache_store (OstreeRepo *repo, const char *key, guint64 valid_until,
+                    const char *description)
+{
+  VerifyCacheEntry *entry = g_new0 (VerifyCacheEntry, 1);
+  entry->valid_until = valid_until;
+  entry->description = g_strdup (description ?: "");
+
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&repo->cache_lock);
+  if (repo->verify_cache == NULL)
+    repo->verify_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                (GDestroyNotify)verify_cache_entry_free);
+  /* Verifications are cheap compared to tracking recency, so just start over */
+  if (g_hash_table_size (repo->verify_cache) >= VERIFY_CACHE_MAX_ENTRIES)
+    g_hash_table_remove_all (repo->verify_cache);
+  g_hash_table_replace (repo->verify_cache, g_strdup (key), entry);
+}
+
 /* Iterate over the configured verifiers, and require the commit is signed
  * by at least one.
  */
 gboolean
-_sign_verify_for_remote (GPtrArray *verifiers, GBytes *signed_data, GVariant *metadata,
-                         char **out_success_message, GError **error)
+_sign_verify_for_remote (OstreeRepo *repo, GPtrArray *verifiers, GBytes *signed_data,
+                         GVariant *metadata, char **out_success_message, GError **error)
 {
   guint n_invalid_signatures = 0;
   g_autoptr (GError) last_sig_error = NULL;
@@ -269,6 +355,20 @@ _sign_verify_for_remote (GPtrArray *verifiers, GBytes *signed_data, GVariant *me
       found_sig = TRUE;
 
       g_autofree char *success_message = NULL;
+      g_autofree char *keys_checksum = _ostree_sign_checksum_keys (sign);
+      g_autofree char *cache_key = NULL;
+      if (keys_checksum != NULL)
+        {
+          cache_key = verify_cache_key (ostree_sign_get_name (sign), keys_checksum, signed_data,
+                                        signatures);
+          if (verify_cache_lookup (repo, cache_key, &success_message))
+            {
+              if (out_success_message)
+                *out_success_message = g_steal_pointer (&success_message);
+              return TRUE;
+            }
+        }
+
       /* Return true if any signature fit to pre-loaded public keys.
        * If no keys configured -- then system configuration will be used */
       if (!ostree_sign_data_verify (sign, signed_data, signatures, &success_message,
@@ -277,6 +377,8 @@ _sign_verify_for_remote (GPtrArray *verifiers, GBytes *signed_data, GVariant *me
           n_invalid_signatures++;
           continue;
         }
+      if (cache_key != NULL)
+        verify_cache_store (repo, cache_key, 0, success_message);
       /* Accept the first valid signature */
       if (out_success_message)
         *out_success_message = g_steal_pointer (&success_message);
@@ -294,6 +396,98 @@ _sign_verify_for_remote (GPtrArray *verifiers, GBytes *signed_data, GVariant *me
 }
 
 #ifndef OSTREE_DISABLE_GPGME
+/* Returns the earliest expiry of the valid signatures in @result and their
+ * keys, or 0 if none of them expire.
+ */
+static guint64
+gpg_result_valid_until (OstreeGpgVerifyResult *result)
+{
+  OstreeGpgSignatureAttr attrs[] = {
+    OSTREE_GPG_SIGNATURE_ATTR_VALID,
+    OSTREE_GPG_SIGNATURE_ATTR_EXP_TIMESTAMP,
+    OSTREE_GPG_SIGNATURE_ATTR_KEY_EXP_TIMESTAMP,
+    OSTREE_GPG_SIGNATURE_ATTR_KEY_EXP_TIMESTAMP_PRIMARY,
+  };
+  guint64 valid_until = 0;
+
+  const guint n_signatures = ostree_gpg_verify_result_count_all (result);
+  for (guint i = 0; i < n_signatures; i++)
+    {
+      g_autoptr (GVariant) values = g_variant_ref_sink (
+          ostree_gpg_verify_result_get (result, i, attrs, G_N_ELEMENTS (attrs)));
+      gboolean valid;
+      gint64 timestamps[3];
+      g_variant_get (values, "(bxxx)", &valid, &timestamps[0], &timestamps[1], &timestamps[2]);
+      if (!valid)
+        continue;
+      for (guint j = 0; j < G_N_ELEMENTS (timestamps); j++)
+        {
+          if (timestamps[j] > 0 && (valid_until == 0 || (guint64)timestamps[j] < valid_until))
+            valid_until = timestamps[j];
+        }
+    }
+
+  return valid_until;
+}
+
+/* Verify the GPG signatures in @metadata for @signed_data with the keyrings
+ * of @remote_name and require at least one valid signature, like
+ * _ostree_repo_gpg_verify_with_metadata() followed by
+ * ostree_gpg_verify_result_require_valid_signature(), but using the
+ * verification cache.  If @out_description is non-%NULL, a description of
+ * each signature is appended to it.
+ */
+gboolean
+_ostree_repo_gpg_verify_cached (OstreeRepo *repo, GBytes *signed_data, GVariant *metadata,
+                                const char *remote_name, GString *out_description,
+                                GCancellable *cancellable, GError **error)
+{
+  g_autofree char *cache_key = NULL;
+  g_autoptr (GVariant) signatures
+      = metadata ? g_variant_lookup_value (metadata, _OSTREE_METADATA_GPGSIGS_NAME,
+                                           _OSTREE_METADATA_GPGSIGS_TYPE)
+                 : NULL;
+  if (signatures != NULL)
+    {
+      g_autofree char *keys_checksum = NULL;
+      g_autoptr (GError) local_error = NULL;
+      if (!_ostree_repo_gpg_checksum_keyrings (repo, remote_name, &keys_checksum, cancellable,
+                                               &local_error))
+        g_debug ("Failed to checksum GPG keyrings: %s", local_error->message);
+      else
+        {
+          g_autofree char *description = NULL;
+          cache_key = verify_cache_key ("gpg", keys_checksum, signed_data, signatures);
+          if (verify_cache_lookup (repo, cache_key, &description))
+            {
+              if (out_description)
+                g_string_append (out_description, description);
+              return TRUE;
+            }
+        }
+    }
+
+  g_autoptr (OstreeGpgVerifyResult) result = _ostree_repo_gpg_verify_with_metadata (
+      repo, signed_data, metadata, remote_name, NULL, NULL, cancellable, error);
+  if (!ostree_gpg_verify_result_require_valid_signature (result, error))
+    return FALSE;
+
+  g_autoptr (GString) description = g_string_new ("");
+  const guint n_signatures = ostree_gpg_verify_result_count_all (result);
+  g_assert_cmpuint (n_signatures, >, 0);
+  for (guint jj = 0; jj < n_signatures; jj++)
+    {
+      ostree_gpg_verify_result_describe (result, jj, description, "GPG: ",
+                                         OSTREE_GPG_SIGNATURE_FORMAT_DEFAULT);
+    }
+
+  if (cache_key != NULL)
+    verify_cache_store (repo, cache_key, gpg_result_valid_until (result), description->str);
+  if (out_description)
+    g_string_append (out_description, description->str);
+  return TRUE;
+}
+
 gboolean
 _process_gpg_verify_result (OtPullData *pull_data, const char *checksum,
                             OstreeGpgVerifyResult *result, GError **error)
@@ -397,20 +591,9 @@ ostree_repo_signature_verify_commit_data (OstreeRepo *self, const char *remote_n
 #ifndef OSTREE_DISABLE_GPGME
   if (gpg)
     {
-      g_autoptr (OstreeGpgVerifyResult) result = _ostree_repo_gpg_verify_with_metadata (
-          self, commit_data, commit_metadata_v, remote_name, NULL, NULL, NULL, error);
-      if (!result)
-        return FALSE;
-      if (!ostree_gpg_verify_result_require_valid_signature (result, error))
+      if (!_ostree_repo_gpg_verify_cached (self, commit_data, commit_metadata_v, remote_name,
+                                           results_buf, NULL, error))
         return FALSE;
-
-      const guint n_signatures = ostree_gpg_verify_result_count_all (result);
-      g_assert_cmpuint (n_signatures, >, 0);
-      for (guint jj = 0; jj < n_signatures; jj++)
-        {
-          ostree_gpg_verify_result_describe (result, jj, results_buf,
-                                             "GPG: ", OSTREE_GPG_SIGNATURE_FORMAT_DEFAULT);
-        }
       verified = TRUE;
     }
 #endif /* OSTREE_DISABLE_GPGME */
@@ -418,7 +601,7 @@ ostree_repo_signature_verify_commit_data (OstreeRepo *self, const char *remote_n
   if (signapi_verifiers)
     {
       g_autofree char *success_message = NULL;
-      if (!_sign_verify_for_remote (signapi_verifiers, commit_data, commit_metadata_v,
+      if (!_sign_verify_for_remote (self, signapi_verifiers, commit_data, commit_metadata_v,
                                     &success_message, error))
         return glnx_prefix_error (error, "Can't verify commit");
       if (verified)
@@ -472,8 +655,8 @@ _verify_unwritten_commit (OtPullData *pull_data, const char *checksum, GVariant
         return glnx_throw (error, "Can't verify commit without detached metadata");
 
       g_autofree char *success_message = NULL;
-      if (!_sign_verify_for_remote (pull_data->signapi_commit_verifiers, signed_data,
-                                    detached_metadata, &success_message, error))
+      if (!_sign_verify_for_remote (pull_data->repo, pull_data->signapi_commit_verifiers,
+                                    signed_data, detached_metadata, &success_message, error))
         return glnx_prefix_error (error, "Can't verify commit");
 
       /* Mark the commit as verified to avoid double verification
@@ -65,6 +65,11 @@
 #define OPT_LOWSPEEDTIME_DEFAULT 30
 #define OPT_RETRYALL_DEFAULT TRUE
 #define OPT_OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS_DEFAULT 8
+#define MAX_PARALLEL_SUMMARY_FETCHES 8
+/* With stripe-mirrors, stop starting requests on a mirror after this many failures */
+#define MAX_MIRROR_FAILURES 3
+/* Spans kept for the trace-file option; a huge pull drops the rest */
+#define MAX_PULL_TRACE_EVENTS (1 << 18)
 
 typedef struct
 {
@@ -80,6 +85,10 @@ typedef struct
 
   OstreeCollectionRef *requested_ref; /* (nullable) */
   guint n_retries_remaining;
+  guint mirror_idx; /* Index into content_mirrorlist, or G_MAXUINT if not striping */
+  gint64 queue_time; /* When the request was queued behind others, for tracing */
+  gint64 start_time;
+  gint64 write_time; /* When writing the fetched object started, for tracing */
 } FetchObjectData;
 
 typedef struct
@@ -92,6 +101,10 @@ typedef struct
   guint i;
   guint64 size;
   guint n_retries_remaining;
+  guint mirror_idx; /* Index into content_mirrorlist, or G_MAXUINT if not striping */
+  gint64 queue_time; /* When the request was queued behind others, for tracing */
+  gint64 start_time;
+  gint64 write_time; /* When executing the part started, for tracing */
 } FetchStaticDeltaData;
 
 typedef struct
@@ -754,6 +767,40 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
   return TRUE;
 }
 
+/* Look up the ref file @filename in the remote's refs/packed-refs, which is
+ * only fetched once.  Sets @out_contents to %NULL if it isn't there.
+ */
+static gboolean
+lookup_remote_packed_ref (OtPullData *pull_data, const char *filename, char **out_contents,
+                          GCancellable *cancellable, GError **error)
+{
+  if (!pull_data->remote_packed_refs_fetched)
+    {
+      g_autofree char *contents = NULL;
+      g_autoptr (GError) local_error = NULL;
+      if (fetch_mirrored_uri_contents_utf8_sync (pull_data->fetcher, pull_data->meta_mirrorlist,
+                                                 _OSTREE_PACKED_REFS_PATH,
+                                                 pull_data->n_network_retries, &contents,
+                                                 cancellable, &local_error))
+        {
+          if (!_ostree_parse_packed_refs (contents, &pull_data->remote_packed_refs, error))
+            return FALSE;
+        }
+      else if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+      pull_data->remote_packed_refs_fetched = TRUE;
+    }
+
+  const char *checksum = pull_data->remote_packed_refs
+                             ? g_hash_table_lookup (pull_data->remote_packed_refs, filename)
+                             : NULL;
+  *out_contents = g_strdup (checksum);
+  return TRUE;
+}
+
 /* Given a @ref, fetch its contents (should be a SHA256 ASCII string) */
 static gboolean
 fetch_ref_contents (OtPullData *pull_data, const char *main_collection_id,
@@ -784,12 +831,30 @@ fetch_ref_contents (OtPullData *pull_data, const char *main_collection_id,
       else
         filename = g_build_filename ("refs", "mirrors", ref->collection_id, ref->ref_name, NULL);
 
-      if (!fetch_mirrored_uri_contents_utf8_sync (pull_data->fetcher, pull_data->meta_mirrorlist,
-                                                  filename, pull_data->n_network_retries,
-                                                  &ret_contents, cancellable, error))
-        return FALSE;
-      g_assert (ret_contents);
-      g_strchomp (ret_contents);
+      g_autoptr (GError) local_error = NULL;
+      if (fetch_mirrored_uri_contents_utf8_sync (pull_data->fetcher, pull_data->meta_mirrorlist,
+                                                 filename, pull_data->n_network_retries,
+                                                 &ret_contents, cancellable, &local_error))
+        {
+          g_assert (ret_contents);
+          g_strchomp (ret_contents);
+        }
+      else if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          /* The remote may have packed its refs; see the core.packed-refs option */
+          if (!lookup_remote_packed_ref (pull_data, filename, &ret_contents, cancellable, error))
+            return FALSE;
+          if (ret_contents == NULL)
+            {
+              g_propagate_error (error, g_steal_pointer (&local_error));
+              return FALSE;
+            }
+        }
+      else
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
     }
 
   g_assert (ret_contents);
@@ -863,6 +928,445 @@ lookup_commit_checksum_and_collection_from_summary (OtPullData *pull_data,
   return TRUE;
 }
 
+/* Returns the mirrorlist to use for a new content request.  With the
+ * `stripe-mirrors` option, this starts with the mirror which should finish
+ * the request soonest, given its measured throughput and the requests it
+ * is already serving; the other mirrors follow as fallbacks.  If
+ * @bloom_key is non-%NULL, mirrors whose objects bloom filter does not
+ * contain it are only chosen if no other mirror is usable. */
+static GPtrArray *
+choose_content_mirrorlist (OtPullData *pull_data, const char *bloom_key, guint *out_mirror_idx)
+{
+  if (!pull_data->stripe_mirrors)
+    {
+      *out_mirror_idx = G_MAXUINT;
+      return pull_data->content_mirrorlist;
+    }
+
+  const guint n_mirrors = pull_data->content_mirrorlist->len;
+  double max_rate = 0;
+  for (guint i = 0; i < n_mirrors; i++)
+    max_rate = MAX (max_rate, pull_data->content_mirror_stats[i].bytes_per_sec);
+
+  /* Prefer healthy mirrors which advertise the object; relax those
+   * conditions in turn if no mirror meets them. */
+  guint best_idx = G_MAXUINT;
+  for (guint pass = 0; pass < 3 && best_idx == G_MAXUINT; pass++)
+    {
+      double best_cost = G_MAXDOUBLE;
+
+      for (guint i = 0; i < n_mirrors; i++)
+        {
+          OtPullMirrorStats *stats = &pull_data->content_mirror_stats[i];
+          if (pass < 2 && stats->n_failures >= MAX_MIRROR_FAILURES)
+            continue;
+          if (pass < 1 && bloom_key != NULL && stats->objects_bloom != NULL
+              && !ostree_bloom_maybe_contains (stats->objects_bloom, bloom_key))
+            continue;
+
+          /* Optimistically assume a mirror we haven't measured yet is as
+           * fast as the fastest one, so that every mirror gets tried. */
+          double rate = stats->bytes_per_sec;
+          if (rate == 0)
+            rate = max_rate > 0 ? max_rate : 1;
+          double cost = (stats->n_outstanding + 1) / rate;
+          if (cost < best_cost)
+            {
+              best_idx = i;
+              best_cost = cost;
+            }
+        }
+    }
+  g_assert (best_idx != G_MAXUINT);
+
+  pull_data->content_mirror_stats[best_idx].n_outstanding++;
+  *out_mirror_idx = best_idx;
+  return pull_data->content_mirror_rotations->pdata[best_idx];
+}
+
+/* Parse an objects bloom filter (see _OSTREE_OBJECTS_BLOOM); returns %NULL if
+ * it is unusable, meaning the mirror may have any object. */
+static OstreeBloom *
+parse_mirror_objects_bloom (GBytes *bytes)
+{
+  g_autoptr (GVariant) bloom_v
+      = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("(yyay)"), bytes, FALSE));
+  g_autoptr (GVariant) bloom_bytes_v = NULL;
+  guint8 k, hash_id;
+  g_variant_get (bloom_v, "(yy@ay)", &k, &hash_id, &bloom_bytes_v);
+  if (k == 0 || hash_id != _OSTREE_OBJECTS_BLOOM_HASH_ID || g_variant_get_size (bloom_bytes_v) == 0)
+    {
+      g_debug ("Ignoring objects bloom filter with k %u and hash ID %u", k, hash_id);
+      return NULL;
+    }
+
+  g_autoptr (GBytes) bloom_bytes = g_variant_get_data_as_bytes (bloom_bytes_v);
+  return ostree_bloom_new_from_bytes (bloom_bytes, k, ostree_str_bloom_hash);
+}
+
+typedef struct
+{
+  OtPullData *pull_data;
+  guint mirror_idx;
+  guint *n_pending;
+} FetchMirrorBloomData;
+
+static void
+fetch_mirror_objects_bloom_on_complete (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  g_autofree FetchMirrorBloomData *data = user_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GError) local_error = NULL;
+
+  if (_ostree_fetcher_request_to_membuf_finish ((OstreeFetcher *)object, result, &bytes, NULL,
+                                                NULL, NULL, &local_error))
+    data->pull_data->content_mirror_stats[data->mirror_idx].objects_bloom
+        = parse_mirror_objects_bloom (bytes);
+  else
+    g_debug ("Ignoring objects bloom filter: %s", local_error->message);
+
+  (*data->n_pending)--;
+  g_main_context_wakeup (g_main_context_get_thread_default ());
+}
+
+static gboolean
+cancel_bloom_fetches (gpointer user_data)
+{
+  g_cancellable_cancel (user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_pull_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  g_cancellable_cancel (user_data);
+}
+
+/* Fetch the objects bloom filters which the content mirrors may publish next
+ * to their summary, all at once.  They're only an optimization, so a mirror
+ * which doesn't answer quickly, or fails, is treated as having no filter
+ * (and so possibly any object) rather than retried. */
+static gboolean
+fetch_mirror_objects_blooms (OtPullData *pull_data, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GMainContext) mainctx = g_main_context_new ();
+  g_main_context_push_thread_default (mainctx);
+
+  g_autoptr (GCancellable) fetch_cancellable = g_cancellable_new ();
+  gulong cancelled_id = 0;
+  if (cancellable != NULL)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (on_pull_cancelled),
+                                          fetch_cancellable, NULL);
+  /* The curl fetcher ignores cancellation, so the requests also have a
+   * timeout of their own; but libsoup's session timeouts are much longer */
+  g_autoptr (GSource) timeout_src
+      = g_timeout_source_new_seconds (OSTREE_FETCHER_SHORT_REQUEST_TIMEOUT);
+  g_source_set_callback (timeout_src, cancel_bloom_fetches, fetch_cancellable, NULL);
+  g_source_attach (timeout_src, mainctx);
+
+  guint n_pending = 0;
+  for (guint i = 0; i < pull_data->content_mirrorlist->len; i++)
+    {
+      /* A single mirror, so the fetcher doesn't fall back to the others */
+      g_autoptr (GPtrArray) mirrorlist = g_ptr_array_new ();
+      g_ptr_array_add (mirrorlist, pull_data->content_mirrorlist->pdata[i]); /* no transfer */
+
+      FetchMirrorBloomData *data = g_new0 (FetchMirrorBloomData, 1);
+      data->pull_data = pull_data;
+      data->mirror_idx = i;
+      data->n_pending = &n_pending;
+      n_pending++;
+      _ostree_fetcher_request_to_membuf (pull_data->fetcher, mirrorlist, _OSTREE_OBJECTS_BLOOM,
+                                         OSTREE_FETCHER_REQUEST_OPTIONAL_CONTENT
+                                             | OSTREE_FETCHER_REQUEST_SHORT_TIMEOUT,
+                                         NULL, 0, OSTREE_MAX_METADATA_SIZE,
+                                         OSTREE_FETCHER_DEFAULT_PRIORITY, fetch_cancellable,
+                                         fetch_mirror_objects_bloom_on_complete, data);
+    }
+
+  /* Cancelled and timed out requests still complete, so this terminates
+   * shortly after the timeout at the latest */
+  while (n_pending > 0)
+    g_main_context_iteration (mainctx, TRUE);
+
+  g_source_destroy (timeout_src);
+  if (cancellable != NULL)
+    g_cancellable_disconnect (cancellable, cancelled_id);
+  g_main_context_pop_thread_default (mainctx);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+  return TRUE;
+}
+
+/* Update the statistics for a request started on the mirrorlist returned by
+ * choose_content_mirrorlist() once it has finished; @fd is the downloaded
+ * file, or -1 on error. */
+static void
+note_content_mirror_result (OtPullData *pull_data, guint mirror_idx, gint64 start_time,
+                            OstreeFetcher *fetcher, GAsyncResult *result, int fd,
+                            const GError *error)
+{
+  if (mirror_idx == G_MAXUINT)
+    return;
+
+  const guint n_mirrors = pull_data->content_mirrorlist->len;
+  g_assert_cmpuint (pull_data->content_mirror_stats[mirror_idx].n_outstanding, >, 0);
+  pull_data->content_mirror_stats[mirror_idx].n_outstanding--;
+
+  /* The fetcher falls back through the mirrorlist rotated to start at
+   * @mirror_idx; the last mirror it tried is the one which served the
+   * request (or failed it).  Mirrors skipped because they don't have the
+   * file, as is normal for a partial mirror, or a cancelled request don't
+   * say anything about their health. */
+  const guint n_tried = _ostree_fetcher_request_get_mirror_index (fetcher, result) + 1;
+  g_assert_cmpuint (n_tried, <=, n_mirrors);
+  const guint served_idx = (mirror_idx + n_tried - 1) % n_mirrors;
+  const GArray *failed_mirrors = _ostree_fetcher_request_get_failed_mirrors (fetcher, result);
+  for (guint i = 0; failed_mirrors != NULL && i < failed_mirrors->len; i++)
+    {
+      const guint failed_idx = g_array_index (failed_mirrors, guint, i);
+      g_assert_cmpuint (failed_idx, <, n_tried - 1);
+      pull_data->content_mirror_stats[(mirror_idx + failed_idx) % n_mirrors].n_failures++;
+    }
+
+  const gboolean served_failed
+      = error != NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+        && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  if (error != NULL && !served_failed)
+    return;
+  if (served_failed)
+    {
+      pull_data->content_mirror_stats[served_idx].n_failures++;
+      return;
+    }
+
+  OtPullMirrorStats *stats = &pull_data->content_mirror_stats[served_idx];
+
+  struct stat stbuf;
+  const gint64 elapsed = g_get_monotonic_time () - start_time;
+  if (fd < 0 || fstat (fd, &stbuf) < 0 || elapsed <= 0)
+    return;
+
+  /* Use a moving average, so the estimate follows a mirror which slows
+   * down or recovers during the pull. */
+  const double rate = (double)stbuf.st_size * G_USEC_PER_SEC / elapsed;
+  if (stats->bytes_per_sec > 0)
+    stats->bytes_per_sec = (3 * stats->bytes_per_sec + rate) / 4;
+  else
+    stats->bytes_per_sec = rate;
+}
+
+/* Record a span from @start_time until now for the `trace-file` option;
+ * @fd, if not -1, is a file whose size is the amount of data involved.
+ */
+static void
+pull_trace (OtPullData *pull_data, const char *phase, const char *name, gint64 start_time, int fd)
+{
+  if (pull_data->trace_events == NULL || start_time == 0)
+    return;
+  /* The span of the whole pull is recorded last, and always kept */
+  if (pull_data->trace_events->len >= MAX_PULL_TRACE_EVENTS && strcmp (phase, "pull") != 0)
+    {
+      pull_data->n_trace_events_dropped++;
+      return;
+    }
+
+  const gint64 now = g_get_monotonic_time ();
+  OtPullTraceEvent event = {
+    phase, g_strdup (name), start_time - (gint64)pull_data->start_time, now - start_time, -1,
+  };
+  struct stat stbuf;
+  if (fd != -1 && fstat (fd, &stbuf) == 0)
+    event.size = stbuf.st_size;
+  g_array_append_val (pull_data->trace_events, event);
+}
+
+static void
+pull_trace_object (OtPullData *pull_data, const char *phase, FetchObjectData *fetch_data,
+                   gint64 start_time, int fd)
+{
+  const char *checksum;
+  OstreeObjectType objtype;
+
+  if (pull_data->trace_events == NULL)
+    return;
+
+  ostree_object_name_deserialize (fetch_data->object, &checksum, &objtype);
+  if (fetch_data->is_detached_meta)
+    objtype = OSTREE_OBJECT_TYPE_COMMIT_META;
+  g_autofree char *name = ostree_object_to_string (checksum, objtype);
+  pull_trace (pull_data, phase, name, start_time, fd);
+}
+
+static void
+pull_trace_deltapart (OtPullData *pull_data, const char *phase, FetchStaticDeltaData *fetch_data,
+                      gint64 start_time, int fd)
+{
+  if (pull_data->trace_events == NULL)
+    return;
+
+  g_autofree char *name = _ostree_get_relative_static_delta_part_path (
+      fetch_data->from_revision, fetch_data->to_revision, fetch_data->i);
+  pull_trace (pull_data, phase, name, start_time, fd);
+}
+
+static void
+pull_trace_event_clear (gpointer data)
+{
+  OtPullTraceEvent *event = data;
+  g_free (event->name);
+}
+
+static gint
+pull_trace_event_compare (gconstpointer a, gconstpointer b)
+{
+  const OtPullTraceEvent *event_a = a;
+  const OtPullTraceEvent *event_b = b;
+
+  if (event_a->start != event_b->start)
+    return event_a->start < event_b->start ? -1 : 1;
+  return 0;
+}
+
+static void
+append_json_string (GString *buf, const char *str)
+{
+  g_string_append_c (buf, '"');
+  for (const char *p = str; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        g_string_append_printf (buf, "\\%c", *p);
+      else if ((guchar)*p < 0x20)
+        g_string_append_printf (buf, "\\u%04x", (guchar)*p);
+      else
+        g_string_append_c (buf, *p);
+    }
+  g_string_append_c (buf, '"');
+}
+
+typedef struct
+{
+  gint64 key;
+  guint lane;
+} PullTraceLane;
+
+/* Binary min-heap of PullTraceLane by key */
+static void
+pull_trace_lanes_push (GArray *heap, gint64 key, guint lane)
+{
+  PullTraceLane item = { key, lane };
+  guint i = heap->len;
+
+  g_array_set_size (heap, heap->len + 1);
+  while (i > 0)
+    {
+      const guint parent = (i - 1) / 2;
+      if (g_array_index (heap, PullTraceLane, parent).key <= key)
+        break;
+      g_array_index (heap, PullTraceLane, i) = g_array_index (heap, PullTraceLane, parent);
+      i = parent;
+    }
+  g_array_index (heap, PullTraceLane, i) = item;
+}
+
+static PullTraceLane
+pull_trace_lanes_pop (GArray *heap)
+{
+  const PullTraceLane top = g_array_index (heap, PullTraceLane, 0);
+  const PullTraceLane last = g_array_index (heap, PullTraceLane, heap->len - 1);
+  guint i = 0;
+
+  g_array_set_size (heap, heap->len - 1);
+  while (heap->len > 0)
+    {
+      guint child = 2 * i + 1;
+      if (child >= heap->len)
+        break;
+      if (child + 1 < heap->len
+          && g_array_index (heap, PullTraceLane, child + 1).key
+                 < g_array_index (heap, PullTraceLane, child).key)
+        child++;
+      if (last.key <= g_array_index (heap, PullTraceLane, child).key)
+        break;
+      g_array_index (heap, PullTraceLane, i) = g_array_index (heap, PullTraceLane, child);
+      i = child;
+    }
+  if (heap->len > 0)
+    g_array_index (heap, PullTraceLane, i) = last;
+  return top;
+}
+
+/* Write the recorded spans in the Chrome trace event format, which
+ * chrome://tracing and Perfetto can display.  Those only nest complete
+ * events on one thread, so each span is put on the lowest numbered
+ * "thread" which is free when it starts.
+ */
+static gboolean
+write_pull_trace (OtPullData *pull_data, const char *path, GError **error)
+{
+  GArray *events = pull_data->trace_events;
+  /* Lanes in use, by the end of their span; and free lanes, by number */
+  g_autoptr (GArray) busy_lanes = g_array_new (FALSE, FALSE, sizeof (PullTraceLane));
+  g_autoptr (GArray) free_lanes = g_array_new (FALSE, FALSE, sizeof (PullTraceLane));
+  guint n_lanes = 0;
+  g_autoptr (GString) buf = g_string_new ("{\"traceEvents\":[");
+
+  g_autofree char *dir = g_path_get_dirname (path);
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (AT_FDCWD, dir, O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (fchmod (tmpf.fd, 0644) < 0)
+    return glnx_throw_errno_prefix (error, "fchmod");
+
+  g_array_sort (events, pull_trace_event_compare);
+  for (guint i = 0; i < events->len; i++)
+    {
+      const OtPullTraceEvent *event = &g_array_index (events, OtPullTraceEvent, i);
+      guint lane;
+
+      while (busy_lanes->len > 0
+             && g_array_index (busy_lanes, PullTraceLane, 0).key <= event->start)
+        {
+          const PullTraceLane done = pull_trace_lanes_pop (busy_lanes);
+          pull_trace_lanes_push (free_lanes, done.lane, done.lane);
+        }
+      if (free_lanes->len > 0)
+        lane = pull_trace_lanes_pop (free_lanes).lane;
+      else
+        lane = n_lanes++;
+      pull_trace_lanes_push (busy_lanes, event->start + event->duration, lane);
+
+      g_string_append_printf (buf,
+                              "%s\n{\"name\":\"%s\",\"cat\":\"pull\",\"ph\":\"X\",\"pid\":1,"
+                              "\"tid\":%u,\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT
+                              ",\"args\":{\"name\":",
+                              i > 0 ? "," : "", event->phase, lane + 1, event->start,
+                              event->duration);
+      append_json_string (buf, event->name);
+      if (event->size >= 0)
+        g_string_append_printf (buf, ",\"bytes\":%" G_GINT64_FORMAT, event->size);
+      g_string_append (buf, "}}");
+
+      if (buf->len >= 64 * 1024)
+        {
+          if (glnx_loop_write (tmpf.fd, buf->str, buf->len) < 0)
+            return glnx_throw_errno_prefix (error, "write");
+          g_string_truncate (buf, 0);
+        }
+    }
+  g_string_append_printf (buf,
+                          "\n],\"displayTimeUnit\":\"ms\","
+                          "\"otherData\":{\"droppedEvents\":%u}}\n",
+                          pull_data->n_trace_events_dropped);
+  if (glnx_loop_write (tmpf.fd, buf->str, buf->len) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+
+  return glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, AT_FDCWD, path, error);
+}
+
 static void
 fetch_object_data_free (FetchObjectData *fetch_data)
 {
@@ -888,6 +1392,7 @@ content_fetch_on_write_complete (GObject *object, GAsyncResult *result, gpointer
 
   if (!ostree_repo_write_content_finish ((OstreeRepo *)object, result, &csum, error))
     goto out;
+  pull_trace_object (pull_data, "write", fetch_data, fetch_data->write_time, -1);
 
   checksum = ostree_checksum_from_bytes (csum);
 
@@ -934,8 +1439,13 @@ content_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_
   OstreeObjectType objtype;
   gboolean free_fetch_data = TRUE;
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  gboolean fetched
+      = _ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error);
+  note_content_mirror_result (pull_data, fetch_data->mirror_idx, fetch_data->start_time,
+                             fetcher, result, fetched ? tmpf.fd : -1, local_error);
+  if (!fetched)
     goto out;
+  pull_trace_object (pull_data, "fetch", fetch_data, fetch_data->start_time, tmpf.fd);
 
   ostree_object_name_deserialize (fetch_data->object, &checksum, &objtype);
   g_assert (objtype == OSTREE_OBJECT_TYPE_FILE);
@@ -952,9 +1462,11 @@ content_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_
   if (pull_data->trusted_http_direct)
     {
       g_assert (!verifying_bareuseronly);
+      fetch_data->write_time = g_get_monotonic_time ();
       if (!_ostree_repo_commit_tmpf_final (pull_data->repo, checksum, objtype, &tmpf, cancellable,
                                            error))
         goto out;
+      pull_trace_object (pull_data, "write", fetch_data, fetch_data->write_time, -1);
       pull_data->n_fetched_content++;
     }
   else
@@ -984,6 +1496,7 @@ content_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_
         goto out;
 
       pull_data->n_outstanding_content_write_requests++;
+      fetch_data->write_time = g_get_monotonic_time ();
       ostree_repo_write_content_async (pull_data->repo, checksum, object_input, length, cancellable,
                                        content_fetch_on_write_complete, fetch_data);
       free_fetch_data = FALSE;
@@ -1017,6 +1530,7 @@ on_metadata_written (GObject *object, GAsyncResult *result, gpointer user_data)
 
   if (!ostree_repo_write_metadata_finish ((OstreeRepo *)object, result, &csum, error))
     goto out;
+  pull_trace_object (pull_data, "write", fetch_data, fetch_data->write_time, -1);
 
   checksum = ostree_checksum_from_bytes (csum);
 
@@ -1080,7 +1594,11 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
   g_debug ("fetch of %s%s complete", checksum_obj,
            fetch_data->is_detached_meta ? " (detached)" : "");
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  gboolean fetched
+      = _ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error);
+  note_content_mirror_result (pull_data, fetch_data->mirror_idx, fetch_data->start_time,
+                             fetcher, result, fetched ? tmpf.fd : -1, local_error);
+  if (!fetched)
     {
       if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
         {
@@ -1124,6 +1642,7 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
 
       goto out;
     }
+  pull_trace_object (pull_data, "fetch", fetch_data, fetch_data->start_time, tmpf.fd);
 
   /* Tombstone commits are always empty, so skip all processing here */
   if (objtype == OSTREE_OBJECT_TYPE_TOMBSTONE_COMMIT)
@@ -1150,6 +1669,7 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
     }
   else
     {
+      const gint64 verify_time = g_get_monotonic_time ();
       if (!ot_variant_read_fd (tmpf.fd, 0, ostree_metadata_variant_type (objtype), FALSE, &metadata,
                                error))
         goto out;
@@ -1184,6 +1704,7 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
           if (!ostree_repo_mark_commit_partial (pull_data->repo, checksum, TRUE, error))
             goto out;
         }
+      pull_trace_object (pull_data, "verify", fetch_data, verify_time, -1);
 
       /* Note that we now (Jan 2018) pass NULL for checksum, which means "don't
        * verify checksum", since we just did it above. Related to this...now
@@ -1191,6 +1712,7 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
        * just `glnx_link_tmpfile_at()` into the repository, like the content
        * fetch path does for trusted commits.
        */
+      fetch_data->write_time = g_get_monotonic_time ();
       ostree_repo_write_metadata_async (pull_data->repo, objtype, NULL, metadata,
                                         pull_data->cancellable, on_metadata_written, fetch_data);
       pull_data->n_outstanding_metadata_write_requests++;
@@ -1236,6 +1758,7 @@ on_static_delta_written (GObject *object, GAsyncResult *result, gpointer user_da
 
   if (!_ostree_static_delta_part_execute_finish (pull_data->repo, result, error))
     goto out;
+  pull_trace_deltapart (pull_data, "execute", fetch_data, fetch_data->write_time, -1);
 
 out:
   g_assert (pull_data->n_outstanding_deltapart_write_requests > 0);
@@ -1263,17 +1786,25 @@ static_deltapart_fetch_on_complete (GObject *object, GAsyncResult *result, gpoin
 
   g_debug ("fetch static delta part %s complete", fetch_data->expected_checksum);
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  gboolean fetched
+      = _ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error);
+  note_content_mirror_result (pull_data, fetch_data->mirror_idx, fetch_data->start_time,
+                             fetcher, result, fetched ? tmpf.fd : -1, local_error);
+  if (!fetched)
     goto out;
+  pull_trace_deltapart (pull_data, "fetch", fetch_data, fetch_data->start_time, tmpf.fd);
 
   /* Transfer ownership of the fd */
   in = g_unix_input_stream_new (g_steal_fd (&tmpf.fd), TRUE);
 
   /* TODO - make async */
+  const gint64 verify_time = g_get_monotonic_time ();
   if (!_ostree_static_delta_part_open (in, NULL, 0, fetch_data->expected_checksum, &part,
                                        pull_data->cancellable, error))
     goto out;
+  pull_trace_deltapart (pull_data, "verify", fetch_data, verify_time, -1);
 
+  fetch_data->write_time = g_get_monotonic_time ();
   _ostree_static_delta_part_execute_async (pull_data->repo, fetch_data->objects, part,
                                            pull_data->cancellable, on_static_delta_written,
                                            fetch_data);
@@ -1845,6 +2376,7 @@ enqueue_one_object_request_s (OtPullData *pull_data, FetchObjectData *fetch_data
     {
       g_debug ("queuing fetch of %s.%s%s", checksum, ostree_object_type_to_string (objtype),
                fetch_data->is_detached_meta ? " (detached)" : "");
+      fetch_data->queue_time = g_get_monotonic_time ();
 
       if (is_meta)
         {
@@ -1900,6 +2432,8 @@ start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
 
   g_debug ("starting fetch of %s.%s%s", expected_checksum, ostree_object_type_to_string (objtype),
            fetch->is_detached_meta ? " (detached)" : "");
+  pull_trace_object (pull_data, "queue", fetch, fetch->queue_time, -1);
+  fetch->queue_time = 0;
 
   gboolean is_meta = OSTREE_OBJECT_TYPE_IS_META (objtype);
   if (is_meta)
@@ -1916,13 +2450,17 @@ start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
                           pull_data->remote_mode);
       obj_subpath = g_build_filename ("objects", buf, NULL);
       mirrorlist = pull_data->meta_mirrorlist;
+      fetch->mirror_idx = G_MAXUINT;
       flags |= OSTREE_FETCHER_REQUEST_OPTIONAL_CONTENT;
     }
   else
     {
       obj_subpath = _ostree_get_relative_object_path (expected_checksum, objtype, TRUE);
-      mirrorlist = pull_data->content_mirrorlist;
+      mirrorlist = choose_content_mirrorlist (
+          pull_data, objtype == OSTREE_OBJECT_TYPE_FILE ? expected_checksum : NULL,
+          &fetch->mirror_idx);
     }
+  fetch->start_time = g_get_monotonic_time ();
 
   /* We may have determined maximum sizes from the summary file content; if so,
    * honor it. Otherwise, metadata has a baseline max size.
@@ -2038,6 +2576,7 @@ enqueue_one_static_delta_part_request_s (OtPullData *pull_data, FetchStaticDelta
     {
       g_debug ("queuing fetch of static delta %s-%s part %u", fetch_data->from_revision ?: "empty",
                fetch_data->to_revision, fetch_data->i);
+      fetch_data->queue_time = g_get_monotonic_time ();
 
       g_hash_table_add (pull_data->pending_fetch_deltaparts, fetch_data);
     }
@@ -2053,13 +2592,20 @@ start_fetch_deltapart (OtPullData *pull_data, FetchStaticDeltaData *fetch)
   g_autofree char *deltapart_path = _ostree_get_relative_static_delta_part_path (
       fetch->from_revision, fetch->to_revision, fetch->i);
   g_debug ("starting fetch of deltapart %s", deltapart_path);
+  pull_trace (pull_data, "queue", deltapart_path, fetch->queue_time, -1);
+  fetch->queue_time = 0;
   pull_data->n_outstanding_deltapart_fetches++;
   g_assert_cmpint (pull_data->n_outstanding_deltapart_fetches, <=,
                    _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS);
-  _ostree_fetcher_request_to_tmpfile (pull_data->fetcher, pull_data->content_mirrorlist,
-                                      deltapart_path, 0, NULL, 0, fetch->size,
-                                      OSTREE_FETCHER_DEFAULT_PRIORITY, pull_data->cancellable,
-                                      static_deltapart_fetch_on_complete, fetch);
+  g_autofree char *delta_name
+      = fetch->from_revision ? g_strconcat (fetch->from_revision, "-", fetch->to_revision, NULL)
+                             : g_strdup (fetch->to_revision);
+  GPtrArray *mirrorlist = choose_content_mirrorlist (pull_data, delta_name, &fetch->mirror_idx);
+  fetch->start_time = g_get_monotonic_time ();
+  _ostree_fetcher_request_to_tmpfile (pull_data->fetcher, mirrorlist, deltapart_path, 0, NULL, 0,
+                                      fetch->size, OSTREE_FETCHER_DEFAULT_PRIORITY,
+                                      pull_data->cancellable, static_deltapart_fetch_on_complete,
+                                      fetch);
 }
 
 static gboolean
@@ -2218,6 +2764,7 @@ process_one_static_delta (OtPullData *pull_data, const char *from_revision, cons
               return FALSE;
             }
 
+          fetch_data->write_time = g_get_monotonic_time ();
           _ostree_static_delta_part_execute_async (pull_data->repo, fetch_data->objects,
                                                    inline_delta_part, pull_data->cancellable,
                                                    on_static_delta_written, fetch_data);
@@ -2473,6 +3020,23 @@ on_superblock_fetched (GObject *src, GAsyncResult *res, gpointer data)
       delta_superblock = g_variant_ref_sink (g_variant_new_from_bytes (
           (GVariantType *)OSTREE_STATIC_DELTA_SUPERBLOCK_FORMAT, delta_superblock_data, FALSE));
 
+      /* If we can't decompress the parts, e.g. zstd in a build without it,
+       * treat this like a missing delta */
+      g_autoptr (GError) compression_error = NULL;
+      if (!_ostree_delta_check_compression (delta_superblock, &compression_error))
+        {
+          if (pull_data->require_static_deltas)
+            {
+              g_propagate_error (error, g_steal_pointer (&compression_error));
+              goto out;
+            }
+
+          g_debug ("Not using static delta %s: %s", delta, compression_error->message);
+          queue_scan_one_metadata_object (pull_data, to_revision, OSTREE_OBJECT_TYPE_COMMIT, NULL,
+                                          0, fetch_data->requested_ref);
+          goto out;
+        }
+
       g_hash_table_add (pull_data->static_delta_targets, g_strdup (to_revision));
       if (!process_one_static_delta (pull_data, from_revision, to_revision, delta_superblock,
                                      fetch_data->requested_ref, pull_data->cancellable, error))
@@ -2699,11 +3263,15 @@ _ostree_repo_verify_summary (OstreeRepo *self, const char *name, gboolean gpg_ve
       /* Verify any summary signatures. */
       if (summary != NULL && signatures != NULL)
         {
-          g_autoptr (OstreeGpgVerifyResult) result = NULL;
-
-          result = ostree_repo_verify_summary (self, name, summary, signatures, cancellable, error);
-          if (!ostree_gpg_verify_result_require_valid_signature (result, error))
+#ifndef OSTREE_DISABLE_GPGME
+          g_autoptr (GVariant) sig_variant = g_variant_ref_sink (
+              g_variant_new_from_bytes (OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, signatures, FALSE));
+          if (!_ostree_repo_gpg_verify_cached (self, summary, sig_variant, name, NULL, cancellable,
+                                               error))
             return FALSE;
+#else
+          return glnx_throw (error, "GPG feature is disabled in a build time");
+#endif /* OSTREE_DISABLE_GPGME */
         }
     }
 
@@ -2733,8 +3301,8 @@ _ostree_repo_verify_summary (OstreeRepo *self, const char *name, gboolean gpg_ve
           sig_variant
               = g_variant_new_from_bytes (OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, signatures, FALSE);
 
-          if (!_sign_verify_for_remote (signapi_summary_verifiers, summary, sig_variant, NULL,
-                                        error))
+          if (!_sign_verify_for_remote (self, signapi_summary_verifiers, summary, sig_variant,
+                                        NULL, error))
             return FALSE;
         }
     }
@@ -3490,6 +4058,18 @@ all_requested_refs_have_commit (
  *     is specified, `summary-bytes` must also be specified. Since: 2020.5
  *   * `disable-verify-bindings` (`b`): Disable verification of commit bindings.
  *     Since: 2020.9
+ *   * `content-mirror-urls` (`as`): Additional base URLs which serve the same
+ *     objects as the remote; they are appended to its content mirrorlist.
+ *     As with `contenturl`, an entry may be of the form `mirrorlist=URL`.
+ *     Since: 2025.2
+ *   * `stripe-mirrors` (`b`): Spread object and static delta part requests
+ *     across all content mirrors at once, weighted by their measured
+ *     throughput, rather than always starting with the first mirror.
+ *     Since: 2025.2
+ *   * `trace-file` (`s`): Record how long each request spent queued,
+ *     fetching, verifying, writing and executing static delta parts, and
+ *     write it to this path in the Chrome trace event JSON format when the
+ *     pull finishes, including when it fails. Since: 2025.2
  */
 gboolean
 ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_baseurl,
@@ -3544,6 +4124,8 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
       = NULL; /* (element-type OstreeCollectionRef utf8) */
   gsize i;
   g_autofree char **opt_localcache_repos = NULL;
+  g_autofree char **opt_content_mirror_urls = NULL;
+  const char *opt_trace_file = NULL;
   g_autoptr (GVariantIter) ref_keyring_map_iter = NULL;
   g_autoptr (GVariant) summary_bytes_v = NULL;
   g_autoptr (GVariant) summary_sig_bytes_v = NULL;
@@ -3613,6 +4195,9 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
       (void)g_variant_lookup (options, "summary-sig-bytes", "@ay", &summary_sig_bytes_v);
       (void)g_variant_lookup (options, "disable-verify-bindings", "b",
                               &pull_data->disable_verify_bindings);
+      (void)g_variant_lookup (options, "content-mirror-urls", "^a&s", &opt_content_mirror_urls);
+      (void)g_variant_lookup (options, "stripe-mirrors", "b", &pull_data->stripe_mirrors);
+      (void)g_variant_lookup (options, "trace-file", "&s", &opt_trace_file);
 
       if (pull_data->remote_refspec_name != NULL)
         pull_data->remote_name = g_strdup (pull_data->remote_refspec_name);
@@ -3760,6 +4345,11 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
   g_queue_init (&pull_data->scan_object_queue);
 
   pull_data->start_time = g_get_monotonic_time ();
+  if (opt_trace_file != NULL)
+    {
+      pull_data->trace_events = g_array_new (FALSE, FALSE, sizeof (OtPullTraceEvent));
+      g_array_set_clear_func (pull_data->trace_events, pull_trace_event_clear);
+    }
 
   if (_ostree_repo_remote_name_is_file (remote_name_or_baseurl))
     {
@@ -3911,6 +4501,71 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
       }
   }
 
+  if (opt_content_mirror_urls != NULL && opt_content_mirror_urls[0] != NULL)
+    {
+      /* Copy, as the content mirrorlist may be shared with the metadata one */
+      g_autoptr (GPtrArray) mirrorlist
+          = g_ptr_array_new_with_free_func ((GDestroyNotify)_ostree_fetcher_uri_free);
+      for (i = 0; i < pull_data->content_mirrorlist->len; i++)
+        g_ptr_array_add (mirrorlist,
+                         _ostree_fetcher_uri_clone (pull_data->content_mirrorlist->pdata[i]));
+
+      for (char **iter = opt_content_mirror_urls; *iter != NULL; iter++)
+        {
+          if (g_str_has_prefix (*iter, "mirrorlist="))
+            {
+              /* These are only extra sources, so don't fail the pull (or
+               * retry) if the mirrorlist can't be fetched */
+              g_autoptr (GPtrArray) extra_mirrorlist = NULL;
+              g_autoptr (GError) local_error = NULL;
+              if (!compute_effective_mirrorlist (self, remote_name_or_baseurl, *iter,
+                                                 pull_data->fetcher, 0, &extra_mirrorlist,
+                                                 cancellable, &local_error))
+                {
+                  g_debug ("Ignoring content mirror %s: %s", *iter, local_error->message);
+                  continue;
+                }
+              for (guint j = 0; j < extra_mirrorlist->len; j++)
+                g_ptr_array_add (mirrorlist,
+                                 _ostree_fetcher_uri_clone (extra_mirrorlist->pdata[j]));
+              continue;
+            }
+
+          g_autoptr (OstreeFetcherURI) uri = _ostree_fetcher_uri_parse (*iter, error);
+          if (!uri)
+            goto out;
+          if (!_ostree_fetcher_uri_validate (uri, error))
+            goto out;
+          g_ptr_array_add (mirrorlist, g_steal_pointer (&uri));
+        }
+
+      g_clear_pointer (&pull_data->content_mirrorlist, g_ptr_array_unref);
+      pull_data->content_mirrorlist = g_steal_pointer (&mirrorlist);
+    }
+
+  /* Striping only makes sense with a choice of mirrors. Precompute the
+   * mirrorlist rotated to start at each mirror, so the fetcher still falls
+   * back through all the others. */
+  if (pull_data->stripe_mirrors && pull_data->content_mirrorlist->len > 1)
+    {
+      const guint n_mirrors = pull_data->content_mirrorlist->len;
+      pull_data->content_mirror_rotations
+          = g_ptr_array_new_full (n_mirrors, (GDestroyNotify)g_ptr_array_unref);
+      for (i = 0; i < n_mirrors; i++)
+        {
+          GPtrArray *rotation = g_ptr_array_sized_new (n_mirrors);
+          for (guint j = 0; j < n_mirrors; j++)
+            g_ptr_array_add (rotation, pull_data->content_mirrorlist->pdata[(i + j) % n_mirrors]);
+          g_ptr_array_add (pull_data->content_mirror_rotations, rotation);
+        }
+      pull_data->content_mirror_stats = g_new0 (OtPullMirrorStats, n_mirrors);
+
+      if (!fetch_mirror_objects_blooms (pull_data, cancellable, error))
+        goto out;
+    }
+  else
+    pull_data->stripe_mirrors = FALSE;
+
   /* FIXME: Do we want an analogue of this which supports collection IDs? */
   if (!ostree_repo_get_remote_list_option (self, remote_name_or_baseurl, "branches",
                                            &configured_branches, error))
@@ -4107,6 +4762,7 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
       g_autoptr (GVariant) additional_metadata = NULL;
       gboolean summary_from_cache = FALSE;
       gboolean tombstone_commits = FALSE;
+      const gint64 summary_start_time = g_get_monotonic_time ();
 
       if (summary_sig_bytes_v)
         {
@@ -4208,6 +4864,8 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
             }
         }
 
+      pull_trace (pull_data, "fetch", "summary", summary_start_time, -1);
+
 #ifndef OSTREE_DISABLE_GPGME
       if (!bytes_summary && pull_data->gpg_verify_summary)
         {
@@ -4237,12 +4895,13 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
 
       if (pull_data->gpg_verify_summary && bytes_summary && bytes_sig)
         {
-          g_autoptr (OstreeGpgVerifyResult) result = NULL;
           g_autoptr (GError) temp_error = NULL;
+          g_autoptr (GVariant) signatures = g_variant_ref_sink (
+              g_variant_new_from_bytes (OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, bytes_sig, FALSE));
 
-          result = ostree_repo_verify_summary (self, pull_data->remote_name, bytes_summary,
-                                               bytes_sig, cancellable, &temp_error);
-          if (!ostree_gpg_verify_result_require_valid_signature (result, &temp_error))
+          if (!_ostree_repo_gpg_verify_cached (self, bytes_summary, signatures,
+                                               pull_data->remote_name, NULL, cancellable,
+                                               &temp_error))
             {
               if (summary_from_cache)
                 {
@@ -4273,9 +4932,9 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
                           cancellable, error))
                     goto out;
 
-                  g_autoptr (OstreeGpgVerifyResult) retry = ostree_repo_verify_summary (
-                      self, pull_data->remote_name, bytes_summary, bytes_sig, cancellable, error);
-                  if (!ostree_gpg_verify_result_require_valid_signature (retry, error))
+                  if (!_ostree_repo_gpg_verify_cached (self, bytes_summary, signatures,
+                                                       pull_data->remote_name, NULL, cancellable,
+                                                       error))
                     goto out;
                 }
               else
@@ -4305,8 +4964,8 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
                   = g_variant_new_from_bytes (OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, bytes_sig, FALSE);
 
               g_assert (pull_data->signapi_summary_verifiers);
-              if (!_sign_verify_for_remote (pull_data->signapi_summary_verifiers, bytes_summary,
-                                            signatures, NULL, &temp_error))
+              if (!_sign_verify_for_remote (self, pull_data->signapi_summary_verifiers,
+                                            bytes_summary, signatures, NULL, &temp_error))
                 {
                   if (summary_from_cache)
                     {
@@ -4338,7 +4997,7 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
                               cancellable, error))
                         goto out;
 
-                      if (!_sign_verify_for_remote (pull_data->signapi_summary_verifiers,
+                      if (!_sign_verify_for_remote (self, pull_data->signapi_summary_verifiers,
                                                     bytes_summary, signatures, NULL, error))
                         goto out;
                     }
@@ -4766,9 +5425,13 @@ ostree_repo_pull_with_options (OstreeRepo *self, const char *remote_name_or_base
         }
     }
 
-  if (!inherit_transaction
-      && !ostree_repo_commit_transaction (pull_data->repo, &tstats, cancellable, error))
-    goto out;
+  if (!inherit_transaction)
+    {
+      const gint64 commit_start_time = g_get_monotonic_time ();
+      if (!ostree_repo_commit_transaction (pull_data->repo, &tstats, cancellable, error))
+        goto out;
+      pull_trace (pull_data, "commit", "transaction", commit_start_time, -1);
+    }
 
   end_time = g_get_monotonic_time ();
 
@@ -4925,6 +5588,26 @@ out:
   else
     g_clear_error (&pull_data->cached_async_error);
 
+  if (pull_data->trace_events != NULL)
+    {
+      g_autoptr (GError) trace_error = NULL;
+
+      pull_trace (pull_data, "pull", remote_name_or_baseurl, pull_data->start_time, -1);
+      /* A failed pull is also worth a trace; keep its own error though */
+      if (!write_pull_trace (pull_data, opt_trace_file, &trace_error))
+        {
+          g_prefix_error (&trace_error, "Writing trace file: ");
+          if (ret)
+            {
+              g_propagate_error (error, g_steal_pointer (&trace_error));
+              ret = FALSE;
+            }
+          else
+            g_debug ("%s", trace_error->message);
+        }
+      g_clear_pointer (&pull_data->trace_events, g_array_unref);
+    }
+
   if (!inherit_transaction)
     ostree_repo_abort_transaction (pull_data->repo, cancellable, NULL);
   g_main_context_unref (pull_data->main_context);
@@ -4941,6 +5624,13 @@ out:
   g_free (pull_data->append_user_agent);
   g_clear_pointer (&pull_data->signapi_commit_verifiers, g_ptr_array_unref);
   g_clear_pointer (&pull_data->signapi_summary_verifiers, g_ptr_array_unref);
+  if (pull_data->content_mirror_stats != NULL)
+    {
+      for (i = 0; i < pull_data->content_mirrorlist->len; i++)
+        g_clear_pointer (&pull_data->content_mirror_stats[i].objects_bloom, ostree_bloom_unref);
+      g_clear_pointer (&pull_data->content_mirror_stats, g_free);
+    }
+  g_clear_pointer (&pull_data->content_mirror_rotations, g_ptr_array_unref);
   g_clear_pointer (&pull_data->meta_mirrorlist, g_ptr_array_unref);
   g_clear_pointer (&pull_data->content_mirrorlist, g_ptr_array_unref);
   g_clear_pointer (&pull_data->summary_data, g_bytes_unref);
@@ -4959,6 +5649,7 @@ out:
   g_clear_pointer (&pull_data->verified_commits, g_hash_table_unref);
   g_clear_pointer (&pull_data->signapi_verified_commits, g_hash_table_unref);
   g_clear_pointer (&pull_data->ref_keyring_map, g_hash_table_unref);
+  g_clear_pointer (&pull_data->remote_packed_refs, g_hash_table_unref);
   g_clear_pointer (&pull_data->requested_content, g_hash_table_unref);
   g_clear_pointer (&pull_data->requested_fallback_content, g_hash_table_unref);
   g_clear_pointer (&pull_data->requested_metadata, g_hash_table_unref);
@@ -5495,6 +6186,36 @@ find_remotes_process_refs (OstreeRepo *self, const OstreeCollectionRef *const *r
   return TRUE;
 }
 
+/* A summary download for one #OstreeRepoFinderResult in find_remotes_cb() */
+typedef struct
+{
+  OstreeRepo *repo;
+  const char *remote_name;
+  GCancellable *cancellable;
+  GBytes *summary_bytes;
+  GError *error;
+} FindRemotesSummaryFetch;
+
+static void
+find_remotes_summary_fetch_clear (gpointer datap)
+{
+  FindRemotesSummaryFetch *fetch = datap;
+  g_clear_pointer (&fetch->summary_bytes, g_bytes_unref);
+  g_clear_error (&fetch->error);
+}
+
+static void
+find_remotes_summary_fetch_thread (gpointer datap, gpointer user_data)
+{
+  FindRemotesSummaryFetch *fetch = datap;
+
+  /* Load the summary from the cache if possible, otherwise download it. */
+  (void)ostree_repo_remote_fetch_summary_with_options (fetch->repo, fetch->remote_name,
+                                                       NULL, /* no options */
+                                                       &fetch->summary_bytes, NULL,
+                                                       fetch->cancellable, &fetch->error);
+}
+
 static void
 find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
 {
@@ -5571,20 +6292,19 @@ find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
   refs_and_remotes_table = pointer_table_new (n_refs, results->len);
   remotes_to_remove = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_remote_unref);
 
-  /* Fetch and validate the summary file for each result. */
-  /* FIXME: All these downloads could be parallelised; that requires the
-   * ostree_repo_remote_fetch_summary_with_options() API to be async. */
+  /* Fetch the summary file for each result.  The synchronous
+   * ostree_repo_remote_fetch_summary_with_options() API runs its own main
+   * context, so do the downloads concurrently from a thread pool; then
+   * validate the summaries in order below. */
+  g_autoptr (GArray) summary_fetches
+      = g_array_sized_new (FALSE, TRUE, sizeof (FindRemotesSummaryFetch), results->len);
+  g_array_set_clear_func (summary_fetches, find_remotes_summary_fetch_clear);
+  g_array_set_size (summary_fetches, results->len);
+
   for (i = 0; i < results->len; i++)
     {
       OstreeRepoFinderResult *result = g_ptr_array_index (results, i);
-      g_autoptr (GBytes) summary_bytes = NULL;
-      g_autoptr (GVariant) summary_v = NULL;
-      guint64 summary_last_modified;
-      g_autoptr (GVariant) summary_refs = NULL;
-      g_autoptr (GVariant) additional_metadata_v = NULL;
-      g_autofree gchar *summary_collection_id = NULL;
-      g_autoptr (GVariantIter) summary_collection_map = NULL;
-      gboolean invalid_result = FALSE;
+      FindRemotesSummaryFetch *fetch = &g_array_index (summary_fetches, FindRemotesSummaryFetch, i);
 
       /* Add the remote to our internal list of remotes, so other libostree
        * API can access it. */
@@ -5594,10 +6314,36 @@ find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
       g_debug ("%s: Fetching summary for remote ‘%s’ with keyring ‘%s’.", G_STRFUNC,
                result->remote->name, result->remote->keyring);
 
-      /* Download the summary. This will load from the cache if possible. */
-      ostree_repo_remote_fetch_summary_with_options (self, result->remote->name,
-                                                     NULL, /* no options */
-                                                     &summary_bytes, NULL, cancellable, &error);
+      fetch->repo = self;
+      fetch->remote_name = result->remote->name;
+      fetch->cancellable = cancellable;
+    }
+
+  {
+    GThreadPool *pool = g_thread_pool_new (find_remotes_summary_fetch_thread, NULL,
+                                           MIN (results->len, MAX_PARALLEL_SUMMARY_FETCHES),
+                                           FALSE, NULL);
+    for (i = 0; i < results->len; i++)
+      g_thread_pool_push (pool, &g_array_index (summary_fetches, FindRemotesSummaryFetch, i),
+                          NULL);
+    g_thread_pool_free (pool, FALSE, TRUE);
+  }
+
+  /* Validate the summary file for each result. */
+  for (i = 0; i < results->len; i++)
+    {
+      OstreeRepoFinderResult *result = g_ptr_array_index (results, i);
+      FindRemotesSummaryFetch *fetch = &g_array_index (summary_fetches, FindRemotesSummaryFetch, i);
+      g_autoptr (GBytes) summary_bytes = g_steal_pointer (&fetch->summary_bytes);
+      g_autoptr (GVariant) summary_v = NULL;
+      guint64 summary_last_modified;
+      g_autoptr (GVariant) summary_refs = NULL;
+      g_autoptr (GVariant) additional_metadata_v = NULL;
+      g_autofree gchar *summary_collection_id = NULL;
+      g_autoptr (GVariantIter) summary_collection_map = NULL;
+      gboolean invalid_result = FALSE;
+
+      error = g_steal_pointer (&fetch->error);
 
       if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         goto error;
@@ -6024,6 +6770,51 @@ ostree_repo_find_remotes_finish (OstreeRepo *self, GAsyncResult *result, GError
     return NULL;
 }
 
+/* Returns the URLs of the remotes in @results, other than the one at
+ * @result_idx, which have the same commits for all of @refs_to_pull, so
+ * they can serve as additional mirrors for it.  The array is
+ * %NULL-terminated. */
+static GPtrArray *
+find_remotes_mirror_urls (const OstreeRepoFinderResult *const *results, gsize result_idx,
+                          GPtrArray *refs_to_pull)
+{
+  g_autoptr (GPtrArray) mirror_urls = g_ptr_array_new_with_free_func (g_free);
+
+  for (gsize i = 0; results[i] != NULL; i++)
+    {
+      const OstreeRepoFinderResult *result = results[i];
+      const OstreeRepoFinderResult *pulling = results[result_idx];
+      gboolean same_commits = TRUE;
+
+      if (i == result_idx)
+        continue;
+
+      for (gsize j = 0; refs_to_pull->pdata[j] != NULL && same_commits; j++)
+        {
+          const OstreeCollectionRef *ref = refs_to_pull->pdata[j];
+          const char *checksum = g_hash_table_lookup (pulling->ref_to_checksum, ref);
+          const char *other_checksum = g_hash_table_lookup (result->ref_to_checksum, ref);
+
+          same_commits = (other_checksum != NULL && g_str_equal (checksum, other_checksum));
+        }
+
+      if (!same_commits)
+        continue;
+
+      /* Objects come from the contenturl if the remote has one; either may
+       * be a mirrorlist= URL, which the pull resolves */
+      g_autofree char *url = g_key_file_get_string (result->remote->options,
+                                                    result->remote->group, "contenturl", NULL);
+      if (url == NULL)
+        url = ostree_remote_get_url (result->remote);
+      if (url != NULL)
+        g_ptr_array_add (mirror_urls, g_steal_pointer (&url));
+    }
+
+  g_ptr_array_add (mirror_urls, NULL);
+  return g_steal_pointer (&mirror_urls);
+}
+
 static void
 copy_option (GVariantDict *master_options, GVariantDict *slave_options, const gchar *key,
              const GVariantType *expected_type)
@@ -6087,6 +6878,10 @@ copy_option (GVariantDict *master_options, GVariantDict *slave_options, const gc
  *     not being pulled will be ignored and any ref without a keyring remote
  *     will be verified with the keyring of the remote being pulled from.
  *     Since: 2019.2
+ *   * `stripe-mirrors` (`b`): When pulling from a remote, also fetch objects
+ *     from any other remotes in @results which have the same commits for the
+ *     refs being pulled, spreading requests across all of them weighted by
+ *     their measured throughput. Since: 2025.2
  *
  * Since: 2018.6
  */
@@ -6110,6 +6905,7 @@ ostree_repo_pull_from_remotes_async (OstreeRepo *self, const OstreeRepoFinderRes
   g_auto (GVariantDict) options_dict = OT_VARIANT_BUILDER_INITIALIZER;
   OstreeRepoPullFlags flags;
   gboolean inherit_transaction;
+  gboolean stripe_mirrors;
 
   /* Set up a task for the whole operation. */
   task = g_task_new (self, cancellable, callback, user_data);
@@ -6126,6 +6922,8 @@ ostree_repo_pull_from_remotes_async (OstreeRepo *self, const OstreeRepoFinderRes
     flags = OSTREE_REPO_PULL_FLAGS_NONE;
   if (!g_variant_dict_lookup (&options_dict, "inherit-transaction", "b", &inherit_transaction))
     inherit_transaction = FALSE;
+  if (!g_variant_dict_lookup (&options_dict, "stripe-mirrors", "b", &stripe_mirrors))
+    stripe_mirrors = FALSE;
 
   /* Run all the local pull operations in a single overall transaction. */
   if (!inherit_transaction
@@ -6215,6 +7013,16 @@ ostree_repo_pull_from_remotes_async (OstreeRepo *self, const OstreeRepoFinderRes
       copy_option (&options_dict, &local_options_dict, "ref-keyring-map",
                    G_VARIANT_TYPE ("a(sss)"));
 
+      if (stripe_mirrors)
+        {
+          g_autoptr (GPtrArray) mirror_urls = find_remotes_mirror_urls (results, i, refs_to_pull);
+
+          g_variant_dict_insert (&local_options_dict, "stripe-mirrors", "b", TRUE);
+          if (mirror_urls->len > 1)
+            g_variant_dict_insert (&local_options_dict, "content-mirror-urls", "^as",
+                                   (char **)mirror_urls->pdata);
+        }
+
       local_options = g_variant_dict_end (&local_options_dict);
 
       /* FIXME: We do nothing useful with @progress at the moment. */
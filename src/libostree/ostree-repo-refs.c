@@ -60,6 +60,272 @@ add_ref_to_set (const char *remote, const char *collection_id, int base_fd, cons
   return TRUE;
 }
 
+/* If core.packed-refs is enabled, transactions write all of their ref
+ * updates to refs/packed-refs in one go; it has a `<checksum> <path>` line
+ * for each ref, where the path is that of the ref's loose file relative to
+ * the repository (e.g. `refs/heads/exampleos/x86_64/stable`).  A loose file
+ * always takes precedence over the packed entry for the same path.
+ */
+#define PACKED_REFS_LOCK_PATH "refs/packed-refs.lock"
+
+gboolean
+_ostree_parse_packed_refs (const char *contents, GHashTable **out_refs, GError **error)
+{
+  g_autoptr (GHashTable) ret_refs
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_auto (GStrv) lines = g_strsplit (contents, "\n", -1);
+
+  for (guint i = 0; lines[i] != NULL; i++)
+    {
+      const char *line = lines[i];
+      if (*line == '\0' || *line == '#')
+        continue;
+
+      const char *space = strchr (line, ' ');
+      if (space == NULL || space - line != OSTREE_SHA256_STRING_LEN
+          || !g_str_has_prefix (space + 1, "refs/"))
+        return glnx_throw (error, "Invalid line %u in %s", i + 1, _OSTREE_PACKED_REFS_PATH);
+
+      g_autofree char *checksum = g_strndup (line, space - line);
+      if (!ostree_validate_checksum_string (checksum, error))
+        return glnx_prefix_error (error, "Invalid line %u in %s", i + 1, _OSTREE_PACKED_REFS_PATH);
+
+      g_hash_table_replace (ret_refs, g_strdup (space + 1), g_steal_pointer (&checksum));
+    }
+
+  *out_refs = g_steal_pointer (&ret_refs);
+  return TRUE;
+}
+
+static gboolean
+packed_refs_stbuf_equal (const struct stat *a, const struct stat *b)
+{
+  return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size
+         && a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/* Sets @out_refs to the (shared, read-only) contents of refs/packed-refs,
+ * or %NULL if there is no such file.  The parsed table is kept around until
+ * the file is replaced. */
+static gboolean
+load_packed_refs (OstreeRepo *self, GHashTable **out_refs, GCancellable *cancellable,
+                  GError **error)
+{
+  struct stat stbuf;
+
+  if (!glnx_fstatat_allow_noent (self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH, &stbuf, 0, error))
+    return FALSE;
+  if (errno == ENOENT)
+    {
+      *out_refs = NULL;
+      return TRUE;
+    }
+
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->packed_refs_lock);
+
+  if (self->packed_refs_cache == NULL
+      || !packed_refs_stbuf_equal (&self->packed_refs_stbuf, &stbuf))
+    {
+      glnx_autofd int fd = -1;
+      if (!glnx_openat_rdonly (self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH, TRUE, &fd, error))
+        return FALSE;
+      if (!glnx_fstat (fd, &stbuf, error))
+        return FALSE;
+
+      g_autofree char *contents = glnx_fd_readall_utf8 (fd, NULL, cancellable, error);
+      if (!contents)
+        return FALSE;
+
+      g_autoptr (GHashTable) refs = NULL;
+      if (!_ostree_parse_packed_refs (contents, &refs, error))
+        return FALSE;
+
+      g_clear_pointer (&self->packed_refs_cache, g_hash_table_unref);
+      self->packed_refs_cache = g_steal_pointer (&refs);
+      self->packed_refs_stbuf = stbuf;
+    }
+
+  *out_refs = g_hash_table_ref (self->packed_refs_cache);
+  return TRUE;
+}
+
+static gboolean
+write_packed_refs (OstreeRepo *self, GHashTable *refs, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GString) buf = g_string_new ("# ostree packed-refs\n");
+  g_autoptr (GList) paths = g_hash_table_get_keys (refs);
+
+  paths = g_list_sort (paths, (GCompareFunc)strcmp);
+  for (GList *l = paths; l != NULL; l = l->next)
+    {
+      const char *path = l->data;
+      g_string_append_printf (buf, "%s %s\n", (char *)g_hash_table_lookup (refs, path), path);
+    }
+
+  return _ostree_repo_file_replace_contents (self, self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH,
+                                             (guint8 *)buf->str, buf->len, cancellable, error);
+}
+
+static gboolean
+lookup_packed_ref (OstreeRepo *self, const char *path, char **out_rev, GError **error)
+{
+  g_autoptr (GHashTable) packed_refs = NULL;
+
+  if (!load_packed_refs (self, &packed_refs, NULL, error))
+    return FALSE;
+
+  *out_rev = packed_refs ? g_strdup (g_hash_table_lookup (packed_refs, path)) : NULL;
+  return TRUE;
+}
+
+/* The packed equivalent of find_ref_in_remotes() */
+static gboolean
+find_packed_ref_in_remotes (OstreeRepo *self, const char *rev, char **out_rev, GError **error)
+{
+  g_autoptr (GHashTable) packed_refs = NULL;
+
+  *out_rev = NULL;
+
+  if (!load_packed_refs (self, &packed_refs, NULL, error))
+    return FALSE;
+  if (packed_refs == NULL)
+    return TRUE;
+
+  GLNX_HASH_TABLE_FOREACH_KV (packed_refs, const char *, path, const char *, checksum)
+    {
+      if (!g_str_has_prefix (path, "refs/remotes/"))
+        continue;
+
+      const char *slash = strchr (path + strlen ("refs/remotes/"), '/');
+      if (slash != NULL && strcmp (slash + 1, rev) == 0)
+        {
+          *out_rev = g_strdup (checksum);
+          break;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Packed refs are only used where there is no loose file, which have been
+ * added to @refs already. */
+static void
+add_packed_ref_to_set (const char *remote, const char *name, const char *checksum,
+                       GHashTable *refs)
+{
+  g_autofree char *refspec = remote ? g_strconcat (remote, ":", name, NULL) : g_strdup (name);
+
+  if (!g_hash_table_contains (refs, refspec))
+    g_hash_table_insert (refs, g_steal_pointer (&refspec), g_strdup (checksum));
+}
+
+/* The path of the loose file for @ref, e.g. `refs/remotes/origin/exampleos/stable` */
+static char *
+ref_path (OstreeRepo *self, const char *remote, const OstreeCollectionRef *ref)
+{
+  if (remote == NULL
+      && (ref->collection_id == NULL
+          || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0))
+    return g_strconcat ("refs/heads/", ref->ref_name, NULL);
+  else if (remote == NULL)
+    return g_strconcat ("refs/mirrors/", ref->collection_id, "/", ref->ref_name, NULL);
+  else
+    return g_strconcat ("refs/remotes/", remote, "/", ref->ref_name, NULL);
+}
+
+static GHashTable *
+copy_packed_refs (GHashTable *packed_refs)
+{
+  GHashTable *ret_refs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  if (packed_refs != NULL)
+    {
+      GLNX_HASH_TABLE_FOREACH_KV (packed_refs, const char *, path, const char *, checksum)
+        g_hash_table_insert (ret_refs, g_strdup (path), g_strdup (checksum));
+    }
+
+  return ret_refs;
+}
+
+/* Resolve the target of the alias symlink at @path to the path of the ref it
+ * points to; see relative_symlink_to(). */
+static char *
+resolve_alias_path (const char *path, const char *target)
+{
+  g_autofree char *dir = g_path_get_dirname (path);
+
+  while (g_str_has_prefix (target, "../"))
+    {
+      char *slash = strrchr (dir, '/');
+      if (slash == NULL)
+        break;
+      *slash = '\0';
+      target += 3;
+    }
+
+  return g_build_filename (dir, target, NULL);
+}
+
+static gboolean
+write_loose_ref (OstreeRepo *self, const char *path, const char *rev, GCancellable *cancellable,
+                 GError **error)
+{
+  g_autofree char *parent = g_path_get_dirname (path);
+  g_autofree char *contents = g_strconcat (rev, "\n", NULL);
+
+  if (!glnx_shutil_mkdir_p_at (self->repo_dir_fd, parent, DEFAULT_DIRECTORY_MODE, cancellable,
+                               error))
+    return FALSE;
+
+  return _ostree_repo_file_replace_contents (self, self->repo_dir_fd, path, (guint8 *)contents,
+                                             strlen (contents), cancellable, error);
+}
+
+/* Remove the loose file at @path, along with any directories that leaves
+ * empty below refs/heads, refs/remotes and refs/mirrors. */
+static gboolean
+remove_loose_ref (OstreeRepo *self, const char *path, GError **error)
+{
+  if (!ot_ensure_unlinked_at (self->repo_dir_fd, path, error))
+    return FALSE;
+
+  g_autofree char *dir = g_path_get_dirname (path);
+  while (strchr (dir + strlen ("refs/"), '/') != NULL)
+    {
+      if (unlinkat (self->repo_dir_fd, dir, AT_REMOVEDIR) < 0)
+        break;
+      *strrchr (dir, '/') = '\0';
+    }
+
+  return TRUE;
+}
+
+/* Refs can't be both a ref and a "directory" of other refs, which the
+ * filesystem enforces for loose refs. */
+static gboolean
+check_packed_ref_conflict (GHashTable *packed_refs, const char *path, GError **error)
+{
+  g_autofree char *dir_prefix = g_strconcat (path, "/", NULL);
+  GLNX_HASH_TABLE_FOREACH (packed_refs, const char *, packed_path)
+    {
+      if (g_str_has_prefix (packed_path, dir_prefix))
+        return glnx_throw (error, "Conflict: %s exists under %s when attempting write",
+                           packed_path, path);
+    }
+
+  g_autofree char *parent = g_strdup (path);
+  char *slash;
+  while ((slash = strrchr (parent, '/')) != NULL)
+    {
+      *slash = '\0';
+      if (g_hash_table_contains (packed_refs, parent))
+        return glnx_throw (error, "Conflict: %s exists when attempting to write %s", parent,
+                           path);
+    }
+
+  return TRUE;
+}
+
 static gboolean
 write_checksum_file_at (OstreeRepo *self, int dfd, const char *name, const char *sha256,
                         GCancellable *cancellable, GError **error)
@@ -239,12 +505,15 @@ resolve_refspec (OstreeRepo *self, const char *remote, const char *ref, gboolean
       return TRUE;
     }
 
+  /* For each location, a loose ref takes precedence over a packed one */
   if (remote != NULL)
     {
       const char *remote_ref = glnx_strjoina ("refs/remotes/", remote, "/", ref);
 
       if (!ot_openat_ignore_enoent (self->repo_dir_fd, remote_ref, &target_fd, error))
         return FALSE;
+      if (target_fd == -1 && !lookup_packed_ref (self, remote_ref, &ret_rev, error))
+        return FALSE;
     }
   else
     {
@@ -252,22 +521,29 @@ resolve_refspec (OstreeRepo *self, const char *remote, const char *ref, gboolean
 
       if (!ot_openat_ignore_enoent (self->repo_dir_fd, local_ref, &target_fd, error))
         return FALSE;
+      if (target_fd == -1 && !lookup_packed_ref (self, local_ref, &ret_rev, error))
+        return FALSE;
 
-      if (target_fd == -1 && fallback_remote)
+      if (target_fd == -1 && ret_rev == NULL && fallback_remote)
         {
           local_ref = glnx_strjoina ("refs/remotes/", ref);
 
           if (!ot_openat_ignore_enoent (self->repo_dir_fd, local_ref, &target_fd, error))
             return FALSE;
+          if (target_fd == -1 && !lookup_packed_ref (self, local_ref, &ret_rev, error))
+            return FALSE;
 
-          if (target_fd == -1)
+          if (target_fd == -1 && ret_rev == NULL)
             {
               if (!find_ref_in_remotes (self, ref, &target_fd, error))
                 return FALSE;
+              if (target_fd == -1 && !find_packed_ref_in_remotes (self, ref, &ret_rev, error))
+                return FALSE;
             }
         }
     }
 
+  /* A ret_rev found in refs/packed-refs was validated when loading it */
   if (target_fd != -1)
     {
       ret_rev = glnx_fd_readall_utf8 (target_fd, NULL, NULL, error);
@@ -281,7 +557,7 @@ resolve_refspec (OstreeRepo *self, const char *remote, const char *ref, gboolean
       if (!ostree_validate_checksum_string (ret_rev, error))
         return FALSE;
     }
-  else
+  else if (ret_rev == NULL)
     {
       if (!resolve_refspec_fallback (self, remote, ref, allow_noent, fallback_remote, &ret_rev,
                                      cancellable, error))
@@ -377,7 +653,7 @@ _ostree_repo_resolve_rev_internal (OstreeRepo *self, const char *refspec, gboole
         {
           g_autofree char *parent_refspec = NULL;
           g_autofree char *parent_rev = NULL;
-          g_autoptr (GVariant) commit = NULL;
+          gboolean exists;
 
           parent_refspec = g_strdup (refspec);
           parent_refspec[strlen (parent_refspec) - 1] = '\0';
@@ -385,11 +661,19 @@ _ostree_repo_resolve_rev_internal (OstreeRepo *self, const char *refspec, gboole
           if (!ostree_repo_resolve_rev (self, parent_refspec, allow_noent, &parent_rev, error))
             return FALSE;
 
-          if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, parent_rev, &commit,
-                                         error))
+          if (!ostree_repo_lookup_commit_graph (self, parent_rev, &exists, &ret_rev, NULL, NULL,
+                                                NULL, error))
             return FALSE;
+          if (!exists)
+            {
+              /* Load the commit anyways for the usual error */
+              g_autoptr (GVariant) commit = NULL;
+              if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, parent_rev, &commit,
+                                             error))
+                return FALSE;
+            }
 
-          if (!(ret_rev = ostree_commit_get_parent (commit)))
+          if (ret_rev == NULL)
             return glnx_throw (error, "Commit %s has no parent", parent_rev);
         }
       else
@@ -702,6 +986,34 @@ _ostree_repo_list_refs_internal (OstreeRepo *self, gboolean cut_prefix,
                 return FALSE;
             }
         }
+
+      g_autoptr (GHashTable) packed_refs = NULL;
+      if (!(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES)
+          && !load_packed_refs (self, &packed_refs, cancellable, error))
+        return FALSE;
+
+      if (packed_refs != NULL)
+        {
+          /* "<remote>:." lists everything in the remote */
+          const char *dir_prefix
+              = strcmp (ref_prefix, ".") == 0 ? prefix_path : glnx_strjoina (path, "/");
+          const char *checksum = g_hash_table_lookup (packed_refs, path);
+
+          if (checksum != NULL)
+            add_packed_ref_to_set (remote, ref_prefix, checksum, ret_all_refs);
+
+          GLNX_HASH_TABLE_FOREACH_KV (packed_refs, const char *, packed_path, const char *,
+                                      packed_checksum)
+            {
+              if (!g_str_has_prefix (packed_path, dir_prefix))
+                continue;
+
+              const char *name = packed_path + strlen (dir_prefix);
+              g_autofree char *prefixed_name
+                  = cut_prefix ? g_strdup (name) : g_strconcat (ref_prefix, "/", name, NULL);
+              add_packed_ref_to_set (remote, prefixed_name, packed_checksum, ret_all_refs);
+            }
+        }
     }
   else
     {
@@ -748,6 +1060,35 @@ _ostree_repo_list_refs_internal (OstreeRepo *self, gboolean cut_prefix,
                 return FALSE;
             }
         }
+
+      g_autoptr (GHashTable) packed_refs = NULL;
+      if (!(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES)
+          && !load_packed_refs (self, &packed_refs, cancellable, error))
+        return FALSE;
+
+      if (packed_refs != NULL)
+        {
+          GLNX_HASH_TABLE_FOREACH_KV (packed_refs, const char *, packed_path, const char *,
+                                      checksum)
+            {
+              if (g_str_has_prefix (packed_path, "refs/heads/"))
+                {
+                  add_packed_ref_to_set (NULL, packed_path + strlen ("refs/heads/"), checksum,
+                                         ret_all_refs);
+                }
+              else if (!(flags & OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES)
+                       && g_str_has_prefix (packed_path, "refs/remotes/"))
+                {
+                  const char *remote_name = packed_path + strlen ("refs/remotes/");
+                  const char *slash = strchr (remote_name, '/');
+                  if (slash == NULL)
+                    continue;
+
+                  g_autofree char *packed_remote = g_strndup (remote_name, slash - remote_name);
+                  add_packed_ref_to_set (packed_remote, slash + 1, checksum, ret_all_refs);
+                }
+            }
+        }
     }
 
   ot_transfer_out_value (out_all_refs, &ret_all_refs);
@@ -1027,6 +1368,25 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
   if (!ostree_validate_rev (ref->ref_name, error))
     return FALSE;
 
+  g_autofree char *path = ref_path (self, remote, ref);
+
+  /* Don't race with _ostree_repo_pack_refs() folding the loose refs */
+  g_auto (GLnxLockFile) packed_refs_lock = {
+    0,
+  };
+  g_autoptr (GHashTable) packed_refs = NULL;
+  if (!load_packed_refs (self, &packed_refs, cancellable, error))
+    return FALSE;
+  if (self->packed_refs || packed_refs != NULL)
+    {
+      if (!glnx_make_lock_file (self->repo_dir_fd, PACKED_REFS_LOCK_PATH, LOCK_EX,
+                                &packed_refs_lock, error))
+        return FALSE;
+      g_clear_pointer (&packed_refs, g_hash_table_unref);
+      if (!load_packed_refs (self, &packed_refs, cancellable, error))
+        return FALSE;
+    }
+
   if (remote == NULL
       && (ref->collection_id == NULL
           || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0))
@@ -1076,6 +1436,14 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
 
   if (rev == NULL && alias == NULL)
     {
+      if (packed_refs != NULL && g_hash_table_contains (packed_refs, path))
+        {
+          g_autoptr (GHashTable) new_packed_refs = copy_packed_refs (packed_refs);
+          g_hash_table_remove (new_packed_refs, path);
+          if (!write_packed_refs (self, new_packed_refs, cancellable, error))
+            return FALSE;
+        }
+
       if (dfd >= 0)
         {
           if (!ot_ensure_unlinked_at (dfd, ref->ref_name, error))
@@ -1084,11 +1452,33 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
     }
   else if (rev != NULL)
     {
+      if (packed_refs != NULL && !check_packed_ref_conflict (packed_refs, path, error))
+        return FALSE;
+
       if (!write_checksum_file_at (self, dfd, ref->ref_name, rev, cancellable, error))
         return FALSE;
     }
   else if (alias != NULL)
     {
+      if (packed_refs != NULL)
+        {
+          const OstreeCollectionRef alias_ref = { ref->collection_id, (char *)alias };
+          g_autofree char *alias_path = ref_path (self, remote, &alias_ref);
+          const char *alias_rev = g_hash_table_lookup (packed_refs, alias_path);
+          struct stat stbuf;
+
+          /* Aliases are symlinks, so the ref they point to needs a loose file */
+          if (alias_rev != NULL)
+            {
+              if (!glnx_fstatat_allow_noent (self->repo_dir_fd, alias_path, &stbuf,
+                                             AT_SYMLINK_NOFOLLOW, error))
+                return FALSE;
+              if (errno == ENOENT
+                  && !write_loose_ref (self, alias_path, alias_rev, cancellable, error))
+                return FALSE;
+            }
+        }
+
       const char *lastslash = strrchr (ref->ref_name, '/');
 
       if (lastslash)
@@ -1160,6 +1550,449 @@ _ostree_repo_update_collection_refs (OstreeRepo *self,
   return TRUE;
 }
 
+/* Collect the loose refs below @path: the contents of regular files go in
+ * @loose_refs, the paths of alias symlinks in @aliases, and the paths of the
+ * refs they point to in @alias_targets.  Below refs/remotes and refs/mirrors,
+ * refs are only looked for in the per-remote and per-collection directories.
+ */
+static gboolean
+collect_loose_refs (int dfd, const char *name, GString *path, gboolean files_allowed,
+                    GHashTable *loose_refs, GHashTable *aliases, GHashTable *alias_targets,
+                    GCancellable *cancellable, GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  gboolean exists;
+
+  if (!ot_dfd_iter_init_allow_noent (dfd, name, &dfd_iter, &exists, error))
+    return FALSE;
+
+  while (exists)
+    {
+      const gsize len = path->len;
+      struct dirent *dent = NULL;
+
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      /* See enumerate_refs_recurse() */
+      if (!_ostree_validate_ref_fragment (dent->d_name, NULL))
+        continue;
+
+      g_string_append_c (path, '/');
+      g_string_append (path, dent->d_name);
+
+      if (dent->d_type == DT_DIR)
+        {
+          if (!collect_loose_refs (dfd_iter.fd, dent->d_name, path, TRUE, loose_refs, aliases,
+                                   alias_targets, cancellable, error))
+            return FALSE;
+        }
+      else if (files_allowed && dent->d_type == DT_LNK)
+        {
+          g_autofree char *target
+              = glnx_readlinkat_malloc (dfd_iter.fd, dent->d_name, cancellable, error);
+          if (!target)
+            return FALSE;
+
+          g_hash_table_add (aliases, g_strdup (path->str));
+          g_hash_table_add (alias_targets, resolve_alias_path (path->str, target));
+        }
+      else if (files_allowed && dent->d_type == DT_REG)
+        {
+          g_autofree char *contents = glnx_file_get_contents_utf8_at (
+              dfd_iter.fd, dent->d_name, NULL, cancellable, error);
+          if (!contents)
+            return FALSE;
+
+          /* Leave alone anything that isn't a valid ref */
+          g_strchomp (contents);
+          if (ostree_validate_checksum_string (contents, NULL))
+            g_hash_table_insert (loose_refs, g_strdup (path->str), g_steal_pointer (&contents));
+        }
+
+      g_string_truncate (path, len);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+validate_ref_update (OstreeRepo *self, const char *remote, const OstreeCollectionRef *ref,
+                     const char *rev, GError **error)
+{
+  if (remote != NULL && !ostree_validate_remote_name (remote, error))
+    return FALSE;
+  if (ref->collection_id != NULL && !ostree_validate_collection_id (ref->collection_id, error))
+    return FALSE;
+  if (!ostree_validate_rev (ref->ref_name, error))
+    return FALSE;
+
+  if (rev != NULL)
+    {
+      if (!ostree_validate_checksum_string (rev, error))
+        return FALSE;
+      if (ostree_validate_checksum_string (ref->ref_name, NULL))
+        return glnx_throw (error, "Rev name '%s' looks like a checksum", ref->ref_name);
+    }
+
+  return TRUE;
+}
+
+/* The bulk version of check_packed_ref_conflict(), for the refs written
+ * by @updates (path → checksum, or %NULL when deleting the ref). */
+static gboolean
+check_ref_update_conflicts (GHashTable *updates, GHashTable *new_packed_refs,
+                            GHashTable *loose_refs, GHashTable *aliases, GError **error)
+{
+  GHashTable *ref_sets[] = { new_packed_refs, loose_refs, aliases };
+  /* char * directory → const char * path of a ref in it */
+  g_autoptr (GHashTable) dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (ref_sets); i++)
+    {
+      GLNX_HASH_TABLE_FOREACH (ref_sets[i], const char *, path)
+        {
+          gpointer rev;
+          if (g_hash_table_lookup_extended (updates, path, NULL, &rev) && rev == NULL)
+            continue;
+
+          /* Skip over `refs/heads/` and friends */
+          const char *slash = strchr (path + strlen ("refs/"), '/');
+          while ((slash = strchr (slash + 1, '/')) != NULL)
+            g_hash_table_insert (dirs, g_strndup (path, slash - path), (char *)path);
+        }
+    }
+
+  GLNX_HASH_TABLE_FOREACH_KV (updates, const char *, path, const char *, rev)
+    {
+      if (rev == NULL)
+        continue;
+
+      const char *child = g_hash_table_lookup (dirs, path);
+      if (child != NULL)
+        return glnx_throw (error, "Conflict: %s exists under %s when attempting write", child,
+                           path);
+
+      g_autofree char *parent = g_strdup (path);
+      char *slash;
+      while ((slash = strrchr (parent, '/')) != NULL)
+        {
+          *slash = '\0';
+          for (guint i = 0; i < G_N_ELEMENTS (ref_sets); i++)
+            {
+              gpointer parent_rev;
+              if (g_hash_table_lookup_extended (updates, parent, NULL, &parent_rev)
+                  && parent_rev == NULL)
+                continue;
+              if (g_hash_table_contains (ref_sets[i], parent))
+                return glnx_throw (error, "Conflict: %s exists when attempting to write %s",
+                                   parent, path);
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+/* Look at what's on disk for @path, which a transaction is about to write,
+ * without walking the rest of refs/.  An existing loose file is added to
+ * @loose_refs and @keep_loose so it's updated in place, since it may be
+ * the target of an alias, and an alias symlink to @aliases.  A file in
+ * place of one of the parent directories, or refs under @path, is a
+ * conflict.
+ */
+static gboolean
+lookup_loose_ref_for_update (OstreeRepo *self, const char *path, const char *rev,
+                             GHashTable *loose_refs, GHashTable *aliases, GHashTable *keep_loose,
+                             GCancellable *cancellable, GError **error)
+{
+  struct stat stbuf;
+  if (!glnx_fstatat_allow_noent (self->repo_dir_fd, path, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+    return FALSE;
+  if (errno == ENOENT)
+    {
+      if (rev == NULL)
+        return TRUE;
+
+      g_autofree char *parent = g_path_get_dirname (path);
+      while (strchr (parent + strlen ("refs/"), '/') != NULL)
+        {
+          if (!glnx_fstatat_allow_noent (self->repo_dir_fd, parent, &stbuf, 0, error))
+            return FALSE;
+          if (errno == 0 && !S_ISDIR (stbuf.st_mode))
+            return glnx_throw (error, "Conflict: %s exists when attempting to write %s", parent,
+                               path);
+          *strrchr (parent, '/') = '\0';
+        }
+    }
+  else if (S_ISLNK (stbuf.st_mode))
+    g_hash_table_add (aliases, g_strdup (path));
+  else if (S_ISREG (stbuf.st_mode))
+    {
+      g_autofree char *contents
+          = glnx_file_get_contents_utf8_at (self->repo_dir_fd, path, NULL, cancellable, error);
+      if (!contents)
+        return FALSE;
+      g_strchomp (contents);
+      if (ostree_validate_checksum_string (contents, NULL))
+        {
+          g_hash_table_insert (loose_refs, g_strdup (path), g_steal_pointer (&contents));
+          g_hash_table_add (keep_loose, g_strdup (path));
+        }
+    }
+  else if (S_ISDIR (stbuf.st_mode) && rev != NULL)
+    {
+      /* Only leftover empty directories can be replaced */
+      if (unlinkat (self->repo_dir_fd, path, AT_REMOVEDIR) < 0)
+        {
+          if (errno == ENOTEMPTY || errno == EEXIST)
+            return glnx_throw (error, "Conflict: refs exist under %s when attempting write",
+                               path);
+          return glnx_throw_errno_prefix (error, "unlinkat(%s)", path);
+        }
+    }
+
+  return TRUE;
+}
+
+/* Apply @refs (refspec → checksum) and @collection_refs (collection–ref →
+ * checksum) from a transaction, where a %NULL checksum deletes the ref, with
+ * a single atomic rewrite of refs/packed-refs.
+ *
+ * The first time refs/packed-refs is written, all other loose refs are
+ * folded into it, except for aliases and the refs they point to, which
+ * always stay loose.  After that, only the refs in the transaction are
+ * looked at, so committing doesn't walk refs/; any of them that still has
+ * a loose file is updated in place.
+ */
+gboolean
+_ostree_repo_pack_refs (OstreeRepo *self, GHashTable *refs, GHashTable *collection_refs,
+                        GCancellable *cancellable, GError **error)
+{
+  GLNX_AUTO_PREFIX_ERROR ("Writing packed refs", error);
+
+  /* Older versions don't read refs/packed-refs; see reload_core_config() */
+  g_assert (self->packed_refs);
+
+  /* char * path → const char * checksum, or %NULL to delete it */
+  g_autoptr (GHashTable) updates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (refs != NULL)
+    {
+      GLNX_HASH_TABLE_FOREACH_KV (refs, const char *, refspec, const char *, rev)
+        {
+          g_autofree char *remote = NULL;
+          g_autofree char *ref_name = NULL;
+          if (!ostree_parse_refspec (refspec, &remote, &ref_name, error))
+            return FALSE;
+
+          const OstreeCollectionRef ref = { NULL, ref_name };
+          if (!validate_ref_update (self, remote, &ref, rev, error))
+            return FALSE;
+          g_hash_table_replace (updates, ref_path (self, remote, &ref), (char *)rev);
+        }
+    }
+
+  if (collection_refs != NULL)
+    {
+      GLNX_HASH_TABLE_FOREACH_KV (collection_refs, const OstreeCollectionRef *, ref, const char *,
+                                  rev)
+        {
+          if (!validate_ref_update (self, NULL, ref, rev, error))
+            return FALSE;
+          g_hash_table_replace (updates, ref_path (self, NULL, ref), (char *)rev);
+        }
+    }
+
+  g_auto (GLnxLockFile) lock = {
+    0,
+  };
+  if (!glnx_make_lock_file (self->repo_dir_fd, PACKED_REFS_LOCK_PATH, LOCK_EX, &lock, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) packed_refs = NULL;
+  if (!load_packed_refs (self, &packed_refs, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) loose_refs
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_autoptr (GHashTable) aliases = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_autoptr (GHashTable) alias_targets
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (packed_refs == NULL)
+    {
+      g_autoptr (GString) path = g_string_new ("");
+      const char *refs_dirs[] = { "refs/heads", "refs/remotes", "refs/mirrors" };
+
+      for (guint i = 0; i < G_N_ELEMENTS (refs_dirs); i++)
+        {
+          g_string_assign (path, refs_dirs[i]);
+          if (!collect_loose_refs (self->repo_dir_fd, refs_dirs[i], path, i == 0, loose_refs,
+                                   aliases, alias_targets, cancellable, error))
+            return FALSE;
+        }
+
+      /* The targets of aliases that do have a loose file keep it */
+      GHashTableIter iter;
+      gpointer target;
+      g_hash_table_iter_init (&iter, alias_targets);
+      while (g_hash_table_iter_next (&iter, &target, NULL))
+        {
+          if (!g_hash_table_contains (loose_refs, target))
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+  else
+    {
+      GLNX_HASH_TABLE_FOREACH_KV (updates, const char *, update_path, const char *, rev)
+        {
+          if (!lookup_loose_ref_for_update (self, update_path, rev, loose_refs, aliases,
+                                            alias_targets, cancellable, error))
+            return FALSE;
+        }
+    }
+
+  g_autoptr (GHashTable) new_packed_refs = copy_packed_refs (packed_refs);
+  GLNX_HASH_TABLE_FOREACH_KV (loose_refs, const char *, loose_path, const char *, checksum)
+    {
+      if (!g_hash_table_contains (alias_targets, loose_path))
+        g_hash_table_replace (new_packed_refs, g_strdup (loose_path), g_strdup (checksum));
+    }
+  GLNX_HASH_TABLE_FOREACH_KV (updates, const char *, update_path, const char *, rev)
+    {
+      if (rev == NULL || g_hash_table_contains (alias_targets, update_path))
+        g_hash_table_remove (new_packed_refs, update_path);
+      else
+        g_hash_table_replace (new_packed_refs, g_strdup (update_path), g_strdup (rev));
+    }
+
+  if (!check_ref_update_conflicts (updates, new_packed_refs, loose_refs, aliases, error))
+    return FALSE;
+
+  if (!write_packed_refs (self, new_packed_refs, cancellable, error))
+    return FALSE;
+
+  /* Only now that refs/packed-refs is written can the loose files it
+   * replaces go; removing them doesn't need to be synced. */
+  GLNX_HASH_TABLE_FOREACH (loose_refs, const char *, loose_path)
+    {
+      if (!g_hash_table_contains (alias_targets, loose_path)
+          && !remove_loose_ref (self, loose_path, error))
+        return FALSE;
+    }
+  GLNX_HASH_TABLE_FOREACH_KV (updates, const char *, update_path, const char *, rev)
+    {
+      if (rev != NULL && g_hash_table_contains (alias_targets, update_path))
+        {
+          if (!write_loose_ref (self, update_path, rev, cancellable, error))
+            return FALSE;
+        }
+      else if (!remove_loose_ref (self, update_path, error))
+        return FALSE;
+    }
+
+  return _ostree_repo_update_mtime (self, error);
+}
+
+/* Returns the collection ID of @remote_name, or %NULL if it doesn't have a
+ * valid one, looking it up only once per remote. */
+static const char *
+lookup_remote_collection_id (OstreeRepo *self, GHashTable *collection_ids,
+                             const char *remote_name)
+{
+  gpointer collection_id;
+
+  if (!g_hash_table_lookup_extended (collection_ids, remote_name, NULL, &collection_id))
+    {
+      g_autofree char *remote_collection_id = NULL;
+      g_autoptr (GError) local_error = NULL;
+
+      if (!ostree_repo_get_remote_option (self, remote_name, "collection-id", NULL,
+                                          &remote_collection_id, &local_error)
+          || !ostree_validate_collection_id (remote_collection_id, &local_error))
+        {
+          g_debug ("Ignoring remote ‘%s’ due to no valid collection ID being configured "
+                   "for it: %s",
+                   remote_name, local_error->message);
+          g_clear_pointer (&remote_collection_id, g_free);
+        }
+
+      collection_id = remote_collection_id;
+      g_hash_table_insert (collection_ids, g_strdup (remote_name),
+                           g_steal_pointer (&remote_collection_id));
+    }
+
+  return collection_id;
+}
+
+/* The refs/packed-refs part of ostree_repo_list_collection_refs() */
+static gboolean
+add_packed_collection_refs (OstreeRepo *self, const char *match_collection_id,
+                            OstreeRepoListRefsExtFlags flags, GHashTable *refs,
+                            GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GHashTable) packed_refs = NULL;
+
+  if (!load_packed_refs (self, &packed_refs, cancellable, error))
+    return FALSE;
+  if (packed_refs == NULL)
+    return TRUE;
+
+  const char *main_collection_id = ostree_repo_get_collection_id (self);
+  g_autoptr (GHashTable) remote_collection_ids
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  GLNX_HASH_TABLE_FOREACH_KV (packed_refs, const char *, path, const char *, checksum)
+    {
+      g_autofree char *dir_name = NULL;
+      const char *collection_id;
+      const char *name;
+
+      if (g_str_has_prefix (path, "refs/heads/"))
+        {
+          collection_id = main_collection_id;
+          name = path + strlen ("refs/heads/");
+        }
+      else
+        {
+          const gboolean is_mirror = g_str_has_prefix (path, "refs/mirrors/");
+          if (is_mirror && (flags & OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_MIRRORS))
+            continue;
+          if (!is_mirror
+              && (!g_str_has_prefix (path, "refs/remotes/")
+                  || (flags & OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES)))
+            continue;
+
+          const char *dir = strchr (path + strlen ("refs/"), '/') + 1;
+          const char *slash = strchr (dir, '/');
+          if (slash == NULL)
+            continue;
+
+          dir_name = g_strndup (dir, slash - dir);
+          name = slash + 1;
+          if (is_mirror)
+            collection_id = dir_name;
+          else
+            collection_id = lookup_remote_collection_id (self, remote_collection_ids, dir_name);
+        }
+
+      if (collection_id == NULL
+          || (match_collection_id != NULL && strcmp (match_collection_id, collection_id) != 0))
+        continue;
+
+      g_autoptr (OstreeCollectionRef) ref = ostree_collection_ref_new (collection_id, name);
+      if (!g_hash_table_contains (refs, ref))
+        g_hash_table_insert (refs, g_steal_pointer (&ref), g_strdup (checksum));
+    }
+
+  return TRUE;
+}
+
 /**
  * ostree_repo_list_collection_refs:
  * @self: Repo
@@ -1297,6 +2130,11 @@ ostree_repo_list_collection_refs (OstreeRepo *self, const char *match_collection
         }
     }
 
+  if (!(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES)
+      && !add_packed_collection_refs (self, match_collection_id, flags, ret_all_refs, cancellable,
+                                      error))
+    return FALSE;
+
   ot_transfer_out_value (out_all_refs, &ret_all_refs);
   return TRUE;
 }
@@ -23,9 +23,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "bsdiff/bsdiff.h"
 #include "libglnx.h"
 #include "ostree-autocleanups.h"
+#include "ostree-bsdiff.h"
 #include "ostree-core-private.h"
 #include "ostree-diff.h"
 #include "ostree-lzma-compressor.h"
@@ -34,6 +34,9 @@
 #include "ostree-rollsum.h"
 #include "ostree-sign.h"
 #include "ostree-varint.h"
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-compressor.h"
+#endif
 #include "otutil.h"
 
 #define CONTENT_SIZE_SIMILARITY_THRESHOLD_PERCENT (30)
@@ -42,7 +45,8 @@ typedef enum
 {
   DELTAOPT_FLAG_NONE = (1 << 0),
   DELTAOPT_FLAG_DISABLE_BSDIFF = (1 << 1),
-  DELTAOPT_FLAG_VERBOSE = (1 << 2)
+  DELTAOPT_FLAG_VERBOSE = (1 << 2),
+  DELTAOPT_FLAG_ROLLSUM_BUPSPLIT = (1 << 3)
 } DeltaOpts;
 
 typedef struct
@@ -58,6 +62,7 @@ typedef struct
   GPtrArray *xattrs;
   GLnxTmpfile part_tmpf;
   GVariant *header;
+  guint8 compression_type;
 } OstreeStaticDeltaPartBuilder;
 
 typedef struct
@@ -67,10 +72,17 @@ typedef struct
   guint64 loose_compressed_size;
   guint64 min_fallback_size_bytes;
   guint64 max_bsdiff_size_bytes;
+  guint64 max_bsdiff_memory_bytes;
   guint64 max_chunk_size_bytes;
+  guint8 compression;
+  guint lzma_threads;
+  guint64 lzma_block_size_bytes;
+  gint zstd_level;
+  guint zstd_max_overhead;
   guint64 rollsum_size;
   guint n_rollsum;
   guint n_bsdiff;
+  guint n_bsdiff_index_reused;
   guint n_fallback;
   gboolean swap_endian;
   int parts_dfd;
@@ -209,6 +221,55 @@ xattr_chunk_equals (const void *one, const void *two)
   return memcmp (g_variant_get_data (v1), g_variant_get_data (v2), l1) == 0;
 }
 
+/* Compress serialized part content with @comptype, using the same
+ * type byte as stored at the start of the part.
+ */
+static GBytes *
+compress_part_content (OstreeStaticDeltaBuilder *builder, guint8 comptype, GVariant *content,
+                       GError **error)
+{
+  g_autoptr (GConverter) compressor = NULL;
+  g_auto (GVariantBuilder) compressor_params = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&compressor_params, G_VARIANT_TYPE ("a{sv}"));
+
+  switch (comptype)
+    {
+    case 0:
+      return g_variant_get_data_as_bytes (content);
+    case 'x':
+      g_variant_builder_add (&compressor_params, "{sv}", "threads",
+                             g_variant_new_uint32 (builder->lzma_threads));
+      g_variant_builder_add (&compressor_params, "{sv}", "block-size",
+                             g_variant_new_uint64 (builder->lzma_block_size_bytes));
+      compressor = (GConverter *)_ostree_lzma_compressor_new (
+          g_variant_builder_end (&compressor_params));
+      break;
+#ifdef HAVE_ZSTD
+    case 'z':
+      g_variant_builder_add (&compressor_params, "{sv}", "level",
+                             g_variant_new_int32 (builder->zstd_level));
+      compressor = (GConverter *)_ostree_zstd_compressor_new (
+          g_variant_builder_end (&compressor_params));
+      break;
+#endif
+    default:
+      g_assert_not_reached ();
+    }
+
+  g_autoptr (GInputStream) part_payload_in = variant_to_inputstream (content);
+  g_autoptr (GOutputStream) part_payload_out
+      = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  g_autoptr (GOutputStream) part_payload_compressor
+      = g_converter_output_stream_new (part_payload_out, compressor);
+  gssize n_bytes_written = g_output_stream_splice (
+      part_payload_compressor, part_payload_in,
+      G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET | G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE, NULL, error);
+  if (n_bytes_written < 0)
+    return NULL;
+
+  return g_memory_output_stream_steal_as_bytes ((GMemoryOutputStream *)part_payload_out);
+}
+
 static gboolean
 finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
 {
@@ -218,10 +279,6 @@ finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
   g_autoptr (GBytes) checksum_bytes = NULL;
   g_autoptr (GOutputStream) part_temp_outstream = NULL;
   g_autoptr (GInputStream) part_in = NULL;
-  g_autoptr (GInputStream) part_payload_in = NULL;
-  g_autoptr (GMemoryOutputStream) part_payload_out = NULL;
-  g_autoptr (GConverterOutputStream) part_payload_compressor = NULL;
-  g_autoptr (GConverter) compressor = NULL;
   g_autoptr (GVariant) delta_part_content = NULL;
   g_autoptr (GVariant) delta_part = NULL;
   g_autoptr (GVariant) delta_part_header = NULL;
@@ -251,29 +308,49 @@ finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
     g_variant_ref_sink (delta_part_content);
   }
 
-  /* Hardcode xz for now */
-  compressor = (GConverter *)_ostree_lzma_compressor_new (NULL);
-  compression_type_char = 'x';
-  part_payload_in = variant_to_inputstream (delta_part_content);
-  part_payload_out = (GMemoryOutputStream *)g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
-  part_payload_compressor = (GConverterOutputStream *)g_converter_output_stream_new (
-      (GOutputStream *)part_payload_out, compressor);
+  g_autoptr (GBytes) payload = NULL;
+  compression_type_char = builder->compression;
+  if (compression_type_char == 'a')
+    {
+      /* zstd decompresses several times faster than lzma, which is what
+       * dominates applying a delta on slow CPUs; only pay for lzma when it
+       * makes the part meaningfully smaller.
+       */
+      g_autoptr (GBytes) lzma_payload
+          = compress_part_content (builder, 'x', delta_part_content, error);
+      if (!lzma_payload)
+        return FALSE;
+      g_autoptr (GBytes) zstd_payload
+          = compress_part_content (builder, 'z', delta_part_content, error);
+      if (!zstd_payload)
+        return FALSE;
 
-  {
-    gssize n_bytes_written = g_output_stream_splice (
-        (GOutputStream *)part_payload_compressor, part_payload_in,
-        G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET | G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE, NULL, error);
-    if (n_bytes_written < 0)
-      return FALSE;
-  }
+      guint64 lzma_size = g_bytes_get_size (lzma_payload);
+      guint64 zstd_size = g_bytes_get_size (zstd_payload);
+      if (zstd_size * 100 <= lzma_size * (100 + builder->zstd_max_overhead))
+        {
+          compression_type_char = 'z';
+          payload = g_steal_pointer (&zstd_payload);
+        }
+      else
+        {
+          compression_type_char = 'x';
+          payload = g_steal_pointer (&lzma_payload);
+        }
+    }
+  else
+    {
+      payload = compress_part_content (builder, compression_type_char, delta_part_content, error);
+      if (!payload)
+        return FALSE;
+    }
+  part_builder->compression_type = compression_type_char;
 
   g_clear_pointer (&delta_part_content, g_variant_unref);
 
-  {
-    g_autoptr (GBytes) payload = g_memory_output_stream_steal_as_bytes (part_payload_out);
-    delta_part = g_variant_ref_sink (
-        g_variant_new ("(y@ay)", compression_type_char, ot_gvariant_new_ay_bytes (payload)));
-  }
+  delta_part = g_variant_ref_sink (
+      g_variant_new ("(y@ay)", compression_type_char, ot_gvariant_new_ay_bytes (payload)));
+  g_clear_pointer (&payload, g_bytes_unref);
 
   if (!glnx_open_tmpfile_linkable_at (builder->parts_dfd, ".", O_RDWR | O_CLOEXEC,
                                       &part_builder->part_tmpf, error))
@@ -301,9 +378,10 @@ finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
   if (builder->delta_opts & DELTAOPT_FLAG_VERBOSE)
     {
       g_printerr ("part %u n:%u compressed:%" G_GUINT64_FORMAT " uncompressed:%" G_GUINT64_FORMAT
-                  "\n",
+                  " compression:%c\n",
                   builder->parts->len, part_builder->objects->len, part_builder->compressed_size,
-                  part_builder->uncompressed_size);
+                  part_builder->uncompressed_size,
+                  part_builder->compression_type ? part_builder->compression_type : '0');
     }
 
   return TRUE;
@@ -551,8 +629,9 @@ get_unpacked_unlinked_content (OstreeRepo *repo, const char *checksum, GBytes **
 }
 
 static gboolean
-try_content_bsdiff (OstreeRepo *repo, const char *from, const char *to, ContentBsdiff **out_bsdiff,
-                    guint64 max_bsdiff_size_bytes, GCancellable *cancellable, GError **error)
+try_content_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder, const char *from,
+                    const char *to, ContentBsdiff **out_bsdiff, GCancellable *cancellable,
+                    GError **error)
 {
 
   g_autoptr (GFileInfo) from_finfo = NULL;
@@ -564,9 +643,21 @@ try_content_bsdiff (OstreeRepo *repo, const char *from, const char *to, ContentB
 
   *out_bsdiff = NULL;
 
+  const guint64 from_size = g_file_info_get_size (from_finfo);
+  const guint64 to_size = g_file_info_get_size (to_finfo);
+
   /* Ignore this if it's too large */
-  if (g_file_info_get_size (to_finfo) + g_file_info_get_size (from_finfo) > max_bsdiff_size_bytes)
+  if (builder->max_bsdiff_size_bytes > 0
+      && from_size + to_size > builder->max_bsdiff_size_bytes)
     return TRUE;
+  if (from_size >= G_MAXINT32 || to_size >= G_MAXINT32)
+    return TRUE;
+  if (_ostree_bsdiff_memory_estimate (from_size, to_size) > builder->max_bsdiff_memory_bytes)
+    {
+      if (builder->delta_opts & DELTAOPT_FLAG_VERBOSE)
+        g_printerr ("bsdiff for %s -> %s exceeds memory budget\n", from, to);
+      return TRUE;
+    }
 
   ContentBsdiff *ret_bsdiff = g_new0 (ContentBsdiff, 1);
   ret_bsdiff->from_checksum = g_strdup (from);
@@ -591,7 +682,11 @@ try_content_rollsum (OstreeRepo *repo, DeltaOpts opts, const char *from, const c
   if (!get_unpacked_unlinked_content (repo, to, &tmp_to, cancellable, error))
     return FALSE;
 
-  g_autoptr (OstreeRollsumMatches) matches = _ostree_compute_rollsum_matches (tmp_from, tmp_to);
+  const OstreeRollsumChunker chunker = (opts & DELTAOPT_FLAG_ROLLSUM_BUPSPLIT)
+                                           ? OSTREE_ROLLSUM_CHUNKER_BUPSPLIT
+                                           : OSTREE_ROLLSUM_CHUNKER_GEAR;
+  g_autoptr (OstreeRollsumMatches) matches
+      = _ostree_compute_rollsum_matches_full (tmp_from, tmp_to, chunker);
 
   const guint match_ratio = (matches->bufmatches * 100) / matches->total;
 
@@ -615,22 +710,22 @@ try_content_rollsum (OstreeRepo *repo, DeltaOpts opts, const char *from, const c
   return TRUE;
 }
 
-struct bzdiff_opaque_s
+/* The index of the most recent bsdiff source, reused while consecutive
+ * targets share it.
+ */
+typedef struct
 {
-  GOutputStream *out;
-  GCancellable *cancellable;
-  GError **error;
-};
+  char *from_checksum;
+  OstreeBsdiffIndex *index;
+} BsdiffIndexCache;
 
-static int
-bzdiff_write (struct bsdiff_stream *stream, const void *buffer, int size)
+static void
+bsdiff_index_cache_clear (BsdiffIndexCache *cache)
 {
-  struct bzdiff_opaque_s *op = stream->opaque;
-  if (!g_output_stream_write (op->out, buffer, size, op->cancellable, op->error))
-    return -1;
-
-  return 0;
+  g_clear_pointer (&cache->from_checksum, g_free);
+  g_clear_pointer (&cache->index, _ostree_bsdiff_index_free);
 }
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (BsdiffIndexCache, bsdiff_index_cache_clear)
 
 static void
 append_payload_chunk_and_write (OstreeStaticDeltaPartBuilder *current_part, const guint8 *buf,
@@ -764,7 +859,8 @@ process_one_rollsum (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
 static gboolean
 process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
                     OstreeStaticDeltaPartBuilder **current_part_val, const char *to_checksum,
-                    ContentBsdiff *bsdiff_content, GCancellable *cancellable, GError **error)
+                    ContentBsdiff *bsdiff_content, BsdiffIndexCache *index_cache,
+                    GCancellable *cancellable, GError **error)
 {
   OstreeStaticDeltaPartBuilder *current_part = *current_part_val;
 
@@ -777,18 +873,30 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
       *current_part_val = current_part;
     }
 
-  g_autoptr (GBytes) tmp_from = NULL;
-  if (!get_unpacked_unlinked_content (repo, bsdiff_content->from_checksum, &tmp_from, cancellable,
-                                      error))
-    return FALSE;
+  /* Building the index of the source dominates the cost, so keep it
+   * around for the next target diffed against the same source.
+   */
+  if (g_strcmp0 (index_cache->from_checksum, bsdiff_content->from_checksum) != 0)
+    {
+      bsdiff_index_cache_clear (index_cache);
+
+      g_autoptr (GBytes) tmp_from = NULL;
+      if (!get_unpacked_unlinked_content (repo, bsdiff_content->from_checksum, &tmp_from,
+                                          cancellable, error))
+        return FALSE;
+      index_cache->index = _ostree_bsdiff_index_new (tmp_from, error);
+      if (!index_cache->index)
+        return FALSE;
+      index_cache->from_checksum = g_strdup (bsdiff_content->from_checksum);
+    }
+  else
+    builder->n_bsdiff_index_reused++;
+
   g_autoptr (GBytes) tmp_to = NULL;
   if (!get_unpacked_unlinked_content (repo, to_checksum, &tmp_to, cancellable, error))
     return FALSE;
 
-  gsize tmp_to_len;
-  const guint8 *tmp_to_buf = g_bytes_get_data (tmp_to, &tmp_to_len);
-  gsize tmp_from_len;
-  const guint8 *tmp_from_buf = g_bytes_get_data (tmp_from, &tmp_from_len);
+  gsize tmp_to_len = g_bytes_get_size (tmp_to);
 
   g_autoptr (GFileInfo) content_finfo = NULL;
   g_autoptr (GVariant) content_xattrs = NULL;
@@ -823,23 +931,12 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
     _ostree_write_varuint64 (current_part->operations, content_size);
 
     {
-      struct bsdiff_stream stream;
-      struct bzdiff_opaque_s op;
-      const gchar *payload;
-      gssize payload_size;
-      g_autoptr (GOutputStream) out = g_memory_output_stream_new_resizable ();
-      stream.malloc = malloc;
-      stream.free = free;
-      stream.write = bzdiff_write;
-      op.out = out;
-      op.cancellable = cancellable;
-      op.error = error;
-      stream.opaque = &op;
-      if (bsdiff (tmp_from_buf, tmp_from_len, tmp_to_buf, tmp_to_len, &stream) < 0)
-        return glnx_throw (error, "bsdiff generation failed");
-
-      payload = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (out));
-      payload_size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (out));
+      g_autoptr (GBytes) patch = _ostree_bsdiff_index_diff (index_cache->index, tmp_to, error);
+      if (!patch)
+        return FALSE;
+
+      gsize payload_size;
+      const gchar *payload = g_bytes_get_data (patch, &payload_size);
 
       g_string_append_c (current_part->operations, (gchar)OSTREE_STATIC_DELTA_OP_BSPATCH);
       _ostree_write_varuint64 (current_part->operations, current_part->payload->len);
@@ -852,8 +949,8 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
        * hard/messy as it's quite optimized for execution now.
        */
 #if 0
-      g_printerr ("bspatch %s [%llu] → %s [%llu] bsdiff:%llu (%f)\n",
-                  bsdiff_content->from_checksum, (unsigned long long)tmp_from_len,
+      g_printerr ("bspatch %s → %s [%llu] bsdiff:%llu (%f)\n",
+                  bsdiff_content->from_checksum,
                   to_checksum, (unsigned long long)tmp_to_len,
                   (unsigned long long)payload_size,
                   ((double)payload_size)/tmp_to_len);
@@ -869,6 +966,21 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
   return TRUE;
 }
 
+static gint
+compare_bsdiff_targets (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  GHashTable *bsdiffs = user_data;
+  const char *to_a = *(const char **)a;
+  const char *to_b = *(const char **)b;
+  ContentBsdiff *bsdiff_a = g_hash_table_lookup (bsdiffs, to_a);
+  ContentBsdiff *bsdiff_b = g_hash_table_lookup (bsdiffs, to_b);
+
+  int r = strcmp (bsdiff_a->from_checksum, bsdiff_b->from_checksum);
+  if (r != 0)
+    return r;
+  return strcmp (to_a, to_b);
+}
+
 static gboolean
 check_object_world_readable (OstreeRepo *repo, const char *checksum, gboolean *out_readable,
                              GCancellable *cancellable, GError **error)
@@ -1027,8 +1139,8 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
 
       if (!(opts & DELTAOPT_FLAG_DISABLE_BSDIFF))
         {
-          if (!try_content_bsdiff (repo, from_checksum, to_checksum, &bsdiff,
-                                   builder->max_bsdiff_size_bytes, cancellable, error))
+          if (!try_content_bsdiff (repo, builder, from_checksum, to_checksum, &bsdiff,
+                                   cancellable, error))
             return FALSE;
 
           if (bsdiff)
@@ -1082,17 +1194,28 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
   if (n_bsdiff > 0)
     {
       const guint mod = n_bsdiff / 10;
+      g_auto (BsdiffIndexCache) index_cache = {
+        0,
+      };
+
+      /* Group the targets by source so that each source is indexed once */
+      g_autoptr (GPtrArray) bsdiff_targets = g_ptr_array_new ();
       g_hash_table_iter_init (&hashiter, bsdiff_optimized_content_objects);
       while (g_hash_table_iter_next (&hashiter, &key, &value))
+        g_ptr_array_add (bsdiff_targets, key);
+      g_ptr_array_sort_with_data (bsdiff_targets, compare_bsdiff_targets,
+                                  bsdiff_optimized_content_objects);
+
+      for (guint i = 0; i < bsdiff_targets->len; i++)
         {
-          const char *checksum = key;
-          ContentBsdiff *bsdiff = value;
+          const char *checksum = bsdiff_targets->pdata[i];
+          ContentBsdiff *bsdiff = g_hash_table_lookup (bsdiff_optimized_content_objects, checksum);
 
           if (opts & DELTAOPT_FLAG_VERBOSE && (mod == 0 || builder->n_bsdiff % mod == 0))
             g_printerr ("processing bsdiff: [%u/%u]\n", builder->n_bsdiff, n_bsdiff);
 
-          if (!process_one_bsdiff (repo, builder, &current_part, checksum, bsdiff, cancellable,
-                                   error))
+          if (!process_one_bsdiff (repo, builder, &current_part, checksum, bsdiff, &index_cache,
+                                   cancellable, error))
             return FALSE;
 
           builder->n_bsdiff++;
@@ -1238,10 +1361,22 @@ get_fallback_headers (OstreeRepo *self, OstreeStaticDeltaBuilder *builder, GVari
  *   - min-fallback-size: u: Minimum uncompressed size in megabytes to use fallback, 0 to disable
  * fallbacks
  *   - max-chunk-size: u: Maximum size in megabytes of a delta part
- *   - max-bsdiff-size: u: Maximum size in megabytes to consider bsdiff compression
- *   for input files
- *   - compression: y: Compression type: 0=none, x=lzma, g=gzip
+ *   - max-bsdiff-size: u: Maximum combined size in megabytes of input files to consider bsdiff
+ *   compression, 0 for no limit.  Default 0.
+ *   - max-bsdiff-memory: u: Maximum memory in megabytes to use computing a single bsdiff;
+ *   larger files are shipped whole.  Default 1024.
+ *   - compression: y: Compression type: 0=none, x=lzma, z=zstd, a=automatic (choose zstd or
+ *   lzma for each part).  Default x.  Clients need zstd support to apply parts using zstd.
+ *   - lzma-threads: u: Number of threads compressing each part, 0 for one per CPU.  Fewer are
+ *   used if the encoder would need more than a quarter of the physical memory.  Default 1.
+ *   - lzma-block-size: u: Size in megabytes of the independently compressed blocks of a part
+ *   when using more than one thread.  Default is the chunk size divided by the thread count.
+ *   - zstd-level: i: zstd compression level.  Default 19.
+ *   - zstd-max-overhead: u: With automatic compression, use zstd for a part if it is at most
+ *   this many percent larger than with lzma.  Default 10.
  *   - bsdiff-enabled: b: Enable bsdiff compression.  Default TRUE.
+ *   - rollsum-bupsplit: b: Split files for rollsum matching at the same places as versions
+ *   before 2025.2, rather than with the faster gear hash.  Default FALSE.
  *   - inline-parts: b: Put part data in header, to get a single file delta.  Default FALSE.
  *   - verbose: b: Print diagnostic messages.  Default FALSE.
  *   - endianness: b: Deltas use host byte order by default; this option allows choosing
@@ -1262,6 +1397,7 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
   guint i;
   guint min_fallback_size;
   guint max_bsdiff_size;
+  guint max_bsdiff_memory;
   guint max_chunk_size;
   DeltaOpts delta_opts = DELTAOPT_FLAG_NONE;
   guint64 total_compressed_size = 0;
@@ -1290,12 +1426,51 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
   builder.min_fallback_size_bytes = ((guint64)min_fallback_size) * 1000 * 1000;
 
   if (!g_variant_lookup (params, "max-bsdiff-size", "u", &max_bsdiff_size))
-    max_bsdiff_size = 128;
+    max_bsdiff_size = 0;
   builder.max_bsdiff_size_bytes = ((guint64)max_bsdiff_size) * 1000 * 1000;
+  if (!g_variant_lookup (params, "max-bsdiff-memory", "u", &max_bsdiff_memory))
+    max_bsdiff_memory = 1024;
+  builder.max_bsdiff_memory_bytes = ((guint64)max_bsdiff_memory) * 1000 * 1000;
   if (!g_variant_lookup (params, "max-chunk-size", "u", &max_chunk_size))
     max_chunk_size = 32;
   builder.max_chunk_size_bytes = ((guint64)max_chunk_size) * 1000 * 1000;
 
+  guint lzma_threads;
+  if (!g_variant_lookup (params, "lzma-threads", "u", &lzma_threads))
+    lzma_threads = 1;
+  /* Resolve this here rather than in the compressor, as the default block
+   * size depends on it */
+  if (lzma_threads == 0)
+    lzma_threads = g_get_num_processors ();
+  builder.lzma_threads = lzma_threads;
+  guint lzma_block_size;
+  if (g_variant_lookup (params, "lzma-block-size", "u", &lzma_block_size))
+    builder.lzma_block_size_bytes = ((guint64)lzma_block_size) * 1000 * 1000;
+  else if (lzma_threads > 1)
+    /* Enough blocks to give each thread a share of a full part */
+    builder.lzma_block_size_bytes = MAX (builder.max_chunk_size_bytes / lzma_threads, 1000 * 1000);
+
+  if (!g_variant_lookup (params, "compression", "y", &builder.compression))
+    builder.compression = 'x';
+  switch (builder.compression)
+    {
+    case 0:
+    case 'x':
+      break;
+    case 'z':
+    case 'a':
+#ifndef HAVE_ZSTD
+      return glnx_throw (error, "zstd compression is not supported in this build");
+#endif
+      break;
+    default:
+      return glnx_throw (error, "Invalid compression type '%u'", builder.compression);
+    }
+  if (!g_variant_lookup (params, "zstd-level", "i", &builder.zstd_level))
+    builder.zstd_level = 19;
+  if (!g_variant_lookup (params, "zstd-max-overhead", "u", &builder.zstd_max_overhead))
+    builder.zstd_max_overhead = 10;
+
   (void)g_variant_lookup (params, "endianness", "u", &endianness);
   if (!(endianness == G_BIG_ENDIAN || endianness == G_LITTLE_ENDIAN))
     return glnx_throw (error, "Invalid endianness parameter");
@@ -1312,6 +1487,14 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
       delta_opts |= DELTAOPT_FLAG_DISABLE_BSDIFF;
   }
 
+  {
+    gboolean rollsum_bupsplit;
+    if (!g_variant_lookup (params, "rollsum-bupsplit", "b", &rollsum_bupsplit))
+      rollsum_bupsplit = FALSE;
+    if (rollsum_bupsplit)
+      delta_opts |= DELTAOPT_FLAG_ROLLSUM_BUPSPLIT;
+  }
+
   {
     gboolean verbose;
     if (!g_variant_lookup (params, "verbose", "b", &verbose))
@@ -1420,6 +1603,27 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
       return FALSE;
   }
 
+  {
+    gboolean seen[G_MAXUINT8 + 1] = {
+      FALSE,
+    };
+    g_autoptr (GByteArray) comptypes = g_byte_array_new ();
+
+    for (i = 0; i < builder.parts->len; i++)
+      {
+        OstreeStaticDeltaPartBuilder *part_builder = builder.parts->pdata[i];
+        if (!seen[part_builder->compression_type])
+          {
+            seen[part_builder->compression_type] = TRUE;
+            g_byte_array_append (comptypes, &part_builder->compression_type, 1);
+          }
+      }
+    if (!ot_variant_builder_add (descriptor_builder, error, "{sv}",
+                                 OSTREE_STATIC_DELTA_META_COMPRESSION,
+                                 ot_gvariant_new_bytearray (comptypes->data, comptypes->len)))
+      return FALSE;
+  }
+
   part_headers = g_variant_builder_new (G_VARIANT_TYPE ("a" OSTREE_STATIC_DELTA_META_ENTRY_FORMAT));
   for (i = 0; i < builder.parts->len; i++)
     {
@@ -1509,7 +1713,8 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
                   total_uncompressed_size, total_compressed_size, builder.loose_compressed_size);
       g_printerr ("rollsum=%u objects, %" G_GUINT64_FORMAT " bytes\n", builder.n_rollsum,
                   builder.rollsum_size);
-      g_printerr ("bsdiff=%u objects\n", builder.n_bsdiff);
+      g_printerr ("bsdiff=%u objects (%u reusing an index)\n", builder.n_bsdiff,
+                  builder.n_bsdiff_index_reused);
     }
 
   if (opt_sign_name != NULL && opt_key_ids != NULL)
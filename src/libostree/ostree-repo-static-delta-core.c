@@ -25,6 +25,9 @@
 #include "ostree-lzma-decompressor.h"
 #include "ostree-repo-private.h"
 #include "ostree-repo-static-delta-private.h"
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-decompressor.h"
+#endif
 #include "otutil.h"
 #include <gio/gfiledescriptorbased.h>
 #include <gio/gunixinputstream.h>
@@ -697,8 +700,17 @@ _ostree_static_delta_part_open (GInputStream *part_in, GBytes *inline_part_bytes
 
       break;
     case 'x':
+#ifdef HAVE_ZSTD
+    case 'z':
+#endif
       {
-        g_autoptr (GConverter) decomp = (GConverter *)_ostree_lzma_decompressor_new ();
+        g_autoptr (GConverter) decomp = NULL;
+#ifdef HAVE_ZSTD
+        if (comptype == 'z')
+          decomp = (GConverter *)_ostree_zstd_decompressor_new ();
+        else
+#endif
+          decomp = (GConverter *)_ostree_lzma_decompressor_new ();
         g_autoptr (GInputStream) convin = g_converter_input_stream_new (source_in, decomp);
         g_autoptr (GBytes) buf = ot_map_anonymous_tmpfile_from_content (convin, cancellable, error);
         if (!buf)
@@ -708,6 +720,11 @@ _ostree_static_delta_part_open (GInputStream *part_in, GBytes *inline_part_bytes
             G_VARIANT_TYPE (OSTREE_STATIC_DELTA_PART_PAYLOAD_FORMAT_V0), buf, FALSE);
       }
       break;
+#ifndef HAVE_ZSTD
+    case 'z':
+      return glnx_throw (error, "Static delta part uses zstd compression, which is not supported "
+                                "in this build");
+#endif
     default:
       return glnx_throw (error, "Invalid compression type '%u'", comptype);
     }
@@ -899,6 +916,64 @@ _ostree_delta_needs_byteswap (GVariant *superblock)
     }
 }
 
+gboolean
+_ostree_delta_compression_supported (guint8 comptype)
+{
+  switch (comptype)
+    {
+    case 0:
+    case 'x':
+      return TRUE;
+#ifdef HAVE_ZSTD
+    case 'z':
+      return TRUE;
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+static const char *
+delta_compression_name (guint8 comptype)
+{
+  switch (comptype)
+    {
+    case 0:
+      return "none";
+    case 'x':
+      return "lzma";
+    case 'z':
+      return "zstd";
+    default:
+      return "unknown";
+    }
+}
+
+/* Check up front that all of the parts of the delta can be decompressed,
+ * so that pull can use plain object fetches instead.
+ */
+gboolean
+_ostree_delta_check_compression (GVariant *superblock, GError **error)
+{
+  g_autoptr (GVariant) delta_meta = g_variant_get_child_value (superblock, 0);
+  g_autoptr (GVariantDict) delta_metadict = g_variant_dict_new (delta_meta);
+  g_autoptr (GVariant) comptypes = g_variant_dict_lookup_value (
+      delta_metadict, OSTREE_STATIC_DELTA_META_COMPRESSION, G_VARIANT_TYPE_BYTESTRING);
+  if (!comptypes)
+    return TRUE;
+
+  gsize n_comptypes;
+  const guint8 *comptypes_buf = g_variant_get_fixed_array (comptypes, &n_comptypes, 1);
+  for (gsize i = 0; i < n_comptypes; i++)
+    {
+      if (!_ostree_delta_compression_supported (comptypes_buf[i]))
+        return glnx_throw (error, "Static delta uses unsupported compression type '%s'",
+                           delta_compression_name (comptypes_buf[i]));
+    }
+
+  return TRUE;
+}
+
 gboolean
 _ostree_repo_static_delta_delete (OstreeRepo *self, const char *delta_id, GCancellable *cancellable,
                                   GError **error)
@@ -1050,6 +1125,25 @@ _ostree_repo_static_delta_dump (OstreeRepo *self, const char *delta_id, GCancell
     g_print ("Endianness: %s\n", endianness_description);
   }
 
+  {
+    g_autoptr (GVariant) delta_meta = g_variant_get_child_value (delta_superblock, 0);
+    g_autoptr (GVariant) comptypes = g_variant_lookup_value (
+        delta_meta, OSTREE_STATIC_DELTA_META_COMPRESSION, G_VARIANT_TYPE_BYTESTRING);
+    if (comptypes && g_variant_n_children (comptypes) > 0)
+      {
+        gsize n_comptypes;
+        const guint8 *comptypes_buf = g_variant_get_fixed_array (comptypes, &n_comptypes, 1);
+        g_autoptr (GString) description = g_string_new ("");
+        for (gsize i = 0; i < n_comptypes; i++)
+          {
+            if (i > 0)
+              g_string_append (description, ", ");
+            g_string_append (description, delta_compression_name (comptypes_buf[i]));
+          }
+        g_print ("Compression: %s\n", description->str);
+      }
+  }
+
   guint64 ts;
   g_variant_get_child (delta_superblock, 1, "t", &ts);
   g_print ("Timestamp: %" G_GUINT64_FORMAT "\n", GUINT64_FROM_BE (ts));
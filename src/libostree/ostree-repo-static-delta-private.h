@@ -30,10 +30,17 @@ G_BEGIN_DECLS
 
 #define OSTREE_SUMMARY_STATIC_DELTAS "ostree.static-deltas"
 
+/* Superblock metadata key (ay) listing the compression types used by the
+ * parts, so clients can fall back to fetching objects rather than
+ * downloading parts they can't decompress.  Deltas predating zstd support
+ * lack it and only use lzma.
+ */
+#define OSTREE_STATIC_DELTA_META_COMPRESSION "ostree.delta-compression"
+
 /**
  * OSTREE_STATIC_DELTA_PART_PAYLOAD_FORMAT_V0:
  *
- *   y  compression type (0: none, 'x': lzma)
+ *   y  compression type (0: none, 'x': lzma, 'z': zstd)
  *   ---
  *   a(uuu) modes
  *   aa(ayay) xattrs
@@ -236,4 +243,8 @@ OstreeDeltaEndianness _ostree_delta_get_endianness (GVariant *superblock,
 
 gboolean _ostree_delta_needs_byteswap (GVariant *superblock);
 
+gboolean _ostree_delta_compression_supported (guint8 comptype);
+
+gboolean _ostree_delta_check_compression (GVariant *superblock, GError **error);
+
 G_END_DECLS
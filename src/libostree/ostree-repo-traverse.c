@@ -547,31 +547,44 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
       if (g_hash_table_contains (inout_reachable, key))
         break;
 
-      g_autoptr (GVariant) commit = NULL;
-      if (!ostree_repo_load_variant_if_exists (repo, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum,
-                                               &commit, error))
-        return FALSE;
-
-      /* Just return if the parent isn't found; we do expect most
-       * people to have partial repositories.
-       */
-      if (!commit)
-        break;
+      g_autofree char *parent = NULL;
+      if (commit_only)
+        {
+          /* Save time by walking the commit graph rather than loading each commit */
+          gboolean exists;
+          if (!ostree_repo_lookup_commit_graph (repo, commit_checksum, &exists, &parent, NULL,
+                                                NULL, cancellable, error))
+            return FALSE;
 
-      /* See if the commit is partial, if so it's not an error to lack objects */
-      OstreeRepoCommitState commitstate;
-      if (!ostree_repo_load_commit (repo, commit_checksum, NULL, &commitstate, error))
-        return FALSE;
+          /* Just return if the parent isn't found; we do expect most
+           * people to have partial repositories.
+           */
+          if (!exists)
+            break;
 
-      gboolean ignore_missing_dirs = FALSE;
-      if ((commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) != 0)
-        ignore_missing_dirs = TRUE;
+          g_hash_table_add (inout_reachable, g_variant_ref (key));
+        }
+      else
+        {
+          g_autoptr (GVariant) commit = NULL;
+          if (!ostree_repo_load_variant_if_exists (repo, OSTREE_OBJECT_TYPE_COMMIT,
+                                                   commit_checksum, &commit, error))
+            return FALSE;
 
-      g_hash_table_add (inout_reachable, g_variant_ref (key));
+          if (!commit)
+            break;
+
+          /* See if the commit is partial, if so it's not an error to lack objects */
+          OstreeRepoCommitState commitstate;
+          if (!ostree_repo_load_commit (repo, commit_checksum, NULL, &commitstate, error))
+            return FALSE;
+
+          gboolean ignore_missing_dirs = FALSE;
+          if ((commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) != 0)
+            ignore_missing_dirs = TRUE;
+
+          g_hash_table_add (inout_reachable, g_variant_ref (key));
 
-      /* Save time by skipping traversal of non-commit objects */
-      if (!commit_only)
-        {
           g_debug ("Traversing commit %s", commit_checksum);
           ostree_cleanup_repo_commit_traverse_iter OstreeRepoCommitTraverseIter iter = {
             0,
@@ -583,20 +596,19 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
           if (!traverse_iter (repo, &iter, key, inout_reachable, inout_parents, ignore_missing_dirs,
                               cancellable, error))
             return FALSE;
+
+          parent = ostree_commit_get_parent (commit);
         }
 
       gboolean recurse = FALSE;
-      if (maxdepth == -1 || maxdepth > 0)
+      if ((maxdepth == -1 || maxdepth > 0) && parent != NULL)
         {
           g_free (tmp_checksum);
-          tmp_checksum = ostree_commit_get_parent (commit);
-          if (tmp_checksum)
-            {
-              commit_checksum = tmp_checksum;
-              if (maxdepth > 0)
-                maxdepth -= 1;
-              recurse = TRUE;
-            }
+          tmp_checksum = g_steal_pointer (&parent);
+          commit_checksum = tmp_checksum;
+          if (maxdepth > 0)
+            maxdepth -= 1;
+          recurse = TRUE;
         }
       if (!recurse)
         break;
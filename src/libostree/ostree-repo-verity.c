@@ -245,3 +245,431 @@ _ostree_ensure_fsverity (OstreeRepo *self, gboolean allow_enoent, int dirfd, con
 
   return TRUE;
 }
+
+/* The fs-verity digest index maps content object checksums to the
+ * fs-verity digest of their content, so that composefs images can be
+ * generated at deploy time without reading every object when the
+ * repository filesystem lacks fs-verity.  It lives in the repo cache
+ * directory and is purely an optimization: digests measured by the kernel
+ * always take precedence, it is never used for commit metadata, which may
+ * be signed, and anything invalid is ignored.
+ *
+ * A record is the binary object checksum and the binary SHA-256 fs-verity
+ * digest (4096 byte blocks, no salt; see _ostree_fsverity_enable()).  The
+ * main file is a magic, records sorted by checksum, and the SHA-256 of
+ * everything before it.  New records are appended to a journal, each
+ * followed by its own SHA-256, and only merged into the main file once
+ * the journal has grown to FSVERITY_INDEX_JOURNAL_MAX records, so that a
+ * transaction doesn't rewrite the whole index.  Neither file is synced.
+ */
+#define FSVERITY_INDEX_MAGIC "OSTFSV02"
+#define FSVERITY_INDEX_MAGIC_LEN 8
+#define FSVERITY_INDEX_RECORD_SIZE (2 * OSTREE_SHA256_DIGEST_LEN)
+#define FSVERITY_INDEX_JOURNAL_RECORD_SIZE (FSVERITY_INDEX_RECORD_SIZE + OSTREE_SHA256_DIGEST_LEN)
+#define FSVERITY_INDEX_JOURNAL_MAX 4096
+
+struct _OstreeFsverityIndex
+{
+  /* Sorted records of the main file, may be %NULL */
+  GBytes *records;
+  /* Object checksum -> digest, from the journal */
+  GHashTable *journal;
+};
+
+void
+_ostree_fsverity_index_free (OstreeFsverityIndex *index)
+{
+  g_clear_pointer (&index->records, g_bytes_unref);
+  g_clear_pointer (&index->journal, g_hash_table_unref);
+  g_free (index);
+}
+
+static int
+compare_fsverity_index_record (const void *a, const void *b)
+{
+  return memcmp (a, b, OSTREE_SHA256_DIGEST_LEN);
+}
+
+static void
+sha256_digest (const guint8 *buf, gsize len, guint8 *out_digest)
+{
+  g_auto (OtChecksum) hasher = {
+    0,
+  };
+  ot_checksum_init (&hasher);
+  ot_checksum_update (&hasher, buf, len);
+  ot_checksum_get_digest (&hasher, out_digest, OSTREE_SHA256_DIGEST_LEN);
+}
+
+/* Record the fs-verity digest of content object @checksum, to be written
+ * to the index by _ostree_repo_flush_fsverity_index().
+ */
+void
+_ostree_repo_note_fsverity_digest (OstreeRepo *self, const char *checksum, const guint8 *digest)
+{
+  if (self->cache_dir_fd == -1)
+    return;
+
+  g_mutex_lock (&self->txn_lock);
+  if (self->pending_fsverity_digests == NULL)
+    self->pending_fsverity_digests
+        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_replace (self->pending_fsverity_digests, g_strdup (checksum),
+                        g_memdup2 (digest, OSTREE_SHA256_DIGEST_LEN));
+  g_mutex_unlock (&self->txn_lock);
+}
+
+/* Like _ostree_repo_note_fsverity_digest(), but ask the kernel for the
+ * digest of @fd, if it has fs-verity enabled.
+ */
+void
+_ostree_repo_note_fsverity_digest_from_fd (OstreeRepo *self, const char *checksum, int fd)
+{
+#ifdef HAVE_LINUX_FSVERITY_H
+  union
+  {
+    struct fsverity_digest d;
+    char buf[sizeof (struct fsverity_digest) + OSTREE_SHA256_DIGEST_LEN];
+  } result;
+
+  if (self->cache_dir_fd == -1 || self->fs_verity_wanted == _OSTREE_FEATURE_NO)
+    return;
+
+  result.d.digest_size = OSTREE_SHA256_DIGEST_LEN;
+  if (ioctl (fd, FS_IOC_MEASURE_VERITY, &result) == 0
+      && result.d.digest_size == OSTREE_SHA256_DIGEST_LEN
+      && result.d.digest_algorithm == FS_VERITY_HASH_ALG_SHA256)
+    _ostree_repo_note_fsverity_digest (self, checksum, result.d.digest);
+#endif
+}
+
+/* Read @path in the cache directory, setting @out_bytes to %NULL if it
+ * doesn't exist.
+ */
+static gboolean
+load_cache_file (OstreeRepo *self, const char *path, GBytes **out_bytes, GError **error)
+{
+  *out_bytes = NULL;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, path, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  *out_bytes = ot_fd_readall_or_mmap (fd, 0, error);
+  return *out_bytes != NULL;
+}
+
+static GBytes *
+load_fsverity_index_records (OstreeRepo *self, GError **error)
+{
+  g_autoptr (GBytes) bytes = NULL;
+  if (!load_cache_file (self, _OSTREE_FSVERITY_INDEX, &bytes, error))
+    return NULL;
+  if (bytes == NULL)
+    return g_bytes_new (NULL, 0);
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (bytes, &len);
+  gboolean valid = len >= FSVERITY_INDEX_MAGIC_LEN + OSTREE_SHA256_DIGEST_LEN
+                   && memcmp (buf, FSVERITY_INDEX_MAGIC, FSVERITY_INDEX_MAGIC_LEN) == 0;
+  if (valid)
+    {
+      len -= OSTREE_SHA256_DIGEST_LEN;
+      guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+      sha256_digest (buf, len, digest);
+      valid = (len - FSVERITY_INDEX_MAGIC_LEN) % FSVERITY_INDEX_RECORD_SIZE == 0
+              && memcmp (digest, buf + len, sizeof (digest)) == 0;
+    }
+  if (!valid)
+    {
+      g_debug ("Ignoring invalid fs-verity digest index");
+      (void)unlinkat (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX, 0);
+      return g_bytes_new (NULL, 0);
+    }
+
+  return g_bytes_new_from_bytes (bytes, FSVERITY_INDEX_MAGIC_LEN, len - FSVERITY_INDEX_MAGIC_LEN);
+}
+
+/* Load the valid records of the journal; a trailing partial record is from
+ * an interrupted or concurrent append.
+ */
+static GHashTable *
+load_fsverity_index_journal (OstreeRepo *self, GError **error)
+{
+  g_autoptr (GHashTable) journal
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_autoptr (GBytes) bytes = NULL;
+  if (!load_cache_file (self, _OSTREE_FSVERITY_INDEX_JOURNAL, &bytes, error))
+    return NULL;
+  if (bytes == NULL)
+    return g_steal_pointer (&journal);
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (bytes, &len);
+  for (gsize off = 0; off + FSVERITY_INDEX_JOURNAL_RECORD_SIZE <= len;
+       off += FSVERITY_INDEX_JOURNAL_RECORD_SIZE)
+    {
+      const guint8 *record = buf + off;
+      guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+      sha256_digest (record, FSVERITY_INDEX_RECORD_SIZE, digest);
+      if (memcmp (digest, record + FSVERITY_INDEX_RECORD_SIZE, sizeof (digest)) != 0)
+        {
+          g_debug ("Ignoring invalid fs-verity digest index journal record");
+          continue;
+        }
+
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (record, checksum);
+      g_hash_table_replace (
+          journal, g_strdup (checksum),
+          g_memdup2 (record + OSTREE_SHA256_DIGEST_LEN, OSTREE_SHA256_DIGEST_LEN));
+    }
+
+  return g_steal_pointer (&journal);
+}
+
+/* Load the index; sets @out_index to %NULL if the repository has no cache
+ * directory.
+ */
+gboolean
+_ostree_repo_load_fsverity_index (OstreeRepo *self, OstreeFsverityIndex **out_index,
+                                  GError **error)
+{
+  *out_index = NULL;
+
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_autoptr (OstreeFsverityIndex) index = g_new0 (OstreeFsverityIndex, 1);
+  index->records = load_fsverity_index_records (self, error);
+  if (!index->records)
+    return FALSE;
+  index->journal = load_fsverity_index_journal (self, error);
+  if (!index->journal)
+    return FALSE;
+
+  *out_index = g_steal_pointer (&index);
+  return TRUE;
+}
+
+/* Look up @checksum in @index, which may be %NULL. */
+gboolean
+_ostree_fsverity_index_lookup (OstreeFsverityIndex *index, const char *checksum,
+                               guint8 *out_digest)
+{
+  if (index == NULL)
+    return FALSE;
+
+  const guint8 *journal_digest = g_hash_table_lookup (index->journal, checksum);
+  if (journal_digest)
+    {
+      memcpy (out_digest, journal_digest, OSTREE_SHA256_DIGEST_LEN);
+      return TRUE;
+    }
+
+  guint8 key[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, key);
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (index->records, &len);
+  const guint8 *record = bsearch (key, buf, len / FSVERITY_INDEX_RECORD_SIZE,
+                                  FSVERITY_INDEX_RECORD_SIZE, compare_fsverity_index_record);
+  if (record == NULL)
+    return FALSE;
+
+  memcpy (out_digest, record + OSTREE_SHA256_DIGEST_LEN, OSTREE_SHA256_DIGEST_LEN);
+  return TRUE;
+}
+
+/* Merge the journal into the main file, and remove it.  Records appended
+ * concurrently may be lost, which only costs recomputation later.
+ */
+static gboolean
+merge_fsverity_index_journal (OstreeRepo *self, GError **error)
+{
+  g_autoptr (OstreeFsverityIndex) index = NULL;
+  if (!_ostree_repo_load_fsverity_index (self, &index, error))
+    return FALSE;
+
+  const guint n_new = g_hash_table_size (index->journal);
+  g_autofree guint8 *new_records = g_malloc (n_new * FSVERITY_INDEX_RECORD_SIZE);
+  guint8 *p = new_records;
+  GLNX_HASH_TABLE_FOREACH_KV (index->journal, const char *, checksum, const guint8 *, digest)
+    {
+      ostree_checksum_inplace_to_bytes (checksum, p);
+      memcpy (p + OSTREE_SHA256_DIGEST_LEN, digest, OSTREE_SHA256_DIGEST_LEN);
+      p += FSVERITY_INDEX_RECORD_SIZE;
+    }
+  qsort (new_records, n_new, FSVERITY_INDEX_RECORD_SIZE, compare_fsverity_index_record);
+
+  gsize old_len;
+  const guint8 *old_records = g_bytes_get_data (index->records, &old_len);
+  const gsize new_len = n_new * FSVERITY_INDEX_RECORD_SIZE;
+
+  /* Merge the two sorted lists; journal entries win, though for a given
+   * checksum they can only differ if the index was corrupted.
+   */
+  g_autoptr (GByteArray) buf = g_byte_array_sized_new (
+      FSVERITY_INDEX_MAGIC_LEN + old_len + new_len + OSTREE_SHA256_DIGEST_LEN);
+  g_byte_array_append (buf, (const guint8 *)FSVERITY_INDEX_MAGIC, FSVERITY_INDEX_MAGIC_LEN);
+  gsize i = 0, j = 0;
+  while (i < old_len || j < new_len)
+    {
+      const guint8 *record;
+      int c;
+      if (i == old_len)
+        c = 1;
+      else if (j == new_len)
+        c = -1;
+      else
+        c = compare_fsverity_index_record (old_records + i, new_records + j);
+      if (c < 0)
+        {
+          record = old_records + i;
+          i += FSVERITY_INDEX_RECORD_SIZE;
+        }
+      else
+        {
+          record = new_records + j;
+          j += FSVERITY_INDEX_RECORD_SIZE;
+          if (c == 0)
+            i += FSVERITY_INDEX_RECORD_SIZE;
+        }
+      g_byte_array_append (buf, record, FSVERITY_INDEX_RECORD_SIZE);
+    }
+  guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+  sha256_digest (buf->data, buf->len, digest);
+  g_byte_array_append (buf, digest, sizeof (digest));
+
+  if (!glnx_file_replace_contents_at (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX, buf->data,
+                                      buf->len, GLNX_FILE_REPLACE_NODATASYNC, NULL, error))
+    return FALSE;
+  if (!ot_ensure_unlinked_at (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX_JOURNAL, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+flush_fsverity_index (OstreeRepo *self, GHashTable *pending, GError **error)
+{
+  g_autoptr (GByteArray) buf
+      = g_byte_array_sized_new (g_hash_table_size (pending) * FSVERITY_INDEX_JOURNAL_RECORD_SIZE);
+  GLNX_HASH_TABLE_FOREACH_KV (pending, const char *, checksum, const guint8 *, digest)
+    {
+      guint8 record[FSVERITY_INDEX_JOURNAL_RECORD_SIZE];
+      ostree_checksum_inplace_to_bytes (checksum, record);
+      memcpy (record + OSTREE_SHA256_DIGEST_LEN, digest, OSTREE_SHA256_DIGEST_LEN);
+      sha256_digest (record, FSVERITY_INDEX_RECORD_SIZE, record + FSVERITY_INDEX_RECORD_SIZE);
+      g_byte_array_append (buf, record, sizeof (record));
+    }
+
+  /* A single append, so that concurrent writers don't interleave records */
+  glnx_autofd int fd = openat (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX_JOURNAL,
+                               O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return glnx_throw_errno_prefix (error, "openat(%s)", _OSTREE_FSVERITY_INDEX_JOURNAL);
+  if (glnx_loop_write (fd, buf->data, buf->len) < 0)
+    return glnx_throw_errno_prefix (error, "write(%s)", _OSTREE_FSVERITY_INDEX_JOURNAL);
+
+  struct stat stbuf;
+  if (!glnx_fstat (fd, &stbuf, error))
+    return FALSE;
+  if (stbuf.st_size / FSVERITY_INDEX_JOURNAL_RECORD_SIZE >= FSVERITY_INDEX_JOURNAL_MAX)
+    return merge_fsverity_index_journal (self, error);
+
+  return TRUE;
+}
+
+/* Append any digests noted since the last flush to the index journal.
+ * Errors are logged and otherwise ignored.
+ */
+void
+_ostree_repo_flush_fsverity_index (OstreeRepo *self)
+{
+  g_mutex_lock (&self->txn_lock);
+  g_autoptr (GHashTable) pending = g_steal_pointer (&self->pending_fsverity_digests);
+  g_mutex_unlock (&self->txn_lock);
+
+  if (pending == NULL || self->cache_dir_fd == -1)
+    return;
+
+  g_autoptr (GError) local_error = NULL;
+  if (!flush_fsverity_index (self, pending, &local_error))
+    g_debug ("Failed to update fs-verity digest index: %s", local_error->message);
+}
+
+/* Remove the index, e.g. after finding a wrong digest in it */
+gboolean
+_ostree_repo_drop_fsverity_index (OstreeRepo *self, GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  if (!ot_ensure_unlinked_at (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX, error))
+    return FALSE;
+  if (!ot_ensure_unlinked_at (self->cache_dir_fd, _OSTREE_FSVERITY_INDEX_JOURNAL, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/**
+ * ostree_repo_lookup_fsverity_digests:
+ * @self: Repo
+ * @checksums: (array zero-terminated=1): Checksums of content objects
+ * @out_digests: (out) (transfer full) (element-type utf8 GBytes): Map from checksum to digest
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Look up the fs-verity digests of the given content objects in the
+ * repository's digest index, without opening the objects themselves.
+ * The digests use SHA-256 with 4096 byte blocks and no salt, as used
+ * by composefs.
+ *
+ * The index is updated when content objects are written with fs-verity
+ * enabled, and when composefs images are generated; it is a cache and
+ * may be incomplete.  Objects which are not found are omitted from
+ * @out_digests.  As the index is not authenticated, prefer measuring the
+ * objects for anything security sensitive.
+ *
+ * Since: 2025.2
+ */
+gboolean
+ostree_repo_lookup_fsverity_digests (OstreeRepo *self, const char *const *checksums,
+                                     GHashTable **out_digests, GCancellable *cancellable,
+                                     GError **error)
+{
+  g_autoptr (OstreeFsverityIndex) index = NULL;
+  if (!_ostree_repo_load_fsverity_index (self, &index, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) ret_digests
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+
+  g_mutex_lock (&self->txn_lock);
+  for (const char *const *it = checksums; it && *it; it++)
+    {
+      const char *checksum = *it;
+      if (!ostree_validate_checksum_string (checksum, NULL))
+        continue;
+
+      guint8 digest[OSTREE_SHA256_DIGEST_LEN];
+      const guint8 *pending = self->pending_fsverity_digests
+                                  ? g_hash_table_lookup (self->pending_fsverity_digests, checksum)
+                                  : NULL;
+      if (pending)
+        memcpy (digest, pending, sizeof (digest));
+      else if (!_ostree_fsverity_index_lookup (index, checksum, digest))
+        continue;
+
+      g_hash_table_replace (ret_digests, g_strdup (checksum),
+                            g_bytes_new (digest, sizeof (digest)));
+    }
+  g_mutex_unlock (&self->txn_lock);
+
+  ot_transfer_out_value (out_digests, &ret_digests);
+  return TRUE;
+}
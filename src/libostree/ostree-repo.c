@@ -34,6 +34,7 @@
 #include <linux/magic.h>
 
 #include "ostree-autocleanups.h"
+#include "ostree-bloom-private.h"
 #include "ostree-core-private.h"
 #include "ostree-gpg-verifier.h"
 #include "ostree-remote-private.h"
@@ -1134,6 +1135,97 @@ ostree_repo_get_remote_boolean_option (OstreeRepo *self, const char *remote_name
   return ret;
 }
 
+/* Upper bound on the total size of the variants in the metadata cache */
+#define METADATA_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct
+{
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+  OstreeObjectType objtype;
+  GVariant *variant;
+} OstreeRepoMetadataCacheEntry;
+
+static void
+metadata_cache_entry_free (OstreeRepoMetadataCacheEntry *entry)
+{
+  g_variant_unref (entry->variant);
+  g_free (entry);
+}
+
+/* Returns a new reference to the cached @objtype object @checksum, or %NULL,
+ * marking it as the most recently used one. */
+static GVariant *
+metadata_cache_lookup (OstreeRepo *self, OstreeObjectType objtype, const char *checksum)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->cache_lock);
+  GList *link = g_hash_table_lookup (self->metadata_cache, checksum);
+  OstreeRepoMetadataCacheEntry *entry = link ? link->data : NULL;
+
+  if (entry == NULL || entry->objtype != objtype)
+    {
+      self->metadata_cache_misses++;
+      return NULL;
+    }
+
+  self->metadata_cache_hits++;
+  g_queue_unlink (&self->metadata_cache_lru, link);
+  g_queue_push_head_link (&self->metadata_cache_lru, link);
+  return g_variant_ref (entry->variant);
+}
+
+/* Removes the least recently used entry from the metadata cache */
+static void
+metadata_cache_evict_one (OstreeRepo *self)
+{
+  OstreeRepoMetadataCacheEntry *entry = g_queue_pop_tail (&self->metadata_cache_lru);
+
+  g_hash_table_remove (self->metadata_cache, entry->checksum);
+  self->metadata_cache_size -= g_variant_get_size (entry->variant);
+  metadata_cache_entry_free (entry);
+}
+
+static void
+metadata_cache_insert (OstreeRepo *self, OstreeObjectType objtype, const char *checksum,
+                       GVariant *variant)
+{
+  const gsize size = g_variant_get_size (variant);
+
+  if (size > METADATA_CACHE_MAX_SIZE / 4)
+    return;
+
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->cache_lock);
+  /* Another thread may have raced with us to load it */
+  if (g_hash_table_contains (self->metadata_cache, checksum))
+    return;
+
+  while (self->metadata_cache_size + size > METADATA_CACHE_MAX_SIZE)
+    metadata_cache_evict_one (self);
+
+  OstreeRepoMetadataCacheEntry *entry = g_new0 (OstreeRepoMetadataCacheEntry, 1);
+  memcpy (entry->checksum, checksum, OSTREE_SHA256_STRING_LEN);
+  entry->objtype = objtype;
+  entry->variant = g_variant_ref (variant);
+  g_queue_push_head (&self->metadata_cache_lru, entry);
+  g_hash_table_insert (self->metadata_cache, entry->checksum, self->metadata_cache_lru.head);
+  self->metadata_cache_size += size;
+}
+
+static void
+metadata_cache_remove (OstreeRepo *self, const char *checksum)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->cache_lock);
+  GList *link = g_hash_table_lookup (self->metadata_cache, checksum);
+
+  if (link == NULL)
+    return;
+
+  OstreeRepoMetadataCacheEntry *entry = link->data;
+  g_hash_table_remove (self->metadata_cache, checksum);
+  g_queue_delete_link (&self->metadata_cache_lru, link);
+  self->metadata_cache_size -= g_variant_get_size (entry->variant);
+  metadata_cache_entry_free (entry);
+}
+
 static void
 ostree_repo_finalize (GObject *object)
 {
@@ -1166,6 +1258,20 @@ ostree_repo_finalize (GObject *object)
   g_clear_error (&self->writable_error);
   g_clear_pointer (&self->object_sizes, g_hash_table_unref);
   g_clear_pointer (&self->dirmeta_cache, g_hash_table_unref);
+  if (self->uncompressed_cache_hits + self->uncompressed_cache_misses > 0)
+    g_debug ("uncompressed object cache: %u hits, %u misses", self->uncompressed_cache_hits,
+             self->uncompressed_cache_misses);
+  if (self->metadata_cache_hits + self->metadata_cache_misses > 0)
+    g_debug ("metadata cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses",
+             self->metadata_cache_hits, self->metadata_cache_misses);
+  g_clear_pointer (&self->metadata_cache, g_hash_table_unref);
+  g_clear_pointer (&self->verify_cache, g_hash_table_unref);
+  g_queue_clear_full (&self->metadata_cache_lru, (GDestroyNotify)metadata_cache_entry_free);
+  g_clear_pointer (&self->pending_fsverity_digests, g_hash_table_unref);
+  g_clear_pointer (&self->pending_commit_graph, g_hash_table_unref);
+  g_clear_pointer (&self->commit_graph, g_bytes_unref);
+  g_clear_pointer (&self->packed_refs_cache, g_hash_table_unref);
+  g_mutex_clear (&self->packed_refs_lock);
   g_mutex_clear (&self->cache_lock);
   g_mutex_clear (&self->txn_lock);
   g_free (self->collection_id);
@@ -1323,6 +1429,7 @@ ostree_repo_init (OstreeRepo *self)
 
   g_mutex_init (&self->lock.mutex);
   g_mutex_init (&self->cache_lock);
+  g_mutex_init (&self->packed_refs_lock);
   g_mutex_init (&self->txn_lock);
 
   self->remotes = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)NULL,
@@ -1331,6 +1438,9 @@ ostree_repo_init (OstreeRepo *self)
                                                    (GDestroyNotify)g_free);
   g_mutex_init (&self->remotes_lock);
 
+  self->metadata_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&self->metadata_cache_lru);
+
   self->repo_dir_fd = -1;
   self->cache_dir_fd = -1;
   self->tmp_dir_fd = -1;
@@ -2940,9 +3050,9 @@ min_free_space_calculate_reserved_bytes (OstreeRepo *self, guint64 *bytes, GErro
   return TRUE;
 }
 
+/* Parse a size of the form '123MB', '123GB' or '123TB' into megabytes */
 static gboolean
-min_free_space_size_validate_and_convert (OstreeRepo *self, const char *min_free_space_size_str,
-                                          GError **error)
+parse_size_mb (const char *size_str, guint64 *out_mb, GError **error)
 {
   static GRegex *regex;
   static gsize regex_initialized;
@@ -2954,10 +3064,10 @@ min_free_space_size_validate_and_convert (OstreeRepo *self, const char *min_free
     }
 
   g_autoptr (GMatchInfo) match = NULL;
-  if (!g_regex_match (regex, min_free_space_size_str, 0, &match))
+  if (!g_regex_match (regex, size_str, 0, &match))
     return glnx_throw (error, "It should be of the format '123MB', '123GB' or '123TB'");
 
-  g_autofree char *size_str = g_match_info_fetch (match, 1);
+  g_autofree char *number_str = g_match_info_fetch (match, 1);
   g_autofree char *unit = g_match_info_fetch (match, 2);
   guint shifts;
 
@@ -2976,11 +3086,11 @@ min_free_space_size_validate_and_convert (OstreeRepo *self, const char *min_free
       g_assert_not_reached ();
     }
 
-  guint64 min_free_space = g_ascii_strtoull (size_str, NULL, 10);
-  if (shifts > 0 && g_bit_nth_lsf (min_free_space, 63 - shifts) != -1)
+  guint64 size = g_ascii_strtoull (number_str, NULL, 10);
+  if (shifts > 0 && g_bit_nth_lsf (size, 63 - shifts) != -1)
     return glnx_throw (error, "Value was too high");
 
-  self->min_free_space_mb = min_free_space << shifts;
+  *out_mb = size << shifts;
 
   return TRUE;
 }
@@ -3011,7 +3121,8 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
   if (!version)
     return FALSE;
 
-  if (strcmp (version, "1") != 0)
+  /* Version 2 is only needed for packed refs, which older versions can't read */
+  if (strcmp (version, "1") != 0 && strcmp (version, "2") != 0)
     return glnx_throw (error, "Invalid repository version '%s'", version);
 
   if (!ot_keyfile_get_boolean_with_default (self->config, "core", "archive", FALSE, &is_archive,
@@ -3039,6 +3150,19 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
   else
     self->enable_uncompressed_cache = FALSE;
 
+  {
+    g_autofree char *max_size_str = NULL;
+
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "uncompressed-cache-max-size",
+                                            NULL, &max_size_str, error))
+      return FALSE;
+
+    self->uncompressed_cache_max_mb = 0;
+    if (max_size_str != NULL
+        && !parse_size_mb (max_size_str, &self->uncompressed_cache_max_mb, error))
+      return glnx_prefix_error (error, "Invalid uncompressed-cache-max-size '%s'", max_size_str);
+  }
+
   {
     gboolean do_fsync;
 
@@ -3054,6 +3178,12 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
                                             &self->per_object_fsync, error))
     return FALSE;
 
+  if (!ot_keyfile_get_boolean_with_default (self->config, "core", "packed-refs", FALSE,
+                                            &self->packed_refs, error))
+    return FALSE;
+  if (self->packed_refs && strcmp (version, "2") != 0)
+    return glnx_throw (error, "core.packed-refs requires core.repo_version=2");
+
   /* See https://github.com/ostreedev/ostree/issues/758 */
   if (!ot_keyfile_get_boolean_with_default (self->config, "core", "disable-xattrs", FALSE,
                                             &self->disable_xattrs, error))
@@ -3107,6 +3237,36 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
       self->zlib_compression_level = OSTREE_ARCHIVE_DEFAULT_COMPRESSION_LEVEL;
   }
 
+  {
+    g_autofree char *archive_compression = NULL;
+    g_autofree char *zstd_level_str = NULL;
+
+    if (!ot_keyfile_get_value_with_default (self->config, "archive", "compression", "zlib",
+                                            &archive_compression, error))
+      return FALSE;
+    if (g_str_equal (archive_compression, "zstd"))
+      {
+#ifdef HAVE_ZSTD
+        self->archive_zstd = TRUE;
+#else
+        return glnx_throw (error, "Archive compression zstd is not supported in this build");
+#endif
+      }
+    else if (g_str_equal (archive_compression, "zlib"))
+      self->archive_zstd = FALSE;
+    else
+      return glnx_throw (error, "Invalid archive compression '%s'", archive_compression);
+
+    (void)ot_keyfile_get_value_with_default (self->config, "archive", "zstd-level", NULL,
+                                             &zstd_level_str, NULL);
+    if (zstd_level_str)
+      /* Ensure level is in [1,19]; higher levels need lots of memory */
+      self->zstd_compression_level
+          = MAX (1, MIN (19, g_ascii_strtoll (zstd_level_str, NULL, 10)));
+    else
+      self->zstd_compression_level = OSTREE_ARCHIVE_DEFAULT_ZSTD_LEVEL;
+  }
+
   {
     /* Try to parse both min-free-space-* config options first. If both are absent, fallback on 3%
      * free space. If both are present and are non-zero, use min-free-space-size unconditionally
@@ -3121,7 +3281,7 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
           return FALSE;
 
         /* Validate the string and convert the size to MBs */
-        if (!min_free_space_size_validate_and_convert (self, min_free_space_size_str, error))
+        if (!parse_size_mb (min_free_space_size_str, &self->min_free_space_mb, error))
           return glnx_prefix_error (error, "Invalid min-free-space-size '%s'",
                                     min_free_space_size_str);
       }
@@ -3861,10 +4021,25 @@ load_metadata_internal (OstreeRepo *self, OstreeObjectType objtype, const char *
         return TRUE;
     }
 
+  /* Walking commits through OstreeRepoFile or the traversal API loads the
+   * same dirtree and dirmeta objects over and over, so keep recently used
+   * ones in memory too.  Only objects in the main object store are cached,
+   * as staged ones go away if the transaction is aborted. */
+  const gboolean is_lru_cachable
+      = ((objtype == OSTREE_OBJECT_TYPE_DIR_TREE || objtype == OSTREE_OBJECT_TYPE_DIR_META)
+         && out_variant && !out_stream && !out_size);
+  if (is_lru_cachable)
+    {
+      *out_variant = metadata_cache_lookup (self, objtype, sha256);
+      if (*out_variant != NULL)
+        return TRUE;
+    }
+
   _ostree_loose_path (loose_path_buf, sha256, objtype, self->mode);
 
   if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
     return FALSE;
+  const gboolean in_objects_dir = (fd != -1);
 
   if (fd < 0 && self->commit_stagedir.initialized)
     {
@@ -3893,6 +4068,8 @@ load_metadata_internal (OstreeRepo *self, OstreeObjectType objtype, const char *
                                       g_variant_ref (ret_variant));
               g_mutex_unlock (lock);
             }
+          if (is_lru_cachable && in_objects_dir)
+            metadata_cache_insert (self, objtype, sha256, ret_variant);
         }
       else if (out_stream)
         {
@@ -4392,6 +4569,9 @@ ostree_repo_delete_object (OstreeRepo *self, OstreeObjectType objtype, const cha
     return glnx_prefix_error (error, "Deleting object %s.%s", sha256,
                               ostree_object_type_to_string (objtype));
 
+  if (objtype == OSTREE_OBJECT_TYPE_DIR_TREE || objtype == OSTREE_OBJECT_TYPE_DIR_META)
+    metadata_cache_remove (self, sha256);
+
   /* If the repository is configured to use tombstone commits, create one when deleting a commit.
    */
   if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
@@ -5540,6 +5720,22 @@ _ostree_repo_gpg_verify_with_metadata (OstreeRepo *self, GBytes *signed_data, GV
                                                 keyringdir, extra_keyring, cancellable, error);
 }
 
+/* Checksum the keyrings _ostree_repo_gpg_verify_with_metadata() uses for
+ * @remote_name, to identify its result in the verification cache.
+ */
+gboolean
+_ostree_repo_gpg_checksum_keyrings (OstreeRepo *self, const char *remote_name,
+                                    char **out_checksum, GCancellable *cancellable,
+                                    GError **error)
+{
+  g_autoptr (OstreeGpgVerifier) verifier = NULL;
+  if (!_ostree_repo_gpg_prepare_verifier (self, remote_name, NULL, NULL, TRUE, &verifier,
+                                          cancellable, error))
+    return FALSE;
+
+  return _ostree_gpg_verifier_checksum_keyrings (verifier, out_checksum, cancellable, error);
+}
+
 /* Needed an internal version for the remote_name parameter. */
 OstreeGpgVerifyResult *
 _ostree_repo_verify_commit_internal (OstreeRepo *self, const char *commit_checksum,
@@ -5786,6 +5982,79 @@ summary_add_ref_entry (OstreeRepo *self, const char *ref, const char *checksum,
   return TRUE;
 }
 
+/* If `core/objects-bloom` is set, build the bloom filter of content objects
+ * and static deltas which clients pulling with `stripe-mirrors` use to
+ * route requests to the mirrors which probably have each object.
+ * Otherwise, set @out_bloom to %NULL. */
+static gboolean
+build_objects_bloom (OstreeRepo *self, GVariant **out_bloom, GCancellable *cancellable,
+                     GError **error)
+{
+  gboolean enabled = FALSE;
+  if (!ot_keyfile_get_boolean_with_default (self->config, "core", "objects-bloom", FALSE, &enabled,
+                                            error))
+    return FALSE;
+  if (!enabled)
+    {
+      *out_bloom = NULL;
+      return TRUE;
+    }
+
+  double fp_rate = _OSTREE_OBJECTS_BLOOM_DEFAULT_FP_RATE;
+  g_autofree char *fp_rate_str = NULL;
+  if (!ot_keyfile_get_value_with_default (self->config, "core", "objects-bloom-fp-rate", NULL,
+                                          &fp_rate_str, error))
+    return FALSE;
+  if (fp_rate_str != NULL)
+    {
+      char *endp = NULL;
+      fp_rate = g_ascii_strtod (fp_rate_str, &endp);
+      if (*endp != '\0' || !(fp_rate > 0 && fp_rate < 1))
+        return glnx_throw (error, "Invalid core/objects-bloom-fp-rate '%s'", fp_rate_str);
+    }
+
+  g_autoptr (GHashTable) objects = NULL;
+  if (!ostree_repo_list_objects (self,
+                                 OSTREE_REPO_LIST_OBJECTS_ALL | OSTREE_REPO_LIST_OBJECTS_NO_PARENTS,
+                                 &objects, cancellable, error))
+    return FALSE;
+  g_autoptr (GPtrArray) delta_names = NULL;
+  if (!ostree_repo_list_static_delta_names (self, &delta_names, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GPtrArray) elements = g_ptr_array_new ();
+  GLNX_HASH_TABLE_FOREACH (objects, GVariant *, object)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype == OSTREE_OBJECT_TYPE_FILE)
+        g_ptr_array_add (elements, (char *)checksum);
+    }
+  for (guint i = 0; i < delta_names->len; i++)
+    g_ptr_array_add (elements, delta_names->pdata[i]);
+
+  /* An optimally sized filter with m bits for n elements, using
+   * k = (m / n) ln(2) hash functions, has a false positive rate of about
+   * 0.6185^(m / n); find the number of bits per element which meets
+   * @fp_rate. */
+  guint bits_per_element = 1;
+  for (double rate = 0.6185; rate > fp_rate && bits_per_element < 64; rate *= 0.6185)
+    bits_per_element++;
+  const guint8 k = MAX ((guint)(bits_per_element * G_LN2 + 0.5), 1);
+  const gsize n_bytes = ((gsize)MAX (elements->len, 1) * bits_per_element + 7) / 8;
+
+  g_autoptr (OstreeBloom) bloom = ostree_bloom_new (n_bytes, k, ostree_str_bloom_hash);
+  for (guint i = 0; i < elements->len; i++)
+    ostree_bloom_add_element (bloom, elements->pdata[i]);
+
+  g_autoptr (GBytes) bloom_bytes = ostree_bloom_seal (bloom);
+  *out_bloom = g_variant_ref_sink (
+      g_variant_new ("(yy@ay)", k, _OSTREE_OBJECTS_BLOOM_HASH_ID,
+                     g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, bloom_bytes, TRUE)));
+  return TRUE;
+}
+
 static gboolean
 regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *additional_metadata,
                      GVariant *options, GCancellable *cancellable, GError **error)
@@ -6068,6 +6337,10 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
   if (!ostree_repo_static_delta_reindex (self, 0, NULL, cancellable, error))
     return FALSE;
 
+  g_autoptr (GVariant) objects_bloom = NULL;
+  if (!build_objects_bloom (self, &objects_bloom, cancellable, error))
+    return FALSE;
+
   /* Create the summary and signature in a temporary directory so that
    * the summary isn't published without a matching signature.
    */
@@ -6109,6 +6382,19 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
         return glnx_throw_errno_prefix (error, "Unable to change summary timestamps");
     }
 
+  /* The objects bloom filter is only a hint, so it is fine to publish it
+   * before the summary. */
+  if (objects_bloom != NULL)
+    {
+      if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, _OSTREE_OBJECTS_BLOOM,
+                                               g_variant_get_data (objects_bloom),
+                                               g_variant_get_size (objects_bloom), cancellable,
+                                               error))
+        return FALSE;
+    }
+  else if (!ot_ensure_unlinked_at (self->repo_dir_fd, _OSTREE_OBJECTS_BLOOM, error))
+    return FALSE;
+
   /* Rename them into place */
   if (!glnx_renameat (summary_tmpdir.fd, "summary", self->repo_dir_fd, "summary", error))
     return glnx_prefix_error (error, "Unable to rename summary file: ");
@@ -447,6 +447,12 @@ _OSTREE_PUBLIC
 gboolean ostree_repo_load_commit (OstreeRepo *self, const char *checksum, GVariant **out_commit,
                                   OstreeRepoCommitState *out_state, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_repo_lookup_commit_graph (OstreeRepo *self, const char *checksum,
+                                          gboolean *out_exists, char **out_parent,
+                                          guint64 *out_timestamp, guint *out_generation,
+                                          GCancellable *cancellable, GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_repo_load_file (OstreeRepo *self, const char *checksum, GInputStream **out_input,
                                 GFileInfo **out_file_info, GVariant **out_xattrs,
@@ -845,6 +851,11 @@ gboolean ostree_repo_checkout_composefs (OstreeRepo *self, GVariant *options, in
                                          const char *destination_path, const char *checksum,
                                          GCancellable *cancellable, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_repo_lookup_fsverity_digests (OstreeRepo *self, const char *const *checksums,
+                                              GHashTable **out_digests, GCancellable *cancellable,
+                                              GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_repo_checkout_gc (OstreeRepo *self, GCancellable *cancellable, GError **error);
 
@@ -28,26 +28,105 @@
 
 #define ROLLSUM_BLOB_MAX (8192 * 4)
 
-static GHashTable *
-rollsum_chunks_crc32 (GBytes *bytes)
+/* Gear hash chunking, after FastCDC (Xia et al., "FastCDC: a Fast and
+ * Efficient Content-Defined Chunking Approach for Data Deduplication").
+ * Each byte costs a shift, an add and a table lookup, where bupsplit
+ * maintains a window and two sums.  The first GEAR_BLOB_MIN bytes of a
+ * chunk are skipped entirely, and the cut condition is stricter before
+ * the average size and looser after it, which keeps chunks close to
+ * the same average size as bupsplit.
+ */
+#define GEAR_BLOB_MIN (2048)
+#define GEAR_BLOB_AVG (1 << BUP_BLOBBITS)
+/* The high bits of the hash depend on the most bytes of input */
+#define GEAR_MASK(bits) (~(G_MAXUINT64 >> (bits)))
+#define GEAR_MASK_SMALL GEAR_MASK (BUP_BLOBBITS + 2)
+#define GEAR_MASK_LARGE GEAR_MASK (BUP_BLOBBITS - 2)
+
+static guint64 gear_table[256];
+
+static void
+gear_table_init (void)
+{
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      /* A fixed splitmix64 sequence, so chunk boundaries are stable */
+      guint64 state = 0;
+      for (guint i = 0; i < G_N_ELEMENTS (gear_table); i++)
+        {
+          guint64 z = (state += 0x9e3779b97f4a7c15ULL);
+          z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+          z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+          gear_table[i] = z ^ (z >> 31);
+        }
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
+/* Returns the length of the chunk starting at @buf; unlike
+ * bupsplit_find_ofs() the end of the buffer or ROLLSUM_BLOB_MAX is a
+ * boundary too.
+ */
+gsize
+_ostree_rollsum_gear_find_ofs (const guint8 *buf, gsize len)
+{
+  const gsize max = MIN (len, ROLLSUM_BLOB_MAX);
+  const gsize normal = MIN (max, GEAR_BLOB_AVG);
+  guint64 hash = 0;
+  gsize i;
+
+  if (len <= GEAR_BLOB_MIN)
+    return len;
+
+  gear_table_init ();
+
+  for (i = GEAR_BLOB_MIN; i < normal; i++)
+    {
+      hash = (hash << 1) + gear_table[buf[i]];
+      if (!(hash & GEAR_MASK_SMALL))
+        return i + 1;
+    }
+  for (; i < max; i++)
+    {
+      hash = (hash << 1) + gear_table[buf[i]];
+      if (!(hash & GEAR_MASK_LARGE))
+        return i + 1;
+    }
+
+  return max;
+}
+
+typedef struct
+{
+  guint32 crc;
+  guint32 len;
+  guint64 start;
+} RollsumChunk;
+
+static GArray *
+rollsum_chunks_crc32 (GBytes *bytes, OstreeRollsumChunker chunker)
 {
   gsize start = 0;
   gboolean rollsum_end = FALSE;
-  GHashTable *ret_rollsums = NULL;
   const guint8 *buf;
   gsize buflen;
   gsize remaining;
 
-  ret_rollsums = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_ptr_array_unref);
+  GArray *ret_chunks = g_array_new (FALSE, FALSE, sizeof (RollsumChunk));
 
   buf = g_bytes_get_data (bytes, &buflen);
 
   remaining = buflen;
   while (remaining > 0)
     {
-      int offset, bits;
+      gsize offset;
+      int bits;
 
-      if (!rollsum_end)
+      if (chunker == OSTREE_ROLLSUM_CHUNKER_GEAR)
+        offset = _ostree_rollsum_gear_find_ofs (buf + start, remaining);
+      else if (!rollsum_end)
         {
           offset = bupsplit_find_ofs (buf + start, MIN (G_MAXINT32, remaining), &bits);
           if (offset == 0)
@@ -62,145 +141,148 @@ rollsum_chunks_crc32 (GBytes *bytes)
         offset = MIN (ROLLSUM_BLOB_MAX, remaining);
 
       /* Use zlib's crc32 */
-      {
-        guint32 crc = crc32 (0L, NULL, 0);
-        GVariant *val;
-        GPtrArray *matches;
-
-        crc = crc32 (crc, buf, offset);
-
-        val = g_variant_ref_sink (g_variant_new ("(utt)", crc, (guint64)start, (guint64)offset));
-        matches = g_hash_table_lookup (ret_rollsums, GUINT_TO_POINTER (crc));
-        if (!matches)
-          {
-            matches = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
-            g_hash_table_insert (ret_rollsums, GUINT_TO_POINTER (crc), matches);
-          }
-        g_ptr_array_add (matches, val);
-      }
+      RollsumChunk chunk = { crc32 (crc32 (0L, NULL, 0), buf + start, offset), offset, start };
+      g_array_append_val (ret_chunks, chunk);
 
       start += offset;
       remaining -= offset;
     }
 
-  return ret_rollsums;
+  return ret_chunks;
 }
 
-static gint
-compare_matches (const void *app, const void *bpp)
+/* An open addressing table of the chunks of the source, keyed by their
+ * crc32 and probed linearly.  Chunks with the same crc32 are found in
+ * the order they were inserted, which is the order of the source.  A
+ * chunk identical to one already in the table is not inserted, since
+ * only the first one could ever match; otherwise repetitive input such
+ * as runs of zeroes would make a single long probe chain.
+ */
+typedef struct
+{
+  guint32 *slots; /* Chunk index + 1, 0 if empty */
+  guint32 mask;
+} RollsumChunkTable;
+
+static void
+rollsum_chunk_table_init (RollsumChunkTable *table, GArray *chunks, const guint8 *buf)
 {
-  GVariant **avpp = (GVariant **)app;
-  GVariant *a = *avpp;
-  GVariant **bvpp = (GVariant **)bpp;
-  GVariant *b = *bvpp;
-  guint64 a_start, b_start;
+  guint32 size = 16;
+
+  g_assert_cmpuint (chunks->len, <, G_MAXUINT32 / 4);
+  while (size < chunks->len * 2)
+    size <<= 1;
+  table->slots = g_new0 (guint32, size);
+  table->mask = size - 1;
 
-  g_variant_get_child (a, 2, "t", &a_start);
-  g_variant_get_child (b, 2, "t", &b_start);
+  for (guint i = 0; i < chunks->len; i++)
+    {
+      const RollsumChunk *chunk = &g_array_index (chunks, RollsumChunk, i);
+      guint32 slot = chunk->crc & table->mask;
+      gboolean duplicate = FALSE;
 
-  g_assert_cmpint (a_start, !=, b_start);
+      for (; table->slots[slot] != 0; slot = (slot + 1) & table->mask)
+        {
+          const RollsumChunk *other
+              = &g_array_index (chunks, RollsumChunk, table->slots[slot] - 1);
 
-  if (a_start < b_start)
-    return -1;
-  return 1;
+          if (other->crc == chunk->crc && other->len == chunk->len
+              && memcmp (buf + other->start, buf + chunk->start, chunk->len) == 0)
+            {
+              duplicate = TRUE;
+              break;
+            }
+        }
+      if (!duplicate)
+        table->slots[slot] = i + 1;
+    }
 }
 
+static void
+rollsum_chunk_table_clear (RollsumChunkTable *table)
+{
+  g_clear_pointer (&table->slots, g_free);
+}
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (RollsumChunkTable, rollsum_chunk_table_clear)
+
 OstreeRollsumMatches *
-_ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
+_ostree_compute_rollsum_matches_full (GBytes *from, GBytes *to, OstreeRollsumChunker chunker)
 {
   OstreeRollsumMatches *ret_rollsum = NULL;
-  g_autoptr (GHashTable) from_rollsum = NULL;
-  g_autoptr (GHashTable) to_rollsum = NULL;
-  g_autoptr (GPtrArray) matches = NULL;
+  g_autoptr (GArray) from_chunks = NULL;
+  g_autoptr (GArray) to_chunks = NULL;
+  g_auto (RollsumChunkTable) from_table = {
+    0,
+  };
   const guint8 *from_buf;
   gsize from_len;
   const guint8 *to_buf;
   gsize to_len;
-  gpointer hkey, hvalue;
-  GHashTableIter hiter;
 
   ret_rollsum = g_new0 (OstreeRollsumMatches, 1);
 
-  matches = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+  ret_rollsum->matches = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
 
   from_buf = g_bytes_get_data (from, &from_len);
   to_buf = g_bytes_get_data (to, &to_len);
 
-  from_rollsum = rollsum_chunks_crc32 (from);
-  to_rollsum = rollsum_chunks_crc32 (to);
+  from_chunks = rollsum_chunks_crc32 (from, chunker);
+  to_chunks = rollsum_chunks_crc32 (to, chunker);
+  rollsum_chunk_table_init (&from_table, from_chunks, from_buf);
 
-  g_hash_table_iter_init (&hiter, to_rollsum);
-  while (g_hash_table_iter_next (&hiter, &hkey, &hvalue))
+  /* Walking the target in order means the matches come out sorted */
+  for (guint i = 0; i < to_chunks->len; i++)
     {
-      GPtrArray *to_chunks = hvalue;
-      GPtrArray *from_chunks;
+      const RollsumChunk *to_chunk = &g_array_index (to_chunks, RollsumChunk, i);
+      gboolean crc_matched = FALSE;
 
-      from_chunks = g_hash_table_lookup (from_rollsum, hkey);
-      if (from_chunks != NULL)
+      for (guint32 slot = to_chunk->crc & from_table.mask; from_table.slots[slot] != 0;
+           slot = (slot + 1) & from_table.mask)
         {
-          guint i;
+          const RollsumChunk *from_chunk
+              = &g_array_index (from_chunks, RollsumChunk, from_table.slots[slot] - 1);
 
-          ret_rollsum->crcmatches++;
+          if (from_chunk->crc != to_chunk->crc)
+            continue;
 
-          for (i = 0; i < to_chunks->len; i++)
+          crc_matched = TRUE;
+
+          /* Same crc32 but different length, skip it.  */
+          if (from_chunk->len != to_chunk->len)
+            continue;
+
+          /* Rsync uses a cryptographic checksum, but let's be
+           * very conservative here and just memcmp.
+           */
+          if (memcmp (from_buf + from_chunk->start, to_buf + to_chunk->start, to_chunk->len) == 0)
             {
-              GVariant *to_chunk = to_chunks->pdata[i];
-              guint64 to_start, to_offset;
-              guint32 tocrc;
-              guint j;
-
-              g_variant_get (to_chunk, "(utt)", &tocrc, &to_start, &to_offset);
-
-              for (j = 0; j < from_chunks->len; j++)
-                {
-                  GVariant *from_chunk = from_chunks->pdata[j];
-                  guint32 fromcrc;
-                  guint64 from_start, from_offset;
-
-                  g_variant_get (from_chunk, "(utt)", &fromcrc, &from_start, &from_offset);
-
-                  g_assert (fromcrc == tocrc);
-
-                  /* Same crc32 but different length, skip it.  */
-                  if (to_offset != from_offset)
-                    continue;
-
-                  /* Rsync uses a cryptographic checksum, but let's be
-                   * very conservative here and just memcmp.
-                   */
-                  if (memcmp (from_buf + from_start, to_buf + to_start, to_offset) == 0)
-                    {
-                      GVariant *match
-                          = g_variant_new ("(uttt)", fromcrc, to_offset, to_start, from_start);
-                      ret_rollsum->bufmatches++;
-                      ret_rollsum->match_size += to_offset;
-                      g_ptr_array_add (matches, g_variant_ref_sink (match));
-                      break; /* Don't need any more matches */
-                    }
-                }
+              GVariant *match = g_variant_new ("(uttt)", to_chunk->crc, (guint64)to_chunk->len,
+                                               to_chunk->start, from_chunk->start);
+              ret_rollsum->bufmatches++;
+              ret_rollsum->match_size += to_chunk->len;
+              g_ptr_array_add (ret_rollsum->matches, g_variant_ref_sink (match));
+              break; /* Don't need any more matches */
             }
         }
 
-      ret_rollsum->total += to_chunks->len;
+      if (crc_matched)
+        ret_rollsum->crcmatches++;
     }
 
-  g_ptr_array_sort (matches, compare_matches);
-
-  ret_rollsum->from_rollsums = from_rollsum;
-  from_rollsum = NULL;
-  ret_rollsum->to_rollsums = to_rollsum;
-  to_rollsum = NULL;
-  ret_rollsum->matches = matches;
-  matches = NULL;
+  ret_rollsum->total = to_chunks->len;
 
   return ret_rollsum;
 }
 
+OstreeRollsumMatches *
+_ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
+{
+  return _ostree_compute_rollsum_matches_full (from, to, OSTREE_ROLLSUM_CHUNKER_GEAR);
+}
+
 void
 _ostree_rollsum_matches_free (OstreeRollsumMatches *rollsum)
 {
-  g_hash_table_unref (rollsum->to_rollsums);
-  g_hash_table_unref (rollsum->from_rollsums);
   g_ptr_array_unref (rollsum->matches);
   g_free (rollsum);
 }
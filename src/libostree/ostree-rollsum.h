@@ -24,10 +24,14 @@
 
 G_BEGIN_DECLS
 
+typedef enum
+{
+  OSTREE_ROLLSUM_CHUNKER_GEAR,
+  OSTREE_ROLLSUM_CHUNKER_BUPSPLIT,
+} OstreeRollsumChunker;
+
 typedef struct
 {
-  GHashTable *from_rollsums;
-  GHashTable *to_rollsums;
   guint crcmatches;
   guint bufmatches;
   guint total;
@@ -35,7 +39,11 @@ typedef struct
   GPtrArray *matches;
 } OstreeRollsumMatches;
 
+gsize _ostree_rollsum_gear_find_ofs (const guint8 *buf, gsize len);
+
 OstreeRollsumMatches *_ostree_compute_rollsum_matches (GBytes *from, GBytes *to);
+OstreeRollsumMatches *_ostree_compute_rollsum_matches_full (GBytes *from, GBytes *to,
+                                                            OstreeRollsumChunker chunker);
 
 void _ostree_rollsum_matches_free (OstreeRollsumMatches *rollsum);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeRollsumMatches, _ostree_rollsum_matches_free)
@@ -51,6 +51,7 @@ struct _OstreeSignEd25519
   guchar *secret_key;  /* malloc'd buffer of length OSTREE_SIGN_ED25519_SECKEY_SIZE */
   GList *public_keys;  /* malloc'd buffer of length OSTREE_SIGN_ED25519_PUBKEY_SIZE */
   GList *revoked_keys; /* malloc'd buffer of length OSTREE_SIGN_ED25519_PUBKEY_SIZE */
+  gint valid_key_hint; /* atomic; index in public_keys of the last key which verified */
 };
 
 static void ostree_sign_ed25519_iface_init (OstreeSignInterface *self);
@@ -229,43 +230,61 @@ ostree_sign_ed25519_data_verify (OstreeSign *self, GBytes *data, GVariant *signa
 
       g_debug ("Read signature %d: %s", (gint)i, g_variant_print (child, TRUE));
 
-      for (GList *public_key = sign->public_keys; public_key != NULL; public_key = public_key->next)
+      /* Signatures don't say which key made them, so we can only guess; try
+       * the key which verified the last signature first, since a run of
+       * commits (e.g. in a pull) is most likely signed by the same key.
+       * This is only a hint, so that verifying doesn't modify the key list
+       * and can be done from several threads at once.
+       */
+      const guint hint = (guint)g_atomic_int_get (&sign->valid_key_hint);
+      for (guint pass = 0; pass < 2; pass++)
         {
-          /* TODO: use non-list for tons of revoked keys? */
-          if (g_list_find_custom (sign->revoked_keys, public_key->data, _compare_ed25519_keys)
-              != NULL)
+          guint idx = 0;
+          for (GList *public_key = sign->public_keys; public_key != NULL;
+               public_key = public_key->next, idx++)
             {
-              ot_bin2hex (hex, public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
-              g_debug ("Skip revoked key '%s'", hex);
-              continue;
-            }
+              if ((idx == hint) != (pass == 0))
+                continue;
 
-          bool valid = false;
-          // Wrap the pubkey in a GBytes as that's what this API wants
-          g_autoptr (GBytes) public_key_bytes
-              = g_bytes_new_static (public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
-          if (!otcore_validate_ed25519_signature (data, public_key_bytes, signature, &valid, error))
-            return FALSE;
-          if (!valid)
-            {
-              /* Incorrect signature! */
-              if (invalid_signatures == NULL)
-                invalid_signatures = g_string_new ("");
-              else
-                g_string_append (invalid_signatures, "; ");
-              n_invalid_signatures++;
-              ot_bin2hex (hex, public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
-              g_string_append_printf (invalid_signatures, "key '%s'", hex);
-            }
-          else
-            {
-              if (out_success_message)
+              /* TODO: use non-list for tons of revoked keys? */
+              if (g_list_find_custom (sign->revoked_keys, public_key->data,
+                                      _compare_ed25519_keys)
+                  != NULL)
+                {
+                  ot_bin2hex (hex, public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
+                  g_debug ("Skip revoked key '%s'", hex);
+                  continue;
+                }
+
+              bool valid = false;
+              // Wrap the pubkey in a GBytes as that's what this API wants
+              g_autoptr (GBytes) public_key_bytes
+                  = g_bytes_new_static (public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
+              if (!otcore_validate_ed25519_signature (data, public_key_bytes, signature, &valid,
+                                                      error))
+                return FALSE;
+              if (!valid)
                 {
+                  /* Incorrect signature! */
+                  if (invalid_signatures == NULL)
+                    invalid_signatures = g_string_new ("");
+                  else
+                    g_string_append (invalid_signatures, "; ");
+                  n_invalid_signatures++;
                   ot_bin2hex (hex, public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
-                  *out_success_message = g_strdup_printf (
-                      "ed25519: Signature verified successfully with key '%s'", hex);
+                  g_string_append_printf (invalid_signatures, "key '%s'", hex);
+                }
+              else
+                {
+                  if (out_success_message)
+                    {
+                      ot_bin2hex (hex, public_key->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
+                      *out_success_message = g_strdup_printf (
+                          "ed25519: Signature verified successfully with key '%s'", hex);
+                    }
+                  g_atomic_int_set (&sign->valid_key_hint, idx);
+                  return TRUE;
                 }
-              return TRUE;
             }
         }
     }
@@ -285,6 +304,41 @@ ostree_sign_ed25519_data_verify (OstreeSign *self, GBytes *data, GVariant *signa
   return glnx_throw (error, "ed25519: no signatures found");
 }
 
+/* Returns a checksum of the trusted and revoked keys, which identifies the
+ * outcome of a verification with them; or %NULL if no keys are loaded yet,
+ * since ostree_sign_ed25519_data_verify() then loads the system keys.
+ */
+char *
+_ostree_sign_ed25519_checksum_keys (OstreeSign *self)
+{
+  OstreeSignEd25519 *sign = _ostree_sign_ed25519_get_instance_private (OSTREE_SIGN_ED25519 (self));
+
+  if (sign->state != ED25519_OK || sign->public_keys == NULL)
+    return NULL;
+
+  /* The order of the trusted keys changes as they're used, so sort them */
+  g_autoptr (GList) public_keys
+      = g_list_sort (g_list_copy (sign->public_keys), _compare_ed25519_keys);
+  g_autoptr (GList) revoked_keys
+      = g_list_sort (g_list_copy (sign->revoked_keys), _compare_ed25519_keys);
+
+  g_auto (OtChecksum) checksum = {
+    0,
+  };
+  ot_checksum_init (&checksum);
+  for (GList *l = public_keys; l != NULL; l = l->next)
+    ot_checksum_update (&checksum, l->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
+  /* Separate the two lists; a key is never all zeroes */
+  static const guint8 separator[OSTREE_SIGN_ED25519_PUBKEY_SIZE] = { 0 };
+  ot_checksum_update (&checksum, separator, sizeof (separator));
+  for (GList *l = revoked_keys; l != NULL; l = l->next)
+    ot_checksum_update (&checksum, l->data, OSTREE_SIGN_ED25519_PUBKEY_SIZE);
+
+  char hexdigest[_OSTREE_SHA256_STRING_LEN + 1];
+  ot_checksum_get_hexdigest (&checksum, hexdigest, sizeof (hexdigest));
+  return g_strdup (hexdigest);
+}
+
 const gchar *
 ostree_sign_ed25519_get_name (OstreeSign *self)
 {
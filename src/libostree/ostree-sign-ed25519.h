@@ -53,4 +53,6 @@ gboolean ostree_sign_ed25519_add_pk (OstreeSign *self, GVariant *public_key, GEr
 
 gboolean ostree_sign_ed25519_load_pk (OstreeSign *self, GVariant *options, GError **error);
 
+char *_ostree_sign_ed25519_checksum_keys (OstreeSign *self);
+
 G_END_DECLS
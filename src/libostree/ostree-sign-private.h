@@ -32,4 +32,6 @@ G_BEGIN_DECLS
 gboolean _ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVariant *keys,
                                   GCancellable *cancellable, GError **error);
 
+char *_ostree_sign_checksum_keys (OstreeSign *self);
+
 G_END_DECLS
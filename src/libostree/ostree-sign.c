@@ -557,6 +557,17 @@ ostree_sign_get_by_name (const gchar *name, GError **error)
   return sign;
 }
 
+/* Returns a checksum identifying the keys loaded into @self for
+ * verification, or %NULL if that isn't known for this signing type.
+ */
+char *
+_ostree_sign_checksum_keys (OstreeSign *self)
+{
+  if (OSTREE_IS_SIGN_ED25519 (self))
+    return _ostree_sign_ed25519_checksum_keys (self);
+  return NULL;
+}
+
 gboolean
 _ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVariant *keys,
                          GCancellable *cancellable, GError **error)
@@ -24,6 +24,7 @@
 #include "ostree-repo-private.h"
 #include "otcore.h"
 #include "otutil.h"
+#include <sys/file.h>
 
 #include "ostree-sysroot-private.h"
 
@@ -213,10 +214,13 @@ cleanup_other_bootversions (OstreeSysroot *self, GCancellable *cancellable, GErr
   return TRUE;
 }
 
-/* Delete a deployment directory */
-gboolean
-_ostree_sysroot_rmrf_deployment (OstreeSysroot *self, OstreeDeployment *deployment,
-                                 GCancellable *cancellable, GError **error)
+/* Delete a deployment directory.  If @trash_dfd is not -1, the deployment
+ * tree is instead renamed into that directory, to be deleted later by
+ * ostree_sysroot_empty_deployment_trash().
+ */
+static gboolean
+rmrf_deployment_full (OstreeSysroot *self, OstreeDeployment *deployment, int trash_dfd,
+                      GCancellable *cancellable, GError **error)
 {
   g_autofree char *backing_relpath = _ostree_sysroot_get_deployment_backing_relpath (deployment);
   g_autofree char *origin_relpath = ostree_deployment_get_origin_relpath (deployment);
@@ -247,15 +251,217 @@ _ostree_sysroot_rmrf_deployment (OstreeSysroot *self, OstreeDeployment *deployme
     return FALSE;
   if (!glnx_shutil_rm_rf_at (self->sysroot_fd, origin_relpath, cancellable, error))
     return FALSE;
+
+  if (trash_dfd != -1)
+    {
+      g_autofree char *trash_name = g_strdup_printf (
+          "%s-%s.%d", ostree_deployment_get_osname (deployment),
+          ostree_deployment_get_csum (deployment), ostree_deployment_get_deployserial (deployment));
+      /* A previous deployment with the same name may still be in the trash,
+       * and could be being deleted concurrently, so pick a new name rather
+       * than touching it.  Only deletions race with us as we hold the sysroot
+       * lock, so a name which doesn't exist stays free. */
+      for (guint n = 1;; n++)
+        {
+          if (!glnx_fstatat_allow_noent (trash_dfd, trash_name, NULL, AT_SYMLINK_NOFOLLOW, error))
+            return FALSE;
+          if (errno == ENOENT)
+            break;
+          g_free (trash_name);
+          trash_name = g_strdup_printf ("%s-%s.%d.%u", ostree_deployment_get_osname (deployment),
+                                        ostree_deployment_get_csum (deployment),
+                                        ostree_deployment_get_deployserial (deployment), n);
+        }
+      if (renameat (self->sysroot_fd, deployment_path, trash_dfd, trash_name) == 0)
+        return TRUE;
+      /* Fall back to deleting it directly if e.g. it's on a different filesystem */
+      if (errno != EXDEV)
+        return glnx_throw_errno_prefix (error, "rename(%s)", deployment_path);
+    }
+
   if (!glnx_shutil_rm_rf_at (self->sysroot_fd, deployment_path, cancellable, error))
     return FALSE;
 
   return TRUE;
 }
 
+gboolean
+_ostree_sysroot_rmrf_deployment (OstreeSysroot *self, OstreeDeployment *deployment,
+                                 GCancellable *cancellable, GError **error)
+{
+  return rmrf_deployment_full (self, deployment, -1, cancellable, error);
+}
+
+typedef struct
+{
+  int dfd;
+  GThreadPool *pool;
+  GCancellable *cancellable;
+  GMutex mutex;
+  GCond cond;
+  guint n_pending;
+  GError *error;
+} EmptyTrashData;
+
+/* Queue @path (relative to the trash) to be emptied; takes ownership of @path */
+static void
+empty_trash_queue_dir (EmptyTrashData *data, char *path)
+{
+  g_mutex_lock (&data->mutex);
+  data->n_pending++;
+  g_mutex_unlock (&data->mutex);
+  g_thread_pool_push (data->pool, path, NULL);
+}
+
+/* Unlink everything in @path other than directories, which are queued */
+static gboolean
+empty_trash_dir (EmptyTrashData *data, const char *path, GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (data->dfd, path, FALSE, &dfd_iter, error))
+    return FALSE;
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, data->cancellable,
+                                                       error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      if (dent->d_type == DT_DIR)
+        empty_trash_queue_dir (data, g_build_filename (path, dent->d_name, NULL));
+      else if (!glnx_unlinkat (dfd_iter.fd, dent->d_name, 0, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+empty_trash_thread (gpointer datap, gpointer user_data)
+{
+  g_autofree char *path = datap;
+  EmptyTrashData *data = user_data;
+  g_autoptr (GError) local_error = NULL;
+
+  /* Don't start on anything new after a failure */
+  g_mutex_lock (&data->mutex);
+  const gboolean failed = data->error != NULL;
+  g_mutex_unlock (&data->mutex);
+  if (!failed)
+    (void)empty_trash_dir (data, path, &local_error);
+
+  g_mutex_lock (&data->mutex);
+  if (local_error && data->error == NULL)
+    data->error = g_steal_pointer (&local_error);
+  if (--data->n_pending == 0)
+    g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+}
+
+/**
+ * ostree_sysroot_empty_deployment_trash:
+ * @self: Sysroot
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Delete the deployments which were removed by ostree_sysroot_cleanup() or
+ * by writing a new deployment list.  Those only move the deployment trees
+ * aside, which is quick, so that the sysroot lock isn't held while they are
+ * deleted.  This function does not need the sysroot lock, and should be
+ * called after releasing it.  The trash persists across reboots, so
+ * anything left over from an interrupted call is deleted by the next one.
+ *
+ * If another process is already emptying the trash, this returns
+ * immediately.
+ *
+ * Since: 2025.2
+ */
+gboolean
+ostree_sysroot_empty_deployment_trash (OstreeSysroot *self, GCancellable *cancellable,
+                                       GError **error)
+{
+  if (!_ostree_sysroot_ensure_writable (self, error))
+    return FALSE;
+
+  glnx_autofd int trash_dfd
+      = glnx_opendirat_with_errno (self->sysroot_fd, _OSTREE_SYSROOT_DEPLOY_TRASH, TRUE);
+  if (trash_dfd < 0)
+    {
+      if (errno != ENOENT)
+        return glnx_throw_errno_prefix (error, "opendir(%s)", _OSTREE_SYSROOT_DEPLOY_TRASH);
+      return TRUE;
+    }
+
+  /* Concurrent deletions of the same tree would fail on each other's
+   * unlinks, so only one process empties the trash at a time */
+  if (flock (trash_dfd, LOCK_EX | LOCK_NB) < 0)
+    {
+      if (errno == EWOULDBLOCK)
+        return TRUE;
+      return glnx_throw_errno_prefix (error, "flock(%s)", _OSTREE_SYSROOT_DEPLOY_TRASH);
+    }
+
+  /* A deployment is ~100k entries, mostly under a few directories such as
+   * /usr, so the workers share a queue of directories: each unlinks the
+   * files in one directory and queues its subdirectories. */
+
+  EmptyTrashData data = {
+    trash_dfd,
+    NULL,
+    cancellable,
+  };
+  g_mutex_init (&data.mutex);
+  g_cond_init (&data.cond);
+  data.pool = g_thread_pool_new (empty_trash_thread, &data, g_get_num_processors (), FALSE, NULL);
+  empty_trash_queue_dir (&data, g_strdup ("."));
+  /* Workers queue more directories as they go, so wait for the count of
+   * pending directories to drop to zero rather than for the pool */
+  g_mutex_lock (&data.mutex);
+  while (data.n_pending > 0)
+    g_cond_wait (&data.cond, &data.mutex);
+  g_mutex_unlock (&data.mutex);
+  g_thread_pool_free (data.pool, FALSE, TRUE);
+  g_cond_clear (&data.cond);
+  g_mutex_clear (&data.mutex);
+  g_autoptr (GError) thread_error = g_steal_pointer (&data.error);
+  if (thread_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&thread_error));
+      return FALSE;
+    }
+
+  /* What's left is empty directories, and any trees added since we started.
+   * Keep the trash directory itself, as cleanup may be renaming into it. */
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (trash_dfd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+      if (!glnx_shutil_rm_rf_at (dfd_iter.fd, dent->d_name, cancellable, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 /* As the bootloader configuration changes, we will have leftover deployments
  * on disk.  This function deletes all deployments which aren't actively
  * referenced.
+ *
+ * Rather than deleting each tree here, we move them all into a trash
+ * directory, which ostree_sysroot_empty_deployment_trash() deletes in
+ * parallel without holding the sysroot lock.
  */
 static gboolean
 cleanup_old_deployments (OstreeSysroot *self, GCancellable *cancellable, GError **error)
@@ -276,6 +482,7 @@ cleanup_old_deployments (OstreeSysroot *self, GCancellable *cancellable, GError
   if (!list_all_deployment_directories (self, &all_deployment_dirs, cancellable, error))
     return FALSE;
   g_assert (all_deployment_dirs); /* Pacify static analysis */
+  glnx_autofd int trash_dfd = -1;
   for (guint i = 0; i < all_deployment_dirs->len; i++)
     {
       OstreeDeployment *deployment = all_deployment_dirs->pdata[i];
@@ -284,7 +491,17 @@ cleanup_old_deployments (OstreeSysroot *self, GCancellable *cancellable, GError
       if (g_hash_table_lookup (active_deployment_dirs, deployment_path))
         continue;
 
-      if (!_ostree_sysroot_rmrf_deployment (self, deployment, cancellable, error))
+      if (trash_dfd == -1)
+        {
+          if (!glnx_shutil_mkdir_p_at (self->sysroot_fd, _OSTREE_SYSROOT_DEPLOY_TRASH, 0700,
+                                       cancellable, error))
+            return FALSE;
+          if (!glnx_opendirat (self->sysroot_fd, _OSTREE_SYSROOT_DEPLOY_TRASH, TRUE, &trash_dfd,
+                               error))
+            return FALSE;
+        }
+
+      if (!rmrf_deployment_full (self, deployment, trash_dfd, cancellable, error))
         return FALSE;
     }
 
@@ -465,8 +682,6 @@ ostree_sysroot_cleanup_prune_repo (OstreeSysroot *sysroot, OstreeRepoPruneOption
 {
   GLNX_AUTO_PREFIX_ERROR ("Pruning system repository", error);
   OstreeRepo *repo = ostree_sysroot_repo (sysroot);
-  const guint depth = 0; /* Historical default */
-
   if (!_ostree_sysroot_ensure_writable (sysroot, error))
     return FALSE;
 
@@ -481,8 +696,12 @@ ostree_sysroot_cleanup_prune_repo (OstreeSysroot *sysroot, OstreeRepoPruneOption
   /* Ensure reachable has refs, but default to depth 0.  This is
    * what we've always done for the system repo, but perhaps down
    * the line we could add a depth flag to the repo config or something?
+   *
+   * Deployment commits rarely change between prunes, so use the
+   * per-commit reachable cache; after an upgrade only the new
+   * commit needs a full traversal.
    */
-  if (!ostree_repo_traverse_reachable_refs (repo, depth, options->reachable, cancellable, error))
+  if (!_ostree_repo_traverse_reachable_refs_cached (repo, options->reachable, cancellable, error))
     return FALSE;
 
   /* Since ostree was created we've been generating "deployment refs" in
@@ -495,8 +714,8 @@ ostree_sysroot_cleanup_prune_repo (OstreeSysroot *sysroot, OstreeRepoPruneOption
   for (guint i = 0; i < sysroot->deployments->len; i++)
     {
       const char *checksum = ostree_deployment_get_csum (sysroot->deployments->pdata[i]);
-      if (!ostree_repo_traverse_commit_union (repo, checksum, depth, options->reachable,
-                                              cancellable, error))
+      if (!_ostree_repo_traverse_commit_cached (repo, checksum, options->reachable, cancellable,
+                                                error))
         return FALSE;
     }
 
@@ -515,6 +734,9 @@ ostree_sysroot_cleanup_prune_repo (OstreeSysroot *sysroot, OstreeRepoPruneOption
  *
  * Delete any state that resulted from a partially completed
  * transaction, such as incomplete deployments.
+ *
+ * Deployments which are no longer referenced are moved to a trash
+ * directory rather than deleted; see ostree_sysroot_empty_deployment_trash().
  */
 gboolean
 ostree_sysroot_cleanup (OstreeSysroot *self, GCancellable *cancellable, GError **error)
@@ -37,6 +37,9 @@ typedef enum
   /* This is a temporary flag until we fully drop the explicit `systemctl start
    * ostree-finalize-staged.service` so that tests can exercise the new path unit. */
   OSTREE_SYSROOT_DEBUG_TEST_NO_DTB = 1 << 3, /* https://github.com/ostreedev/ostree/issues/2154 */
+  /* Use the deployments cache when not booted, keeping it and the boot ID
+   * it is checked against under the sysroot. */
+  OSTREE_SYSROOT_DEBUG_TEST_DEPLOYMENTS_CACHE = 1 << 4,
 } OstreeSysrootDebugFlags;
 
 typedef enum
@@ -100,11 +103,15 @@ struct OstreeSysroot
 #define _OSTREE_SYSROOT_STAGED_KEY_LOCKED "locked"
 
 #define OSTREE_SYSROOT_LOCKFILE "ostree/lock"
+/* Unreferenced deployment trees are moved here before being deleted */
+#define _OSTREE_SYSROOT_DEPLOY_TRASH "ostree/deploy-trash"
 /* We keep some transient state in /run */
 #define _OSTREE_SYSROOT_RUNSTATE_STAGED "/run/ostree/staged-deployment"
 #define _OSTREE_SYSROOT_RUNSTATE_STAGED_LOCKED "/run/ostree/staged-deployment-locked"
 #define _OSTREE_SYSROOT_RUNSTATE_STAGED_INITRDS_DIR "/run/ostree/staged-initrds/"
 #define _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_DIR "/run/ostree/deployment-state/"
+/* Serialized deployment list, see sysroot_load_from_bootloader_configs() */
+#define _OSTREE_SYSROOT_RUNSTATE_DEPLOYMENTS_CACHE "/run/ostree/deployments-cache"
 #define _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_DEVELOPMENT "unlocked-development"
 #define _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_TRANSIENT "unlocked-transient"
 
@@ -26,6 +26,7 @@
 #include <sys/mount.h>
 #include <sys/wait.h>
 
+#include "ostree-bootconfig-parser-private.h"
 #include "ostree-bootloader-aboot.h"
 #include "ostree-bootloader-grub2.h"
 #include "ostree-bootloader-syslinux.h"
@@ -188,6 +189,7 @@ ostree_sysroot_init (OstreeSysroot *self)
     { "test-fifreeze", OSTREE_SYSROOT_DEBUG_TEST_FIFREEZE },
     { "no-xattrs", OSTREE_SYSROOT_DEBUG_NO_XATTRS },
     { "no-dtb", OSTREE_SYSROOT_DEBUG_TEST_NO_DTB },
+    { "test-deployments-cache", OSTREE_SYSROOT_DEBUG_TEST_DEPLOYMENTS_CACHE },
   };
 
   self->opt_flags = g_parse_debug_string (g_getenv ("OSTREE_SYSROOT_OPTS"), globalopt_keys,
@@ -901,21 +903,12 @@ get_ostree_kernel_arg_from_config (OstreeBootconfigParser *config)
   return NULL;
 }
 
-/* From a BLS config, use its ostree= karg to find the deployment it points to and add it to
- * the inout_deployments array. */
+/* Attach a parsed BLS config to @deployment, along with the overlay initrds
+ * it references. */
 static gboolean
-list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigParser *config,
-                                         GPtrArray *inout_deployments, GCancellable *cancellable,
-                                         GError **error)
+set_deployment_bootconfig (OstreeDeployment *deployment, OstreeBootconfigParser *config,
+                           GError **error)
 {
-  g_autofree char *ostree_arg = get_ostree_kernel_arg_from_config (config);
-  if (ostree_arg == NULL)
-    return glnx_throw (error, "No ostree= kernel argument found");
-
-  g_autoptr (OstreeDeployment) deployment = NULL;
-  if (!parse_deployment (self, ostree_arg, &deployment, cancellable, error))
-    return FALSE;
-
   ostree_deployment_set_bootconfig (deployment, config);
   char **overlay_initrds = ostree_bootconfig_parser_get_overlay_initrds (config);
   g_autoptr (GPtrArray) initrds_chksums = NULL;
@@ -936,6 +929,27 @@ list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigPa
       _ostree_deployment_set_overlay_initrds (deployment, (char **)initrds_chksums->pdata);
     }
 
+  return TRUE;
+}
+
+/* From a BLS config, use its ostree= karg to find the deployment it points to and add it to
+ * the inout_deployments array. */
+static gboolean
+list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigParser *config,
+                                         GPtrArray *inout_deployments, GCancellable *cancellable,
+                                         GError **error)
+{
+  g_autofree char *ostree_arg = get_ostree_kernel_arg_from_config (config);
+  if (ostree_arg == NULL)
+    return glnx_throw (error, "No ostree= kernel argument found");
+
+  g_autoptr (OstreeDeployment) deployment = NULL;
+  if (!parse_deployment (self, ostree_arg, &deployment, cancellable, error))
+    return FALSE;
+
+  if (!set_deployment_bootconfig (deployment, config, error))
+    return FALSE;
+
   g_ptr_array_add (inout_deployments, g_object_ref (deployment));
   return TRUE;
 }
@@ -1128,6 +1142,200 @@ _ostree_sysroot_reload_staged (OstreeSysroot *self, GError **error)
   return TRUE;
 }
 
+/* Format of _OSTREE_SYSROOT_RUNSTATE_DEPLOYMENTS_CACHE: the validation key, and
+ * for each deployment (osname, csum, deployserial, bootcsum, bootserial, unlocked,
+ * booted, bootconfig, origin).
+ */
+#define DEPLOYMENTS_CACHE_ENTRY_GVARIANT_FORMAT \
+  "(ssisiib" _OSTREE_BOOTCONFIG_PARSER_GVARIANT_FORMAT "s)"
+#define DEPLOYMENTS_CACHE_GVARIANT_FORMAT "(a{sv}a" DEPLOYMENTS_CACHE_ENTRY_GVARIANT_FORMAT ")"
+
+/* For tests, the cache and boot ID are looked up relative to the sysroot */
+static int
+deployments_cache_dfd (OstreeSysroot *self)
+{
+  if (self->debug_flags & OSTREE_SYSROOT_DEBUG_TEST_DEPLOYMENTS_CACHE)
+    return self->sysroot_fd;
+  return AT_FDCWD;
+}
+
+static const char *
+deployments_cache_path (OstreeSysroot *self, const char *path)
+{
+  if (self->debug_flags & OSTREE_SYSROOT_DEBUG_TEST_DEPLOYMENTS_CACHE)
+    return path + 1;
+  return path;
+}
+
+/* Compute the key used to validate the deployments cache.  Everything which
+ * changes the deployment list either bumps the mtime of ostree/deploy (see
+ * _ostree_sysroot_bump_mtime()) or rewrites the BLS entries; and since the cache
+ * lives in /run, we also include the boot ID to be safe.
+ */
+static gboolean
+deployments_cache_compute_key (OstreeSysroot *self, int bootversion, int subbootversion,
+                               GVariant **out_key, GError **error)
+{
+  struct stat deploy_stbuf;
+  if (!glnx_fstatat (self->sysroot_fd, "ostree/deploy", &deploy_stbuf, 0, error))
+    return FALSE;
+
+  g_autofree char *entries_path = g_strdup_printf ("boot/loader.%d/entries", bootversion);
+  struct stat entries_stbuf = {
+    0,
+  };
+  if (!glnx_fstatat_allow_noent (self->sysroot_fd, entries_path, &entries_stbuf, 0, error))
+    return FALSE;
+
+  g_autofree char *boot_id = glnx_file_get_contents_utf8_at (
+      deployments_cache_dfd (self),
+      deployments_cache_path (self, "/proc/sys/kernel/random/boot_id"), NULL, NULL, error);
+  if (!boot_id)
+    return FALSE;
+  g_strdelimit (boot_id, "\n", '\0');
+
+  g_auto (GVariantBuilder) builder = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&builder, (GVariantType *)"a{sv}");
+  g_variant_builder_add (&builder, "{sv}", "boot-id", g_variant_new_string (boot_id));
+  g_variant_builder_add (&builder, "{sv}", "bootversion", g_variant_new_int32 (bootversion));
+  g_variant_builder_add (&builder, "{sv}", "subbootversion", g_variant_new_int32 (subbootversion));
+  g_variant_builder_add (&builder, "{sv}", "deploy-mtime",
+                         g_variant_new ("(tt)", (guint64)deploy_stbuf.st_mtim.tv_sec,
+                                        (guint64)deploy_stbuf.st_mtim.tv_nsec));
+  g_variant_builder_add (&builder, "{sv}", "entries",
+                         g_variant_new ("(tttt)", (guint64)entries_stbuf.st_dev,
+                                        (guint64)entries_stbuf.st_ino,
+                                        (guint64)entries_stbuf.st_mtim.tv_sec,
+                                        (guint64)entries_stbuf.st_mtim.tv_nsec));
+  *out_key = g_variant_ref_sink (g_variant_builder_end (&builder));
+  return TRUE;
+}
+
+/* Try to load the (non-staged) deployment list from the cache; returns %NULL
+ * if the cache is missing, stale or unreadable, in which case the caller should
+ * fall back to parsing the bootloader configs.  Note this also sets
+ * self->booted_deployment.
+ */
+static GPtrArray *
+deployments_cache_load (OstreeSysroot *self, GVariant *key)
+{
+  g_autoptr (GError) local_error = NULL;
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (deployments_cache_dfd (self),
+                                deployments_cache_path (self,
+                                                        _OSTREE_SYSROOT_RUNSTATE_DEPLOYMENTS_CACHE),
+                                &fd, &local_error))
+    {
+      g_debug ("Failed to open deployments cache: %s", local_error->message);
+      return NULL;
+    }
+  if (fd == -1)
+    return NULL;
+
+  g_autoptr (GVariant) cache = NULL;
+  if (!ot_variant_read_fd (fd, 0, (GVariantType *)DEPLOYMENTS_CACHE_GVARIANT_FORMAT, FALSE, &cache,
+                           &local_error))
+    {
+      g_debug ("Failed to read deployments cache: %s", local_error->message);
+      return NULL;
+    }
+
+  g_autoptr (GVariant) cached_key = g_variant_get_child_value (cache, 0);
+  if (!g_variant_equal (cached_key, key))
+    {
+      g_debug ("Deployments cache is stale");
+      return NULL;
+    }
+
+  g_autoptr (GPtrArray) deployments
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  g_autoptr (OstreeDeployment) booted = NULL;
+  g_autoptr (GVariant) entries = g_variant_get_child_value (cache, 1);
+  const guint n_entries = g_variant_n_children (entries);
+  for (guint i = 0; i < n_entries; i++)
+    {
+      const char *osname;
+      const char *csum;
+      int deployserial;
+      const char *bootcsum;
+      int bootserial;
+      int unlocked;
+      gboolean is_booted;
+      g_autoptr (GVariant) bootconfig_v = NULL;
+      const char *origin_data;
+      g_variant_get_child (entries, i,
+                           "(&s&si&siib@" _OSTREE_BOOTCONFIG_PARSER_GVARIANT_FORMAT "&s)", &osname,
+                           &csum, &deployserial, &bootcsum, &bootserial, &unlocked, &is_booted,
+                           &bootconfig_v, &origin_data);
+
+      g_autoptr (OstreeDeployment) deployment
+          = ostree_deployment_new (-1, osname, csum, deployserial, bootcsum, bootserial);
+      if (*origin_data)
+        {
+          g_autoptr (GKeyFile) origin = g_key_file_new ();
+          if (!g_key_file_load_from_data (origin, origin_data, -1, 0, &local_error))
+            {
+              g_debug ("Invalid origin in deployments cache: %s", local_error->message);
+              return NULL;
+            }
+          ostree_deployment_set_origin (deployment, origin);
+        }
+      deployment->unlocked = (OstreeDeploymentUnlockedState)unlocked;
+
+      g_autoptr (OstreeBootconfigParser) bootconfig
+          = _ostree_bootconfig_parser_new_from_variant (bootconfig_v);
+      if (!set_deployment_bootconfig (deployment, bootconfig, &local_error))
+        {
+          g_debug ("Invalid bootconfig in deployments cache: %s", local_error->message);
+          return NULL;
+        }
+
+      if (is_booted)
+        booted = g_object_ref (deployment);
+      g_ptr_array_add (deployments, g_steal_pointer (&deployment));
+    }
+
+  g_debug ("Loaded %u deployments from cache", deployments->len);
+  self->booted_deployment = g_steal_pointer (&booted);
+  return g_steal_pointer (&deployments);
+}
+
+/* Write the freshly parsed deployment list to the cache.  This is purely an
+ * optimization, so failures (e.g. we're not running as root) are ignored.
+ */
+static void
+deployments_cache_store (OstreeSysroot *self, GVariant *key, GPtrArray *deployments)
+{
+  g_auto (GVariantBuilder) builder = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&builder, (GVariantType *)"a" DEPLOYMENTS_CACHE_ENTRY_GVARIANT_FORMAT);
+  for (guint i = 0; i < deployments->len; i++)
+    {
+      OstreeDeployment *deployment = deployments->pdata[i];
+      GKeyFile *origin = ostree_deployment_get_origin (deployment);
+      g_autofree char *origin_data = origin ? g_key_file_to_data (origin, NULL, NULL) : NULL;
+      g_variant_builder_add (
+          &builder, "(ssisiib@" _OSTREE_BOOTCONFIG_PARSER_GVARIANT_FORMAT "s)",
+          ostree_deployment_get_osname (deployment), ostree_deployment_get_csum (deployment),
+          ostree_deployment_get_deployserial (deployment),
+          ostree_deployment_get_bootcsum (deployment),
+          ostree_deployment_get_bootserial (deployment), (int)deployment->unlocked,
+          deployment == self->booted_deployment,
+          _ostree_bootconfig_parser_to_variant (ostree_deployment_get_bootconfig (deployment)),
+          origin_data ?: "");
+    }
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (
+      g_variant_new ("(@a{sv}@a" DEPLOYMENTS_CACHE_ENTRY_GVARIANT_FORMAT ")", key,
+                     g_variant_builder_end (&builder)));
+  g_autoptr (GError) local_error = NULL;
+  if (!glnx_file_replace_contents_at (
+          deployments_cache_dfd (self),
+          deployments_cache_path (self, _OSTREE_SYSROOT_RUNSTATE_DEPLOYMENTS_CACHE),
+          g_variant_get_data (cache), g_variant_get_size (cache), GLNX_FILE_REPLACE_NODATASYNC,
+          NULL, &local_error))
+    g_debug ("Failed to write deployments cache: %s", local_error->message);
+}
+
 /* Loads the current bootversion, subbootversion, and deployments, starting from the
  * bootloader configs which are the source of truth.
  */
@@ -1146,25 +1354,50 @@ sysroot_load_from_bootloader_configs (OstreeSysroot *self, GCancellable *cancell
                                                     error))
     return FALSE;
 
-  g_autoptr (GPtrArray) boot_loader_configs = NULL;
-  if (!_ostree_sysroot_read_boot_loader_configs (self, bootversion, &boot_loader_configs,
-                                                 cancellable, error))
-    return FALSE;
-
-  g_autoptr (GPtrArray) deployments
-      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  /* When booted, we keep a serialized copy of the deployment list in /run so
+   * that repeated loads by e.g. `ostree admin status` and rpm-ostreed don't
+   * need to re-parse every BLS entry and origin file.
+   */
+  const gboolean test_cache
+      = (self->debug_flags & OSTREE_SYSROOT_DEBUG_TEST_DEPLOYMENTS_CACHE) > 0;
+  g_autoptr (GVariant) cache_key = NULL;
+  g_autoptr (GPtrArray) deployments = NULL;
+  if (self->root_is_ostree_booted || test_cache)
+    {
+      /* The cache is only an optimization; if we can't validate it, parse */
+      g_autoptr (GError) local_error = NULL;
+      if (deployments_cache_compute_key (self, bootversion, subbootversion, &cache_key,
+                                         &local_error))
+        deployments = deployments_cache_load (self, cache_key);
+      else
+        g_debug ("Not using deployments cache: %s", local_error->message);
+    }
 
-  g_assert (boot_loader_configs); /* Pacify static analysis */
-  for (guint i = 0; i < boot_loader_configs->len; i++)
+  if (!deployments)
     {
-      OstreeBootconfigParser *config = boot_loader_configs->pdata[i];
+      g_autoptr (GPtrArray) boot_loader_configs = NULL;
+      if (!_ostree_sysroot_read_boot_loader_configs (self, bootversion, &boot_loader_configs,
+                                                     cancellable, error))
+        return FALSE;
+
+      deployments = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
 
-      /* Note this also sets self->booted_deployment */
-      if (!list_deployments_process_one_boot_entry (self, config, deployments, cancellable, error))
+      g_assert (boot_loader_configs); /* Pacify static analysis */
+      for (guint i = 0; i < boot_loader_configs->len; i++)
         {
-          g_clear_object (&self->booted_deployment);
-          return FALSE;
+          OstreeBootconfigParser *config = boot_loader_configs->pdata[i];
+
+          /* Note this also sets self->booted_deployment */
+          if (!list_deployments_process_one_boot_entry (self, config, deployments, cancellable,
+                                                        error))
+            {
+              g_clear_object (&self->booted_deployment);
+              return FALSE;
+            }
         }
+
+      if (cache_key && (self->booted_deployment || test_cache))
+        deployments_cache_store (self, cache_key, deployments);
     }
 
   if (self->root_is_ostree_booted && !self->booted_deployment)
@@ -120,6 +120,10 @@ gboolean ostree_sysroot_init_osname (OstreeSysroot *self, const char *osname,
 _OSTREE_PUBLIC
 gboolean ostree_sysroot_cleanup (OstreeSysroot *self, GCancellable *cancellable, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_sysroot_empty_deployment_trash (OstreeSysroot *self, GCancellable *cancellable,
+                                                GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_sysroot_prepare_cleanup (OstreeSysroot *self, GCancellable *cancellable,
                                          GError **error);
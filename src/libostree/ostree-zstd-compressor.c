@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ostree-zstd-compressor.h"
+
+#include <string.h>
+#include <zstd.h>
+
+enum
+{
+  PROP_0,
+  PROP_PARAMS
+};
+
+/**
+ * SECTION:ostree-zstd-compressor
+ * @title: Zstandard compressor
+ *
+ * An implementation of #GConverter that compresses data into a single
+ * Zstandard frame.
+ *
+ * The optional params are an a{sv} with:
+ *   - level: i: Compression level.  Default is the zstd default (3).
+ */
+
+static void _ostree_zstd_compressor_iface_init (GConverterIface *iface);
+
+struct _OstreeZstdCompressor
+{
+  GObject parent_instance;
+
+  GVariant *params;
+  ZSTD_CCtx *cctx;
+};
+
+G_DEFINE_TYPE_WITH_CODE (OstreeZstdCompressor, _ostree_zstd_compressor, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER,
+                                                _ostree_zstd_compressor_iface_init))
+
+static void
+_ostree_zstd_compressor_finalize (GObject *object)
+{
+  OstreeZstdCompressor *self = OSTREE_ZSTD_COMPRESSOR (object);
+
+  ZSTD_freeCCtx (self->cctx);
+  g_clear_pointer (&self->params, g_variant_unref);
+
+  G_OBJECT_CLASS (_ostree_zstd_compressor_parent_class)->finalize (object);
+}
+
+static void
+_ostree_zstd_compressor_set_property (GObject *object, guint prop_id, const GValue *value,
+                                      GParamSpec *pspec)
+{
+  OstreeZstdCompressor *self = OSTREE_ZSTD_COMPRESSOR (object);
+
+  switch (prop_id)
+    {
+    case PROP_PARAMS:
+      self->params = g_value_dup_variant (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+_ostree_zstd_compressor_get_property (GObject *object, guint prop_id, GValue *value,
+                                      GParamSpec *pspec)
+{
+  OstreeZstdCompressor *self = OSTREE_ZSTD_COMPRESSOR (object);
+
+  switch (prop_id)
+    {
+    case PROP_PARAMS:
+      g_value_set_variant (value, self->params);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+_ostree_zstd_compressor_init (OstreeZstdCompressor *self)
+{
+}
+
+static void
+_ostree_zstd_compressor_class_init (OstreeZstdCompressorClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = _ostree_zstd_compressor_finalize;
+  gobject_class->get_property = _ostree_zstd_compressor_get_property;
+  gobject_class->set_property = _ostree_zstd_compressor_set_property;
+
+  g_object_class_install_property (
+      gobject_class, PROP_PARAMS,
+      g_param_spec_variant ("params", "", "", G_VARIANT_TYPE ("a{sv}"), NULL,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+}
+
+OstreeZstdCompressor *
+_ostree_zstd_compressor_new (GVariant *params)
+{
+  return g_object_new (OSTREE_TYPE_ZSTD_COMPRESSOR, "params", params, NULL);
+}
+
+static void
+_ostree_zstd_compressor_reset (GConverter *converter)
+{
+  OstreeZstdCompressor *self = OSTREE_ZSTD_COMPRESSOR (converter);
+
+  if (self->cctx)
+    (void)ZSTD_CCtx_reset (self->cctx, ZSTD_reset_session_only);
+}
+
+static GConverterResult
+_ostree_zstd_compressor_convert (GConverter *converter, const void *inbuf, gsize inbuf_size,
+                                 void *outbuf, gsize outbuf_size, GConverterFlags flags,
+                                 gsize *bytes_read, gsize *bytes_written, GError **error)
+{
+  OstreeZstdCompressor *self = OSTREE_ZSTD_COMPRESSOR (converter);
+
+  if (inbuf_size != 0 && outbuf_size == 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Output buffer too small");
+      return G_CONVERTER_ERROR;
+    }
+
+  if (!self->cctx)
+    {
+      gint32 level = ZSTD_CLEVEL_DEFAULT;
+      if (self->params)
+        (void)g_variant_lookup (self->params, "level", "i", &level);
+
+      self->cctx = ZSTD_createCCtx ();
+      if (!self->cctx)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Out of memory");
+          return G_CONVERTER_ERROR;
+        }
+      size_t res = ZSTD_CCtx_setParameter (self->cctx, ZSTD_c_compressionLevel, level);
+      if (!ZSTD_isError (res))
+        res = ZSTD_CCtx_setParameter (self->cctx, ZSTD_c_checksumFlag, 1);
+      if (ZSTD_isError (res))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "zstd: %s",
+                       ZSTD_getErrorName (res));
+          return G_CONVERTER_ERROR;
+        }
+    }
+
+  ZSTD_EndDirective mode = ZSTD_e_continue;
+  if (flags & G_CONVERTER_INPUT_AT_END)
+    mode = ZSTD_e_end;
+  else if (flags & G_CONVERTER_FLUSH)
+    mode = ZSTD_e_flush;
+
+  ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+  ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+  /* For the end and flush directives, this is the amount of data still
+   * buffered inside the context */
+  size_t remaining = ZSTD_compressStream2 (self->cctx, &out, &in, mode);
+  if (ZSTD_isError (remaining))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "zstd: %s",
+                   ZSTD_getErrorName (remaining));
+      return G_CONVERTER_ERROR;
+    }
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  if (mode == ZSTD_e_end && remaining == 0)
+    return G_CONVERTER_FINISHED;
+  else if (mode == ZSTD_e_flush && remaining == 0)
+    return G_CONVERTER_FLUSHED;
+  return G_CONVERTER_CONVERTED;
+}
+
+static void
+_ostree_zstd_compressor_iface_init (GConverterIface *iface)
+{
+  iface->convert = _ostree_zstd_compressor_convert;
+  iface->reset = _ostree_zstd_compressor_reset;
+}
@@ -27,7 +27,12 @@
 
 #include <glib/gi18n.h>
 
-static GOptionEntry options[] = { { NULL } };
+static gboolean opt_deployment_trash;
+
+static GOptionEntry options[]
+    = { { "deployment-trash", 0, 0, G_OPTION_ARG_NONE, &opt_deployment_trash,
+          "Only delete previously removed deployments, without locking the sysroot", NULL },
+        { NULL } };
 
 gboolean
 ot_admin_builtin_cleanup (int argc, char **argv, OstreeCommandInvocation *invocation,
@@ -35,13 +40,34 @@ ot_admin_builtin_cleanup (int argc, char **argv, OstreeCommandInvocation *invoca
 {
   g_autoptr (GOptionContext) context = g_option_context_new ("");
 
+  /* We load the sysroot ourselves, as --deployment-trash doesn't lock it */
   g_autoptr (OstreeSysroot) sysroot = NULL;
-  if (!ostree_admin_option_context_parse (context, options, &argc, &argv,
-                                          OSTREE_ADMIN_BUILTIN_FLAG_SUPERUSER, invocation, &sysroot,
-                                          cancellable, error))
+  if (!ostree_admin_option_context_parse (
+          context, options, &argc, &argv,
+          OSTREE_ADMIN_BUILTIN_FLAG_SUPERUSER | OSTREE_ADMIN_BUILTIN_FLAG_NO_LOAD, invocation,
+          &sysroot, cancellable, error))
     return FALSE;
 
-  if (!ostree_sysroot_cleanup (sysroot, cancellable, error))
+  if (opt_deployment_trash)
+    {
+      if (!ostree_sysroot_initialize_with_mount_namespace (sysroot, cancellable, error))
+        return FALSE;
+    }
+  else
+    {
+      if (!ostree_admin_sysroot_load (sysroot, OSTREE_ADMIN_BUILTIN_FLAG_SUPERUSER, cancellable,
+                                      error))
+        return FALSE;
+
+      if (!ostree_sysroot_cleanup (sysroot, cancellable, error))
+        return FALSE;
+
+      /* Removed deployments were only moved aside; delete them without
+       * blocking other sysroot operations */
+      ostree_sysroot_unlock (sysroot);
+    }
+
+  if (!ostree_sysroot_empty_deployment_trash (sysroot, cancellable, error))
     return FALSE;
 
   return TRUE;
@@ -28,6 +28,7 @@
 static gboolean opt_stats;
 static gboolean opt_fs_diff;
 static gboolean opt_no_xattrs;
+static gboolean opt_stream;
 static gint opt_owner_uid = -1;
 static gint opt_owner_gid = -1;
 
@@ -45,15 +46,23 @@ static GOptionEntry options[]
           "Use file ownership user id for local files", "UID" },
         { "owner-gid", 0, 0, G_OPTION_ARG_INT, &opt_owner_gid,
           "Use file ownership group id for local files", "GID" },
+        { "stream", 0, 0, G_OPTION_ARG_NONE, &opt_stream,
+          "Compare two revisions by stored checksums, printing changes as they are found", NULL },
         { NULL } };
 
+static gboolean
+is_commit_arg (const char *arg)
+{
+  return !(g_str_has_prefix (arg, "/") || g_str_has_prefix (arg, "./"));
+}
+
 static gboolean
 parse_file_or_commit (OstreeRepo *repo, const char *arg, GFile **out_file,
                       GCancellable *cancellable, GError **error)
 {
   g_autoptr (GFile) ret_file = NULL;
 
-  if (g_str_has_prefix (arg, "/") || g_str_has_prefix (arg, "./"))
+  if (!is_commit_arg (arg))
     {
       ret_file = g_file_new_for_path (arg);
     }
@@ -67,6 +76,28 @@ parse_file_or_commit (OstreeRepo *repo, const char *arg, GFile **out_file,
   return TRUE;
 }
 
+static gboolean
+print_diff_change (const OstreeDiffChange *change, gpointer user_data, GError **error)
+{
+  char prefix;
+
+  switch (change->change_type)
+    {
+    case OSTREE_DIFF_CHANGE_ADDED:
+      prefix = 'A';
+      break;
+    case OSTREE_DIFF_CHANGE_REMOVED:
+      prefix = 'D';
+      break;
+    default:
+      prefix = 'M';
+      break;
+    }
+
+  g_print ("%c    %s\n", prefix, change->path);
+  return TRUE;
+}
+
 static GHashTable *
 reachable_set_intersect (GHashTable *a, GHashTable *b)
 {
@@ -155,7 +186,22 @@ ostree_builtin_diff (int argc, char **argv, OstreeCommandInvocation *invocation,
   g_autoptr (GPtrArray) removed = NULL;
   g_autoptr (GPtrArray) added = NULL;
 
-  if (opt_fs_diff)
+  if (opt_stream && !(is_commit_arg (src) && is_commit_arg (target)))
+    return glnx_throw (error, "--stream requires two revisions");
+  if (opt_stream && opt_no_xattrs)
+    return glnx_throw (error, "--stream cannot be used with --no-xattrs");
+
+  /* Two commits can be compared by their dirtree checksums, without
+   * walking unchanged subdirectories; the ownership options only apply to
+   * local files.
+   */
+  if (opt_fs_diff && opt_stream)
+    {
+      if (!ostree_diff_commits (repo, OSTREE_DIFF_FLAGS_NONE, src, target, print_diff_change, NULL,
+                                cancellable, error))
+        return FALSE;
+    }
+  else if (opt_fs_diff)
     {
       OstreeDiffFlags diff_flags = OSTREE_DIFF_FLAGS_NONE;
 
@@ -33,6 +33,7 @@ static gchar *opt_finders = NULL;
 static gboolean opt_disable_fsync = FALSE;
 static gboolean opt_pull = FALSE;
 static gboolean opt_mirror = FALSE;
+static gboolean opt_stripe_mirrors = FALSE;
 
 static GOptionEntry options[]
     = { { "cache-dir", 0, 0, G_OPTION_ARG_FILENAME, &opt_cache_dir, "Use custom cache dir", NULL },
@@ -43,6 +44,8 @@ static GOptionEntry options[]
         { "pull", 0, 0, G_OPTION_ARG_NONE, &opt_pull, "Pull the updates after finding them", NULL },
         { "mirror", 0, 0, G_OPTION_ARG_NONE, &opt_mirror,
           "Do a mirror pull (see ostree pull --mirror)", NULL },
+        { "stripe-mirrors", 0, 0, G_OPTION_ARG_NONE, &opt_stripe_mirrors,
+          "Fetch objects from all remotes with the same commits at once", NULL },
         { NULL } };
 
 static gchar *
@@ -212,6 +215,13 @@ ostree_builtin_find_remotes (int argc, char **argv, OstreeCommandInvocation *inv
       return FALSE;
     }
 
+  if (opt_stripe_mirrors && !opt_pull)
+    {
+      ot_util_usage_error (context, "When --stripe-mirrors is specified, --pull must also be",
+                           error);
+      return FALSE;
+    }
+
   if (opt_disable_fsync)
     ostree_repo_set_disable_fsync (repo, TRUE);
 
@@ -371,6 +381,9 @@ ostree_builtin_find_remotes (int argc, char **argv, OstreeCommandInvocation *inv
       g_variant_builder_add (
           &builder, "{s@v}", "flags",
           g_variant_new_variant (g_variant_new_int32 (OSTREE_REPO_PULL_FLAGS_MIRROR)));
+    if (opt_stripe_mirrors)
+      g_variant_builder_add (&builder, "{s@v}", "stripe-mirrors",
+                             g_variant_new_variant (g_variant_new_boolean (TRUE)));
 
     pull_options = g_variant_ref_sink (g_variant_builder_end (&builder));
   }
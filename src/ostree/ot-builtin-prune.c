@@ -123,14 +123,15 @@ traverse_keep_younger_than (OstreeRepo *repo, const char *checksum, struct times
 
   while (TRUE)
     {
-      g_autoptr (GVariant) commit = NULL;
-      if (!ostree_repo_load_variant_if_exists (repo, OSTREE_OBJECT_TYPE_COMMIT, next_checksum,
-                                               &commit, error))
+      gboolean exists;
+      guint64 commit_timestamp;
+      g_autofree char *parent = NULL;
+      if (!ostree_repo_lookup_commit_graph (repo, next_checksum, &exists, &parent,
+                                            &commit_timestamp, NULL, cancellable, error))
         return FALSE;
-      if (!commit)
+      if (!exists)
         break; /* This commit was pruned, so we're done */
 
-      guint64 commit_timestamp = ostree_commit_get_timestamp (commit);
       /* Is this commit newer than our --keep-younger-than spec? */
       if (commit_timestamp >= ts->tv_sec)
         {
@@ -140,10 +141,8 @@ traverse_keep_younger_than (OstreeRepo *repo, const char *checksum, struct times
             return FALSE;
 
           g_free (next_checksum);
-          next_checksum = ostree_commit_get_parent (commit);
-          if (next_checksum)
-            g_clear_pointer (&commit, g_variant_unref);
-          else
+          next_checksum = g_steal_pointer (&parent);
+          if (!next_checksum)
             break; /* No parent, we're done */
         }
       else
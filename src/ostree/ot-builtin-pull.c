@@ -39,6 +39,8 @@ static gboolean opt_disable_verify_bindings;
 static char *opt_timestamp_check_from_rev;
 static gboolean opt_bareuseronly_files;
 static gboolean opt_retry_all;
+static gboolean opt_stripe_mirrors;
+static char *opt_trace_file;
 static char **opt_subpaths;
 static char **opt_http_headers;
 static char *opt_cache_dir;
@@ -114,6 +116,10 @@ static GOptionEntry options[]
           "Require fetched commits to have newer timestamps than given rev", NULL },
         { "disable-verify-bindings", 0, 0, G_OPTION_ARG_NONE, &opt_disable_verify_bindings,
           "Do not verify commit bindings", NULL },
+        { "stripe-mirrors", 0, 0, G_OPTION_ARG_NONE, &opt_stripe_mirrors,
+          "Fetch objects from all content mirrors at once", NULL },
+        { "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace_file,
+          "Write a Chrome trace of request timings to FILE", "FILE" },
         /* let's leave this hidden for now; we just need it for tests */
         { "append-user-agent", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &opt_append_user_agent,
           "Append string to user agent", NULL },
@@ -390,6 +396,12 @@ ostree_builtin_pull (int argc, char **argv, OstreeCommandInvocation *invocation,
     if (opt_per_object_fsync)
       g_variant_builder_add (&builder, "{s@v}", "per-object-fsync",
                              g_variant_new_variant (g_variant_new_boolean (TRUE)));
+    if (opt_stripe_mirrors)
+      g_variant_builder_add (&builder, "{s@v}", "stripe-mirrors",
+                             g_variant_new_variant (g_variant_new_boolean (TRUE)));
+    if (opt_trace_file)
+      g_variant_builder_add (&builder, "{s@v}", "trace-file",
+                             g_variant_new_variant (g_variant_new_string (opt_trace_file)));
     g_variant_builder_add (
         &builder, "{s@v}", "disable-verify-bindings",
         g_variant_new_variant (g_variant_new_boolean (opt_disable_verify_bindings)));
@@ -28,13 +28,19 @@ static char *opt_from_rev;
 static char *opt_to_rev;
 static char *opt_min_fallback_size;
 static char *opt_max_bsdiff_size;
+static char *opt_max_bsdiff_memory;
 static char *opt_max_chunk_size;
+static char *opt_lzma_threads;
+static char *opt_lzma_block_size;
+static char *opt_compression;
+static char *opt_zstd_max_overhead;
 static char *opt_endianness;
 static char *opt_filename;
 static gboolean opt_empty;
 static gboolean opt_swap_endianness;
 static gboolean opt_inline;
 static gboolean opt_disable_bsdiff;
+static gboolean opt_rollsum_bupsplit;
 static gboolean opt_if_not_exists;
 static char **opt_key_ids;
 static char *opt_sign_name;
@@ -85,6 +91,8 @@ static GOptionEntry generate_options[] = {
   { "inline", 0, 0, G_OPTION_ARG_NONE, &opt_inline, "Inline delta parts into main delta", NULL },
   { "to", 0, 0, G_OPTION_ARG_STRING, &opt_to_rev, "Create delta to revision REV", "REV" },
   { "disable-bsdiff", 0, 0, G_OPTION_ARG_NONE, &opt_disable_bsdiff, "Disable use of bsdiff", NULL },
+  { "rollsum-bupsplit", 0, 0, G_OPTION_ARG_NONE, &opt_rollsum_bupsplit,
+    "Split files for rollsum matching like older versions", NULL },
   { "if-not-exists", 'n', 0, G_OPTION_ARG_NONE, &opt_if_not_exists,
     "Only generate if a delta does not already exist", NULL },
   { "set-endianness", 0, 0, G_OPTION_ARG_STRING, &opt_endianness,
@@ -95,8 +103,19 @@ static GOptionEntry generate_options[] = {
     "Minimum uncompressed size in megabytes for individual HTTP request", NULL },
   { "max-bsdiff-size", 0, 0, G_OPTION_ARG_STRING, &opt_max_bsdiff_size,
     "Maximum size in megabytes to consider bsdiff compression for input files", NULL },
+  { "max-bsdiff-memory", 0, 0, G_OPTION_ARG_STRING, &opt_max_bsdiff_memory,
+    "Maximum memory in megabytes to use for a single bsdiff", NULL },
   { "max-chunk-size", 0, 0, G_OPTION_ARG_STRING, &opt_max_chunk_size,
     "Maximum size of delta chunks in megabytes", NULL },
+  { "lzma-threads", 0, 0, G_OPTION_ARG_STRING, &opt_lzma_threads,
+    "Number of threads compressing each delta chunk, 0 for one per CPU", NULL },
+  { "lzma-block-size", 0, 0, G_OPTION_ARG_STRING, &opt_lzma_block_size,
+    "Size in megabytes of the blocks compressed in parallel", NULL },
+  { "compression", 0, 0, G_OPTION_ARG_STRING, &opt_compression,
+    "Compression for delta chunks: lzma (default), zstd, auto, or none", "TYPE" },
+  { "zstd-max-overhead", 0, 0, G_OPTION_ARG_STRING, &opt_zstd_max_overhead,
+    "With --compression=auto, use zstd for chunks at most PERCENT larger than with lzma",
+    "PERCENT" },
   { "filename", 0, 0, G_OPTION_ARG_FILENAME, &opt_filename,
     "Write the delta content to PATH (a directory).  If not specified, the OSTree repository is "
     "used",
@@ -375,6 +394,21 @@ ot_static_delta_builtin_generate (int argc, char **argv, OstreeCommandInvocation
       else
         endianness = G_BYTE_ORDER;
 
+      guint8 compression = 'x';
+      if (opt_compression)
+        {
+          if (strcmp (opt_compression, "lzma") == 0)
+            compression = 'x';
+          else if (strcmp (opt_compression, "zstd") == 0)
+            compression = 'z';
+          else if (strcmp (opt_compression, "auto") == 0)
+            compression = 'a';
+          else if (strcmp (opt_compression, "none") == 0)
+            compression = 0;
+          else
+            return glnx_throw (error, "Invalid compression '%s'", opt_compression);
+        }
+
       if (opt_swap_endianness)
         {
           switch (endianness)
@@ -399,13 +433,33 @@ ot_static_delta_builtin_generate (int argc, char **argv, OstreeCommandInvocation
         g_variant_builder_add (
             parambuilder, "{sv}", "max-bsdiff-size",
             g_variant_new_uint32 (g_ascii_strtoull (opt_max_bsdiff_size, NULL, 10)));
+      if (opt_max_bsdiff_memory)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "max-bsdiff-memory",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_max_bsdiff_memory, NULL, 10)));
       if (opt_max_chunk_size)
         g_variant_builder_add (
             parambuilder, "{sv}", "max-chunk-size",
             g_variant_new_uint32 (g_ascii_strtoull (opt_max_chunk_size, NULL, 10)));
+      if (opt_lzma_threads)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "lzma-threads",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_lzma_threads, NULL, 10)));
+      if (opt_lzma_block_size)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "lzma-block-size",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_lzma_block_size, NULL, 10)));
+      g_variant_builder_add (parambuilder, "{sv}", "compression", g_variant_new_byte (compression));
+      if (opt_zstd_max_overhead)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "zstd-max-overhead",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_zstd_max_overhead, NULL, 10)));
       if (opt_disable_bsdiff)
         g_variant_builder_add (parambuilder, "{sv}", "bsdiff-enabled",
                                g_variant_new_boolean (FALSE));
+      if (opt_rollsum_bupsplit)
+        g_variant_builder_add (parambuilder, "{sv}", "rollsum-bupsplit",
+                               g_variant_new_boolean (TRUE));
       if (opt_inline)
         g_variant_builder_add (parambuilder, "{sv}", "inline-parts", g_variant_new_boolean (TRUE));
       if (opt_filename)
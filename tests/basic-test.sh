@@ -19,7 +19,7 @@
 
 set -euo pipefail
 
-echo "1..$((90 + ${extra_basic_tests:-0}))"
+echo "1..$((93 + ${extra_basic_tests:-0}))"
 
 CHECKOUT_U_ARG=""
 CHECKOUT_H_ARGS="-H"
@@ -97,6 +97,16 @@ $OSTREE rev-parse 'test2^'
 $OSTREE rev-parse 'test2^^' 2>/dev/null && fatal "rev-parse test2^^ unexpectedly succeeded!"
 echo "ok rev-parse"
 
+test -f repo/state/commit-graph
+parent=$($OSTREE rev-parse 'test2^')
+# A missing or stale commit graph falls back to loading the commits
+rm repo/state/commit-graph
+assert_streq "$($OSTREE rev-parse 'test2^')" "${parent}"
+echo "garbage" > repo/state/commit-graph
+assert_streq "$($OSTREE rev-parse 'test2^')" "${parent}"
+$OSTREE rev-parse 'test2^^' 2>/dev/null && fatal "rev-parse test2^^ unexpectedly succeeded!"
+echo "ok commit graph"
+
 if $OSTREE rev-parse -S 2>err.txt; then
     fatal "rev parse multiple"
 fi
@@ -324,6 +334,35 @@ assert_file_has_content diff-test2 'A */yet/message$'
 assert_file_has_content diff-test2 'A */yet/another/tree/green$'
 echo "ok diff revisions"
 
+cd ${test_tmpdir}
+$OSTREE diff test2 test2^ > diff-test2-reverse
+assert_file_has_content diff-test2-reverse 'A */a/5$'
+assert_file_has_content diff-test2-reverse 'D */yet$'
+assert_not_file_has_content diff-test2-reverse 'D */yet/another/tree/green$'
+$OSTREE diff --stream test2 test2^ > diff-test2-reverse
+assert_file_has_content diff-test2-reverse 'A */a/5$'
+assert_file_has_content diff-test2-reverse 'D */yet$'
+assert_file_has_content diff-test2-reverse 'D */yet/another/tree/green$'
+rm -rf test2-typechange
+$OSTREE checkout test2 test2-typechange
+rm test2-typechange/four
+mkdir test2-typechange/four
+echo other > test2-typechange/four/other
+$OSTREE commit ${COMMIT_ARGS} -b test2-typechange --tree=dir=test2-typechange
+$OSTREE diff test2 test2-typechange > diff-test2-typechange
+assert_file_has_content diff-test2-typechange 'M */four$'
+assert_not_file_has_content diff-test2-typechange 'A */four/other$'
+$OSTREE diff --stream test2 test2-typechange > diff-test2-typechange
+assert_file_has_content diff-test2-typechange 'M */four$'
+assert_file_has_content diff-test2-typechange 'A */four/other$'
+if $OSTREE diff --stream test2 ./ 2>err.txt; then
+    fatal "diff --stream with a directory succeeded"
+fi
+assert_file_has_content err.txt 'requires two revisions'
+$OSTREE refs --delete test2-typechange
+rm -rf test2-typechange
+echo "ok diff revisions prunes unchanged directories"
+
 cd ${test_tmpdir}/checkout-test2-4
 echo afile > oh-look-a-file
 $OSTREE diff ${DIFF_ARGS} test2 ./ > ${test_tmpdir}/diff-test2-2
@@ -1102,6 +1141,35 @@ if ! is_bare_user_only_repo repo; then
 fi
 echo "ok disable cache checkout"
 
+cd ${test_tmpdir}
+# Writing through a -U checkout modifies the shared cache entry; object reads
+# must not see that
+rm -rf test2-checkout
+${CMD_PREFIX} ostree --repo=repo2 checkout -U test2 test2-checkout
+echo modified > test2-checkout/baz/cow
+${CMD_PREFIX} ostree --repo=repo2 cat test2 /baz/cow > cow.txt
+assert_file_has_content cow.txt moo
+${CMD_PREFIX} ostree --repo=repo2 fsck
+rm -rf test2-checkout
+rm -rf repo2/uncompressed-objects-cache
+rm -rf bigfiles bigfiles-checkout
+mkdir bigfiles
+head -c 786432 /dev/urandom > bigfiles/a
+head -c 786432 /dev/urandom > bigfiles/b
+${CMD_PREFIX} ostree --repo=repo2 commit -b bigfiles --tree=dir=bigfiles
+${CMD_PREFIX} ostree --repo=repo2 config set core.uncompressed-cache-max-size 1MB
+${CMD_PREFIX} ostree --repo=repo2 checkout -U bigfiles bigfiles-checkout
+rm -rf bigfiles-checkout
+# Adding an object to the cache evicts one of the now unused ones
+head -c 4096 /dev/urandom > bigfiles/c
+${CMD_PREFIX} ostree --repo=repo2 commit -b bigfiles --tree=dir=bigfiles
+${CMD_PREFIX} ostree --repo=repo2 checkout -U --subpath=/c bigfiles bigfiles-c
+unused_size=$(find repo2/uncompressed-objects-cache -type f -links 1 -printf '%s\n' | awk '{ s += $1 } END { print s + 0 }')
+assert_streq "$(( unused_size <= 1048576 && unused_size >= 786432 ))" 1
+${CMD_PREFIX} ostree --repo=repo2 config unset core.uncompressed-cache-max-size
+rm -rf bigfiles bigfiles-c
+echo "ok uncompressed cache max size"
+
 cd ${test_tmpdir}
 rm checkout-test2 -rf
 $OSTREE checkout test2 checkout-test2
@@ -0,0 +1,68 @@
+#!/bin/bash
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libbench.sh
+
+# Generate and apply static deltas between a tree and a modified version
+# of it, comparing compressions and the rollsum and bsdiff strategies.
+
+compressions="lzma"
+if has_ostree_feature zstd; then
+    compressions="${compressions} zstd auto"
+fi
+
+for shape in ${BENCH_DELTA_SHAPES:-small huge}; do
+    bench_gen_tree_pair ${shape}
+
+    ostree --repo=repo init --mode=archive
+    from=$(ostree --repo=repo commit -b main --tree=dir=tree-${shape})
+    to=$(ostree --repo=repo commit -b main --tree=dir=tree-${shape}-2)
+    rm -rf tree-${shape} tree-${shape}-2
+
+    # The client has the old commit, and applies the delta to get the new one
+    ostree --repo=repo-client-orig init --mode=bare-user
+    ostree --repo=repo-client-orig pull-local repo ${from}
+
+    for compression in ${compressions}; do
+        mkdir delta-${compression}
+        bench_time delta-generate/${shape}/${compression} \
+            ostree --repo=repo static-delta generate --compression=${compression} \
+            --from=${from} --to=${to} --filename=delta-${compression}/superblock
+        bench_size delta/${shape}/${compression}/size delta-${compression}
+
+        cp -a repo-client-orig repo-client
+        bench_time delta-apply/${shape}/${compression} \
+            ostree --repo=repo-client static-delta apply-offline delta-${compression}/superblock
+        rm -rf repo-client delta-${compression}
+    done
+
+    # Defaults otherwise, to compare against delta-generate/${shape}/lzma
+    for variant in rollsum-bupsplit disable-bsdiff; do
+        mkdir delta-${variant}
+        bench_time delta-generate/${shape}/${variant} \
+            ostree --repo=repo static-delta generate --${variant} \
+            --from=${from} --to=${to} --filename=delta-${variant}/superblock
+        bench_size delta/${shape}/${variant}/size delta-${variant}
+        rm -rf delta-${variant}
+    done
+
+    rm -rf repo repo-client-orig
+done
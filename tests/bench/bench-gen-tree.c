@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Generate the reproducible synthetic trees used by the benchmarks in
+ * tests/bench.  The content of every file is derived from --seed and its
+ * path, so the same arguments always produce the same tree, and
+ * --mutate=N derives a modified version of it as a later commit would.
+ */
+
+#include "config.h"
+
+#include "libglnx.h"
+#include <glib.h>
+#include <string.h>
+
+static int opt_seed = 1;
+static int opt_mutate;
+static double opt_scale = 1.0;
+
+static GOptionEntry options[] = {
+  { "seed", 0, 0, G_OPTION_ARG_INT, &opt_seed, "Seed for the generated content", "N" },
+  { "mutate", 0, 0, G_OPTION_ARG_INT, &opt_mutate, "Modify the tree, with this seed", "N" },
+  { "scale", 0, 0, G_OPTION_ARG_DOUBLE, &opt_scale, "Multiply file counts and sizes", "FACTOR" },
+  { NULL }
+};
+
+/* The tree being generated; content is seeded from paths relative to it,
+ * so that the same file gets the same content in any output directory.
+ */
+static const char *gen_dir;
+
+static GRand *
+rand_for_path (const char *path, guint32 mutation)
+{
+  const char *relpath = path;
+  if (g_str_has_prefix (path, gen_dir))
+    relpath += strlen (gen_dir);
+  guint32 seed[] = { opt_seed, g_str_hash (relpath), mutation };
+  return g_rand_new_with_seed_array (seed, G_N_ELEMENTS (seed));
+}
+
+/* Half random blocks and half copies of earlier blocks, so the content
+ * compresses and deltas roughly like real binaries do.
+ */
+static void
+fill_content (GRand *rand, guint8 *buf, gsize len)
+{
+  const gsize block = 64;
+
+  for (gsize offset = 0; offset < len; offset += block)
+    {
+      const gsize n = MIN (block, len - offset);
+      if (offset >= block && g_rand_boolean (rand))
+        {
+          gsize src = g_rand_int_range (rand, 0, offset / block) * block;
+          memcpy (buf + offset, buf + src, n);
+        }
+      else
+        {
+          for (gsize i = 0; i < n; i++)
+            buf[offset + i] = g_rand_int (rand);
+        }
+    }
+}
+
+static gboolean
+write_file (const char *path, gsize size, gboolean large, GError **error)
+{
+  g_autoptr (GRand) rand = rand_for_path (path, 0);
+  g_autofree guint8 *buf = g_malloc (size + 4096);
+  gsize len = size;
+
+  fill_content (rand, buf, size);
+
+  if (opt_mutate)
+    {
+      g_autoptr (GRand) mutate_rand = rand_for_path (path, opt_mutate);
+
+      if (large)
+        {
+          /* Scattered small edits, and an insertion shifting what follows */
+          for (gsize i = 0; i < size / 4096; i++)
+            buf[g_rand_int_range (mutate_rand, 0, size)] = g_rand_int (mutate_rand);
+          if (size > 0)
+            {
+              const gsize at = g_rand_int_range (mutate_rand, 0, size);
+              memmove (buf + at + 4096, buf + at, size - at);
+              fill_content (mutate_rand, buf + at, 4096);
+              len += 4096;
+            }
+        }
+      else if (g_rand_int_range (mutate_rand, 0, 10) == 0)
+        fill_content (mutate_rand, buf, size);
+    }
+
+  return glnx_file_replace_contents_at (AT_FDCWD, path, buf, len, GLNX_FILE_REPLACE_NODATASYNC,
+                                        NULL, error);
+}
+
+static guint
+scaled (guint n)
+{
+  return MAX (1, (guint)(n * opt_scale));
+}
+
+/* Many small files of up to 16k, a hundred per directory */
+static gboolean
+gen_small (const char *dir, GError **error)
+{
+  const guint n_files = scaled (20000);
+
+  for (guint i = 0; i < n_files; i++)
+    {
+      g_autofree char *subdir = g_strdup_printf ("%s/d%02x/d%02x", dir, (i / 100) % 256,
+                                                 i / 100 / 256);
+      if (!glnx_shutil_mkdir_p_at (AT_FDCWD, subdir, 0755, NULL, error))
+        return FALSE;
+      g_autofree char *path = g_strdup_printf ("%s/f%u", subdir, i);
+      g_autoptr (GRand) rand = rand_for_path (path, 0);
+      if (!write_file (path, 1 << g_rand_int_range (rand, 0, 15), FALSE, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* A few large files, like shared libraries or firmware */
+static gboolean
+gen_huge (const char *dir, GError **error)
+{
+  const gsize size = 64 * 1024 * 1024 * opt_scale;
+
+  if (!glnx_shutil_mkdir_p_at (AT_FDCWD, dir, 0755, NULL, error))
+    return FALSE;
+  for (guint i = 0; i < 4; i++)
+    {
+      g_autofree char *path = g_strdup_printf ("%s/lib%u.so", dir, i);
+      if (!write_file (path, size, TRUE, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Chains of nested directories with a small file at each level */
+static gboolean
+gen_deep (const char *dir, GError **error)
+{
+  const guint n_chains = scaled (64);
+
+  for (guint i = 0; i < n_chains; i++)
+    {
+      g_autoptr (GString) path = g_string_new (dir);
+      g_string_append_printf (path, "/chain%u", i);
+      for (guint depth = 0; depth < 32; depth++)
+        {
+          g_string_append_printf (path, "/level%u", depth);
+          if (!glnx_shutil_mkdir_p_at (AT_FDCWD, path->str, 0755, NULL, error))
+            return FALSE;
+          g_autofree char *file = g_strconcat (path->str, "/file", NULL);
+          if (!write_file (file, 1024, FALSE, error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* A single directory with many tiny entries */
+static gboolean
+gen_wide (const char *dir, GError **error)
+{
+  const guint n_files = scaled (50000);
+
+  if (!glnx_shutil_mkdir_p_at (AT_FDCWD, dir, 0755, NULL, error))
+    return FALSE;
+  for (guint i = 0; i < n_files; i++)
+    {
+      g_autofree char *path = g_strdup_printf ("%s/entry-%08u", dir, i);
+      if (!write_file (path, 64, FALSE, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr (GError) local_error = NULL;
+  GError **error = &local_error;
+  g_autoptr (GOptionContext) context = g_option_context_new ("small|huge|deep|wide DIR");
+  gboolean ret = FALSE;
+
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, error))
+    goto out;
+
+  if (argc != 3)
+    {
+      glnx_throw (error, "usage: %s [OPTION...] small|huge|deep|wide DIR", g_get_prgname ());
+      goto out;
+    }
+
+  const char *shape = argv[1];
+  const char *dir = argv[2];
+  gen_dir = dir;
+  if (g_str_equal (shape, "small"))
+    ret = gen_small (dir, error);
+  else if (g_str_equal (shape, "huge"))
+    ret = gen_huge (dir, error);
+  else if (g_str_equal (shape, "deep"))
+    ret = gen_deep (dir, error);
+  else if (g_str_equal (shape, "wide"))
+    ret = gen_wide (dir, error);
+  else
+    glnx_throw (error, "Unknown shape '%s'", shape);
+
+out:
+  if (!ret)
+    {
+      g_printerr ("%s\n", local_error->message);
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libbench.sh
+
+# Regenerate the GRUB configuration for a growing number of deployments, with
+# the in-process generator and by executing the ostree-grub-generator script.
+
+# The script isn't executable in the source tree
+generator=${bench_tmpdir}/ostree-grub-generator
+cp ${bench_srcdir}/../../src/boot/grub2/ostree-grub-generator ${generator}
+chmod +x ${generator}
+n_deploys=$(awk "BEGIN { n = int(10 * ${BENCH_SCALE}); print (n > 0 ? n : 1) }")
+
+mkdir -p osdata/usr/bin osdata/usr/etc osdata/usr/lib/modules/6.0.0
+echo "a kernel" > osdata/usr/lib/modules/6.0.0/vmlinuz
+echo "an initramfs" > osdata/usr/lib/modules/6.0.0/initramfs.img
+echo "an executable" > osdata/usr/bin/sh
+echo 'PRETTY_NAME="Benchmark OS"' > osdata/usr/etc/os-release
+
+# Deployments in an unprivileged sysroot need to be mutable
+export OSTREE_SYSROOT_DEBUG=mutable-deployments
+export OSTREE_BOOT_PARTITION=/boot
+
+for mode in builtin script; do
+    rm -rf sysroot-${mode}
+    mkdir sysroot-${mode}
+    ostree admin init-fs sysroot-${mode}
+    ostree admin --sysroot=sysroot-${mode} stateroot-init benchos
+    mkdir -p sysroot-${mode}/boot/grub2
+    ln -s ../loader/grub.cfg sysroot-${mode}/boot/grub2/grub.cfg
+    ostree --repo=sysroot-${mode}/ostree/repo commit -b benchos --tree=dir=osdata
+done
+
+deploy_all() {
+    for i in $(seq ${n_deploys}); do
+        ostree admin --sysroot=sysroot-$1 deploy --os=benchos --retain benchos
+    done
+}
+
+OSTREE_GRUB2_EXEC=builtin bench_time grub2/deploy/builtin deploy_all builtin
+OSTREE_GRUB2_EXEC=${generator} bench_time grub2/deploy/script deploy_all script
@@ -0,0 +1,79 @@
+#!/bin/bash
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libbench.sh
+
+# Time the core repository operations on each shape of tree
+
+for shape in ${BENCH_SHAPES}; do
+    bench_gen_tree_pair ${shape}
+    bench_size tree/${shape}/size tree-${shape}
+
+    for mode in archive bare-user; do
+        ostree --repo=repo-${mode} init --mode=${mode}
+        bench_time commit/${shape}/${mode} \
+            ostree --repo=repo-${mode} commit -b main --tree=dir=tree-${shape}
+        bench_time commit-modified/${shape}/${mode} \
+            ostree --repo=repo-${mode} commit -b main --tree=dir=tree-${shape}-2
+    done
+    bench_size repo/${shape}/archive/size repo-archive/objects
+
+    if has_ostree_feature composefs; then
+        bench_time commit-composefs/${shape} \
+            ostree --repo=repo-bare-user commit -b composefs --generate-composefs-metadata \
+            --tree=dir=tree-${shape}
+    fi
+
+    if has_ostree_feature libarchive; then
+        tar -C tree-${shape} -cf tree.tar .
+        ostree --repo=repo-tar init --mode=bare-user
+        bench_time commit-tar/${shape} ostree --repo=repo-tar commit -b main --tree=tar=tree.tar
+        rm -rf tree.tar repo-tar
+    fi
+
+    bench_time checkout/${shape}/hardlink \
+        ostree --repo=repo-bare-user checkout -U --require-hardlinks main co-hardlink
+    bench_time checkout/${shape}/copy \
+        ostree --repo=repo-bare-user checkout -U --force-copy main co-copy
+    bench_time checkout/${shape}/user ostree --repo=repo-archive checkout -U main co-user
+    rm -rf co-hardlink co-copy co-user
+
+    ostree --repo=repo-pull-local init --mode=archive
+    bench_time pull-local/${shape} ostree --repo=repo-pull-local pull-local repo-archive main
+    rm -rf repo-pull-local
+
+    if test -n "${OSTREE_HTTPD}"; then
+        mkdir httpd
+        ln -s ../repo-archive httpd/repo
+        (cd httpd && ${OSTREE_HTTPD} --autoexit --log-file $(pwd)/httpd.log --daemonize \
+                                     -p $(pwd)/httpd-port)
+        ostree --repo=repo-pull init --mode=archive
+        ostree --repo=repo-pull remote add --no-gpg-verify origin \
+            http://127.0.0.1:$(cat httpd/httpd-port)/repo
+        bench_time pull-http/${shape} ostree --repo=repo-pull pull origin main
+        rm -rf repo-pull httpd
+    fi
+
+    bench_time fsck/${shape} ostree --repo=repo-archive fsck
+    bench_time prune/${shape} ostree --repo=repo-archive prune --refs-only --depth=0
+
+    rm -rf tree-${shape} tree-${shape}-2 repo-archive repo-bare-user
+done
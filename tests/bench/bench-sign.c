@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Compare verifying many ed25519 signatures with a single verifier, which
+ * tries the key that verified the previous signature first, against a new
+ * verifier for each signature, with a number of other public keys loaded
+ * as when verifying against a large keyring.  Prints one JSON object per
+ * result, in the format used by tests/bench/libbench.sh.
+ */
+
+#include "config.h"
+
+#include "libglnx.h"
+#include <ostree.h>
+
+static int opt_n_data = 1000;
+static int opt_n_keys = 32;
+
+static GOptionEntry options[]
+    = { { "data", 0, 0, G_OPTION_ARG_INT, &opt_n_data, "Number of signed blobs", "N" },
+        { "keys", 0, 0, G_OPTION_ARG_INT, &opt_n_keys, "Number of other public keys", "N" },
+        { NULL } };
+
+static void
+print_result (const char *name, double value, const char *unit)
+{
+  g_print ("{\"name\": \"%s\", \"value\": %.6f, \"unit\": \"%s\"}\n", name, value, unit);
+}
+
+/* Keys are tried most recently added first, so the signing key is last */
+static gboolean
+load_keys (OstreeSign *sign, const char *public_key, GError **error)
+{
+  g_autoptr (GRand) rand = g_rand_new_with_seed (2);
+
+  if (!ostree_sign_clear_keys (sign, error))
+    return FALSE;
+  g_autoptr (GVariant) pk = g_variant_ref_sink (g_variant_new_string (public_key));
+  if (!ostree_sign_add_pk (sign, pk, error))
+    return FALSE;
+  for (int i = 0; i < opt_n_keys; i++)
+    {
+      guint8 buf[32];
+      for (guint j = 0; j < sizeof (buf); j++)
+        buf[j] = g_rand_int (rand);
+      g_autoptr (GVariant) other_pk = g_variant_ref_sink (
+          g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, buf, sizeof (buf), 1));
+      if (!ostree_sign_add_pk (sign, other_pk, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+run (const char *secret_key, const char *public_key, GError **error)
+{
+  g_autoptr (GRand) rand = g_rand_new_with_seed (1);
+  g_autoptr (OstreeSign) sign = ostree_sign_get_by_name (OSTREE_SIGN_NAME_ED25519, error);
+  if (!sign)
+    return FALSE;
+
+  g_autoptr (GVariant) sk = g_variant_ref_sink (g_variant_new_string (secret_key));
+  if (!ostree_sign_set_sk (sign, sk, error))
+    return FALSE;
+
+  /* Blobs about the size of a commit object */
+  g_autoptr (GPtrArray) data = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+  g_autoptr (GPtrArray) signatures
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+  for (int i = 0; i < opt_n_data; i++)
+    {
+      guint8 buf[512];
+      for (guint j = 0; j < sizeof (buf); j++)
+        buf[j] = g_rand_int (rand);
+      g_autoptr (GBytes) blob = g_bytes_new (buf, sizeof (buf));
+
+      g_autoptr (GBytes) signature = NULL;
+      if (!ostree_sign_data (sign, blob, &signature, NULL, error))
+        return FALSE;
+      GVariant *signature_v = g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, signature, TRUE);
+      GVariant *signatures_v = g_variant_new_array (G_VARIANT_TYPE_BYTESTRING, &signature_v, 1);
+      g_ptr_array_add (signatures, g_variant_ref_sink (signatures_v));
+      g_ptr_array_add (data, g_steal_pointer (&blob));
+    }
+
+  if (!load_keys (sign, public_key, error))
+    return FALSE;
+  gint64 start = g_get_monotonic_time ();
+  for (guint i = 0; i < data->len; i++)
+    {
+      if (!ostree_sign_data_verify (sign, data->pdata[i], signatures->pdata[i], NULL, error))
+        return FALSE;
+    }
+  print_result ("sign/ed25519/verify", (g_get_monotonic_time () - start) / 1e6, "s");
+
+  /* Only time the verification, not setting up the verifiers */
+  gint64 elapsed = 0;
+  for (guint i = 0; i < data->len; i++)
+    {
+      g_autoptr (OstreeSign) verifier = ostree_sign_get_by_name (OSTREE_SIGN_NAME_ED25519, error);
+      if (!verifier || !load_keys (verifier, public_key, error))
+        return FALSE;
+      start = g_get_monotonic_time ();
+      if (!ostree_sign_data_verify (verifier, data->pdata[i], signatures->pdata[i], NULL, error))
+        return FALSE;
+      elapsed += g_get_monotonic_time () - start;
+    }
+  print_result ("sign/ed25519/verify-new-verifier", elapsed / 1e6, "s");
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GOptionContext) context = g_option_context_new ("SECRET-KEY PUBLIC-KEY");
+
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    goto out;
+
+  if (argc != 3)
+    {
+      glnx_throw (&local_error, "usage: %s [OPTION...] SECRET-KEY PUBLIC-KEY", g_get_prgname ());
+      goto out;
+    }
+
+  (void)run (argv[1], argv[2], &local_error);
+
+out:
+  if (local_error)
+    {
+      g_printerr ("%s\n", local_error->message);
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libbench.sh
+
+# Verify many ed25519 signatures, one at a time and as a batch
+
+if ! has_ostree_feature sign-ed25519 || ! command -v openssl > /dev/null; then
+    bench_log "skipping signature benchmarks, no ed25519 support"
+    exit 0
+fi
+
+openssl genpkey -algorithm ed25519 -outform PEM -out ed25519.pem
+public=$(openssl pkey -outform DER -pubout -in ed25519.pem | tail -c 32 | base64)
+seed=$(openssl pkey -outform DER -in ed25519.pem | tail -c 32 | base64)
+secret=$(echo ${seed}${public} | base64 -d | base64 -w 0)
+
+n_data=$(awk "BEGIN { n = int(1000 * ${BENCH_SCALE}); print (n > 0 ? n : 1) }")
+${bench_builddir}/bench-sign --data=${n_data} ${secret} ${public} \
+    | sed -e "s/}\$/, \"iteration\": ${BENCH_ITERATION}}/" >> "${BENCH_RESULTS}"
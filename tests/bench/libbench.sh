@@ -0,0 +1,125 @@
+# Source library for benchmark scripts
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+bench_srcdir=$(cd $(dirname $0) && pwd)
+
+top_builddir="${BENCH_BUILDDIR:-}"
+if test -z "${top_builddir}"; then
+    top_builddir=$(cd ${bench_srcdir}/../.. && pwd)
+fi
+bench_builddir="${top_builddir}/tests/bench"
+
+if test -z "${OSTREE_BIN:-}"; then
+    OSTREE_BIN="${top_builddir}/ostree"
+    if ! [ -x "${OSTREE_BIN}" ]; then
+        OSTREE_BIN=ostree
+    fi
+fi
+
+if test -z "${OSTREE_HTTPD:-}"; then
+    OSTREE_HTTPD="${top_builddir}/ostree-trivial-httpd"
+    if ! [ -x "${OSTREE_HTTPD}" ]; then
+        OSTREE_HTTPD=
+    fi
+fi
+
+# Multiplies file counts and sizes of the generated trees
+BENCH_SCALE="${BENCH_SCALE:-1}"
+BENCH_SHAPES="${BENCH_SHAPES:-small huge deep wide}"
+# One JSON object per line is appended here; run-bench.sh assembles them
+BENCH_RESULTS="${BENCH_RESULTS:-/dev/stdout}"
+BENCH_ITERATION="${BENCH_ITERATION:-1}"
+
+# Default to /var/tmp, which is less likely than /tmp to be a tmpfs
+# without user xattrs, and large enough for the huge trees.
+bench_tmpdir=$(mktemp -d "${BENCH_TMPDIR:-/var/tmp}/ostree-bench.XXXXXX")
+bench_cleanup() {
+    # This also makes any ostree-trivial-httpd --autoexit quit
+    rm -rf "${bench_tmpdir}"
+}
+trap bench_cleanup EXIT
+cd "${bench_tmpdir}"
+
+bench_log() {
+    echo "bench: $@" 1>&2
+}
+
+has_ostree_feature () {
+    local ret=0
+    ${OSTREE_BIN} --version > version.txt
+    grep -q -e "- $1\$" version.txt || ret=$?
+    rm -f version.txt
+    return ${ret}
+}
+
+# bench_record NAME VALUE UNIT
+bench_record() {
+    bench_log "$1: $2 $3"
+    echo "{\"name\": \"$1\", \"value\": $2, \"unit\": \"$3\", \"iteration\": ${BENCH_ITERATION}}" \
+         >> "${BENCH_RESULTS}"
+}
+
+# bench_time NAME COMMAND...: Record the wall clock time of COMMAND
+bench_time() {
+    local name=$1
+    shift
+    sync
+    local start=$(date +%s%N)
+    "$@" > /dev/null
+    local end=$(date +%s%N)
+    bench_record "${name}" $(awk "BEGIN { printf \"%.3f\", (${end} - ${start}) / 1e9 }") s
+}
+
+# bench_size NAME PATH...: Record the total apparent size of PATHs
+bench_size() {
+    local name=$1
+    shift
+    bench_record "${name}" $(du -s --apparent-size --block-size=1 -c "$@" | tail -1 | cut -f1) bytes
+}
+
+# bench_gen_tree SHAPE DIR [OPTION...]: See bench-gen-tree --help
+bench_gen_tree() {
+    local shape=$1 dir=$2
+    shift 2
+    ${bench_builddir}/bench-gen-tree --scale=${BENCH_SCALE} "$@" ${shape} ${dir}
+}
+
+# bench_gen_tree_pair SHAPE: Generate tree-SHAPE, and tree-SHAPE-2 as a
+# modified version of it.  Except in the huge shape, where every file is
+# edited, most files must come out byte-identical in both trees, or the
+# modified commits and deltas would be measuring unrelated content.
+bench_gen_tree_pair() {
+    local shape=$1 f
+    bench_gen_tree ${shape} tree-${shape}
+    bench_gen_tree ${shape} tree-${shape}-2 --mutate=1
+    if [ ${shape} = huge ]; then
+        return 0
+    fi
+    for f in $(cd tree-${shape} && find . -type f | head -100); do
+        if cmp -s tree-${shape}/${f} tree-${shape}-2/${f}; then
+            return 0
+        fi
+    done
+    bench_log "No unmodified file is identical between tree-${shape} and tree-${shape}-2"
+    exit 1
+}
+
+ostree() {
+    ${OSTREE_BIN} "$@"
+}
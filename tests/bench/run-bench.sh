@@ -0,0 +1,73 @@
+#!/bin/bash
+#
+# Copyright (C) Red Hat, Inc.
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+# Run the benchmark suites and write their results as a single JSON
+# document, by default to bench-results.json:
+#
+# {
+#   "version": "2025.2", "revision": "...", "date": "...", "host": "...",
+#   "cpus": 8, "scale": 1,
+#   "results": [ { "name": "commit/small/archive", "value": 1.234, "unit": "s",
+#                  "iteration": 1 }, ... ]
+# }
+#
+# Environment:
+#   BENCH_SUITES: Suites to run (default: "repo delta sign grub2")
+#   BENCH_SHAPES: Trees for the repo suite (default: "small huge deep wide")
+#   BENCH_DELTA_SHAPES: Trees for the delta suite (default: "small huge")
+#   BENCH_SCALE: Multiply generated file counts and sizes (default: 1)
+#   BENCH_ITERATIONS: Number of times to run each suite (default: 1)
+#   BENCH_TMPDIR: Where to create the trees and repositories (default: /var/tmp)
+
+set -euo pipefail
+
+bench_srcdir=$(cd $(dirname $0) && pwd)
+output=$(realpath "${1:-bench-results.json}")
+
+export BENCH_RESULTS=$(mktemp "${output}.XXXXXX")
+trap 'rm -f "${BENCH_RESULTS}"' EXIT
+
+ostree_bin="${BENCH_BUILDDIR:-$(cd ${bench_srcdir}/../.. && pwd)}/ostree"
+if ! [ -x "${ostree_bin}" ]; then
+    ostree_bin=ostree
+fi
+version=$(${ostree_bin} --version | sed -ne "s/^ *Version: '\(.*\)'/\1/p")
+revision=$(git -C ${bench_srcdir} describe --always --dirty 2>/dev/null || echo unknown)
+
+for iteration in $(seq ${BENCH_ITERATIONS:-1}); do
+    for suite in ${BENCH_SUITES:-repo delta sign grub2}; do
+        echo "Running ${suite} benchmarks (iteration ${iteration})" 1>&2
+        BENCH_ITERATION=${iteration} ${bench_srcdir}/bench-${suite}.sh
+    done
+done
+
+{
+    echo "{"
+    echo "  \"version\": \"${version}\","
+    echo "  \"revision\": \"${revision}\","
+    echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+    echo "  \"host\": \"$(uname -srm)\","
+    echo "  \"cpus\": $(nproc),"
+    echo "  \"scale\": ${BENCH_SCALE:-1},"
+    echo "  \"results\": ["
+    sed -e 's/^/    /' -e '$!s/$/,/' "${BENCH_RESULTS}"
+    echo "  ]"
+    echo "}"
+} > "${output}"
+echo "Wrote ${output}" 1>&2
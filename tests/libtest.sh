@@ -396,6 +396,9 @@ setup_os_boot_grub2() {
             chmod +x ${test_tmpdir}/ostree-grub-generator
             export OSTREE_GRUB2_EXEC=${test_tmpdir}/ostree-grub-generator
             ;;
+        *builtin-generator*)
+            export OSTREE_GRUB2_EXEC=builtin
+            ;;
     esac
 }
 
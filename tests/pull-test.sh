@@ -52,7 +52,7 @@ function verify_initial_contents() {
     assert_file_has_content baz/cow '^moo$'
 }
 
-n_base_tests=35
+n_base_tests=36
 gpg_tests=3
 if has_ostree_feature gpgme; then
     echo "1..$(($n_base_tests+$gpg_tests))"
@@ -83,6 +83,17 @@ ${CMD_PREFIX} ostree --repo=repo fsck
 verify_initial_contents
 echo "ok pull --per-object-fsync"
 
+# And record a trace of the request timings
+repo_init --no-sign-verify
+${CMD_PREFIX} ostree --repo=repo pull --trace=${test_tmpdir}/trace.json origin main
+assert_file_has_content ${test_tmpdir}/trace.json '"traceEvents"'
+assert_file_has_content ${test_tmpdir}/trace.json '"name":"fetch"'
+assert_file_has_content ${test_tmpdir}/trace.json '"name":"write"'
+assert_file_has_content ${test_tmpdir}/trace.json '"name":"pull"'
+assert_file_has_content ${test_tmpdir}/trace.json '"droppedEvents":0'
+rm -f ${test_tmpdir}/trace.json
+echo "ok pull --trace"
+
 cd ${test_tmpdir}
 mkdir mirrorrepo
 ostree_repo_init mirrorrepo --mode=archive
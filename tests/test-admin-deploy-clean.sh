@@ -24,7 +24,7 @@ set -euo pipefail
 # Exports OSTREE_SYSROOT so --sysroot not needed.
 setup_os_repository "archive" "syslinux"
 
-echo "1..1"
+echo "1..3"
 
 ${CMD_PREFIX} ostree --repo=sysroot/ostree/repo pull-local --remote=testos testos-repo testos/buildmain/x86_64-runtime
 rev=$(${CMD_PREFIX} ostree --repo=sysroot/ostree/repo rev-parse testos/buildmain/x86_64-runtime)
@@ -35,3 +35,46 @@ ${CMD_PREFIX} ostree --repo=sysroot/ostree/repo refs > refs.txt
 assert_not_file_has_content refs.txt '^ostree/'
 
 echo "ok deploy + undeploy repo prune"
+
+# Undeploying only moves the deployment to the trash, which is emptied
+# outside of the sysroot lock, along with leftovers from an interrupted
+# cleanup
+assert_has_dir sysroot/ostree/deploy-trash/testos-${rev}.0
+${CMD_PREFIX} ostree admin cleanup --deployment-trash
+assert_not_has_dir sysroot/ostree/deploy-trash/testos-${rev}.0
+mkdir -p sysroot/ostree/deploy-trash/testos-leftover.0/usr/bin
+touch sysroot/ostree/deploy-trash/testos-leftover.0/usr/bin/foo
+${CMD_PREFIX} ostree admin deploy --os=testos testos:testos/buildmain/x86_64-runtime
+${CMD_PREFIX} ostree admin undeploy 0
+assert_not_has_dir sysroot/ostree/deploy/testos/deploy/${rev}.0
+assert_has_dir sysroot/ostree/deploy-trash/testos-${rev}.0
+# The same name is still taken in the trash
+${CMD_PREFIX} ostree admin deploy --os=testos testos:testos/buildmain/x86_64-runtime
+${CMD_PREFIX} ostree admin undeploy 0
+assert_has_dir sysroot/ostree/deploy-trash/testos-${rev}.0.1
+${CMD_PREFIX} ostree admin cleanup
+ls sysroot/ostree/deploy-trash > trash.txt
+assert_file_empty trash.txt
+
+echo "ok deploy trash cleanup"
+
+# The sysroot prune caches per-commit reachability; it must tolerate a
+# corrupted cache and drop entries for commits which are gone.
+unset OSTREE_SKIP_CACHE
+${CMD_PREFIX} ostree admin deploy --os=testos testos:testos/buildmain/x86_64-runtime
+assert_has_file sysroot/ostree/repo/tmp/cache/reachable/${rev}
+cp sysroot/ostree/repo/tmp/cache/reachable/${rev} reachable.orig
+echo garbage > sysroot/ostree/repo/tmp/cache/reachable/${rev}
+${CMD_PREFIX} ostree admin cleanup
+${CMD_PREFIX} ostree --repo=sysroot/ostree/repo fsck
+# A well-formed file with a corrupted checksum record must not be trusted
+cp reachable.orig sysroot/ostree/repo/tmp/cache/reachable/${rev}
+printf '\x5a\xa5\x5a\xa5' | dd of=sysroot/ostree/repo/tmp/cache/reachable/${rev} bs=1 seek=16 conv=notrunc
+${CMD_PREFIX} ostree admin cleanup
+${CMD_PREFIX} ostree --repo=sysroot/ostree/repo fsck
+assert_has_file sysroot/ostree/repo/tmp/cache/reachable/${rev}
+${CMD_PREFIX} ostree --repo=sysroot/ostree/repo refs --delete testos:testos/buildmain/x86_64-runtime
+${CMD_PREFIX} ostree admin undeploy 0
+assert_not_has_file sysroot/ostree/repo/tmp/cache/reachable/${rev}
+
+echo "ok prune reachable cache"
@@ -0,0 +1,37 @@
+#!/bin/bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+# Exports OSTREE_SYSROOT so --sysroot not needed.
+setup_os_repository "archive" "grub2 builtin-generator"
+
+extra_admin_tests=1
+
+. $(dirname $0)/admin-test.sh
+
+# The in-process generator should produce the same output as the script
+cd ${test_tmpdir}
+rm -f sysroot/boot/loader/grub.cfg.script
+sh ${test_srcdir}/ostree-grub-generator unused sysroot/boot/loader/grub.cfg.script
+diff -u sysroot/boot/loader/grub.cfg.script sysroot/boot/loader/grub.cfg
+assert_file_has_content sysroot/boot/loader/grub.cfg "^menuentry "
+assert_file_has_content sysroot/boot/loader/grub.cfg "linux /boot/ostree/"
+rm -f sysroot/boot/loader/grub.cfg.script
+echo "ok builtin grub2 generator"
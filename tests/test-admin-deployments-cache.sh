@@ -0,0 +1,73 @@
+#!/bin/bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+# Exports OSTREE_SYSROOT so --sysroot not needed.
+setup_os_repository "archive" "syslinux"
+
+echo "1..5"
+
+${CMD_PREFIX} ostree --repo=sysroot/ostree/repo pull-local --remote=testos testos-repo testos/buildmain/x86_64-runtime
+${CMD_PREFIX} ostree admin deploy --os=testos testos:testos/buildmain/x86_64-runtime
+
+# Keep the cache and the boot ID under the sysroot
+export OSTREE_SYSROOT_DEBUG="${OSTREE_SYSROOT_DEBUG},test-deployments-cache"
+export G_MESSAGES_DEBUG=OSTree
+mkdir -p sysroot/run/ostree sysroot/proc/sys/kernel/random
+echo 11111111-1111-1111-1111-111111111111 > sysroot/proc/sys/kernel/random/boot_id
+
+admin_status() {
+  ${CMD_PREFIX} ostree admin status > status.txt 2> debug.txt
+  assert_file_has_content status.txt 'testos '
+}
+
+admin_status
+assert_not_file_has_content debug.txt 'from cache'
+test -f sysroot/run/ostree/deployments-cache
+admin_status
+assert_file_has_content debug.txt 'Loaded 1 deployments from cache'
+echo "ok cache hit"
+
+touch -d '2000-01-01' sysroot/ostree/deploy
+admin_status
+assert_file_has_content debug.txt 'Deployments cache is stale'
+admin_status
+assert_file_has_content debug.txt 'Loaded 1 deployments from cache'
+echo "ok invalidated by deploy mtime"
+
+echo 22222222-2222-2222-2222-222222222222 > sysroot/proc/sys/kernel/random/boot_id
+admin_status
+assert_file_has_content debug.txt 'Deployments cache is stale'
+admin_status
+assert_file_has_content debug.txt 'Loaded 1 deployments from cache'
+echo "ok invalidated by boot ID"
+
+echo 'not a cache' > sysroot/run/ostree/deployments-cache
+admin_status
+assert_not_file_has_content debug.txt 'from cache'
+admin_status
+assert_file_has_content debug.txt 'Loaded 1 deployments from cache'
+echo "ok corrupt cache"
+
+rm sysroot/proc/sys/kernel/random/boot_id
+admin_status
+assert_file_has_content debug.txt 'Not using deployments cache'
+assert_not_file_has_content debug.txt 'from cache'
+echo "ok missing boot ID"
@@ -21,7 +21,7 @@ set -euo pipefail
 
 . $(dirname $0)/libtest.sh
 
-echo '1..13'
+echo '1..14'
 
 setup_test_repository "archive"
 
@@ -38,3 +38,25 @@ ${CMD_PREFIX} ostree --repo=repo2 pull aremote
 ${CMD_PREFIX} ostree --repo=repo2 rev-parse aremote/test2
 ${CMD_PREFIX} ostree --repo=repo2 fsck
 echo "ok pull with from file:/// uri"
+
+if has_ostree_feature zstd; then
+    cd ${test_tmpdir}
+    rm repo-zstd repo-zstd-bare checkout-zstd -rf
+    ostree_repo_init repo-zstd --mode=archive
+    ${CMD_PREFIX} ostree --repo=repo-zstd config set archive.compression zstd
+    ${CMD_PREFIX} ostree --repo=repo-zstd commit -b zstd -s zstd --tree=dir=checkout-test2
+    # Regular file objects hold a zstd frame
+    find repo-zstd/objects -name '*.filez' > filez.txt
+    test -s filez.txt
+    LC_ALL=C grep -l -P '\x28\xb5\x2f\xfd' $(cat filez.txt) > zstd-filez.txt
+    test -s zstd-filez.txt
+    ${CMD_PREFIX} ostree --repo=repo-zstd fsck
+    ${CMD_PREFIX} ostree --repo=repo-zstd checkout zstd checkout-zstd
+    diff -r checkout-test2 checkout-zstd
+    ostree_repo_init repo-zstd-bare --mode=bare-user
+    ${CMD_PREFIX} ostree --repo=repo-zstd-bare pull-local repo-zstd zstd
+    ${CMD_PREFIX} ostree --repo=repo-zstd-bare fsck
+    echo "ok archive with zstd compression"
+else
+    echo "ok # SKIP no zstd support"
+fi
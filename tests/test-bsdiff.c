@@ -22,6 +22,7 @@
 #include "bsdiff/bsdiff.h"
 #include "bsdiff/bspatch.h"
 #include "libglnx.h"
+#include "ostree-bsdiff.h"
 #include <gio/gio.h>
 #include <glib.h>
 #include <stdlib.h>
@@ -92,10 +93,107 @@ test_bsdiff (void)
   g_assert_cmpint (memcmp (new, new_generated, NEW_SIZE), ==, 0);
 }
 
+static void
+apply_patch (GBytes *old, GBytes *patch, GBytes *expected)
+{
+  struct bspatch_stream bspatch_stream;
+  gsize old_size, new_size;
+  const guint8 *old_buf = g_bytes_get_data (old, &old_size);
+  const guint8 *new_buf = g_bytes_get_data (expected, &new_size);
+  g_autofree guint8 *new_generated = g_new0 (guint8, new_size + 1);
+  g_autoptr (GInputStream) in = g_memory_input_stream_new_from_bytes (patch);
+
+  bspatch_stream.read = bzpatch_read;
+  bspatch_stream.opaque = in;
+  g_assert_cmpint (bspatch (old_buf, old_size, new_generated, new_size, &bspatch_stream), ==, 0);
+  g_assert_cmpint (memcmp (new_buf, new_generated, new_size), ==, 0);
+}
+
+/* The suffix array is a permutation of the suffixes in order, which is
+ * checked by brute force.
+ */
+static void
+assert_suffix_array_sorted (OstreeBsdiffIndex *index, const guint8 *old, gsize old_size)
+{
+  gsize len;
+  const gint32 *sa = _ostree_bsdiff_index_peek_suffix_array (index, &len);
+  g_autofree gboolean *seen = g_new0 (gboolean, old_size + 1);
+
+  g_assert_cmpuint (len, ==, old_size + 1);
+  for (gsize i = 0; i < len; i++)
+    {
+      g_assert_cmpint (sa[i], >=, 0);
+      g_assert_cmpint (sa[i], <=, old_size);
+      g_assert_false (seen[sa[i]]);
+      seen[sa[i]] = TRUE;
+
+      if (i == 0)
+        continue;
+      /* A suffix which is a prefix of the next sorts first */
+      const gsize a_len = old_size - sa[i - 1];
+      const gsize b_len = old_size - sa[i];
+      int cmp = memcmp (old + sa[i - 1], old + sa[i], MIN (a_len, b_len));
+      if (cmp == 0)
+        cmp = a_len < b_len ? -1 : 1;
+      g_assert_cmpint (cmp, <, 0);
+    }
+}
+
+/* Diff several targets against one index of the old content, with
+ * small alphabets to stress the suffix sorting.
+ */
+static void
+test_bsdiff_index (void)
+{
+  const guint alphabets[] = { 2, 4, 256 };
+  const gsize sizes[] = { 0, 1, 2, 17, 4096, 100000 };
+
+  for (guint a = 0; a < G_N_ELEMENTS (alphabets); a++)
+    for (guint s = 0; s < G_N_ELEMENTS (sizes); s++)
+      {
+        const gsize old_size = sizes[s];
+        g_autofree guint8 *old_buf = g_new (guint8, old_size + 1);
+        g_autoptr (GError) error = NULL;
+
+        for (gsize i = 0; i < old_size; i++)
+          old_buf[i] = g_test_rand_int_range (0, alphabets[a]);
+        g_autoptr (GBytes) old = g_bytes_new (old_buf, old_size);
+
+        g_autoptr (OstreeBsdiffIndex) index = _ostree_bsdiff_index_new (old, &error);
+        g_assert_no_error (error);
+        if (old_size <= 4096)
+          assert_suffix_array_sorted (index, old_buf, old_size);
+
+        for (guint t = 0; t < 3; t++)
+          {
+            /* Mostly the old content with insertions, shifts and noise */
+            const gsize new_size = old_size + g_test_rand_int_range (0, 64);
+            g_autofree guint8 *new_buf = g_new (guint8, new_size + 1);
+            gsize shift = 0;
+
+            for (gsize i = 0; i < new_size; i++)
+              {
+                if (g_test_rand_int_range (0, 1000) == 0)
+                  shift++;
+                if (old_size > 0 && g_test_rand_int_range (0, 20) > 0)
+                  new_buf[i] = old_buf[(i + shift) % old_size];
+                else
+                  new_buf[i] = g_test_rand_int_range (0, alphabets[a]);
+              }
+            g_autoptr (GBytes) new = g_bytes_new (new_buf, new_size);
+
+            g_autoptr (GBytes) patch = _ostree_bsdiff_index_diff (index, new, &error);
+            g_assert_no_error (error);
+            apply_patch (old, patch, new);
+          }
+      }
+}
+
 int
 main (int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/bsdiff", test_bsdiff);
+  g_test_add_func ("/bsdiff/index", test_bsdiff_index);
   return g_test_run ();
 }
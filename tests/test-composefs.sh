@@ -52,6 +52,42 @@ assert_file_has_content_literal dump.txt '/baz/cow 4 100644 1 0 0 0 0.0 f6/a517d
 rm -vf dump.txt test2-co.cfs
 tap_ok "checkout composefs"
 
+# Digests computed while generating the image are kept in an index; a
+# checkout using the index must be identical.
+(unset OSTREE_SKIP_CACHE
+ $OSTREE checkout --composefs test-composefs test2-co.cfs
+ assert_has_file repo/tmp/cache/fsverity-index.journal
+ rm test2-co.cfs
+ $OSTREE checkout --composefs test-composefs test2-co.cfs)
+digest=$(sha256sum < test2-co.cfs | cut -f 1 -d ' ')
+assert_streq "${digest}" "031fab2c7f390b752a820146dc89f6880e5739cba7490f64024e0c7d11aad7c9"
+rm -vf test2-co.cfs
+tap_ok "checkout composefs with fsverity index"
+
+# A well-formed index record with a wrong digest for /baz/cow must end up
+# neither in a checkout, which drops the index, nor in commit metadata.
+hex_to_bin() {
+    printf "$(echo $1 | sed -e 's/../\\x&/g')"
+}
+append_bad_index_record() {
+    hex_to_bin f6a517d53831a40cff3886a965c70d57aa50797a8e5ea965b2c49cc575a6ff51$(printf '%064d' 0) > record.bin
+    hex_to_bin $(sha256sum < record.bin | cut -f 1 -d ' ') >> record.bin
+    cat record.bin >> repo/tmp/cache/fsverity-index.journal
+    rm record.bin
+}
+(unset OSTREE_SKIP_CACHE
+ append_bad_index_record
+ $OSTREE checkout --composefs test-composefs test2-co.cfs
+ assert_not_has_file repo/tmp/cache/fsverity-index.journal
+ append_bad_index_record
+ $OSTREE commit ${COMMIT_ARGS} -b test-composefs3 --generate-composefs-metadata --tree=ref=test-composefs)
+digest=$(sha256sum < test2-co.cfs | cut -f 1 -d ' ')
+assert_streq "${digest}" "031fab2c7f390b752a820146dc89f6880e5739cba7490f64024e0c7d11aad7c9"
+rm -vf test2-co.cfs
+new_composefs_digest=$($OSTREE show --print-hex --print-metadata-key ostree.composefs.digest.v0 test-composefs3)
+assert_streq "${new_composefs_digest}" "${orig_composefs_digest}"
+tap_ok "composefs ignores wrong fsverity index digests"
+
 $OSTREE checkout --composefs-noverity test-composefs-without-meta test2-co-noverity.cfs
 digest=$(sha256sum < test2-co-noverity.cfs | cut -f 1 -d ' ')
 # Should be reproducible per above
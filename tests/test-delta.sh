@@ -26,7 +26,7 @@ skip_without_user_xattrs
 bindatafiles="bash true ostree"
 morebindatafiles="false ls"
 
-echo '1..14'
+echo '1..16'
 
 mkdir repo
 ostree_repo_init repo --mode=archive
@@ -147,6 +147,7 @@ ${CMD_PREFIX} ostree --repo=repo static-delta show ${origrev}-${newrev} > show.t
 assert_file_has_content show.txt "From: ${origrev}"
 assert_file_has_content show.txt "To: ${newrev}"
 assert_file_has_content show.txt 'Endianness: \(little\|big\)'
+assert_file_has_content show.txt 'Compression: lzma'
 
 echo 'ok show'
 
@@ -232,6 +233,52 @@ ${CMD_PREFIX} ostree --repo=repo2 ls ${newrev} >/dev/null
 
 echo 'ok apply offline inline'
 
+rm -rf repo/deltas/${deltaprefix}/${deltadir}/*
+${CMD_PREFIX} ostree --repo=repo static-delta generate --from=${origrev} --to=${newrev} \
+    --lzma-threads=2 --lzma-block-size=1
+
+rm repo2 -rf
+ostree_repo_init repo2 --mode=bare-user
+
+${CMD_PREFIX} ostree --repo=repo2 pull-local repo ${origrev}
+${CMD_PREFIX} ostree --repo=repo2 static-delta apply-offline repo/deltas/${deltaprefix}/${deltadir}
+${CMD_PREFIX} ostree --repo=repo2 fsck
+${CMD_PREFIX} ostree --repo=repo2 ls ${newrev} >/dev/null
+
+echo 'ok apply offline multithreaded lzma'
+
+if has_ostree_feature zstd; then
+    rm -rf repo/deltas/${deltaprefix}/${deltadir}/*
+    ${CMD_PREFIX} ostree --repo=repo static-delta generate --from=${origrev} --to=${newrev} \
+        --compression=zstd
+    ${CMD_PREFIX} ostree --repo=repo static-delta show ${origrev}-${newrev} > show-zstd.txt
+    assert_file_has_content show-zstd.txt "Compression: zstd"
+
+    rm repo2 -rf
+    ostree_repo_init repo2 --mode=bare-user
+    ${CMD_PREFIX} ostree --repo=repo2 pull-local repo ${origrev}
+    ${CMD_PREFIX} ostree --repo=repo2 static-delta apply-offline repo/deltas/${deltaprefix}/${deltadir}
+    ${CMD_PREFIX} ostree --repo=repo2 fsck
+    ${CMD_PREFIX} ostree --repo=repo2 ls ${newrev} >/dev/null
+
+    # A large enough overhead always picks zstd
+    rm -rf repo/deltas/${deltaprefix}/${deltadir}/*
+    ${CMD_PREFIX} ostree --repo=repo static-delta generate --from=${origrev} --to=${newrev} \
+        --compression=auto --zstd-max-overhead=1000
+    ${CMD_PREFIX} ostree --repo=repo static-delta show ${origrev}-${newrev} > show-auto.txt
+    assert_file_has_content show-auto.txt "Compression: zstd"
+
+    rm repo2 -rf
+    ostree_repo_init repo2 --mode=bare-user
+    ${CMD_PREFIX} ostree --repo=repo2 pull-local repo ${origrev}
+    ${CMD_PREFIX} ostree --repo=repo2 static-delta apply-offline repo/deltas/${deltaprefix}/${deltadir}
+    ${CMD_PREFIX} ostree --repo=repo2 fsck
+
+    echo 'ok apply offline zstd'
+else
+    echo 'ok # SKIP no zstd support'
+fi
+
 ${CMD_PREFIX} ostree --repo=repo static-delta list | grep ^${origrev}-${newrev}$ || exit 1
 ${CMD_PREFIX} ostree --repo=repo static-delta list | grep ^${origrev}$ || exit 1
 
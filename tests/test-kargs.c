@@ -278,6 +278,116 @@ test_kargs_append (void)
   g_assert_cmpint (7, ==, g_strv_length (kargs_list));
 }
 
+/* Parsing a long command line with repeated keys should round-trip, and
+ * removing entries should preserve the order of the remaining ones.
+ */
+static void
+test_kargs_parse_roundtrip (void)
+{
+  g_autoptr (GString) cmdline = g_string_new ("root=UUID=1234 rw");
+  for (guint i = 0; i < 200; i++)
+    g_string_append_printf (cmdline, " console=ttyS%u foo%u=\"a b %u\" quiet", i, i, i);
+
+  __attribute__ ((cleanup (ostree_kernel_args_cleanup))) OstreeKernelArgs *kargs
+      = ostree_kernel_args_from_string (cmdline->str);
+  g_autofree char *str = ostree_kernel_args_to_string (kargs);
+  g_assert_cmpstr (str, ==, cmdline->str);
+  g_assert_cmpstr (ostree_kernel_args_get_last_value (kargs, "console"), ==, "ttyS199");
+
+  g_autoptr (GError) error = NULL;
+  g_assert (ostree_kernel_args_delete_key_entry (kargs, "quiet", &error));
+  g_assert_no_error (error);
+  g_assert (ostree_kernel_args_delete (kargs, "console=ttyS0 foo1", &error));
+  g_assert_no_error (error);
+  ostree_kernel_args_replace (kargs, "root=UUID=5678");
+  g_auto (GStrv) strv = ostree_kernel_args_to_strv (kargs);
+  g_assert_cmpuint (g_strv_length (strv), ==, 2 + 200 * 2 - 2);
+  g_assert_cmpstr (strv[0], ==, "root=UUID=5678");
+  g_assert_cmpstr (strv[1], ==, "rw");
+  g_assert_cmpstr (strv[2], ==, "foo0=\"a b 0\"");
+  g_assert_cmpstr (strv[3], ==, "console=ttyS1");
+  g_assert_cmpstr (strv[4], ==, "console=ttyS2");
+}
+
+static void
+test_kargs_delete_argv (void)
+{
+  g_autoptr (GError) error = NULL;
+  __attribute__ ((cleanup (ostree_kernel_args_cleanup))) OstreeKernelArgs *kargs
+      = ostree_kernel_args_from_string ("a=1 b c=1 c=2 d=x e");
+
+  /* Later deletions see the effect of earlier ones: "c" is unambiguous once
+   * c=1 is gone.  Elements may also contain several arguments. */
+  const char *argv[] = { "c=1", "b c", "e d=x", NULL };
+  g_assert (ostree_kernel_args_delete_argv (kargs, (char **)argv, &error));
+  g_assert_no_error (error);
+  g_autofree char *str = ostree_kernel_args_to_string (kargs);
+  g_assert_cmpstr (str, ==, "a=1");
+
+  /* On failure, the preceding arguments are deleted and the rest aren't */
+  ostree_kernel_args_parse_append (kargs, "f g h");
+  const char *bad_argv[] = { "f", "nosuchkey", "h", NULL };
+  g_assert (!ostree_kernel_args_delete_argv (kargs, (char **)bad_argv, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_clear_error (&error);
+  g_clear_pointer (&str, g_free);
+  str = ostree_kernel_args_to_string (kargs);
+  g_assert_cmpstr (str, ==, "a=1 g h");
+  g_assert (!ostree_kernel_args_contains (kargs, "f"));
+  g_assert (ostree_kernel_args_contains (kargs, "h"));
+}
+
+/* Run with -m perf */
+static void
+test_kargs_perf (void)
+{
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Not running performance tests");
+      return;
+    }
+
+  const guint n_args = 2000;
+  g_autoptr (GString) cmdline = g_string_new ("root=UUID=1234 rw");
+  g_autoptr (GPtrArray) deletions = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < n_args; i++)
+    {
+      g_string_append_printf (cmdline, " console=ttyS%u foo%u=\"a b %u\"", i, i, i);
+      if (i % 2 == 0)
+        g_ptr_array_add (deletions, g_strdup_printf ("console=ttyS%u", i));
+    }
+  g_ptr_array_add (deletions, NULL);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < 100; i++)
+    {
+      __attribute__ ((cleanup (ostree_kernel_args_cleanup))) OstreeKernelArgs *kargs
+          = ostree_kernel_args_from_string (cmdline->str);
+      g_autofree char *str = ostree_kernel_args_to_string (kargs);
+    }
+  g_test_minimized_result (g_test_timer_elapsed (), "parse and serialize: %.3fs",
+                           g_test_timer_last ());
+
+  __attribute__ ((cleanup (ostree_kernel_args_cleanup))) OstreeKernelArgs *kargs
+      = ostree_kernel_args_from_string (cmdline->str);
+  g_test_timer_start ();
+  for (char **iter = (char **)deletions->pdata; *iter; iter++)
+    g_assert (ostree_kernel_args_delete (kargs, *iter, NULL));
+  g_test_minimized_result (g_test_timer_elapsed (), "delete one at a time: %.3fs",
+                           g_test_timer_last ());
+
+  __attribute__ ((cleanup (ostree_kernel_args_cleanup))) OstreeKernelArgs *batch_kargs
+      = ostree_kernel_args_from_string (cmdline->str);
+  g_test_timer_start ();
+  g_assert (ostree_kernel_args_delete_argv (batch_kargs, (char **)deletions->pdata, NULL));
+  g_test_minimized_result (g_test_timer_elapsed (), "delete as a batch: %.3fs",
+                           g_test_timer_last ());
+
+  g_autofree char *str = ostree_kernel_args_to_string (kargs);
+  g_autofree char *batch_str = ostree_kernel_args_to_string (batch_kargs);
+  g_assert_cmpstr (str, ==, batch_str);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -286,5 +396,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/kargs/kargs_append", test_kargs_append);
   g_test_add_func ("/kargs/kargs_delete", test_kargs_delete);
   g_test_add_func ("/kargs/kargs_replace", test_kargs_replace);
+  g_test_add_func ("/kargs/kargs_parse_roundtrip", test_kargs_parse_roundtrip);
+  g_test_add_func ("/kargs/kargs_delete_argv", test_kargs_delete_argv);
+  g_test_add_func ("/kargs/perf", test_kargs_perf);
   return g_test_run ();
 }
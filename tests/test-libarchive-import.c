@@ -245,6 +245,62 @@ test_libarchive_error_device_file (gconstpointer data)
   g_clear_error (&error);
 }
 
+static void
+test_libarchive_file_then_dir (gconstpointer data)
+{
+  TestData *td = (void *)data;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (OtAutoArchiveWrite) aw = archive_write_new ();
+  g_autoptr (OtAutoArchiveRead) a = archive_read_new ();
+  OstreeRepoImportArchiveOptions opts = {
+    0,
+  };
+  glnx_unref_object OstreeMutableTree *mtree = ostree_mutable_tree_new ();
+  struct archive_entry *ae;
+
+  if (td->skip_all != NULL)
+    {
+      g_test_skip (td->skip_all->message);
+      return;
+    }
+
+  glnx_autofd int fd
+      = openat (AT_FDCWD, "file-then-dir.tar", O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+  g_assert (fd >= 0);
+  (void)unlink ("file-then-dir.tar");
+
+  g_assert_cmpint (0, ==, archive_write_set_format_pax (aw));
+  g_assert_cmpint (0, ==, archive_write_open_fd (aw, fd));
+
+  /* The directory entry comes later, so it must be the one to fail */
+  ae = archive_entry_new ();
+  archive_entry_set_pathname (ae, "/x");
+  archive_entry_set_mode (ae, S_IFREG | 0644);
+  archive_entry_set_size (ae, 4);
+  g_assert_cmpint (0, ==, archive_write_header (aw, ae));
+  g_assert_cmpint (4, ==, archive_write_data (aw, "foo\n", 4));
+  archive_entry_free (ae);
+
+  ae = archive_entry_new ();
+  archive_entry_set_pathname (ae, "/x");
+  archive_entry_set_mode (ae, S_IFDIR | 0755);
+  g_assert_cmpint (0, ==, archive_write_header (aw, ae));
+  archive_entry_free (ae);
+
+  g_assert_cmpint (ARCHIVE_OK, ==, archive_write_close (aw));
+
+  test_archive_setup (fd, a);
+
+  ostree_repo_prepare_transaction (td->repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (!ostree_repo_import_archive_to_mtree (td->repo, &opts, a, mtree, NULL, NULL, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert (strstr (error->message, "Can't replace file with directory: x") != NULL);
+  g_clear_error (&error);
+  ostree_repo_abort_transaction (td->repo, NULL, &error);
+  g_assert_no_error (error);
+}
+
 static gboolean
 skip_if_no_xattr (TestData *td)
 {
@@ -699,6 +755,7 @@ main (int argc, char **argv)
   g_test_add_data_func ("/libarchive/autocreate-empty", &td, test_libarchive_autocreate_empty);
   g_test_add_data_func ("/libarchive/error-device-file", &td, test_libarchive_error_device_file);
   g_test_add_data_func ("/libarchive/ignore-device-file", &td, test_libarchive_ignore_device_file);
+  g_test_add_data_func ("/libarchive/file-then-dir", &td, test_libarchive_file_then_dir);
   g_test_add_data_func ("/libarchive/ostree-convention", &td, test_libarchive_ostree_convention);
   g_test_add_data_func ("/libarchive/xattr-import", &td, test_libarchive_xattr_import);
   g_test_add_data_func ("/libarchive/xattr-import-skip-xattr", &td,
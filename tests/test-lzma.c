@@ -29,7 +29,7 @@
 #include <string.h>
 
 static void
-helper_test_compress_decompress (const guint8 *data, gssize data_size)
+helper_test_compress_decompress (const guint8 *data, gssize data_size, GVariant *params)
 {
   g_autoptr (GError) error = NULL;
   g_autoptr (GOutputStream) out_compress = g_memory_output_stream_new_resizable ();
@@ -41,7 +41,7 @@ helper_test_compress_decompress (const guint8 *data, gssize data_size)
   {
     gssize n_bytes_written;
     g_autoptr (GInputStream) convin = NULL;
-    g_autoptr (GConverter) compressor = (GConverter *)_ostree_lzma_compressor_new (NULL);
+    g_autoptr (GConverter) compressor = (GConverter *)_ostree_lzma_compressor_new (params);
     convin = g_converter_input_stream_new ((GInputStream *)in_compress, compressor);
     n_bytes_written = g_output_stream_splice (
         out_compress, convin,
@@ -87,9 +87,9 @@ test_lzma_random (void)
 
   for (i = 2; i < (sizeof (buffer) - 1); i *= 2)
     {
-      helper_test_compress_decompress (buffer, i - 1);
-      helper_test_compress_decompress (buffer, i);
-      helper_test_compress_decompress (buffer, i + 1);
+      helper_test_compress_decompress (buffer, i - 1, NULL);
+      helper_test_compress_decompress (buffer, i, NULL);
+      helper_test_compress_decompress (buffer, i + 1, NULL);
     }
 }
 
@@ -101,7 +101,27 @@ test_lzma_big_buffer (void)
 
   memset (buffer, (int)'a', buffer_size);
 
-  helper_test_compress_decompress (buffer, buffer_size);
+  helper_test_compress_decompress (buffer, buffer_size, NULL);
+}
+
+static void
+test_lzma_multithreaded (void)
+{
+  const guint32 buffer_size = 1 << 21;
+  g_autofree guint8 *buffer = g_new (guint8, buffer_size);
+  g_autoptr (GRand) r = g_rand_new ();
+  g_auto (GVariantBuilder) builder;
+
+  /* Compressible, but not trivially so */
+  for (guint32 i = 0; i < buffer_size; i++)
+    buffer[i] = 'a' + g_rand_int_range (r, 0, 4);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "threads", g_variant_new_uint32 (4));
+  g_variant_builder_add (&builder, "{sv}", "block-size", g_variant_new_uint64 (1 << 16));
+  g_autoptr (GVariant) params = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  helper_test_compress_decompress (buffer, buffer_size, params);
 }
 
 int
@@ -110,6 +130,7 @@ main (int argc, char **argv)
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/lzma/random-buffer", test_lzma_random);
   g_test_add_func ("/lzma/big-buffer", test_lzma_big_buffer);
+  g_test_add_func ("/lzma/multithreaded", test_lzma_multithreaded);
 
   return g_test_run ();
 }
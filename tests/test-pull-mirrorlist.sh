@@ -26,7 +26,7 @@ if test -z "${OSTREE_HTTPD}"; then
     exit 0
 fi
 
-echo "1..3"
+echo "1..5"
 
 setup_fake_remote_repo1 "archive"
 
@@ -109,3 +109,45 @@ ${CMD_PREFIX} ostree --repo=repo remote add origin --no-sign-verify \
 ${CMD_PREFIX} ostree --repo=repo pull origin:main
 
 echo "ok pull objects from split urls mirrorlists"
+
+# striping requests across all the mirrors must still fall back to the
+# ones which have each object
+
+cd ${test_tmpdir}
+rm -rf repo
+mkdir repo
+ostree_repo_init repo
+${CMD_PREFIX} ostree --repo=repo remote add origin --no-sign-verify \
+  --contenturl=mirrorlist=$(cat httpd-address)/ostree/mirrorlist \
+  $(cat httpd-address)/ostree/gnomerepo
+${CMD_PREFIX} ostree --repo=repo pull --stripe-mirrors origin:main
+${CMD_PREFIX} ostree --repo=repo fsck
+
+echo "ok pull objects with striped mirrors"
+
+# publish objects bloom filters on the mirrors, so striped requests are sent
+# to a mirror which has each object
+
+for mirror in content_mirror1 content_mirror2 content_mirror3; do
+  mirror_repo=${test_tmpdir}/${mirror}/ostree/gnomerepo
+  ${CMD_PREFIX} ostree --repo=${mirror_repo} config set core.objects-bloom true
+  ${CMD_PREFIX} ostree --repo=${mirror_repo} summary -u
+  test -s ${mirror_repo}/objects.bloom
+done
+
+cd ${test_tmpdir}
+rm -rf repo
+mkdir repo
+ostree_repo_init repo
+${CMD_PREFIX} ostree --repo=repo remote add origin --no-sign-verify \
+  --contenturl=mirrorlist=$(cat httpd-address)/ostree/mirrorlist \
+  $(cat httpd-address)/ostree/gnomerepo
+${CMD_PREFIX} ostree --repo=repo pull --stripe-mirrors origin:main
+${CMD_PREFIX} ostree --repo=repo fsck
+
+mirror_repo=${test_tmpdir}/content_mirror3/ostree/gnomerepo
+${CMD_PREFIX} ostree --repo=${mirror_repo} config set core.objects-bloom false
+${CMD_PREFIX} ostree --repo=${mirror_repo} summary -u
+test ! -e ${mirror_repo}/objects.bloom
+
+echo "ok pull objects with striped mirrors and objects bloom filters"
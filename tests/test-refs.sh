@@ -23,7 +23,7 @@ set -euo pipefail
 
 setup_fake_remote_repo1 "archive"
 
-echo '1..7'
+echo '1..8'
 
 cd ${test_tmpdir}
 mkdir repo
@@ -228,3 +228,78 @@ if ${CMD_PREFIX} ostree --repo=repo refs -A --create foobar nonexistent 2>err.tx
 fi
 assert_file_has_content_literal err.txt 'Cannot create alias to non-existent ref'
 echo "ok ref no broken alias"
+
+# With packed refs, transactions write refs to refs/packed-refs
+cd ${test_tmpdir}
+mkdir -p ostree-srv/packed-repo
+ostree_repo_init ostree-srv/packed-repo --mode=archive
+ln -s ostree-srv/packed-repo packed-repo
+# Older versions can't read packed refs, so it needs a new repository version
+sed -i -e 's/^\[core\]$/[core]\npacked-refs=true/' packed-repo/config
+if ${CMD_PREFIX} ostree --repo=packed-repo refs 2>err.txt; then
+    fatal "Opened a repo_version=1 repo with packed refs"
+fi
+assert_file_has_content err.txt 'core.packed-refs requires core.repo_version=2'
+sed -i -e '/^packed-refs=true$/d' packed-repo/config
+${CMD_PREFIX} ostree --repo=packed-repo commit -b loose-before --tree=dir=tree
+${CMD_PREFIX} ostree --repo=packed-repo config set core.repo_version 2
+${CMD_PREFIX} ostree --repo=packed-repo config set core.packed-refs true
+${CMD_PREFIX} ostree --repo=packed-repo commit -b packed/test-1 --tree=dir=tree
+# The first pack folds in the existing loose refs
+assert_not_has_file packed-repo/refs/heads/loose-before
+assert_file_has_content packed-repo/refs/packed-refs ' refs/heads/loose-before$'
+echo b >> tree/root/a
+${CMD_PREFIX} ostree --repo=packed-repo commit -b packed/test-2 --tree=dir=tree
+assert_not_has_file packed-repo/refs/heads/packed/test-1
+assert_not_has_file packed-repo/refs/heads/packed/test-2
+assert_file_has_content packed-repo/refs/packed-refs ' refs/heads/packed/test-2$'
+rev1=$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse packed/test-1)
+rev2=$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse packed/test-2)
+assert_not_streq "${rev1}" "${rev2}"
+${CMD_PREFIX} ostree --repo=packed-repo refs > refs.txt
+assert_file_has_content refs.txt '^packed/test-1$'
+assert_file_has_content refs.txt '^packed/test-2$'
+${CMD_PREFIX} ostree --repo=packed-repo refs packed > refs.txt
+assert_file_has_content refs.txt '^test-1$'
+# A packed ref can't be a directory of other refs
+if ${CMD_PREFIX} ostree --repo=packed-repo commit -b packed/test-1/sub --tree=dir=tree 2>err.txt; then
+    fatal "Committed a ref below a packed ref"
+fi
+assert_file_has_content err.txt 'Conflict'
+# Refs set outside of a transaction are written as loose files
+${CMD_PREFIX} ostree --repo=packed-repo refs --create=loose packed/test-2
+assert_has_file packed-repo/refs/heads/loose
+assert_streq "$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse loose)" "${rev2}"
+${CMD_PREFIX} ostree --repo=packed-repo refs --delete packed/test-1
+assert_not_file_has_content packed-repo/refs/packed-refs 'packed/test-1'
+if ${CMD_PREFIX} ostree --repo=packed-repo rev-parse packed/test-1 2>/dev/null; then
+    fatal "Deleted packed ref still resolves"
+fi
+# Aliases need their target to be a loose file, which stays loose
+${CMD_PREFIX} ostree --repo=packed-repo refs -A --create=packed/stable packed/test-2
+assert_has_file packed-repo/refs/heads/packed/test-2
+# Later transactions only look at the refs they update; ones with a loose
+# file are updated in place
+${CMD_PREFIX} ostree --repo=packed-repo commit -b packed/test-3 --tree=dir=tree
+assert_has_file packed-repo/refs/heads/loose
+assert_not_file_has_content packed-repo/refs/packed-refs ' refs/heads/loose$'
+echo c >> tree/root/a
+${CMD_PREFIX} ostree --repo=packed-repo commit -b loose --tree=dir=tree
+assert_has_file packed-repo/refs/heads/loose
+assert_not_streq "$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse loose)" "${rev2}"
+assert_has_file packed-repo/refs/heads/packed/test-2
+assert_streq "$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse packed/stable)" "${rev2}"
+${CMD_PREFIX} ostree --repo=packed-repo refs > refs.txt
+for ref in loose loose-before packed/stable packed/test-2 packed/test-3; do
+    assert_file_has_content refs.txt "^${ref}\$"
+done
+# Pulling over HTTP without a summary falls back to refs/packed-refs
+rm -rf packed-client
+ostree_repo_init packed-client
+${CMD_PREFIX} ostree --repo=packed-client remote add --set=gpg-verify=false packed $(cat httpd-address)/ostree/packed-repo
+${CMD_PREFIX} ostree --repo=packed-client pull packed packed/test-3 loose
+assert_streq "$(${CMD_PREFIX} ostree --repo=packed-client rev-parse packed:packed/test-3)" \
+    "$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse packed/test-3)"
+assert_streq "$(${CMD_PREFIX} ostree --repo=packed-client rev-parse packed:loose)" \
+    "$(${CMD_PREFIX} ostree --repo=packed-repo rev-parse loose)"
+echo "ok packed refs"
@@ -258,6 +258,118 @@ test_write_regfile_api (Fixture *fixture, gconstpointer test_data)
                    "23a2e97d21d960ac7a4e39a8721b1baff7b213e00e5e5641334f50506012fcff");
 }
 
+/* Dirtree and dirmeta objects are cached in memory once loaded; check that
+ * deleting one does not leave it loadable from the cache. */
+static void
+test_repo_metadata_cache (Fixture *fixture, gconstpointer test_data)
+{
+  g_autoptr (GError) error = NULL;
+
+  g_autoptr (OstreeRepo) repo = ostree_repo_create_at (
+      fixture->tmpdir.fd, ".", OSTREE_REPO_MODE_ARCHIVE, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  g_autoptr (GVariant) dirmeta = g_variant_ref_sink (
+      g_variant_new ("(uuu@a(ayay))", GUINT32_TO_BE (0), GUINT32_TO_BE (0),
+                     GUINT32_TO_BE (S_IFDIR | 0755),
+                     g_variant_new_array (G_VARIANT_TYPE ("(ayay)"), NULL, 0)));
+  g_autofree guchar *csum = NULL;
+  ostree_repo_prepare_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  ostree_repo_write_metadata (repo, OSTREE_OBJECT_TYPE_DIR_META, NULL, dirmeta, &csum, NULL,
+                              &error);
+  g_assert_no_error (error);
+  ostree_repo_commit_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_autofree char *checksum = ostree_checksum_from_bytes (csum);
+
+  /* The second load is served from the cache */
+  for (guint i = 0; i < 2; i++)
+    {
+      g_autoptr (GVariant) loaded = NULL;
+      ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_META, checksum, &loaded, &error);
+      g_assert_no_error (error);
+      g_assert_true (g_variant_equal (loaded, dirmeta));
+    }
+
+  ostree_repo_delete_object (repo, OSTREE_OBJECT_TYPE_DIR_META, checksum, NULL, &error);
+  g_assert_no_error (error);
+
+  g_autoptr (GVariant) loaded = NULL;
+  g_assert_false (
+      ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_META, checksum, &loaded, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_null (loaded);
+}
+
+static char *
+write_test_commit (OstreeRepo *repo, const char *subject)
+{
+  g_autoptr (GError) error = NULL;
+
+  g_autoptr (GVariant) dirmeta = g_variant_ref_sink (
+      g_variant_new ("(uuu@a(ayay))", GUINT32_TO_BE (0), GUINT32_TO_BE (0),
+                     GUINT32_TO_BE (S_IFDIR | 0755),
+                     g_variant_new_array (G_VARIANT_TYPE ("(ayay)"), NULL, 0)));
+  g_autofree guchar *csum = NULL;
+  ostree_repo_write_metadata (repo, OSTREE_OBJECT_TYPE_DIR_META, NULL, dirmeta, &csum, NULL,
+                              &error);
+  g_assert_no_error (error);
+  g_autofree char *dirmeta_checksum = ostree_checksum_from_bytes (csum);
+
+  g_autoptr (OstreeMutableTree) mtree = ostree_mutable_tree_new ();
+  ostree_mutable_tree_set_metadata_checksum (mtree, dirmeta_checksum);
+  g_autoptr (GFile) root = NULL;
+  ostree_repo_write_mtree (repo, mtree, &root, NULL, &error);
+  g_assert_no_error (error);
+
+  g_autofree char *checksum = NULL;
+  ostree_repo_write_commit (repo, NULL, subject, NULL, NULL, OSTREE_REPO_FILE (root), &checksum,
+                            NULL, &error);
+  g_assert_no_error (error);
+  return g_steal_pointer (&checksum);
+}
+
+/* Commits written in an aborted transaction must not end up in the commit
+ * graph written by a later transaction. */
+static void
+test_repo_commit_graph_abort (Fixture *fixture, gconstpointer test_data)
+{
+  g_autoptr (GError) error = NULL;
+
+  g_autoptr (OstreeRepo) repo = ostree_repo_create_at (
+      fixture->tmpdir.fd, ".", OSTREE_REPO_MODE_ARCHIVE, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  ostree_repo_prepare_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_autofree char *aborted = write_test_commit (repo, "aborted");
+  ostree_repo_abort_transaction (repo, NULL, &error);
+  g_assert_no_error (error);
+
+  ostree_repo_prepare_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_autofree char *committed = write_test_commit (repo, "committed");
+  ostree_repo_commit_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  gboolean exists = FALSE;
+  ostree_repo_lookup_commit_graph (repo, committed, &exists, NULL, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (exists);
+
+  ostree_repo_lookup_commit_graph (repo, aborted, &exists, NULL, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_false (exists);
+
+  /* Also with a fresh instance, which only has the graph on disk */
+  g_autoptr (OstreeRepo) repo2 = ostree_repo_open_at (fixture->tmpdir.fd, ".", NULL, &error);
+  g_assert_no_error (error);
+  ostree_repo_lookup_commit_graph (repo2, aborted, &exists, NULL, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_false (exists);
+}
+
 /* Just a sanity check of the C autolocking API */
 static void
 test_repo_autolock (Fixture *fixture, gconstpointer test_data)
@@ -553,6 +665,9 @@ main (int argc, char **argv)
   g_test_add ("/repo/get_min_free_space", Fixture, NULL, setup, test_repo_get_min_free_space,
               teardown);
   g_test_add ("/repo/write_regfile_api", Fixture, NULL, setup, test_write_regfile_api, teardown);
+  g_test_add ("/repo/metadata_cache", Fixture, NULL, setup, test_repo_metadata_cache, teardown);
+  g_test_add ("/repo/commit_graph_abort", Fixture, NULL, setup, test_repo_commit_graph_abort,
+              teardown);
   g_test_add ("/repo/autolock", Fixture, NULL, setup, test_repo_autolock, teardown);
   g_test_add ("/repo/lock/single", Fixture, NULL, lock_setup, test_repo_lock_single, teardown);
   g_test_add ("/repo/lock/unlock-never-locked", Fixture, NULL, lock_setup,
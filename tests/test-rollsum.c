@@ -30,8 +30,8 @@
 #include <string.h>
 
 static void
-test_rollsum_helper (const unsigned char *a, gsize size_a, const unsigned char *b, gsize size_b,
-                     gboolean expected_match)
+test_rollsum_helper_chunker (const unsigned char *a, gsize size_a, const unsigned char *b,
+                             gsize size_b, gboolean expected_match, OstreeRollsumChunker chunker)
 {
   gsize i;
   g_autoptr (GBytes) bytes_a = g_bytes_new_static (a, size_a);
@@ -39,8 +39,9 @@ test_rollsum_helper (const unsigned char *a, gsize size_a, const unsigned char *
   OstreeRollsumMatches *matches;
   GPtrArray *matchlist;
   guint64 sum_matched = 0;
+  guint64 last_to_start = 0;
 
-  matches = _ostree_compute_rollsum_matches (bytes_a, bytes_b);
+  matches = _ostree_compute_rollsum_matches_full (bytes_a, bytes_b, chunker);
   matchlist = matches->matches;
   if (expected_match)
     g_assert_cmpint (matchlist->len, >, 0);
@@ -57,6 +58,9 @@ test_rollsum_helper (const unsigned char *a, gsize size_a, const unsigned char *
       g_assert_cmpint (offset, >=, 0);
       g_assert_cmpint (from_start, <, size_a);
       g_assert_cmpint (to_start, <, size_b);
+      if (i > 0)
+        g_assert_cmpint (to_start, >, last_to_start);
+      last_to_start = to_start;
 
       sum_matched += offset;
 
@@ -68,6 +72,15 @@ test_rollsum_helper (const unsigned char *a, gsize size_a, const unsigned char *
   _ostree_rollsum_matches_free (matches);
 }
 
+static void
+test_rollsum_helper (const unsigned char *a, gsize size_a, const unsigned char *b, gsize size_b,
+                     gboolean expected_match)
+{
+  test_rollsum_helper_chunker (a, size_a, b, size_b, expected_match, OSTREE_ROLLSUM_CHUNKER_GEAR);
+  test_rollsum_helper_chunker (a, size_a, b, size_b, expected_match,
+                               OSTREE_ROLLSUM_CHUNKER_BUPSPLIT);
+}
+
 static void
 test_rollsum (void)
 {
@@ -155,6 +168,132 @@ test_rollsum (void)
   test_rollsum_helper (a, MAX_BUFFER_SIZE, b, MAX_BUFFER_SIZE, FALSE);
 }
 
+static void
+test_rollsum_gear (void)
+{
+  g_autofree guint8 *buf = g_malloc (MAX_BUFFER_SIZE);
+  g_autofree guint8 *shifted = g_malloc (MAX_BUFFER_SIZE + 100);
+  g_autoptr (GHashTable) boundaries = g_hash_table_new (NULL, NULL);
+  gsize offset, len;
+  guint resynced = 0;
+
+  for (gsize i = 0; i < MAX_BUFFER_SIZE; i++)
+    buf[i] = g_random_int ();
+
+  /* Every chunk but the last is between the minimum and maximum size */
+  for (offset = 0; offset < MAX_BUFFER_SIZE; offset += len)
+    {
+      len = _ostree_rollsum_gear_find_ofs (buf + offset, MAX_BUFFER_SIZE - offset);
+      g_assert_cmpint (len, >, 0);
+      if (offset + len < MAX_BUFFER_SIZE)
+        {
+          g_assert_cmpint (len, >, 2048);
+          g_assert_cmpint (len, <=, 8192 * 4);
+        }
+      g_hash_table_add (boundaries, GSIZE_TO_POINTER (offset + len));
+    }
+
+  /* Boundaries only depend on content, so they resynchronize after an
+   * insertion at the start.
+   */
+  for (gsize i = 0; i < 100; i++)
+    shifted[i] = g_random_int ();
+  memcpy (shifted + 100, buf, MAX_BUFFER_SIZE);
+  for (offset = 0; offset < MAX_BUFFER_SIZE + 100; offset += len)
+    {
+      len = _ostree_rollsum_gear_find_ofs (shifted + offset, MAX_BUFFER_SIZE + 100 - offset);
+      if (offset + len > 100
+          && g_hash_table_contains (boundaries, GSIZE_TO_POINTER (offset + len - 100)))
+        resynced++;
+    }
+  g_assert_cmpint (resynced, >, g_hash_table_size (boundaries) * 9 / 10);
+}
+
+/* Identical chunks in the source are only put in the table once, so
+ * matching a long run of zeroes doesn't walk a probe chain per chunk.
+ */
+static void
+test_rollsum_repeated (void)
+{
+#define REPEATED_BUFFER_SIZE (16 * 1024 * 1024)
+  g_autofree guint8 *a = g_malloc0 (REPEATED_BUFFER_SIZE);
+  g_autofree guint8 *b = g_malloc0 (REPEATED_BUFFER_SIZE);
+  /* One differing byte, so not every chunk of the target matches */
+  b[REPEATED_BUFFER_SIZE / 2] = 1;
+  g_autoptr (GBytes) bytes_a = g_bytes_new_static (a, REPEATED_BUFFER_SIZE);
+  g_autoptr (GBytes) bytes_b = g_bytes_new_static (b, REPEATED_BUFFER_SIZE);
+
+  const OstreeRollsumChunker chunkers[]
+      = { OSTREE_ROLLSUM_CHUNKER_BUPSPLIT, OSTREE_ROLLSUM_CHUNKER_GEAR };
+  for (guint i = 0; i < G_N_ELEMENTS (chunkers); i++)
+    {
+      g_autoptr (OstreeRollsumMatches) matches
+          = _ostree_compute_rollsum_matches_full (bytes_a, bytes_b, chunkers[i]);
+      g_assert_cmpuint (matches->bufmatches, >, 0);
+      g_assert_cmpuint (matches->bufmatches, <, matches->total);
+
+      for (guint j = 0; j < matches->matches->len; j++)
+        {
+          guint32 crc;
+          guint64 len, to_start, from_start;
+          g_variant_get (matches->matches->pdata[j], "(uttt)", &crc, &len, &to_start,
+                         &from_start);
+          g_assert (memcmp (a + from_start, b + to_start, len) == 0);
+        }
+    }
+}
+
+/* Run with -m perf */
+static void
+test_rollsum_perf (void)
+{
+#define PERF_BUFFER_SIZE (64 * 1024 * 1024)
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Not running performance tests");
+      return;
+    }
+
+  g_autofree guint8 *a = g_malloc (PERF_BUFFER_SIZE);
+  g_autofree guint8 *b = g_malloc (PERF_BUFFER_SIZE);
+  for (gsize i = 0; i < PERF_BUFFER_SIZE; i++)
+    a[i] = g_random_int ();
+  /* Mostly the same, with a changed byte every 64k */
+  memcpy (b, a, PERF_BUFFER_SIZE);
+  for (gsize i = 0; i < PERF_BUFFER_SIZE; i += 65536)
+    b[i + g_random_int_range (0, 65536)]++;
+  g_autoptr (GBytes) bytes_a = g_bytes_new_static (a, PERF_BUFFER_SIZE);
+  g_autoptr (GBytes) bytes_b = g_bytes_new_static (b, PERF_BUFFER_SIZE);
+
+  g_test_timer_start ();
+  for (gsize offset = 0, len; offset < PERF_BUFFER_SIZE; offset += len)
+    {
+      len = bupsplit_find_ofs (a + offset, PERF_BUFFER_SIZE - offset, NULL);
+      if (len == 0)
+        break;
+    }
+  g_test_minimized_result (g_test_timer_elapsed (), "bupsplit chunking: %.3fs",
+                           g_test_timer_last ());
+
+  g_test_timer_start ();
+  for (gsize offset = 0, len; offset < PERF_BUFFER_SIZE; offset += len)
+    len = _ostree_rollsum_gear_find_ofs (a + offset, PERF_BUFFER_SIZE - offset);
+  g_test_minimized_result (g_test_timer_elapsed (), "gear chunking: %.3fs", g_test_timer_last ());
+
+  const OstreeRollsumChunker chunkers[]
+      = { OSTREE_ROLLSUM_CHUNKER_BUPSPLIT, OSTREE_ROLLSUM_CHUNKER_GEAR };
+  const char *chunker_names[] = { "bupsplit", "gear" };
+  for (guint i = 0; i < G_N_ELEMENTS (chunkers); i++)
+    {
+      g_test_timer_start ();
+      g_autoptr (OstreeRollsumMatches) matches
+          = _ostree_compute_rollsum_matches_full (bytes_a, bytes_b, chunkers[i]);
+      g_test_minimized_result (g_test_timer_elapsed (), "%s matching: %.3fs, %u/%u chunks",
+                               chunker_names[i], g_test_timer_last (), matches->bufmatches,
+                               matches->total);
+    }
+}
+
 #define BUP_SELFTEST_SIZE 100000
 
 static void
@@ -185,6 +324,9 @@ main (int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/rollsum", test_rollsum);
+  g_test_add_func ("/rollsum/gear", test_rollsum_gear);
+  g_test_add_func ("/rollsum/repeated", test_rollsum_repeated);
+  g_test_add_func ("/rollsum/perf", test_rollsum_perf);
   g_test_add_func ("/bupsum", test_bupsplit_sum);
   return g_test_run ();
 }
@@ -0,0 +1,153 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "libglnx.h"
+#include "ostree.h"
+#include "otutil.h"
+
+/* Test vectors 1 and 2 from RFC 8032 */
+static const char *const ed25519_seeds[]
+    = { "9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+        "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb" };
+static const char *const ed25519_public_keys[]
+    = { "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a",
+        "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c" };
+
+#define N_DATA 6
+
+static GVariant *
+new_signatures (OstreeSign *sign, GBytes *signature)
+{
+  g_autoptr (GVariantBuilder) builder
+      = g_variant_builder_new ((GVariantType *)ostree_sign_metadata_format (sign));
+  g_variant_builder_add (builder, "@ay", ot_gvariant_new_ay_bytes (signature));
+  return g_variant_ref_sink (g_variant_builder_end (builder));
+}
+
+static OstreeSign *
+new_ed25519_sign (guint key_index, GError **error)
+{
+  g_autoptr (OstreeSign) sign = ostree_sign_get_by_name (OSTREE_SIGN_NAME_ED25519, error);
+  if (!sign)
+    return NULL;
+
+  guint8 secret_key[64];
+  ostree_checksum_inplace_to_bytes (ed25519_seeds[key_index], secret_key);
+  ostree_checksum_inplace_to_bytes (ed25519_public_keys[key_index], secret_key + 32);
+  g_autoptr (GVariant) secret_key_v = g_variant_ref_sink (
+      g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, secret_key, sizeof (secret_key), 1));
+  if (!ostree_sign_set_sk (sign, secret_key_v, error))
+    return NULL;
+
+  return g_steal_pointer (&sign);
+}
+
+typedef struct
+{
+  OstreeSign *verifier;
+  GPtrArray *data;
+  GPtrArray *signatures;
+} VerifyThreadData;
+
+static void
+verify_all (OstreeSign *verifier, GPtrArray *data, GPtrArray *signatures)
+{
+  g_autoptr (GError) error = NULL;
+
+  for (guint i = 0; i < data->len; i++)
+    {
+      if (!ostree_sign_data_verify (verifier, data->pdata[i], signatures->pdata[i], NULL, &error))
+        g_assert_no_error (error);
+    }
+}
+
+static gpointer
+verify_thread (gpointer user_data)
+{
+  VerifyThreadData *tdata = user_data;
+
+  for (guint i = 0; i < 50; i++)
+    verify_all (tdata->verifier, tdata->data, tdata->signatures);
+  return NULL;
+}
+
+/* The ed25519 verifier tries the key which verified the last signature
+ * first; data signed alternately by two trusted keys must still verify
+ * with either, including from several threads at once with the same
+ * verifier. */
+static void
+test_ed25519_key_hint (void)
+{
+  g_autoptr (GError) error = NULL;
+
+  /* Probe first: the engine may not be supported in this build */
+  g_autoptr (OstreeSign) signer1 = new_ed25519_sign (0, &error);
+  if (signer1 == NULL)
+    {
+      g_test_skip (error->message);
+      return;
+    }
+  g_autoptr (OstreeSign) signer2 = new_ed25519_sign (1, &error);
+  g_assert_no_error (error);
+
+  g_autoptr (OstreeSign) verifier = ostree_sign_get_by_name (OSTREE_SIGN_NAME_ED25519, &error);
+  g_assert_no_error (error);
+  for (guint i = 0; i < G_N_ELEMENTS (ed25519_public_keys); i++)
+    {
+      guint8 public_key[32];
+      ostree_checksum_inplace_to_bytes (ed25519_public_keys[i], public_key);
+      g_autofree char *pk_ascii = g_base64_encode (public_key, sizeof (public_key));
+      g_autoptr (GVariant) pk = g_variant_ref_sink (g_variant_new_string (pk_ascii));
+      if (!ostree_sign_add_pk (verifier, pk, &error))
+        g_assert_no_error (error);
+    }
+
+  /* Every other item is signed by the second key */
+  g_autoptr (GPtrArray) data = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+  g_autoptr (GPtrArray) signatures
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+  for (guint i = 0; i < N_DATA; i++)
+    {
+      OstreeSign *signer = (i % 2 == 0) ? signer1 : signer2;
+      g_autofree char *str = g_strdup_printf ("data %u", i);
+      g_autoptr (GBytes) bytes = g_bytes_new (str, strlen (str));
+      g_autoptr (GBytes) signature = NULL;
+      if (!ostree_sign_data (signer, bytes, &signature, NULL, &error))
+        g_assert_no_error (error);
+      g_ptr_array_add (data, g_steal_pointer (&bytes));
+      g_ptr_array_add (signatures, new_signatures (signer, signature));
+    }
+
+  verify_all (verifier, data, signatures);
+
+  VerifyThreadData tdata = { verifier, data, signatures };
+  GThread *threads[4];
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new ("verify", verify_thread, &tdata);
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/sign/ed25519/key-hint", test_ed25519_key_hint);
+  return g_test_run ();
+}
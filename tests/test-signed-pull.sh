@@ -21,7 +21,7 @@ set -euo pipefail
 
 . $(dirname $0)/libtest.sh
 
-echo "1..20"
+echo "1..21"
 
 # This is explicitly opt in for testing
 export OSTREE_DUMMY_SIGN_ENABLED=1
@@ -149,6 +149,7 @@ if ! has_ostree_feature sign-ed25519; then
     echo "ok ed25519-file re-pull signature for stored commit # SKIP due libsodium unavailability"
     echo "ok ed25519-inline # SKIP due libsodium unavailability"
     echo "ok ed25519-inline # SKIP due libsodium unavailability"
+    echo "ok ed25519 verification cache # SKIP due libsodium unavailability"
     exit 0
 fi
 
@@ -186,3 +187,17 @@ test_signed_pull "ed25519" "file"
 
 repo_init --sign-verify=ed25519=inline:"${ED25519PUBLIC}"
 test_signed_pull "ed25519" "--verify-ed25519"
+
+# Successful verifications are only cached in memory, so nothing on disk
+# can vouch for a signature; and a different key must verify again
+unset OSTREE_SKIP_CACHE
+rm $localsig
+${CMD_PREFIX} ostree --repo=repo pull origin main
+assert_not_has_dir repo/tmp/cache/verified
+${CMD_PREFIX} ostree --repo=repo config set 'remote "origin"'.verification-ed25519-key "$(gen_ed25519_random_public)"
+rm $localsig
+if ${CMD_PREFIX} ostree --repo=repo pull origin main 2>err.txt; then
+    assert_not_reached "pull with a different key unexpectedly succeeded"
+fi
+assert_file_has_content err.txt "Signature couldn't be verified"
+echo "ok ed25519 verification cache"
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) Red Hat, Inc.
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "libglnx.h"
+#include "ostree-zstd-compressor.h"
+#include "ostree-zstd-decompressor.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+
+static GBytes *
+convert_all (GConverter *converter, const guint8 *data, gsize data_size)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GOutputStream) out = g_memory_output_stream_new_resizable ();
+  g_autoptr (GInputStream) in = g_memory_input_stream_new_from_data (data, data_size, NULL);
+  g_autoptr (GInputStream) convin = g_converter_input_stream_new (in, converter);
+
+  gssize n_bytes_written = g_output_stream_splice (
+      out, convin, G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET | G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE, NULL,
+      &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (n_bytes_written, >=, 0);
+
+  return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (out));
+}
+
+static void
+helper_test_compress_decompress (const guint8 *data, gsize data_size, GVariant *params)
+{
+  g_autoptr (GConverter) compressor = (GConverter *)_ostree_zstd_compressor_new (params);
+  g_autoptr (GBytes) compressed = convert_all (compressor, data, data_size);
+  gsize compressed_size;
+  const guint8 *compressed_data = g_bytes_get_data (compressed, &compressed_size);
+
+  /* Always a complete frame, even for empty input */
+  g_assert_cmpuint (compressed_size, >=, 4);
+  g_assert_cmpint (memcmp (compressed_data, "\x28\xb5\x2f\xfd", 4), ==, 0);
+
+  g_autoptr (GConverter) decompressor = (GConverter *)_ostree_zstd_decompressor_new ();
+  g_autoptr (GBytes) decompressed = convert_all (decompressor, compressed_data, compressed_size);
+  gsize decompressed_size;
+  const guint8 *decompressed_data = g_bytes_get_data (decompressed, &decompressed_size);
+
+  g_assert_cmpuint (decompressed_size, ==, data_size);
+  if (data_size > 0)
+    g_assert_cmpint (memcmp (decompressed_data, data, data_size), ==, 0);
+}
+
+static void
+test_zstd_random (void)
+{
+  guint8 buffer[4096];
+  g_autoptr (GRand) r = g_rand_new ();
+  for (gsize i = 0; i < sizeof (buffer); i++)
+    buffer[i] = g_rand_int (r);
+
+  helper_test_compress_decompress (buffer, 0, NULL);
+  for (gsize i = 2; i < (sizeof (buffer) - 1); i *= 2)
+    {
+      helper_test_compress_decompress (buffer, i - 1, NULL);
+      helper_test_compress_decompress (buffer, i, NULL);
+      helper_test_compress_decompress (buffer, i + 1, NULL);
+    }
+}
+
+static void
+test_zstd_big_buffer (void)
+{
+  const guint32 buffer_size = 1 << 21;
+  g_autofree guint8 *buffer = g_new (guint8, buffer_size);
+  g_autoptr (GVariant) params = g_variant_ref_sink (g_variant_new_parsed ("{'level': <19>}"));
+
+  memset (buffer, (int)'a', buffer_size);
+
+  helper_test_compress_decompress (buffer, buffer_size, NULL);
+  helper_test_compress_decompress (buffer, buffer_size, params);
+}
+
+static void
+test_zstd_truncated (void)
+{
+  const guint32 buffer_size = 1 << 16;
+  g_autofree guint8 *buffer = g_new (guint8, buffer_size);
+  g_autoptr (GRand) r = g_rand_new ();
+  for (guint32 i = 0; i < buffer_size; i++)
+    buffer[i] = 'a' + g_rand_int_range (r, 0, 4);
+
+  g_autoptr (GConverter) compressor = (GConverter *)_ostree_zstd_compressor_new (NULL);
+  g_autoptr (GBytes) compressed = convert_all (compressor, buffer, buffer_size);
+  gsize compressed_size;
+  const guint8 *compressed_data = g_bytes_get_data (compressed, &compressed_size);
+
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GConverter) decompressor = (GConverter *)_ostree_zstd_decompressor_new ();
+  g_autoptr (GOutputStream) out = g_memory_output_stream_new_resizable ();
+  g_autoptr (GInputStream) in
+      = g_memory_input_stream_new_from_data (compressed_data, compressed_size / 2, NULL);
+  g_autoptr (GInputStream) convin = g_converter_input_stream_new (in, decompressor);
+  gssize n_bytes_written = g_output_stream_splice (out, convin, 0, NULL, &error);
+  g_assert_cmpint (n_bytes_written, <, 0);
+  g_assert_nonnull (error);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/zstd/random-buffer", test_zstd_random);
+  g_test_add_func ("/zstd/big-buffer", test_zstd_big_buffer);
+  g_test_add_func ("/zstd/truncated", test_zstd_truncated);
+
+  return g_test_run ();
+}